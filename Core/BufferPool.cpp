@@ -0,0 +1,248 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeaders.h"
+#include "BufferPool.h"
+
+#include "OrthancException.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace Orthanc
+{
+  static const size_t MIN_POOLED_SIZE = 16 * 1024;
+  static const size_t MAX_POOLED_SIZE = static_cast<size_t>(1) << 30;
+  static const uint64_t DEFAULT_MAXIMUM_IDLE_SIZE = 64 * 1024 * 1024;
+
+  // Each power of two is split into 4 buckets, so that at most 25% of
+  // an allocated buffer is wasted
+  static const unsigned int BUCKETS_PER_POWER = 4;
+
+
+  static bool LookupBucket(size_t& bucket,
+                           size_t& bucketSize,
+                           size_t size)
+  {
+    if (size < MIN_POOLED_SIZE ||
+        size > MAX_POOLED_SIZE)
+    {
+      return false;
+    }
+
+    // Find "k" such that "2^k <= size < 2^(k+1)"
+    unsigned int k = 0;
+    while ((static_cast<size_t>(2) << k) <= size)
+    {
+      k++;
+    }
+
+    const size_t base = static_cast<size_t>(1) << k;
+    const size_t step = base / BUCKETS_PER_POWER;
+    const size_t sub = (size - base + step - 1) / step;   // Between 0 and 4
+
+    bucket = BUCKETS_PER_POWER * k + sub;
+    bucketSize = base + sub * step;
+    return true;
+  }
+
+
+  BufferPool::Buffer::Buffer(size_t size) :
+    data_(BufferPool::GetInstance().Allocate(size)),
+    size_(size)
+  {
+  }
+
+
+  BufferPool::Buffer::~Buffer()
+  {
+    BufferPool::GetInstance().Release(data_, size_);
+  }
+
+
+  BufferPool::BufferPool()
+  {
+    memset(&statistics_, 0, sizeof(statistics_));
+    statistics_.maximumIdleSize_ = DEFAULT_MAXIMUM_IDLE_SIZE;
+  }
+
+
+  BufferPool::~BufferPool()
+  {
+    ClearInternal();
+  }
+
+
+  BufferPool& BufferPool::GetInstance()
+  {
+    static BufferPool instance;
+    return instance;
+  }
+
+
+  void BufferPool::ClearInternal()
+  {
+    for (size_t i = 0; i < buckets_.size(); i++)
+    {
+      for (size_t j = 0; j < buckets_[i].size(); j++)
+      {
+        free(buckets_[i][j]);
+      }
+
+      buckets_[i].clear();
+    }
+
+    statistics_.idleSize_ = 0;
+    statistics_.idleCount_ = 0;
+  }
+
+
+  void* BufferPool::Allocate(size_t size)
+  {
+    size_t bucket, bucketSize;
+    if (!LookupBucket(bucket, bucketSize, size))
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        statistics_.allocations_++;
+      }
+
+      if (size == 0)
+      {
+        return NULL;
+      }
+
+      void* buffer = malloc(size);
+      if (buffer == NULL)
+      {
+        throw OrthancException(ErrorCode_NotEnoughMemory);
+      }
+
+      return buffer;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      statistics_.allocations_++;
+
+      if (bucket < buckets_.size() &&
+          !buckets_[bucket].empty())
+      {
+        void* buffer = buckets_[bucket].back();
+        buckets_[bucket].pop_back();
+
+        statistics_.hits_++;
+        statistics_.idleSize_ -= bucketSize;
+        statistics_.idleCount_--;
+        statistics_.usedSize_ += bucketSize;
+        return buffer;
+      }
+
+      statistics_.usedSize_ += bucketSize;
+    }
+
+    // Allocate outside of the mutex
+    void* buffer = malloc(bucketSize);
+    if (buffer == NULL)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      statistics_.usedSize_ -= bucketSize;
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    return buffer;
+  }
+
+
+  void BufferPool::Release(void* buffer,
+                           size_t size)
+  {
+    if (buffer == NULL)
+    {
+      return;
+    }
+
+    size_t bucket, bucketSize;
+    if (!LookupBucket(bucket, bucketSize, size))
+    {
+      free(buffer);
+      return;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      statistics_.usedSize_ -= bucketSize;
+
+      if (statistics_.idleSize_ + bucketSize <= statistics_.maximumIdleSize_)
+      {
+        if (bucket >= buckets_.size())
+        {
+          buckets_.resize(bucket + 1);
+        }
+
+        buckets_[bucket].push_back(buffer);
+        statistics_.idleSize_ += bucketSize;
+        statistics_.idleCount_++;
+        return;
+      }
+    }
+
+    // The pool is full
+    free(buffer);
+  }
+
+
+  void BufferPool::SetMaximumIdleSize(uint64_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    statistics_.maximumIdleSize_ = size;
+
+    if (statistics_.idleSize_ > size)
+    {
+      ClearInternal();
+    }
+  }
+
+
+  void BufferPool::Clear()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    ClearInternal();
+  }
+
+
+  void BufferPool::GetStatistics(Statistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    target = statistics_;
+  }
+}
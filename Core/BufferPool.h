@@ -0,0 +1,120 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Pool of memory buffers, bucketed by size, that avoids going
+   * through the system allocator for the large and short-lived
+   * buffers of image decoding and encoding. The released buffers are
+   * kept for reuse, as long as the total size of the idle buffers
+   * stays below a global cap. Small buffers are directly handled by
+   * the system allocator. The compressed outputs of the encoders
+   * (e.g. the ChunkedBuffer of PngWriter) are not pooled. This class
+   * is thread-safe.
+   **/
+  class BufferPool : public boost::noncopyable
+  {
+  public:
+    struct Statistics
+    {
+      uint64_t  allocations_;   // Total number of calls to Allocate()
+      uint64_t  hits_;          // Allocations that reused an idle buffer
+      uint64_t  usedSize_;      // Size of the pooled buffers that are in use
+      uint64_t  idleSize_;      // Size of the idle buffers
+      uint64_t  idleCount_;     // Number of idle buffers
+      uint64_t  maximumIdleSize_;
+    };
+
+    // Buffer taken from the global pool, returned on destruction
+    class Buffer : public boost::noncopyable
+    {
+    private:
+      void*   data_;
+      size_t  size_;
+
+    public:
+      explicit Buffer(size_t size);
+
+      ~Buffer();
+
+      void* GetData()
+      {
+        return data_;
+      }
+
+      size_t GetSize() const
+      {
+        return size_;
+      }
+    };
+
+  private:
+    typedef std::vector<void*>  Bucket;
+
+    boost::mutex         mutex_;
+    std::vector<Bucket>  buckets_;
+    Statistics           statistics_;
+
+    void ClearInternal();
+
+  public:
+    BufferPool();
+
+    ~BufferPool();
+
+    static BufferPool& GetInstance();
+
+    // The returned buffer must be given back to Release(), with the
+    // same size
+    void* Allocate(size_t size);
+
+    void Release(void* buffer,
+                 size_t size);
+
+    // Cap on the total size of the idle buffers (the default is 64MB,
+    // "0" disables the pooling)
+    void SetMaximumIdleSize(uint64_t size);
+
+    // Frees all the idle buffers
+    void Clear();
+
+    void GetStatistics(Statistics& target);
+  };
+}
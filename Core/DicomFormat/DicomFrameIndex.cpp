@@ -0,0 +1,738 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomFrameIndex.h"
+
+#include "../OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+#include <glog/logging.h>
+#include <string.h>
+
+
+// http://dicom.nema.org/medical/dicom/current/output/html/part05.html#sect_7.1
+// http://dicom.nema.org/medical/dicom/current/output/html/part05.html#sect_A.4
+
+namespace Orthanc
+{
+  static const uint32_t UNDEFINED_LENGTH = 0xffffffffu;
+
+  static const uint32_t TAG_TRANSFER_SYNTAX = 0x00020010u;
+  static const uint32_t TAG_SAMPLES_PER_PIXEL = 0x00280002u;
+  static const uint32_t TAG_NUMBER_OF_FRAMES = 0x00280008u;
+  static const uint32_t TAG_ROWS = 0x00280010u;
+  static const uint32_t TAG_COLUMNS = 0x00280011u;
+  static const uint32_t TAG_BITS_ALLOCATED = 0x00280100u;
+  static const uint32_t TAG_PIXEL_REPRESENTATION = 0x00280103u;
+  static const uint32_t TAG_PIXEL_DATA = 0x7fe00010u;
+  static const uint32_t TAG_ITEM = 0xfffee000u;
+  static const uint32_t TAG_ITEM_DELIMITATION = 0xfffee00du;
+  static const uint32_t TAG_SEQUENCE_DELIMITATION = 0xfffee0ddu;
+
+
+  namespace
+  {
+    struct ElementHeader
+    {
+      uint32_t  tag_;
+      char      vr_[2];
+      uint32_t  length_;
+    };
+
+
+    class Reader
+    {
+    private:
+      const uint8_t*  data_;
+      size_t          size_;
+      size_t          position_;
+
+    public:
+      Reader(const void* data,
+             size_t size) :
+        data_(reinterpret_cast<const uint8_t*>(data)),
+        size_(size),
+        position_(0)
+      {
+      }
+
+      size_t GetPosition() const
+      {
+        return position_;
+      }
+
+      bool IsEnd() const
+      {
+        return position_ == size_;
+      }
+
+      size_t GetRemainingSize() const
+      {
+        return size_ - position_;
+      }
+
+      void Skip(uint64_t count)
+      {
+        if (count > static_cast<uint64_t>(size_ - position_))
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        position_ += static_cast<size_t>(count);
+      }
+
+      const uint8_t* Read(size_t count)
+      {
+        const uint8_t* p = data_ + position_;
+        Skip(count);
+        return p;
+      }
+
+      uint16_t ReadUInt16()
+      {
+        const uint8_t* p = Read(2);
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+      }
+
+      uint32_t ReadUInt32()
+      {
+        const uint8_t* p = Read(4);
+        return (static_cast<uint32_t>(p[0]) |
+                (static_cast<uint32_t>(p[1]) << 8) |
+                (static_cast<uint32_t>(p[2]) << 16) |
+                (static_cast<uint32_t>(p[3]) << 24));
+      }
+
+      uint32_t ReadTag()
+      {
+        uint32_t group = ReadUInt16();
+        uint32_t element = ReadUInt16();
+        return (group << 16) | element;
+      }
+
+      uint32_t PeekTag() const
+      {
+        if (size_ - position_ < 4)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        const uint8_t* p = data_ + position_;
+        return ((static_cast<uint32_t>(p[0] | (p[1] << 8)) << 16) |
+                static_cast<uint32_t>(p[2] | (p[3] << 8)));
+      }
+
+      std::string ReadString(uint32_t length)
+      {
+        const char* p = reinterpret_cast<const char*>(Read(length));
+        std::string s(p, length);
+
+        // Remove the padding (spaces and NULL characters)
+        size_t end = s.find_last_not_of(std::string(" \0", 2));
+        return (end == std::string::npos ? "" : s.substr(0, end + 1));
+      }
+    };
+  }
+
+
+  static bool HasLongLength(const char vr[2])
+  {
+    // VRs whose explicit encoding has a 32-bit length (PS 3.5, Table 7.1-1)
+    static const char* const LONG_VRS[] = {
+      "OB", "OD", "OF", "OL", "OW", "SQ", "UC", "UN", "UR", "UT"
+    };
+
+    for (size_t i = 0; i < sizeof(LONG_VRS) / sizeof(LONG_VRS[0]); i++)
+    {
+      if (vr[0] == LONG_VRS[i][0] &&
+          vr[1] == LONG_VRS[i][1])
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  static void ReadElementHeader(ElementHeader& header,
+                                Reader& reader,
+                                bool explicitVR)
+  {
+    header.tag_ = reader.ReadTag();
+    header.vr_[0] = header.vr_[1] = 0;
+
+    if (!explicitVR ||
+        (header.tag_ >> 16) == 0xfffe)   // Items and delimiters have no VR
+    {
+      header.length_ = reader.ReadUInt32();
+      return;
+    }
+
+    const uint8_t* vr = reader.Read(2);
+    header.vr_[0] = static_cast<char>(vr[0]);
+    header.vr_[1] = static_cast<char>(vr[1]);
+
+    if (HasLongLength(header.vr_))
+    {
+      reader.Skip(2);  // Reserved bytes
+      header.length_ = reader.ReadUInt32();
+    }
+    else
+    {
+      header.length_ = reader.ReadUInt16();
+    }
+  }
+
+
+  static void SkipSequence(Reader& reader,
+                           bool explicitVR);
+
+
+  static void SkipItemContent(Reader& reader,
+                              bool explicitVR)
+  {
+    // Skip the elements of an item of undefined length
+    for (;;)
+    {
+      ElementHeader header;
+      ReadElementHeader(header, reader, explicitVR);
+
+      if (header.tag_ == TAG_ITEM_DELIMITATION)
+      {
+        return;
+      }
+      else if (header.length_ == UNDEFINED_LENGTH)
+      {
+        // The content of UN elements of undefined length is encoded
+        // using implicit VR (PS 3.5, Section 6.2.2)
+        bool isUN = (header.vr_[0] == 'U' && header.vr_[1] == 'N');
+        SkipSequence(reader, explicitVR && !isUN);
+      }
+      else
+      {
+        reader.Skip(header.length_);
+      }
+    }
+  }
+
+
+  static void SkipSequence(Reader& reader,
+                           bool explicitVR)
+  {
+    // Skip the items of a sequence of undefined length
+    for (;;)
+    {
+      uint32_t tag = reader.ReadTag();
+      uint32_t length = reader.ReadUInt32();
+
+      if (tag == TAG_SEQUENCE_DELIMITATION)
+      {
+        return;
+      }
+      else if (tag != TAG_ITEM)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+      else if (length == UNDEFINED_LENGTH)
+      {
+        SkipItemContent(reader, explicitVR);
+      }
+      else
+      {
+        reader.Skip(length);
+      }
+    }
+  }
+
+
+  static unsigned int ReadUnsignedShort(Reader& reader,
+                                        const ElementHeader& header)
+  {
+    if (header.length_ != 2)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    return reader.ReadUInt16();
+  }
+
+
+  static void ReadMetaHeader(std::string& transferSyntax,
+                             bool& isExplicitVR,
+                             Reader& reader)
+  {
+    // Preamble and prefix
+    reader.Skip(128);
+    if (memcmp(reader.Read(4), "DICM", 4) != 0)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    // The meta header is always encoded as explicit VR little endian
+    while ((reader.PeekTag() >> 16) == 0x0002)
+    {
+      ElementHeader header;
+      ReadElementHeader(header, reader, true);
+
+      if (header.length_ == UNDEFINED_LENGTH)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+      else if (header.tag_ == TAG_TRANSFER_SYNTAX)
+      {
+        transferSyntax = reader.ReadString(header.length_);
+      }
+      else
+      {
+        reader.Skip(header.length_);
+      }
+    }
+
+    isExplicitVR = true;
+
+    if (transferSyntax == "1.2.840.10008.1.2")
+    {
+      isExplicitVR = false;
+    }
+    else if (transferSyntax.empty() ||
+             transferSyntax == "1.2.840.10008.1.2.2" ||      // Big endian
+             transferSyntax == "1.2.840.10008.1.2.1.99")     // Deflated
+    {
+      LOG(INFO) << "Cannot scan the raw bytes of a file with transfer syntax \""
+                << transferSyntax << "\"";
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  DicomFrameIndex::DicomFrameIndex(const void* dicom,
+                                   size_t size) :
+    isEncapsulated_(false),
+    isExplicitVR_(true),
+    pixelDataOffset_(0),
+    numberOfFramesOffset_(0),
+    numberOfFramesLength_(0),
+    rows_(0),
+    columns_(0),
+    samplesPerPixel_(1),
+    bitsAllocated_(0),
+    pixelRepresentation_(0)
+  {
+    pixelDataVR_[0] = 'O';
+    pixelDataVR_[1] = 'W';
+
+    Reader reader(dicom, size);
+    ReadMetaHeader(transferSyntax_, isExplicitVR_, reader);
+
+    const bool explicitVR = isExplicitVR_;
+
+    // Scan the dataset up to the pixel data
+    unsigned int numberOfFrames = 1;
+
+    ElementHeader header;
+    for (;;)
+    {
+      if (reader.IsEnd())
+      {
+        // No pixel data in this file
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      pixelDataOffset_ = reader.GetPosition();
+      ReadElementHeader(header, reader, explicitVR);
+
+      if (header.tag_ == TAG_PIXEL_DATA)
+      {
+        if (explicitVR)
+        {
+          pixelDataVR_[0] = header.vr_[0];
+          pixelDataVR_[1] = header.vr_[1];
+        }
+
+        break;
+      }
+      else if (header.length_ == UNDEFINED_LENGTH)
+      {
+        bool isUN = (header.vr_[0] == 'U' && header.vr_[1] == 'N');
+        SkipSequence(reader, explicitVR && !isUN);
+      }
+      else if (header.tag_ == TAG_SAMPLES_PER_PIXEL)
+      {
+        samplesPerPixel_ = ReadUnsignedShort(reader, header);
+      }
+      else if (header.tag_ == TAG_ROWS)
+      {
+        rows_ = ReadUnsignedShort(reader, header);
+      }
+      else if (header.tag_ == TAG_COLUMNS)
+      {
+        columns_ = ReadUnsignedShort(reader, header);
+      }
+      else if (header.tag_ == TAG_BITS_ALLOCATED)
+      {
+        bitsAllocated_ = ReadUnsignedShort(reader, header);
+      }
+      else if (header.tag_ == TAG_PIXEL_REPRESENTATION)
+      {
+        pixelRepresentation_ = ReadUnsignedShort(reader, header);
+      }
+      else if (header.tag_ == TAG_NUMBER_OF_FRAMES)
+      {
+        numberOfFramesOffset_ = reader.GetPosition();
+        numberOfFramesLength_ = header.length_;
+
+        try
+        {
+          numberOfFrames = boost::lexical_cast<unsigned int>(reader.ReadString(header.length_));
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+      }
+      else
+      {
+        reader.Skip(header.length_);
+      }
+    }
+
+    if (numberOfFrames == 0)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    // "numberOfFrames" comes from the file: It must be checked against
+    // the actual pixel data before allocating the index of the frames
+
+    if (header.length_ != UNDEFINED_LENGTH)
+    {
+      // Native pixel data: The frames are contiguous
+      if (bitsAllocated_ == 0 ||
+          bitsAllocated_ % 8 != 0)
+      {
+        throw OrthancException(ErrorCode_NotImplemented);
+      }
+
+      const uint64_t frameSize = (static_cast<uint64_t>(rows_) * columns_ * 
+                                  samplesPerPixel_ * (bitsAllocated_ / 8));
+      const uint64_t start = reader.GetPosition();
+
+      if (frameSize == 0 ||
+          numberOfFrames > header.length_ / frameSize)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      reader.Skip(header.length_);
+
+      frameStart_.resize(numberOfFrames);
+      frameEnd_.resize(numberOfFrames);
+
+      for (unsigned int i = 0; i < numberOfFrames; i++)
+      {
+        frameStart_[i] = start + i * frameSize;
+        frameEnd_[i] = frameStart_[i] + frameSize;
+      }
+
+      return;
+    }
+
+    // Encapsulated pixel data: Read the Basic Offset Table
+    isEncapsulated_ = true;
+
+    if (reader.ReadTag() != TAG_ITEM)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    uint32_t tableLength = reader.ReadUInt32();
+    if (tableLength % 4 != 0 ||
+        tableLength > reader.GetRemainingSize())
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    std::vector<uint32_t> offsets(tableLength / 4);
+    for (size_t i = 0; i < offsets.size(); i++)
+    {
+      offsets[i] = reader.ReadUInt32();
+    }
+
+    // Locate the fragment items
+    const uint64_t firstFragment = reader.GetPosition();
+    std::vector<uint64_t> fragments;
+
+    for (;;)
+    {
+      uint64_t position = reader.GetPosition();
+      uint32_t tag = reader.ReadTag();
+      uint32_t length = reader.ReadUInt32();
+
+      if (tag == TAG_SEQUENCE_DELIMITATION)
+      {
+        fragments.push_back(position);  // Sentinel
+        break;
+      }
+      else if (tag != TAG_ITEM ||
+               length == UNDEFINED_LENGTH)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      fragments.push_back(position);
+      reader.Skip(length);
+    }
+
+    const uint64_t end = fragments.back();
+    const size_t fragmentsCount = fragments.size() - 1;
+
+    // Each frame spans at least one fragment
+    if (numberOfFrames > 1 &&
+        numberOfFrames > fragmentsCount)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    frameStart_.resize(numberOfFrames);
+    frameEnd_.resize(numberOfFrames);
+
+    if (offsets.size() == numberOfFrames)
+    {
+      for (unsigned int i = 0; i < numberOfFrames; i++)
+      {
+        frameStart_[i] = firstFragment + offsets[i];
+        frameEnd_[i] = (i + 1 < numberOfFrames ? firstFragment + offsets[i + 1] : end);
+
+        if (frameStart_[i] > frameEnd_[i] ||
+            frameEnd_[i] > end)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+      }
+    }
+    else if (numberOfFrames == 1)
+    {
+      frameStart_[0] = firstFragment;
+      frameEnd_[0] = end;
+    }
+    else if (fragmentsCount == numberOfFrames)
+    {
+      // Empty offset table, but one fragment per frame
+      for (unsigned int i = 0; i < numberOfFrames; i++)
+      {
+        frameStart_[i] = fragments[i];
+        frameEnd_[i] = fragments[i + 1];
+      }
+    }
+    else
+    {
+      LOG(INFO) << "Cannot locate the frames of a multi-fragment image without a Basic Offset Table";
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  void DicomFrameIndex::GetFrameRange(uint64_t& start,
+                                      uint64_t& end,
+                                      unsigned int frame) const
+  {
+    if (frame >= frameStart_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    start = frameStart_[frame];
+    end = frameEnd_[frame];
+  }
+
+
+  static void AppendUInt16(std::string& target,
+                           uint16_t value)
+  {
+    target.push_back(static_cast<char>(value & 0xff));
+    target.push_back(static_cast<char>(value >> 8));
+  }
+
+
+  static void AppendUInt32(std::string& target,
+                           uint32_t value)
+  {
+    AppendUInt16(target, static_cast<uint16_t>(value & 0xffff));
+    AppendUInt16(target, static_cast<uint16_t>(value >> 16));
+  }
+
+
+  static void AppendTag(std::string& target,
+                        uint32_t tag)
+  {
+    AppendUInt16(target, static_cast<uint16_t>(tag >> 16));
+    AppendUInt16(target, static_cast<uint16_t>(tag & 0xffff));
+  }
+
+
+  void DicomFrameIndex::GetSingleFrameEnvelope(std::string& header,
+                                               std::string& trailer,
+                                               const void* dicom,
+                                               size_t size) const
+  {
+    if (size < pixelDataOffset_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    header.assign(reinterpret_cast<const char*>(dicom), static_cast<size_t>(pixelDataOffset_));
+    trailer.clear();
+
+    if (numberOfFramesLength_ > 0)
+    {
+      // Replace the value of "NumberOfFrames" by "1", padded with
+      // spaces so as to keep the length of the element unchanged
+      std::string value = "1" + std::string(numberOfFramesLength_ - 1, ' ');
+      header.replace(static_cast<size_t>(numberOfFramesOffset_), value.size(), value);
+    }
+
+    uint32_t length;
+    if (isEncapsulated_)
+    {
+      length = UNDEFINED_LENGTH;
+    }
+    else
+    {
+      length = static_cast<uint32_t>(frameEnd_[0] - frameStart_[0]);
+      if (length % 2 == 1)
+      {
+        // The length of a DICOM element must be even
+        length++;
+        trailer.push_back('\0');
+      }
+    }
+
+    AppendTag(header, TAG_PIXEL_DATA);
+
+    if (isExplicitVR_)
+    {
+      header.push_back(pixelDataVR_[0]);
+      header.push_back(pixelDataVR_[1]);
+      AppendUInt16(header, 0);  // Reserved bytes
+    }
+
+    AppendUInt32(header, length);
+
+    if (isEncapsulated_)
+    {
+      // Empty Basic Offset Table, as the frame is alone
+      AppendTag(header, TAG_ITEM);
+      AppendUInt32(header, 0);
+
+      AppendTag(trailer, TAG_SEQUENCE_DELIMITATION);
+      AppendUInt32(trailer, 0);
+    }
+  }
+
+
+  void DicomFrameIndex::ParseFragments(Fragments& fragments,
+                                       const void* items,
+                                       size_t size)
+  {
+    fragments.clear();
+
+    Reader reader(items, size);
+    while (!reader.IsEnd())
+    {
+      if (reader.ReadTag() != TAG_ITEM)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      uint32_t length = reader.ReadUInt32();
+      fragments.push_back(std::make_pair(reader.GetPosition(), static_cast<size_t>(length)));
+      reader.Skip(length);
+    }
+  }
+
+
+  bool DicomFrameIndex::LocatePixelData(uint64_t& start,
+                                        uint64_t& end,
+                                        const void* dicom,
+                                        size_t size)
+  {
+    try
+    {
+      Reader reader(dicom, size);
+
+      std::string transferSyntax;
+      bool explicitVR;
+      ReadMetaHeader(transferSyntax, explicitVR, reader);
+
+      while (!reader.IsEnd())
+      {
+        start = reader.GetPosition();
+
+        ElementHeader header;
+        ReadElementHeader(header, reader, explicitVR);
+
+        if (header.tag_ == TAG_PIXEL_DATA)
+        {
+          if (header.length_ == UNDEFINED_LENGTH)
+          {
+            // Encapsulated pixel data: Skip the fragment items
+            SkipSequence(reader, false);
+          }
+          else
+          {
+            reader.Skip(header.length_);
+          }
+
+          end = reader.GetPosition();
+          return true;
+        }
+        else if (header.length_ == UNDEFINED_LENGTH)
+        {
+          bool isUN = (header.vr_[0] == 'U' && header.vr_[1] == 'N');
+          SkipSequence(reader, explicitVR && !isUN);
+        }
+        else
+        {
+          reader.Skip(header.length_);
+        }
+      }
+
+      return false;   // No pixel data in this file
+    }
+    catch (OrthancException&)
+    {
+      return false;
+    }
+  }
+}
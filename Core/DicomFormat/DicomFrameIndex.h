@@ -0,0 +1,155 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Index of the frames of a DICOM file. It is computed by scanning
+   * the raw bytes of the file up to the pixel data element, without
+   * decoding the values of the other elements. For native transfer
+   * syntaxes, each frame is a contiguous range of the pixel data.
+   * For encapsulated transfer syntaxes, each frame is a range of
+   * fragment items, located through the Basic Offset Table.
+   **/
+  class DicomFrameIndex : public boost::noncopyable
+  {
+  private:
+    bool                   isEncapsulated_;
+    bool                   isExplicitVR_;
+    char                   pixelDataVR_[2];
+    uint64_t               pixelDataOffset_;
+    uint64_t               numberOfFramesOffset_;
+    uint32_t               numberOfFramesLength_;
+    std::string            transferSyntax_;
+    unsigned int           rows_;
+    unsigned int           columns_;
+    unsigned int           samplesPerPixel_;
+    unsigned int           bitsAllocated_;
+    unsigned int           pixelRepresentation_;
+    std::vector<uint64_t>  frameStart_;
+    std::vector<uint64_t>  frameEnd_;
+
+  public:
+    typedef std::vector< std::pair<size_t, size_t> >  Fragments;
+
+    // Throws "ErrorCode_NotImplemented" if the file cannot be indexed
+    // (e.g. big endian or deflated transfer syntaxes)
+    DicomFrameIndex(const void* dicom,
+                    size_t size);
+
+    bool IsEncapsulated() const
+    {
+      return isEncapsulated_;
+    }
+
+    const std::string& GetTransferSyntax() const
+    {
+      return transferSyntax_;
+    }
+
+    unsigned int GetRows() const
+    {
+      return rows_;
+    }
+
+    unsigned int GetColumns() const
+    {
+      return columns_;
+    }
+
+    unsigned int GetSamplesPerPixel() const
+    {
+      return samplesPerPixel_;
+    }
+
+    unsigned int GetBitsAllocated() const
+    {
+      return bitsAllocated_;
+    }
+
+    unsigned int GetPixelRepresentation() const
+    {
+      return pixelRepresentation_;
+    }
+
+    // Offset of the pixel data element, i.e. the size of the part of
+    // the file that contains all the other DICOM tags
+    uint64_t GetPixelDataOffset() const
+    {
+      return pixelDataOffset_;
+    }
+
+    unsigned int GetFramesCount() const
+    {
+      return static_cast<unsigned int>(frameStart_.size());
+    }
+
+    // Range of bytes [start, end) of the frame in the DICOM file. For
+    // encapsulated frames, this range contains the fragment items.
+    void GetFrameRange(uint64_t& start,
+                       uint64_t& end,
+                       unsigned int frame) const;
+
+    // Computes the bytes to be put around the range of one frame in
+    // order to create a valid DICOM file that only contains this
+    // frame. The "header" is the part of "dicom" before the pixel
+    // data, with "NumberOfFrames" patched to 1, followed by the
+    // header of the new pixel data element.
+    void GetSingleFrameEnvelope(std::string& header,
+                                std::string& trailer,
+                                const void* dicom,
+                                size_t size) const;
+
+    // Locates the content of the fragments (as pairs "offset, size")
+    // in the fragment items of one encapsulated frame
+    static void ParseFragments(Fragments& fragments,
+                               const void* items,
+                               size_t size);
+
+    // Locates the range of bytes [start, end) of the pixel data
+    // element, without the other requirements of the constructor on
+    // the image. Returns "false" if the file has no pixel data, or if
+    // it cannot be scanned.
+    static bool LocatePixelData(uint64_t& start,
+                                uint64_t& end,
+                                const void* dicom,
+                                size_t size);
+  };
+}
@@ -36,6 +36,7 @@
 #include <stdio.h>
 #include <memory>
 #include "DicomString.h"
+#include "DicomNullValue.h"
 #include "DicomArray.h"
 #include "../OrthancException.h"
 
@@ -101,24 +102,103 @@ namespace Orthanc
 
 
 
-  void DicomMap::SetValue(uint16_t group, 
-                          uint16_t element, 
-                          DicomValue* value)
+  void DicomMap::Value::Assign(const DicomValue& value)
   {
-    DicomTag tag(group, element);
-    Map::iterator it = map_.find(tag);
+    isNull_ = value.IsNull();
+
+    if (isNull_)
+    {
+      value_.clear();
+    }
+    else
+    {
+      value_ = value.AsString();
+    }
+  }
 
-    if (it != map_.end())
+
+  DicomValue* DicomMap::Value::Clone() const
+  {
+    if (isNull_)
     {
-      delete it->second;
-      it->second = value;
+      return new DicomNullValue;
     }
     else
     {
-      map_.insert(std::make_pair(tag, value));
+      return new DicomString(value_);
     }
   }
 
+
+  std::string DicomMap::Value::AsString() const
+  {
+    if (isNull_)
+    {
+      return "(null)";
+    }
+    else
+    {
+      return value_;
+    }
+  }
+
+
+  size_t DicomMap::LowerBound(uint32_t tag) const
+  {
+    // Index of the first entry whose tag is not less than "tag"
+    size_t first = 0;
+    size_t count = content_.size();
+
+    while (count > 0)
+    {
+      size_t half = count / 2;
+      if (content_[first + half].tag_ < tag)
+      {
+        first += half + 1;
+        count -= half + 1;
+      }
+      else
+      {
+        count = half;
+      }
+    }
+
+    return first;
+  }
+
+
+  DicomMap::Value& DicomMap::Access(uint32_t tag)
+  {
+    // Fast path for the tags that are added in increasing order,
+    // which is the order of the elements of a DICOM dataset
+    if (content_.empty() ||
+        content_.back().tag_ < tag)
+    {
+      content_.push_back(Entry());
+      content_.back().tag_ = tag;
+      return content_.back().value_;
+    }
+
+    size_t index = LowerBound(tag);
+    if (content_[index].tag_ != tag)
+    {
+      Entry entry;
+      entry.tag_ = tag;
+      content_.insert(content_.begin() + index, entry);
+    }
+
+    return content_[index].value_;
+  }
+
+
+  void DicomMap::SetValue(uint16_t group, 
+                          uint16_t element, 
+                          DicomValue* value)
+  {
+    std::auto_ptr<DicomValue> tmp(value);
+    Access(Pack(group, element)).Assign(*value);
+  }
+
   void DicomMap::SetValue(DicomTag tag, 
                           DicomValue* value)
   {
@@ -130,12 +210,7 @@ namespace Orthanc
 
   void DicomMap::Clear()
   {
-    for (Map::iterator it = map_.begin(); it != map_.end(); ++it)
-    {
-      delete it->second;
-    }
-
-    map_.clear();
+    content_.clear();
   }
 
 
@@ -144,13 +219,14 @@ namespace Orthanc
                              size_t count) const
   {
     result.Clear();
+    result.content_.reserve(count);
 
     for (unsigned int i = 0; i < count; i++)
     {
-      Map::const_iterator it = map_.find(tags[i]);
-      if (it != map_.end())
+      const DicomValue* value = TestAndGetValue(tags[i]);
+      if (value != NULL)
       {
-        result.SetValue(it->first, it->second->Clone());
+        result.SetValue(tags[i], *value);
       }
     }
   }
@@ -181,24 +257,14 @@ namespace Orthanc
   DicomMap* DicomMap::Clone() const
   {
     std::auto_ptr<DicomMap> result(new DicomMap);
-
-    for (Map::const_iterator it = map_.begin(); it != map_.end(); ++it)
-    {
-      result->map_.insert(std::make_pair(it->first, it->second->Clone()));
-    }
-
+    result->content_ = content_;
     return result.release();
   }
 
 
   void DicomMap::Assign(const DicomMap& other)
   {
-    Clear();
-
-    for (Map::const_iterator it = other.map_.begin(); it != other.map_.end(); ++it)
-    {
-      map_.insert(std::make_pair(it->first, it->second->Clone()));
-    }
+    content_ = other.content_;
   }
 
 
@@ -219,26 +285,30 @@ namespace Orthanc
 
   const DicomValue* DicomMap::TestAndGetValue(const DicomTag& tag) const
   {
-    Map::const_iterator it = map_.find(tag);
+    const uint32_t packed = Pack(tag);
+    size_t index = LowerBound(packed);
 
-    if (it == map_.end())
+    if (index == content_.size() ||
+        content_[index].tag_ != packed)
     {
       return NULL;
     }
     else
     {
-      return it->second;
+      return &content_[index].value_;
     }
   }
 
 
   void DicomMap::Remove(const DicomTag& tag) 
   {
-    Map::iterator it = map_.find(tag);
-    if (it != map_.end())
+    const uint32_t packed = Pack(tag);
+    size_t index = LowerBound(packed);
+
+    if (index < content_.size() &&
+        content_[index].tag_ == packed)
     {
-      delete it->second;
-      map_.erase(it);
+      content_.erase(content_.begin() + index);
     }
   }
 
@@ -422,10 +492,10 @@ namespace Orthanc
   {
     tags.clear();
 
-    for (Map::const_iterator it = map_.begin();
-         it != map_.end(); ++it)
+    for (Content::const_iterator it = content_.begin();
+         it != content_.end(); ++it)
     {
-      tags.insert(it->first);
+      tags.insert(it->GetTag());
     }
   }
 }
@@ -38,7 +38,7 @@
 #include "../Enumerations.h"
 
 #include <set>
-#include <map>
+#include <vector>
 #include <json/json.h>
 
 namespace Orthanc
@@ -50,9 +50,92 @@ namespace Orthanc
     friend class FromDcmtkBridge;
     friend class ToDcmtkBridge;
 
-    typedef std::map<DicomTag, DicomValue*>  Map;
+    /**
+     * Value that is stored inline in the map. This class is copyable,
+     * as opposed to the other subclasses of "DicomValue", so that it
+     * can be put in a vector.
+     **/
+    class Value : public DicomValue
+    {
+    private:
+      std::string  value_;
+      bool         isNull_;
+
+    public:
+      Value() : isNull_(true)
+      {
+      }
+
+      Value(const Value& other) :
+        DicomValue(),
+        value_(other.value_),
+        isNull_(other.isNull_)
+      {
+      }
+
+      Value& operator= (const Value& other)
+      {
+        value_ = other.value_;
+        isNull_ = other.isNull_;
+        return *this;
+      }
+
+      void Assign(const DicomValue& value);
+
+      void Assign(const std::string& value)
+      {
+        value_ = value;
+        isNull_ = false;
+      }
+
+      virtual DicomValue* Clone() const;
+
+      virtual std::string AsString() const;
+
+      virtual bool IsNull() const
+      {
+        return isNull_;
+      }
+    };
+
+    struct Entry
+    {
+      uint32_t  tag_;    // Group in the high 16 bits, element in the low 16 bits
+      Value     value_;
+
+      DicomTag GetTag() const
+      {
+        return DicomTag(static_cast<uint16_t>(tag_ >> 16), 
+                        static_cast<uint16_t>(tag_ & 0xffff));
+      }
+    };
+
+    /**
+     * The entries are sorted by their packed tag, which corresponds
+     * to the order of the DICOM tags. As opposed to a "std::map", no
+     * memory is allocated for each tag, and copying a map only
+     * allocates one block.
+     **/
+    typedef std::vector<Entry>  Content;
+
+    Content content_;
+
+    static uint32_t Pack(uint16_t group,
+                         uint16_t element)
+    {
+      return (static_cast<uint32_t>(group) << 16) | element;
+    }
+
+    static uint32_t Pack(const DicomTag& tag)
+    {
+      return Pack(tag.GetGroup(), tag.GetElement());
+    }
+
+    size_t LowerBound(uint32_t tag) const;
 
-    Map map_;
+    // Returns the value associated with the tag, which is created
+    // (as a null value) if it does not exist yet
+    Value& Access(uint32_t tag);
 
     // Warning: This takes the ownership of "value"
     void SetValue(uint16_t group, 
@@ -73,14 +156,9 @@ namespace Orthanc
     {
     }
 
-    ~DicomMap()
-    {
-      Clear();
-    }
-
     size_t GetSize() const
     {
-      return map_.size();
+      return content_.size();
     }
     
     DicomMap* Clone() const;
@@ -93,26 +171,26 @@ namespace Orthanc
                   uint16_t element, 
                   const DicomValue& value)
     {
-      SetValue(group, element, value.Clone());
+      Access(Pack(group, element)).Assign(value);
     }
 
     void SetValue(const DicomTag& tag,
                   const DicomValue& value)
     {
-      SetValue(tag, value.Clone());
+      Access(Pack(tag)).Assign(value);
     }
 
     void SetValue(const DicomTag& tag,
                   const std::string& str)
     {
-      SetValue(tag, new DicomString(str));
+      Access(Pack(tag)).Assign(str);
     }
 
     void SetValue(uint16_t group, 
                   uint16_t element, 
                   const std::string& str)
     {
-      SetValue(group, element, new DicomString(str));
+      Access(Pack(group, element)).Assign(str);
     }
 
     bool HasTag(uint16_t group, uint16_t element) const
@@ -122,7 +200,7 @@ namespace Orthanc
 
     bool HasTag(const DicomTag& tag) const
     {
-      return map_.find(tag) != map_.end();
+      return TestAndGetValue(tag) != NULL;
     }
 
     const DicomValue& GetValue(uint16_t group, uint16_t element) const
@@ -132,7 +210,8 @@ namespace Orthanc
 
     const DicomValue& GetValue(const DicomTag& tag) const;
 
-    // DO NOT delete the returned value!
+    // DO NOT delete the returned value! The returned references and
+    // pointers are invalidated by the next modification of the map.
     const DicomValue* TestAndGetValue(uint16_t group, uint16_t element) const
     {
       return TestAndGetValue(DicomTag(group, element));
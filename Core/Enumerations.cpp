@@ -493,6 +493,25 @@ namespace Orthanc
   }
 
 
+  ImageInterpolation StringToImageInterpolation(const char* interpolation)
+  {
+    std::string s(interpolation);
+    Toolbox::ToUpperCase(s);
+
+    if (s == "BOX")
+    {
+      return ImageInterpolation_Box;
+    }
+
+    if (s == "BILINEAR")
+    {
+      return ImageInterpolation_Bilinear;
+    }
+
+    throw OrthancException(ErrorCode_ParameterOutOfRange);
+  }
+
+
   unsigned int GetBytesPerPixel(PixelFormat format)
   {
     switch (format)
@@ -231,6 +231,25 @@ namespace Orthanc
   };
 
 
+  enum ImageInterpolation
+  {
+    ImageInterpolation_Box,       // Area averaging, suited for downscaling
+    ImageInterpolation_Bilinear
+  };
+
+
+  // http://www.w3.org/TR/PNG/#9Filters
+  enum PngFilter
+  {
+    PngFilter_Adaptive,   // Best filter for each row (default of libpng)
+    PngFilter_None,
+    PngFilter_Sub,
+    PngFilter_Up,
+    PngFilter_Average,
+    PngFilter_Paeth
+  };
+
+
   // http://www.dabsoft.ch/dicom/3/C.12.1.1.2/
   enum Encoding
   {
@@ -336,6 +355,8 @@ namespace Orthanc
 
   ImageFormat StringToImageFormat(const char* format);
 
+  ImageInterpolation StringToImageInterpolation(const char* interpolation);
+
   unsigned int GetBytesPerPixel(PixelFormat format);
 
   bool GetDicomEncoding(Encoding& encoding,
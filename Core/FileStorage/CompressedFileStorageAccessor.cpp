@@ -144,6 +144,40 @@ namespace Orthanc
     }
   }
 
+
+  void CompressedFileStorageAccessor::ReadRange(std::string& content,
+                                                const std::string& uuid,
+                                                FileContentType type,
+                                                uint64_t start,
+                                                uint64_t end)
+  {
+    switch (compressionType_)
+    {
+    case CompressionType_None:
+      GetStorageArea().ReadRange(content, uuid, type, start, end);
+      break;
+
+    case CompressionType_Zlib:
+    {
+      std::string uncompressed;
+      Read(uncompressed, uuid, type);
+
+      if (start > end ||
+          end > uncompressed.size())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      content = uncompressed.substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
+      break;
+    }
+
+    default:
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
   HttpFileSender* CompressedFileStorageAccessor::ConstructHttpFileSender(const std::string& uuid,
                                                                          FileContentType type)
   {
@@ -81,6 +81,14 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type);
 
+    // Reads the range [start, end) of the uncompressed content. Only
+    // uncompressed files benefit from random access in the storage area.
+    void ReadRange(std::string& content,
+                   const std::string& uuid,
+                   FileContentType type,
+                   uint64_t start,
+                   uint64_t end);
+
     virtual HttpFileSender* ConstructHttpFileSender(const std::string& uuid,
                                                     FileContentType type);
 
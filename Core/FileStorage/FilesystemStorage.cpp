@@ -149,6 +149,46 @@ namespace Orthanc
   }
 
 
+  void FilesystemStorage::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType /*type*/,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    if (start > end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::filesystem::ifstream f;
+    f.open(GetPath(uuid), std::ifstream::in | std::ifstream::binary);
+    if (!f.good())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    f.seekg(0, std::ios::end);
+    if (static_cast<uint64_t>(f.tellg()) < end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    content.resize(static_cast<size_t>(end - start));
+    if (!content.empty())
+    {
+      f.seekg(start, std::ios::beg);
+      f.read(&content[0], content.size());
+
+      if (!f.good())
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+
+    f.close();
+  }
+
+
   uintmax_t FilesystemStorage::GetSize(const std::string& uuid) const
   {
     boost::filesystem::path path = GetPath(uuid);
@@ -33,7 +33,9 @@
 #pragma once
 
 #include "../Enumerations.h"
+#include "../OrthancException.h"
 
+#include <stdint.h>
 #include <string>
 #include <boost/noncopyable.hpp>
 
@@ -57,5 +59,26 @@ namespace Orthanc
 
     virtual void Remove(const std::string& uuid,
                         FileContentType type) = 0;
+
+    // Reads the range of bytes [start, end) of a file. Storage areas
+    // that support random access should override this default
+    // implementation, which reads the whole file.
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end)
+    {
+      std::string file;
+      Read(file, uuid, type);
+
+      if (start > end ||
+          end > file.size())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      content = file.substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
+    }
   };
 }
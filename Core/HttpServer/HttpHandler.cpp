@@ -33,8 +33,11 @@
 #include "../PrecompiledHeaders.h"
 #include "HttpHandler.h"
 
+#include "../OrthancException.h"
+
 #include <string.h>
 #include <iostream>
+#include <boost/lexical_cast.hpp>
 
 
 namespace Orthanc
@@ -188,4 +191,251 @@ namespace Orthanc
       compiled[source[i].first] = source[i].second;
     }
   }
+
+
+  static bool ParseRangeBound(uint64_t& target,
+                              const std::string& value)
+  {
+    // Only digits are allowed ("boost::lexical_cast" would accept a
+    // minus sign, and wrap the value around)
+    if (value.empty() ||
+        value.find_first_not_of("0123456789") != std::string::npos)
+    {
+      return false;
+    }
+
+    try
+    {
+      target = boost::lexical_cast<uint64_t>(value);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;  // Overflow
+    }
+  }
+
+
+  bool HttpHandler::ParseRange(bool& satisfiable,
+                               uint64_t& start,
+                               uint64_t& end,
+                               const std::string& range,
+                               uint64_t size)
+  {
+    // http://tools.ietf.org/html/rfc7233#section-2.1
+    satisfiable = false;
+
+    std::string s = Toolbox::StripSpaces(range);
+    if (s.compare(0, 6, "bytes=") != 0)
+    {
+      return false;
+    }
+
+    s = s.substr(6);
+    size_t dash = s.find('-');
+    if (dash == std::string::npos ||
+        s.find(',') != std::string::npos)   // Multiple ranges are not supported
+    {
+      return false;
+    }
+
+    std::string first = Toolbox::StripSpaces(s.substr(0, dash));
+    std::string last = Toolbox::StripSpaces(s.substr(dash + 1));
+
+    if (first.empty())
+    {
+      // Suffix range: The last bytes of the resource
+      uint64_t length;
+      if (!ParseRangeBound(length, last))
+      {
+        return false;
+      }
+
+      if (length != 0 &&
+          size != 0)
+      {
+        start = (length > size ? 0 : size - length);
+        end = size;
+        satisfiable = true;
+      }
+
+      return true;
+    }
+
+    if (!ParseRangeBound(start, first))
+    {
+      return false;
+    }
+
+    if (last.empty())
+    {
+      end = size;
+    }
+    else
+    {
+      uint64_t lastByte;
+      if (!ParseRangeBound(lastByte, last) ||
+          lastByte < start)
+      {
+        return false;
+      }
+
+      end = (lastByte >= size ? size : lastByte + 1);
+    }
+
+    satisfiable = (start < size);
+    return true;
+  }
+
+
+  static bool ParseMediaRange(std::string& type,
+                              std::string& subtype,
+                              float& quality,
+                              const std::string& item)
+  {
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, item, ';');
+
+    std::string range = Toolbox::StripSpaces(tokens[0]);
+    Toolbox::ToLowerCase(range);
+
+    size_t slash = range.find('/');
+    if (slash == std::string::npos)
+    {
+      return false;
+    }
+
+    type = range.substr(0, slash);
+    subtype = range.substr(slash + 1);
+
+    if (type.empty() ||
+        subtype.empty() ||
+        (type == "*" && subtype != "*"))
+    {
+      return false;
+    }
+
+    quality = 1.0f;
+
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+      std::string parameter = Toolbox::StripSpaces(tokens[i]);
+      Toolbox::ToLowerCase(parameter);
+
+      if (parameter.compare(0, 2, "q=") == 0)
+      {
+        try
+        {
+          quality = boost::lexical_cast<float>(Toolbox::StripSpaces(parameter.substr(2)));
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+          return false;
+        }
+
+        if (quality < 0.0f ||
+            quality > 1.0f)
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+
+  bool HttpHandler::SelectMediaType(size_t& selected,
+                                    const std::string& accept,
+                                    const std::vector<std::string>& candidates)
+  {
+    if (candidates.empty())
+    {
+      return false;
+    }
+
+    if (Toolbox::StripSpaces(accept).empty())
+    {
+      // No "Accept" header: All the media types are acceptable
+      selected = 0;
+      return true;
+    }
+
+    std::vector<std::string> items;
+    Toolbox::TokenizeString(items, accept, ',');
+
+    bool found = false;
+    float bestQuality = 0.0f;
+    size_t bestPosition = 0;
+
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+      std::string candidate = candidates[i];
+      Toolbox::ToLowerCase(candidate);
+
+      size_t slash = candidate.find('/');
+      if (slash == std::string::npos)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      const std::string candidateType = candidate.substr(0, slash);
+      const std::string candidateSubtype = candidate.substr(slash + 1);
+
+      // Look for the most specific range that matches the candidate:
+      // "type/subtype", then "type/*", then "*/*"
+      int specificity = -1;
+      float quality = 0.0f;
+      size_t position = 0;
+
+      for (size_t j = 0; j < items.size(); j++)
+      {
+        std::string type, subtype;
+        float q;
+        if (!ParseMediaRange(type, subtype, q, items[j]))
+        {
+          continue;  // Ignore the malformed ranges
+        }
+
+        int s;
+        if (type == candidateType && subtype == candidateSubtype)
+        {
+          s = 2;
+        }
+        else if (type == candidateType && subtype == "*")
+        {
+          s = 1;
+        }
+        else if (type == "*")
+        {
+          s = 0;
+        }
+        else
+        {
+          continue;
+        }
+
+        if (s > specificity)
+        {
+          specificity = s;
+          quality = q;
+          position = j;
+        }
+      }
+
+      if (specificity >= 0 &&
+          quality > 0.0f &&
+          (!found ||
+           quality > bestQuality ||
+           (quality == bestQuality && position < bestPosition)))
+      {
+        found = true;
+        selected = i;
+        bestQuality = quality;
+        bestPosition = position;
+      }
+    }
+
+    return found;
+  }
 }
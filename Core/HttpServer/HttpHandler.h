@@ -78,5 +78,27 @@ namespace Orthanc
 
     static void CompileGetArguments(Arguments& compiled,
                                     const GetArguments& source);
+
+    // Parses the value of a "Range" HTTP header that contains a
+    // single range of bytes, for a resource of "size" bytes. Returns
+    // "false" if the header is invalid or unsupported, in which case
+    // it must be ignored (RFC 7233). Otherwise, "satisfiable" tells
+    // whether the range [start, end) overlaps the resource.
+    static bool ParseRange(bool& satisfiable,
+                           uint64_t& start,
+                           uint64_t& end,
+                           const std::string& range,
+                           uint64_t size);
+
+    // Content negotiation (RFC 7231, section 5.3.2): Selects the
+    // candidate media type (such as "image/png") with the highest
+    // quality in the value of an "Accept" HTTP header. The quality of
+    // a candidate is the "q" parameter of its most specific matching
+    // range ("q=0" means "not acceptable"). Ties are broken by the
+    // order of the ranges in the header. Returns "false" if no
+    // candidate is acceptable.
+    static bool SelectMediaType(size_t& selected,
+                                const std::string& accept,
+                                const std::vector<std::string>& candidates);
   };
 }
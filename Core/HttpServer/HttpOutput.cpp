@@ -36,10 +36,12 @@
 #include <iostream>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 #include <glog/logging.h>
 #include <boost/lexical_cast.hpp>
 #include "../OrthancException.h"
 #include "../Toolbox.h"
+#include "../Uuid.h"
 
 namespace Orthanc
 {
@@ -66,6 +68,11 @@ namespace Orthanc
     {
       LOG(ERROR) << "This HTTP answer has not sent the proper number of bytes in its body";
     }
+
+    if (state_ == State_WritingChunks)
+    {
+      LOG(ERROR) << "This chunked HTTP answer has not been closed";
+    }
   }
 
 
@@ -151,37 +158,21 @@ namespace Orthanc
       }
     }
 
+    if (state_ == State_WritingChunks)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
     if (state_ == State_WritingHeader)
     {
       // Send the HTTP header before writing the body
-
-      stream_.OnHttpStatusReceived(status_);
-
-      std::string s = "HTTP/1.1 " + 
-        boost::lexical_cast<std::string>(status_) +
-        " " + std::string(EnumerationToString(status_)) +
-        "\r\n";
-
-      if (keepAlive_)
-      {
-        s += "Connection: keep-alive\r\n";
-      }
-
-      for (std::list<std::string>::const_iterator
-             it = headers_.begin(); it != headers_.end(); ++it)
-      {
-        s += *it;
-      }
-
       if (status_ != HttpStatus_200_Ok)
       {
         hasContentLength_ = false;
       }
 
       uint64_t contentLength = (hasContentLength_ ? contentLength_ : length);
-      s += "Content-Length: " + boost::lexical_cast<std::string>(contentLength) + "\r\n\r\n";
-
-      stream_.Send(true, s.c_str(), s.size());
+      SendHeader("Content-Length: " + boost::lexical_cast<std::string>(contentLength) + "\r\n");
       state_ = State_WritingBody;
     }
 
@@ -206,6 +197,172 @@ namespace Orthanc
   }
 
 
+  void HttpOutput::StateMachine::SendHeader(const std::string& lengthHeader)
+  {
+    stream_.OnHttpStatusReceived(status_);
+
+    std::string s = "HTTP/1.1 " + 
+      boost::lexical_cast<std::string>(status_) +
+      " " + std::string(EnumerationToString(status_)) +
+      "\r\n";
+
+    if (keepAlive_)
+    {
+      s += "Connection: keep-alive\r\n";
+    }
+
+    for (std::list<std::string>::const_iterator
+           it = headers_.begin(); it != headers_.end(); ++it)
+    {
+      s += *it;
+    }
+
+    s += lengthHeader + "\r\n";
+
+    stream_.Send(true, s.c_str(), s.size());
+  }
+
+
+  void HttpOutput::StateMachine::StartChunkedTransfer()
+  {
+    if (state_ != State_WritingHeader ||
+        hasContentLength_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (stream_.IsChunkedTransferEncoding())
+    {
+      SendHeader("Transfer-Encoding: chunked\r\n");
+    }
+    else
+    {
+      SendHeader("");
+    }
+
+    state_ = State_WritingChunks;
+  }
+
+
+  void HttpOutput::StateMachine::SendChunk(const void* buffer, size_t length)
+  {
+    if (state_ != State_WritingChunks)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (length == 0)
+    {
+      // An empty chunk would terminate the transfer
+      return;
+    }
+
+    if (stream_.IsChunkedTransferEncoding())
+    {
+      char size[32];
+      sprintf(size, "%lx\r\n", static_cast<unsigned long>(length));
+
+      stream_.Send(false, size, strlen(size));
+      stream_.Send(false, buffer, length);
+      stream_.Send(false, "\r\n", 2);
+    }
+    else
+    {
+      stream_.Send(false, buffer, length);
+    }
+  }
+
+
+  void HttpOutput::StateMachine::CloseChunkedTransfer()
+  {
+    if (state_ != State_WritingChunks)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (stream_.IsChunkedTransferEncoding())
+    {
+      stream_.Send(false, "0\r\n\r\n", 5);
+    }
+
+    state_ = State_Done;
+  }
+
+
+  void HttpOutput::SendChunk(const std::string& chunk)
+  {
+    if (chunk.size() > 0)
+    {
+      stateMachine_.SendChunk(chunk.c_str(), chunk.size());
+    }
+  }
+
+
+  void HttpOutput::StartMultipart(const std::string& subType,
+                                  const std::string& contentType)
+  {
+    if (isMultipart_ ||
+        subType.empty() ||
+        subType.find_first_of("\r\n\"") != std::string::npos ||
+        contentType.find_first_of("\r\n\"") != std::string::npos)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    multipartBoundary_ = Toolbox::GenerateUuid();
+    multipartContentType_ = contentType;
+
+    std::string header = "multipart/" + subType;
+    if (!contentType.empty())
+    {
+      header += "; type=\"" + contentType + "\"";
+    }
+
+    header += "; boundary=" + multipartBoundary_;
+
+    stateMachine_.AddHeader("Content-Type", header);
+    stateMachine_.StartChunkedTransfer();
+    isMultipart_ = true;
+  }
+
+
+  void HttpOutput::SendMultipartItem(const void* item, size_t length)
+  {
+    if (!isMultipart_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // The CRLF before the boundary belongs to the delimiter (RFC
+    // 2046), which avoids copying the item to append a trailing CRLF
+    std::string header = "\r\n--" + multipartBoundary_ + "\r\n";
+
+    if (!multipartContentType_.empty())
+    {
+      header += "Content-Type: " + multipartContentType_ + "\r\n";
+    }
+
+    header += "Content-Length: " + boost::lexical_cast<std::string>(length) + "\r\n\r\n";
+
+    stateMachine_.SendChunk(header.c_str(), header.size());
+    stateMachine_.SendChunk(item, length);
+  }
+
+
+  void HttpOutput::CloseMultipart()
+  {
+    if (!isMultipart_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    std::string trailer = "\r\n--" + multipartBoundary_ + "--\r\n";
+    stateMachine_.SendChunk(trailer.c_str(), trailer.size());
+    stateMachine_.CloseChunkedTransfer();
+    isMultipart_ = false;
+  }
+
+
   void HttpOutput::SendMethodNotAllowed(const std::string& allowed)
   {
     stateMachine_.ClearHeaders();
@@ -220,7 +377,8 @@ namespace Orthanc
     if (status == HttpStatus_200_Ok ||
         status == HttpStatus_301_MovedPermanently ||
         status == HttpStatus_401_Unauthorized ||
-        status == HttpStatus_405_MethodNotAllowed)
+        status == HttpStatus_405_MethodNotAllowed ||
+        status == HttpStatus_416_RequestedRangeNotSatisfiable)
     {
       LOG(ERROR) << "Please use the dedicated methods to this HTTP status code in HttpOutput";
       throw OrthancException(ErrorCode_ParameterOutOfRange);
@@ -232,6 +390,16 @@ namespace Orthanc
   }
 
 
+  void HttpOutput::SendRangeNotSatisfiable(uint64_t size)
+  {
+    // http://tools.ietf.org/html/rfc7233#section-4.4
+    stateMachine_.ClearHeaders();
+    stateMachine_.SetHttpStatus(HttpStatus_416_RequestedRangeNotSatisfiable);
+    stateMachine_.AddHeader("Content-Range", "bytes */" + boost::lexical_cast<std::string>(size));
+    stateMachine_.SendBody(NULL, 0);
+  }
+
+
   void HttpOutput::Redirect(const std::string& path)
   {
     stateMachine_.ClearHeaders();
@@ -270,4 +438,22 @@ namespace Orthanc
   {
     stateMachine_.SendBody(NULL, 0);
   }
+
+  void HttpOutput::SendBodyRange(const std::string& body,
+                                 uint64_t start,
+                                 uint64_t end)
+  {
+    if (start >= end ||
+        end > body.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    stateMachine_.SetHttpStatus(HttpStatus_206_PartialContent);
+    stateMachine_.AddHeader("Content-Range", "bytes " + 
+                            boost::lexical_cast<std::string>(start) + "-" +
+                            boost::lexical_cast<std::string>(end - 1) + "/" +
+                            boost::lexical_cast<std::string>(body.size()));
+    stateMachine_.SendBody(body.c_str() + start, static_cast<size_t>(end - start));
+  }
 }
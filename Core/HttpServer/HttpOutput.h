@@ -53,6 +53,7 @@ namespace Orthanc
       {
         State_WritingHeader,      
         State_WritingBody,
+        State_WritingChunks,
         State_Done
       };
 
@@ -66,6 +67,8 @@ namespace Orthanc
       bool keepAlive_;
       std::list<std::string> headers_;
 
+      void SendHeader(const std::string& lengthHeader);
+
     public:
       StateMachine(IHttpOutputStream& stream,
                    bool isKeepAlive);
@@ -89,14 +92,29 @@ namespace Orthanc
       void ClearHeaders();
 
       void SendBody(const void* buffer, size_t length);
+
+      void StartChunkedTransfer();
+
+      void SendChunk(const void* buffer, size_t length);
+
+      void CloseChunkedTransfer();
+
+      bool IsWritingChunks() const
+      {
+        return state_ == State_WritingChunks;
+      }
     };
 
     StateMachine stateMachine_;
+    bool         isMultipart_;
+    std::string  multipartBoundary_;
+    std::string  multipartContentType_;
 
   public:
     HttpOutput(IHttpOutputStream& stream,
                bool isKeepAlive) : 
-      stateMachine_(stream, isKeepAlive)
+      stateMachine_(stream, isKeepAlive),
+      isMultipart_(false)
     {
     }
 
@@ -135,6 +153,60 @@ namespace Orthanc
 
     void SendBody();
 
+    // Streaming of a body whose size is unknown, using the "chunked"
+    // transfer encoding of HTTP/1.1
+    void StartChunkedTransfer()
+    {
+      stateMachine_.StartChunkedTransfer();
+    }
+
+    void SendChunk(const void* buffer, size_t length)
+    {
+      stateMachine_.SendChunk(buffer, length);
+    }
+
+    void SendChunk(const std::string& chunk);
+
+    void CloseChunkedTransfer()
+    {
+      stateMachine_.CloseChunkedTransfer();
+    }
+
+    bool IsWritingChunks() const
+    {
+      return stateMachine_.IsWritingChunks();
+    }
+
+    // Streaming of a "multipart/{subType}" answer, whose items all
+    // have the same MIME type. Each item is sent to the client as
+    // soon as it is available, without buffering.
+    void StartMultipart(const std::string& subType,
+                        const std::string& contentType);
+
+    void SendMultipartItem(const void* item, size_t length);
+
+    void SendMultipartItem(const std::string& item)
+    {
+      SendMultipartItem(item.c_str(), item.size());
+    }
+
+    void CloseMultipart();
+
+    bool IsWritingMultipart() const
+    {
+      return isMultipart_;
+    }
+
+    // Sends the range [start, end) of the body as a "206 Partial
+    // Content" answer
+    void SendBodyRange(const std::string& body,
+                       uint64_t start,
+                       uint64_t end);
+
+    // Answers "416 Requested Range Not Satisfiable" for a resource
+    // of "size" bytes
+    void SendRangeNotSatisfiable(uint64_t size);
+
     void SendMethodNotAllowed(const std::string& allowed);
 
     void Redirect(const std::string& path);
@@ -48,6 +48,13 @@ namespace Orthanc
 
     virtual void OnHttpStatusReceived(HttpStatus status) = 0;
 
+    // Throws "ErrorCode_NetworkProtocol" if the data cannot be written
+    // to the connection (e.g. if it was closed by the client)
     virtual void Send(bool isHeader, const void* buffer, size_t length) = 0;
+
+    // Whether the streamed answers must be framed according to the
+    // "chunked" transfer encoding of HTTP/1.1. This is not the case
+    // if the answer is accumulated in memory, as for internal calls.
+    virtual bool IsChunkedTransferEncoding() const = 0;
   };
 }
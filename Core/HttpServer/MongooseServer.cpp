@@ -80,9 +80,11 @@ namespace Orthanc
 
       virtual void Send(bool isHeader, const void* buffer, size_t length)
       {
-        if (length > 0)
+        if (length > 0 &&
+            mg_write(connection_, buffer, length) != static_cast<int>(length))
         {
-          mg_write(connection_, buffer, length);
+          // The connection is most probably closed by the client
+          throw OrthancException(ErrorCode_NetworkProtocol);
         }
       }
 
@@ -90,6 +92,11 @@ namespace Orthanc
       {
         // Ignore this
       }
+
+      virtual bool IsChunkedTransferEncoding() const
+      {
+        return true;
+      }
     };
 
 
@@ -691,21 +698,29 @@ namespace Orthanc
         // Using this candidate handler results in an exception
         LOG(ERROR) << "Exception in the HTTP handler: " << e.What();
 
-        switch (e.GetErrorCode())
+        try
+        {
+          switch (e.GetErrorCode())
+          {
+            case ErrorCode_InexistentFile:
+            case ErrorCode_InexistentItem:
+            case ErrorCode_UnknownResource:
+              output.SendStatus(HttpStatus_404_NotFound);
+              break;
+
+            case ErrorCode_BadRequest:
+            case ErrorCode_UriSyntax:
+              output.SendStatus(HttpStatus_400_BadRequest);
+              break;
+
+            default:
+              output.SendStatus(HttpStatus_500_InternalServerError);
+          }
+        }
+        catch (OrthancException&)
         {
-          case ErrorCode_InexistentFile:
-          case ErrorCode_InexistentItem:
-          case ErrorCode_UnknownResource:
-            output.SendStatus(HttpStatus_404_NotFound);
-            break;
-
-          case ErrorCode_BadRequest:
-          case ErrorCode_UriSyntax:
-            output.SendStatus(HttpStatus_400_BadRequest);
-            break;
-
-          default:
-            output.SendStatus(HttpStatus_500_InternalServerError);
+          // The answer was already partially sent, or the connection
+          // is closed: The error cannot be reported to the client
         }
 
         return;
@@ -731,6 +746,22 @@ namespace Orthanc
   }
 
 
+  static void ProtectedCallback(struct mg_connection *connection,
+                                const struct mg_request_info *request)
+  {
+    try
+    {
+      InternalCallback(connection, request);
+    }
+    catch (OrthancException& e)
+    {
+      // Most probably, the client has closed the connection. No
+      // exception must reach the code of Mongoose.
+      LOG(ERROR) << "Error while answering an HTTP request: " << e.What();
+    }
+  }
+
+
 #if MONGOOSE_USE_CALLBACKS == 0
   static void* Callback(enum mg_event event,
                         struct mg_connection *connection,
@@ -738,7 +769,7 @@ namespace Orthanc
   {
     if (event == MG_NEW_REQUEST) 
     {
-      InternalCallback(connection, request);
+      ProtectedCallback(connection, request);
 
       // Mark as processed
       return (void*) "";
@@ -754,7 +785,7 @@ namespace Orthanc
   {
     struct mg_request_info *request = mg_get_request_info(connection);
 
-    InternalCallback(connection, request);
+    ProtectedCallback(connection, request);
 
     return 1;  // Do not let Mongoose handle the request by itself
   }
@@ -199,6 +199,44 @@ namespace Orthanc
   }
 
 
+  ImageAccessor ImageAccessor::GetRegion(unsigned int x,
+                                         unsigned int y,
+                                         unsigned int width,
+                                         unsigned int height) const
+  {
+    if (x + width > width_ ||
+        y + height > height_)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    ImageAccessor region;
+
+    if (width == 0 ||
+        height == 0 ||
+        buffer_ == NULL)
+    {
+      region.AssignEmpty(format_);
+      region.readOnly_ = readOnly_;
+      return region;
+    }
+
+    uint8_t* p = (reinterpret_cast<uint8_t*>(buffer_) + 
+                  y * pitch_ + x * GetBytesPerPixel());
+
+    if (readOnly_)
+    {
+      region.AssignReadOnly(format_, width, height, pitch_, p);
+    }
+    else
+    {
+      region.AssignWritable(format_, width, height, pitch_, p);
+    }
+
+    return region;
+  }
+
+
   void ImageAccessor::ToMatlabString(std::string& target) const
   {
     ChunkedBuffer buffer;
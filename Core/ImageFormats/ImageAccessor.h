@@ -114,6 +114,13 @@ namespace Orthanc
                         unsigned int pitch,
                         void *buffer);
 
+    // Returns an accessor to a rectangular region of this image,
+    // sharing the same memory buffer and the same read-only flag
+    ImageAccessor GetRegion(unsigned int x,
+                            unsigned int y,
+                            unsigned int width,
+                            unsigned int height) const;
+
     void ToMatlabString(std::string& target) const; 
   };
 }
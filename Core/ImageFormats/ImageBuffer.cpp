@@ -33,10 +33,10 @@
 #include "../PrecompiledHeaders.h"
 #include "ImageBuffer.h"
 
+#include "../BufferPool.h"
 #include "../OrthancException.h"
 
 #include <stdio.h>
-#include <stdlib.h>
 
 namespace Orthanc
 {
@@ -56,18 +56,10 @@ namespace Orthanc
       pitch_ = GetBytesPerPixel() * width_;
       size_t size = pitch_ * height_;
 
-      if (size == 0)
-      {
-        buffer_ = NULL;
-      }
-      else
-      {
-        buffer_ = malloc(size);
-        if (buffer_ == NULL)
-        {
-          throw OrthancException(ErrorCode_NotEnoughMemory);
-        }
-      }
+      // The buffers are recycled through the global pool, as images
+      // of the same size are often decoded over and over
+      buffer_ = BufferPool::GetInstance().Allocate(size);
+      bufferSize_ = size;
 
       changed_ = false;
     }
@@ -78,8 +70,9 @@ namespace Orthanc
   {
     if (buffer_ != NULL)
     {
-      free(buffer_);
+      BufferPool::GetInstance().Release(buffer_, bufferSize_);
       buffer_ = NULL;
+      bufferSize_ = 0;
       changed_ = true;
     }
   }
@@ -105,6 +98,7 @@ namespace Orthanc
     height_ = 0;
     pitch_ = 0;
     buffer_ = NULL;
+    bufferSize_ = 0;
   }
 
 
@@ -185,6 +179,7 @@ namespace Orthanc
     height_ = other.height_;
     pitch_ = other.pitch_;
     buffer_ = other.buffer_;
+    bufferSize_ = other.bufferSize_;
 
     // Force the reinitialization of the other image
     other.Initialize();
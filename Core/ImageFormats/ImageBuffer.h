@@ -51,6 +51,7 @@ namespace Orthanc
     unsigned int height_;
     unsigned int pitch_;
     void *buffer_;
+    size_t bufferSize_;
 
     void Initialize();
     
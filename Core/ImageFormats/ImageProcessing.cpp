@@ -34,81 +34,575 @@
 #include "ImageProcessing.h"
 
 #include "../OrthancException.h"
+#include "../MultiThreading/ThreadPool.h"
 
 #include <boost/math/special_functions/round.hpp>
+#include <boost/thread.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <memory>
 #include <string.h>
 #include <limits>
 #include <stdint.h>
 
+#if ORTHANC_SSE2_ENABLED == 1
+#  include <emmintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
 namespace Orthanc
 {
+#if ORTHANC_SSE2_ENABLED == 1
+  static bool HasSse2()
+  {
+#  if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#  else
+    unsigned int eax, ebx, ecx, edx;
+    return (__get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+            (edx & bit_SSE2) != 0);
+#  endif
+  }
+
+  static const bool hasSse2_ = HasSse2();
+  static bool useSse2_ = hasSse2_;
+#endif
+
+
+  /**
+   * Scalar implementations of the kernels, working on one row of
+   * pixels. They are used as the fallback if SSE2 is not available,
+   * and to process the pixels at the end of each row that do not fill
+   * a whole SIMD register.
+   **/
+
   template <typename TargetType, typename SourceType>
-  static void ConvertInternal(ImageAccessor& target,
-                              const ImageAccessor& source)
+  static void ConvertRow(TargetType* t,
+                         const SourceType* s,
+                         unsigned int width)
+  {
+    const TargetType minValue = std::numeric_limits<TargetType>::min();
+    const TargetType maxValue = std::numeric_limits<TargetType>::max();
+
+    for (unsigned int x = 0; x < width; x++, t++, s++)
+    {
+      if (static_cast<int32_t>(*s) < static_cast<int32_t>(minValue))
+      {
+        *t = minValue;
+      }
+      else if (static_cast<int32_t>(*s) > static_cast<int32_t>(maxValue))
+      {
+        *t = maxValue;
+      }
+      else
+      {
+        *t = static_cast<TargetType>(*s);
+      }
+    }
+  }
+
+
+  template <typename TargetType>
+  static void ConvertColorToGrayscaleRow(TargetType* t,
+                                         const uint8_t* s,
+                                         unsigned int width)
   {
     const TargetType minValue = std::numeric_limits<TargetType>::min();
     const TargetType maxValue = std::numeric_limits<TargetType>::max();
 
+    for (unsigned int x = 0; x < width; x++, t++, s += 3)
+    {
+      // Y = 0.2126 R + 0.7152 G + 0.0722 B
+      int32_t v = (2126 * static_cast<int32_t>(s[0]) +
+                   7152 * static_cast<int32_t>(s[1]) +
+                   0722 * static_cast<int32_t>(s[2])) / 1000;
+        
+      if (static_cast<int32_t>(v) < static_cast<int32_t>(minValue))
+      {
+        *t = minValue;
+      }
+      else if (static_cast<int32_t>(v) > static_cast<int32_t>(maxValue))
+      {
+        *t = maxValue;
+      }
+      else
+      {
+        *t = static_cast<TargetType>(v);
+      }
+    }
+  }
+
+
+  template <typename PixelType>
+  static void GetMinMaxValueRow(PixelType& minValue,
+                                PixelType& maxValue,
+                                const PixelType* p,
+                                unsigned int width)
+  {
+    for (unsigned int x = 0; x < width; x++, p++)
+    {
+      if (*p < minValue)
+      {
+        minValue = *p;
+      }
+
+      if (*p > maxValue)
+      {
+        maxValue = *p;
+      }
+    }
+  }
+
+
+  template <typename PixelType>
+  static void ShiftScaleRow(PixelType* p,
+                            unsigned int width,
+                            float offset,
+                            float scaling)
+  {
+    const float minValue = static_cast<float>(std::numeric_limits<PixelType>::min());
+    const float maxValue = static_cast<float>(std::numeric_limits<PixelType>::max());
+
+    for (unsigned int x = 0; x < width; x++, p++)
+    {
+      float v = (static_cast<float>(*p) + offset) * scaling;
+
+      // Saturate before rounding, as the SSE2 kernel does. NaN is
+      // mapped to the minimum, like "_mm_max_ps()" does.
+      if (v > maxValue)
+      {
+        *p = std::numeric_limits<PixelType>::max();
+      }
+      else if (!(v >= minValue))
+      {
+        *p = std::numeric_limits<PixelType>::min();
+      }
+      else
+      {
+        *p = static_cast<PixelType>(boost::math::iround(v));
+      }
+    }
+  }
+
+
+  template <typename PixelType>
+  static void MultiplyConstantRow(PixelType* p,
+                                  unsigned int width,
+                                  float factor)
+  {
+    // Multiplying by a factor is a shift-scale with a null offset,
+    // which saturates exactly as the SSE2 kernel
+    ShiftScaleRow<PixelType>(p, width, 0.0f, factor);
+  }
+
+
+
+#if ORTHANC_SSE2_ENABLED == 1
+  /**
+   * SSE2 implementations of the kernels. Each function processes as
+   * many pixels of the row as possible, and returns their number. The
+   * remaining pixels are handled by the scalar implementations
+   * above. The results are bit-exact with the scalar versions.
+   **/
+
+  template <typename TargetType, typename SourceType>
+  static unsigned int ConvertRowSse2(TargetType* t,
+                                     const SourceType* s,
+                                     unsigned int width)
+  {
+    return 0;  // No SIMD implementation for this pair of formats
+  }
+
+
+  static unsigned int ConvertRowSse2(uint16_t* t,
+                                     const uint8_t* s,
+                                     unsigned int width)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x + 8), _mm_unpackhi_epi8(v, zero));
+    }
+
+    return x;
+  }
+
+
+  static unsigned int ConvertRowSse2(int16_t* t,
+                                     const uint8_t* s,
+                                     unsigned int width)
+  {
+    return ConvertRowSse2(reinterpret_cast<uint16_t*>(t), s, width);
+  }
+
+
+  static unsigned int ConvertRowSse2(uint8_t* t,
+                                     const uint16_t* s,
+                                     unsigned int width)
+  {
+    const __m128i maxValue = _mm_set1_epi16(255);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x + 8));
+
+      // Unsigned minimum with 255 (there is no "_mm_min_epu16" in SSE2)
+      a = _mm_subs_epu16(a, _mm_subs_epu16(a, maxValue));
+      b = _mm_subs_epu16(b, _mm_subs_epu16(b, maxValue));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_packus_epi16(a, b));
+    }
+
+    return x;
+  }
+
+
+  static unsigned int ConvertRowSse2(int16_t* t,
+                                     const uint16_t* s,
+                                     unsigned int width)
+  {
+    const __m128i maxValue = _mm_set1_epi16(32767);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      v = _mm_subs_epu16(v, _mm_subs_epu16(v, maxValue));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), v);
+    }
+
+    return x;
+  }
+
+
+  static unsigned int ConvertRowSse2(uint8_t* t,
+                                     const int16_t* s,
+                                     unsigned int width)
+  {
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x + 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_packus_epi16(a, b));
+    }
+
+    return x;
+  }
+
+
+  static unsigned int ConvertRowSse2(uint16_t* t,
+                                     const int16_t* s,
+                                     unsigned int width)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(t + x), _mm_max_epi16(v, zero));
+    }
+
+    return x;
+  }
+
+
+  template <typename PixelType>
+  static unsigned int GetMinMaxValueRowSse2(PixelType& minValue,
+                                            PixelType& maxValue,
+                                            const PixelType* p,
+                                            unsigned int width)
+  {
+    return 0;
+  }
+
+
+  template <typename PixelType>
+  static void ReduceMinMax(PixelType& minValue,
+                           PixelType& maxValue,
+                           __m128i vmin,
+                           __m128i vmax)
+  {
+    PixelType a[16 / sizeof(PixelType)], b[16 / sizeof(PixelType)];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(a), vmin);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b), vmax);
+
+    for (size_t i = 0; i < 16 / sizeof(PixelType); i++)
+    {
+      if (a[i] < minValue)
+      {
+        minValue = a[i];
+      }
+
+      if (b[i] > maxValue)
+      {
+        maxValue = b[i];
+      }
+    }
+  }
+
+
+  static unsigned int GetMinMaxValueRowSse2(uint8_t& minValue,
+                                            uint8_t& maxValue,
+                                            const uint8_t* p,
+                                            unsigned int width)
+  {
+    if (width < 16)
+    {
+      return 0;
+    }
+
+    __m128i vmin = _mm_set1_epi8(static_cast<char>(minValue));
+    __m128i vmax = _mm_set1_epi8(static_cast<char>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+      vmin = _mm_min_epu8(vmin, v);
+      vmax = _mm_max_epu8(vmax, v);
+    }
+
+    ReduceMinMax<uint8_t>(minValue, maxValue, vmin, vmax);
+    return x;
+  }
+
+
+  static unsigned int GetMinMaxValueRowSse2(int16_t& minValue,
+                                            int16_t& maxValue,
+                                            const int16_t* p,
+                                            unsigned int width)
+  {
+    if (width < 8)
+    {
+      return 0;
+    }
+
+    __m128i vmin = _mm_set1_epi16(minValue);
+    __m128i vmax = _mm_set1_epi16(maxValue);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+      vmin = _mm_min_epi16(vmin, v);
+      vmax = _mm_max_epi16(vmax, v);
+    }
+
+    ReduceMinMax<int16_t>(minValue, maxValue, vmin, vmax);
+    return x;
+  }
+
+
+  static unsigned int GetMinMaxValueRowSse2(uint16_t& minValue,
+                                            uint16_t& maxValue,
+                                            const uint16_t* p,
+                                            unsigned int width)
+  {
+    if (width < 8)
+    {
+      return 0;
+    }
+
+    // SSE2 only provides signed 16bit comparisons: Flip the sign bit
+    // to map the unsigned range onto the signed range
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    __m128i vmin = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(minValue)), bias);
+    __m128i vmax = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(maxValue)), bias);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x)), bias);
+      vmin = _mm_min_epi16(vmin, v);
+      vmax = _mm_max_epi16(vmax, v);
+    }
+
+    ReduceMinMax<uint16_t>(minValue, maxValue, 
+                           _mm_xor_si128(vmin, bias), 
+                           _mm_xor_si128(vmax, bias));
+    return x;
+  }
+
+
+  class ShiftScaleSse2
+  {
+  private:
+    __m128 offset_;
+    __m128 scaling_;
+    __m128 minValue_;
+    __m128 maxValue_;
+
+  public:
+    ShiftScaleSse2(float offset,
+                   float scaling,
+                   float minValue,
+                   float maxValue) :
+      offset_(_mm_set1_ps(offset)),
+      scaling_(_mm_set1_ps(scaling)),
+      minValue_(_mm_set1_ps(minValue)),
+      maxValue_(_mm_set1_ps(maxValue))
+    {
+    }
+
+    // Applies the transform to 4 pixels stored as 32bit integers
+    __m128i Apply(__m128i v) const
+    {
+      __m128 f = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(v), offset_), scaling_);
+      f = _mm_min_ps(_mm_max_ps(f, minValue_), maxValue_);
+
+      // Round half away from zero, as "boost::math::iround()"
+      __m128i t = _mm_cvttps_epi32(f);
+      __m128 fraction = _mm_sub_ps(f, _mm_cvtepi32_ps(t));
+      __m128i up = _mm_castps_si128(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)));
+      __m128i down = _mm_castps_si128(_mm_cmple_ps(fraction, _mm_set1_ps(-0.5f)));
+
+      // The comparison masks are equal to -1 where they hold
+      return _mm_add_epi32(_mm_sub_epi32(t, up), down);
+    }
+  };
+
+
+  template <typename PixelType>
+  static unsigned int ShiftScaleRowSse2(PixelType* p,
+                                        unsigned int width,
+                                        const ShiftScaleSse2& transform)
+  {
+    return 0;
+  }
+
+
+  static unsigned int ShiftScaleRowSse2(uint8_t* p,
+                                        unsigned int width,
+                                        const ShiftScaleSse2& transform)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+      __m128i lo = _mm_unpacklo_epi8(v, zero);
+      __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+      __m128i a = transform.Apply(_mm_unpacklo_epi16(lo, zero));
+      __m128i b = transform.Apply(_mm_unpackhi_epi16(lo, zero));
+      __m128i c = transform.Apply(_mm_unpacklo_epi16(hi, zero));
+      __m128i d = transform.Apply(_mm_unpackhi_epi16(hi, zero));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), 
+                       _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+    }
+
+    return x;
+  }
+
+
+  static unsigned int ShiftScaleRowSse2(int16_t* p,
+                                        unsigned int width,
+                                        const ShiftScaleSse2& transform)
+  {
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+
+      // Sign extension of the 16bit values to 32bit
+      __m128i a = transform.Apply(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+      __m128i b = transform.Apply(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), _mm_packs_epi32(a, b));
+    }
+
+    return x;
+  }
+
+
+  static unsigned int ShiftScaleRowSse2(uint16_t* p,
+                                        unsigned int width,
+                                        const ShiftScaleSse2& transform)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+      __m128i a = transform.Apply(_mm_unpacklo_epi16(v, zero));
+      __m128i b = transform.Apply(_mm_unpackhi_epi16(v, zero));
+
+      // There is no "_mm_packus_epi32" in SSE2: Pack in the signed
+      // range, then flip the sign bit back
+      a = _mm_sub_epi32(a, bias32);
+      b = _mm_sub_epi32(b, bias32);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x),
+                       _mm_xor_si128(_mm_packs_epi32(a, b), bias16));
+    }
+
+    return x;
+  }
+#endif
+
+
+
+  template <typename TargetType, typename SourceType>
+  static void ConvertInternal(ImageAccessor& target,
+                              const ImageAccessor& source)
+  {
+    const unsigned int width = source.GetWidth();
+
     for (unsigned int y = 0; y < source.GetHeight(); y++)
     {
       TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
       const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < source.GetWidth(); x++, t++, s++)
+      unsigned int x = 0;
+
+#if ORTHANC_SSE2_ENABLED == 1
+      if (useSse2_)
       {
-        if (static_cast<int32_t>(*s) < static_cast<int32_t>(minValue))
-        {
-          *t = minValue;
-        }
-        else if (static_cast<int32_t>(*s) > static_cast<int32_t>(maxValue))
-        {
-          *t = maxValue;
-        }
-        else
-        {
-          *t = static_cast<TargetType>(*s);
-        }
+        x = ConvertRowSse2(t, s, width);
       }
+#endif
+
+      ConvertRow<TargetType, SourceType>(t + x, s + x, width - x);
     }
   }
 
 
   template <typename TargetType>
   static void ConvertColorToGrayscale(ImageAccessor& target,
-                              const ImageAccessor& source)
+                                      const ImageAccessor& source)
   {
     assert(source.GetFormat() == PixelFormat_RGB24);
 
-    const TargetType minValue = std::numeric_limits<TargetType>::min();
-    const TargetType maxValue = std::numeric_limits<TargetType>::max();
+    const unsigned int width = source.GetWidth();
 
     for (unsigned int y = 0; y < source.GetHeight(); y++)
     {
       TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
       const uint8_t* s = reinterpret_cast<const uint8_t*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < source.GetWidth(); x++, t++, s += 3)
-      {
-        // Y = 0.2126 R + 0.7152 G + 0.0722 B
-        int32_t v = (2126 * static_cast<int32_t>(s[0]) +
-                     7152 * static_cast<int32_t>(s[1]) +
-                     0722 * static_cast<int32_t>(s[2])) / 1000;
-        
-        if (static_cast<int32_t>(v) < static_cast<int32_t>(minValue))
-        {
-          *t = minValue;
-        }
-        else if (static_cast<int32_t>(v) > static_cast<int32_t>(maxValue))
-        {
-          *t = maxValue;
-        }
-        else
-        {
-          *t = static_cast<TargetType>(v);
-        }
-      }
+      // No SSE2 implementation: Deinterleaving RGB24 pixels without
+      // SSSE3 byte shuffles is slower than the scalar loop
+      ConvertColorToGrayscaleRow<TargetType>(t, s, width);
     }
   }
 
@@ -146,22 +640,22 @@ namespace Orthanc
     minValue = std::numeric_limits<PixelType>::max();
     maxValue = std::numeric_limits<PixelType>::min();
 
+    const unsigned int width = source.GetWidth();
+
     for (unsigned int y = 0; y < source.GetHeight(); y++)
     {
       const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < source.GetWidth(); x++, p++)
-      {
-        if (*p < minValue)
-        {
-          minValue = *p;
-        }
+      unsigned int x = 0;
 
-        if (*p > maxValue)
-        {
-          maxValue = *p;
-        }
+#if ORTHANC_SSE2_ENABLED == 1
+      if (useSse2_)
+      {
+        x = GetMinMaxValueRowSse2(minValue, maxValue, p, width);
       }
+#endif
+
+      GetMinMaxValueRow<PixelType>(minValue, maxValue, p + x, width - x);
     }
   }
 
@@ -214,30 +708,29 @@ namespace Orthanc
       return;
     }
 
-    const int64_t minValue = std::numeric_limits<PixelType>::min();
-    const int64_t maxValue = std::numeric_limits<PixelType>::max();
+#if ORTHANC_SSE2_ENABLED == 1
+    // Multiplying by a factor is a shift-scale with a null offset
+    const ShiftScaleSse2 transform(0.0f, factor,
+                                   static_cast<float>(std::numeric_limits<PixelType>::min()),
+                                   static_cast<float>(std::numeric_limits<PixelType>::max()));
+#endif
+
+    const unsigned int width = image.GetWidth();
 
     for (unsigned int y = 0; y < image.GetHeight(); y++)
     {
       PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
 
-      for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
-      {
-        int64_t v = boost::math::llround(static_cast<float>(*p) * factor);
+      unsigned int x = 0;
 
-        if (v > maxValue)
-        {
-          *p = std::numeric_limits<PixelType>::max();
-        }
-        else if (v < minValue)
-        {
-          *p = std::numeric_limits<PixelType>::min();
-        }
-        else
-        {
-          *p = static_cast<PixelType>(v);
-        }
+#if ORTHANC_SSE2_ENABLED == 1
+      if (useSse2_)
+      {
+        x = ShiftScaleRowSse2(p, width, transform);
       }
+#endif
+
+      MultiplyConstantRow<PixelType>(p + x, width - x, factor);
     }
   }
 
@@ -247,48 +740,54 @@ namespace Orthanc
                           float offset,
                           float scaling)
   {
-    const float minValue = static_cast<float>(std::numeric_limits<PixelType>::min());
-    const float maxValue = static_cast<float>(std::numeric_limits<PixelType>::max());
+#if ORTHANC_SSE2_ENABLED == 1
+    const ShiftScaleSse2 transform(offset, scaling,
+                                   static_cast<float>(std::numeric_limits<PixelType>::min()),
+                                   static_cast<float>(std::numeric_limits<PixelType>::max()));
+#endif
+
+    const unsigned int width = image.GetWidth();
 
     for (unsigned int y = 0; y < image.GetHeight(); y++)
     {
       PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
 
-      for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
-      {
-        float v = (static_cast<float>(*p) + offset) * scaling;
+      unsigned int x = 0;
 
-        if (v > maxValue)
-        {
-          *p = std::numeric_limits<PixelType>::max();
-        }
-        else if (v < minValue)
-        {
-          *p = std::numeric_limits<PixelType>::min();
-        }
-        else
-        {
-          *p = static_cast<PixelType>(boost::math::iround(v));
-        }
+#if ORTHANC_SSE2_ENABLED == 1
+      if (useSse2_)
+      {
+        x = ShiftScaleRowSse2(p, width, transform);
       }
+#endif
+
+      ShiftScaleRow<PixelType>(p + x, width - x, offset, scaling);
     }
   }
 
 
-  void ImageProcessing::Copy(ImageAccessor& target,
-                             const ImageAccessor& source)
+  bool ImageProcessing::IsSimdEnabled()
   {
-    if (target.GetWidth() != source.GetWidth() ||
-        target.GetHeight() != source.GetHeight())
-    {
-      throw OrthancException(ErrorCode_IncompatibleImageSize);
-    }
+#if ORTHANC_SSE2_ENABLED == 1
+    return useSse2_;
+#else
+    return false;
+#endif
+  }
 
-    if (target.GetFormat() != source.GetFormat())
-    {
-      throw OrthancException(ErrorCode_IncompatibleImageFormat);
-    }
 
+  void ImageProcessing::SetSimdEnabled(bool enabled)
+  {
+#if ORTHANC_SSE2_ENABLED == 1
+    // SIMD can only be enabled if the CPU supports SSE2
+    useSse2_ = (enabled && hasSse2_);
+#endif
+  }
+
+
+  static void CopySequential(ImageAccessor& target,
+                             const ImageAccessor& source)
+  {
     unsigned int lineSize = GetBytesPerPixel(source.GetFormat()) * source.GetWidth();
 
     assert(source.GetPitch() >= lineSize && target.GetPitch() >= lineSize);
@@ -300,21 +799,9 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::Convert(ImageAccessor& target,
+  static void ConvertSequential(ImageAccessor& target,
                                 const ImageAccessor& source)
   {
-    if (target.GetWidth() != source.GetWidth() ||
-        target.GetHeight() != source.GetHeight())
-    {
-      throw OrthancException(ErrorCode_IncompatibleImageSize);
-    }
-
-    if (source.GetFormat() == target.GetFormat())
-    {
-      Copy(target, source);
-      return;
-    }
-
     if (target.GetFormat() == PixelFormat_Grayscale16 &&
         source.GetFormat() == PixelFormat_Grayscale8)
     {
@@ -383,7 +870,7 @@ namespace Orthanc
 
 
 
-  void ImageProcessing::Set(ImageAccessor& image,
+  static void SetSequential(ImageAccessor& image,
                             int64_t value)
   {
     switch (image.GetFormat())
@@ -406,22 +893,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::ShiftRight(ImageAccessor& image,
-                                   unsigned int shift)
-  {
-    if (image.GetWidth() == 0 ||
-        image.GetHeight() == 0 ||
-        shift == 0)
-    {
-      // Nothing to do
-      return;
-    }
-
-    throw OrthancException(ErrorCode_NotImplemented);
-  }
-
-
-  void ImageProcessing::GetMinMaxValue(int64_t& minValue,
+  static void GetMinMaxValueSequential(int64_t& minValue,
                                        int64_t& maxValue,
                                        const ImageAccessor& image)
   {
@@ -461,7 +933,7 @@ namespace Orthanc
 
 
 
-  void ImageProcessing::AddConstant(ImageAccessor& image,
+  static void AddConstantSequential(ImageAccessor& image,
                                     int64_t value)
   {
     switch (image.GetFormat())
@@ -484,7 +956,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::MultiplyConstant(ImageAccessor& image,
+  static void MultiplyConstantSequential(ImageAccessor& image,
                                          float factor)
   {
     switch (image.GetFormat())
@@ -507,7 +979,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::ShiftScale(ImageAccessor& image,
+  static void ShiftScaleSequential(ImageAccessor& image,
                                    float offset,
                                    float scaling)
   {
@@ -529,4 +1001,1057 @@ namespace Orthanc
         throw OrthancException(ErrorCode_NotImplemented);
     }
   }
+
+
+
+  /**
+   * Parallel processing of large images. The image is split into
+   * horizontal bands of rows, that are processed by the shared pool
+   * of worker threads. Small images are processed in the calling
+   * thread, as the synchronization would cost more than it saves.
+   **/
+
+  static const unsigned int MIN_PIXELS_PER_BAND = 256 * 1024;
+
+  static boost::mutex poolMutex_;
+  static std::auto_ptr<ThreadPool> pool_;
+  static unsigned int threadsCount_ = 0;   // "0" means "number of cores"
+
+
+  static ThreadPool& GetThreadPool()
+  {
+    boost::mutex::scoped_lock lock(poolMutex_);
+
+    if (pool_.get() == NULL)
+    {
+      unsigned int count = threadsCount_;
+      if (count == 0)
+      {
+        count = boost::thread::hardware_concurrency();
+      }
+
+      // The thread that calls ImageProcessing is one of the threads
+      pool_.reset(new ThreadPool(count > 1 ? count - 1 : 0));
+    }
+
+    return *pool_;
+  }
+
+
+  class IBandOperation : public boost::noncopyable
+  {
+  public:
+    virtual ~IBandOperation()
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height) = 0;
+  };
+
+
+  class BandCommand : public ICommand
+  {
+  private:
+    IBandOperation& operation_;
+    unsigned int band_;
+    unsigned int y_;
+    unsigned int height_;
+
+  public:
+    BandCommand(IBandOperation& operation,
+                unsigned int band,
+                unsigned int y,
+                unsigned int height) :
+      operation_(operation),
+      band_(band),
+      y_(y),
+      height_(height)
+    {
+    }
+
+    virtual bool Execute()
+    {
+      operation_.Apply(band_, y_, height_);
+      return true;
+    }
+  };
+
+
+  class BandCommands : public boost::noncopyable
+  {
+  private:
+    std::vector<ICommand*> commands_;
+
+  public:
+    ~BandCommands()
+    {
+      for (size_t i = 0; i < commands_.size(); i++)
+      {
+        delete commands_[i];
+      }
+    }
+
+    void Add(ICommand* command)
+    {
+      std::auto_ptr<ICommand> protection(command);
+      commands_.push_back(command);
+      protection.release();
+    }
+
+    const std::vector<ICommand*>& GetCommands() const
+    {
+      return commands_;
+    }
+  };
+
+
+  static unsigned int GetBandsCount(const ImageAccessor& image)
+  {
+    uint64_t pixels = static_cast<uint64_t>(image.GetWidth()) * image.GetHeight();
+    if (pixels < 2 * MIN_PIXELS_PER_BAND)
+    {
+      return 1;
+    }
+
+    uint64_t count = std::min(static_cast<uint64_t>(GetThreadPool().GetWorkersCount() + 1),
+                              pixels / MIN_PIXELS_PER_BAND);
+    count = std::min(count, static_cast<uint64_t>(image.GetHeight()));
+
+    return static_cast<unsigned int>(count);
+  }
+
+
+  // Returns the number of bands that were actually processed, which
+  // can be below "countBands" because of the rounding of the height
+  // of the bands (e.g. 12 rows in 8 bands give 6 bands of 2 rows)
+  static unsigned int ApplyByBands(IBandOperation& operation,
+                                   unsigned int countBands,
+                                   unsigned int height)
+  {
+    if (countBands <= 1)
+    {
+      operation.Apply(0, 0, height);
+      return 1;
+    }
+
+    const unsigned int bandHeight = (height + countBands - 1) / countBands;
+
+    BandCommands commands;
+    unsigned int count = 0;
+    for (unsigned int y = 0; count < countBands && y < height; count++, y += bandHeight)
+    {
+      commands.Add(new BandCommand(operation, count, y, std::min(bandHeight, height - y)));
+    }
+
+    GetThreadPool().ExecuteBatch(commands.GetCommands());
+
+    return count;
+  }
+
+
+  class CopyOperation : public IBandOperation
+  {
+  private:
+    ImageAccessor& target_;
+    const ImageAccessor& source_;
+    bool convert_;
+
+  public:
+    CopyOperation(ImageAccessor& target,
+                  const ImageAccessor& source,
+                  bool convert) :
+      target_(target),
+      source_(source),
+      convert_(convert)
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height)
+    {
+      ImageAccessor target = target_.GetRegion(0, y, target_.GetWidth(), height);
+      ImageAccessor source = source_.GetRegion(0, y, source_.GetWidth(), height);
+
+      if (convert_)
+      {
+        ConvertSequential(target, source);
+      }
+      else
+      {
+        CopySequential(target, source);
+      }
+    }
+  };
+
+
+  class InPlaceOperation : public IBandOperation
+  {
+  public:
+    enum Type
+    {
+      Type_Set,
+      Type_AddConstant,
+      Type_MultiplyConstant,
+      Type_ShiftScale
+    };
+
+  private:
+    ImageAccessor& image_;
+    Type type_;
+    int64_t value_;
+    float offset_;
+    float scaling_;
+
+  public:
+    InPlaceOperation(ImageAccessor& image,
+                     Type type,
+                     int64_t value,
+                     float offset,
+                     float scaling) :
+      image_(image),
+      type_(type),
+      value_(value),
+      offset_(offset),
+      scaling_(scaling)
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height)
+    {
+      ImageAccessor region = image_.GetRegion(0, y, image_.GetWidth(), height);
+
+      switch (type_)
+      {
+        case Type_Set:
+          SetSequential(region, value_);
+          break;
+
+        case Type_AddConstant:
+          AddConstantSequential(region, value_);
+          break;
+
+        case Type_MultiplyConstant:
+          MultiplyConstantSequential(region, scaling_);
+          break;
+
+        case Type_ShiftScale:
+          ShiftScaleSequential(region, offset_, scaling_);
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+  };
+
+
+  class MinMaxOperation : public IBandOperation
+  {
+  private:
+    const ImageAccessor& image_;
+    std::vector<int64_t> minValues_;
+    std::vector<int64_t> maxValues_;
+
+  public:
+    MinMaxOperation(const ImageAccessor& image,
+                    unsigned int countBands) :
+      image_(image),
+      minValues_(countBands),
+      maxValues_(countBands)
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height)
+    {
+      ImageAccessor region = image_.GetRegion(0, y, image_.GetWidth(), height);
+      GetMinMaxValueSequential(minValues_[band], maxValues_[band], region);
+    }
+
+    // Only the "countBands" first bands have been processed
+    void Reduce(int64_t& minValue,
+                int64_t& maxValue,
+                unsigned int countBands) const
+    {
+      if (countBands == 0 ||
+          countBands > minValues_.size())
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      minValue = *std::min_element(minValues_.begin(), minValues_.begin() + countBands);
+      maxValue = *std::max_element(maxValues_.begin(), maxValues_.begin() + countBands);
+    }
+  };
+
+
+  static void ApplyInPlace(ImageAccessor& image,
+                           InPlaceOperation::Type type,
+                           int64_t value,
+                           float offset,
+                           float scaling)
+  {
+    InPlaceOperation operation(image, type, value, offset, scaling);
+    ApplyByBands(operation, GetBandsCount(image), image.GetHeight());
+  }
+
+
+  void ImageProcessing::SetThreadsCount(unsigned int count)
+  {
+    boost::mutex::scoped_lock lock(poolMutex_);
+    threadsCount_ = count;
+    pool_.reset(NULL);
+  }
+
+
+  ThreadPool& ImageProcessing::GetThreadPool()
+  {
+    return Orthanc::GetThreadPool();
+  }
+
+
+  void ImageProcessing::Copy(ImageAccessor& target,
+                             const ImageAccessor& source)
+  {
+    if (target.GetWidth() != source.GetWidth() ||
+        target.GetHeight() != source.GetHeight())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    if (target.GetFormat() != source.GetFormat())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    CopyOperation operation(target, source, false);
+    ApplyByBands(operation, GetBandsCount(source), source.GetHeight());
+  }
+
+
+  void ImageProcessing::Convert(ImageAccessor& target,
+                                const ImageAccessor& source)
+  {
+    if (target.GetWidth() != source.GetWidth() ||
+        target.GetHeight() != source.GetHeight())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    if (source.GetFormat() == target.GetFormat())
+    {
+      Copy(target, source);
+      return;
+    }
+
+    CopyOperation operation(target, source, true);
+    ApplyByBands(operation, GetBandsCount(source), source.GetHeight());
+  }
+
+
+  void ImageProcessing::Set(ImageAccessor& image,
+                            int64_t value)
+  {
+    ApplyInPlace(image, InPlaceOperation::Type_Set, value, 0.0f, 1.0f);
+  }
+
+
+  void ImageProcessing::ShiftRight(ImageAccessor& image,
+                                   unsigned int shift)
+  {
+    if (image.GetWidth() == 0 ||
+        image.GetHeight() == 0 ||
+        shift == 0)
+    {
+      // Nothing to do
+      return;
+    }
+
+    throw OrthancException(ErrorCode_NotImplemented);
+  }
+
+
+  void ImageProcessing::GetMinMaxValue(int64_t& minValue,
+                                       int64_t& maxValue,
+                                       const ImageAccessor& image)
+  {
+    unsigned int countBands = GetBandsCount(image);
+
+    MinMaxOperation operation(image, countBands);
+    countBands = ApplyByBands(operation, countBands, image.GetHeight());
+    operation.Reduce(minValue, maxValue, countBands);
+  }
+
+
+  void ImageProcessing::AddConstant(ImageAccessor& image,
+                                    int64_t value)
+  {
+    ApplyInPlace(image, InPlaceOperation::Type_AddConstant, value, 0.0f, 1.0f);
+  }
+
+
+  void ImageProcessing::MultiplyConstant(ImageAccessor& image,
+                                         float factor)
+  {
+    ApplyInPlace(image, InPlaceOperation::Type_MultiplyConstant, 0, 0.0f, factor);
+  }
+
+
+  void ImageProcessing::ShiftScale(ImageAccessor& image,
+                                   float offset,
+                                   float scaling)
+  {
+    ApplyInPlace(image, InPlaceOperation::Type_ShiftScale, 0, offset, scaling);
+  }
+
+
+
+  /**
+   * Resizing of images. The resampling is separable: Each target
+   * pixel along one axis is a weighted sum of source pixels, whose
+   * weights are precomputed by the "ResizeKernel" class. The
+   * resampled values are kept as floating-point numbers until the
+   * very end, where the shift-scale transform is applied and where
+   * they are rounded to the target pixel type. This allows to fuse
+   * the resizing with the stretching of the dynamics.
+   **/
+
+  class ResizeKernel : public boost::noncopyable
+  {
+  private:
+    std::vector<unsigned int>  first_;    // First source index for each target index
+    std::vector<size_t>        offsets_;  // Offsets of the weights for each target index
+    std::vector<float>         weights_;
+
+    void AddWeight(unsigned int index,
+                   double weight)
+    {
+      if (offsets_.back() == weights_.size())
+      {
+        first_.back() = index;
+      }
+
+      weights_.push_back(static_cast<float>(weight));
+    }
+
+    void NextTarget()
+    {
+      offsets_.push_back(weights_.size());
+      first_.push_back(0);
+    }
+
+  public:
+    ResizeKernel(unsigned int sourceSize,
+                 unsigned int targetSize,
+                 ImageInterpolation interpolation)
+    {
+      assert(sourceSize > 0 && targetSize > 0);
+
+      const double scale = static_cast<double>(sourceSize) / static_cast<double>(targetSize);
+
+      offsets_.reserve(targetSize + 1);
+      first_.reserve(targetSize + 1);
+      offsets_.push_back(0);
+      first_.push_back(0);
+
+      for (unsigned int i = 0; i < targetSize; i++)
+      {
+        switch (interpolation)
+        {
+          case ImageInterpolation_Box:
+          {
+            // Average of the source pixels covered by the target pixel,
+            // weighted by the covered area
+            const double a = static_cast<double>(i) * scale;
+            const double b = static_cast<double>(i + 1) * scale;
+            const unsigned int end = std::min(sourceSize, static_cast<unsigned int>(std::ceil(b)));
+
+            for (unsigned int j = static_cast<unsigned int>(std::floor(a)); j < end; j++)
+            {
+              double w = std::min(b, static_cast<double>(j + 1)) - std::max(a, static_cast<double>(j));
+              if (w > 0)
+              {
+                AddWeight(j, w / scale);
+              }
+            }
+
+            break;
+          }
+
+          case ImageInterpolation_Bilinear:
+          {
+            // Align the centers of the target and source pixels
+            double center = (static_cast<double>(i) + 0.5) * scale - 0.5;
+            if (center <= 0)
+            {
+              AddWeight(0, 1);
+            }
+            else if (center >= static_cast<double>(sourceSize - 1))
+            {
+              AddWeight(sourceSize - 1, 1);
+            }
+            else
+            {
+              unsigned int j = static_cast<unsigned int>(center);
+              double fraction = center - static_cast<double>(j);
+              AddWeight(j, 1.0 - fraction);
+              AddWeight(j + 1, fraction);
+            }
+
+            break;
+          }
+
+          default:
+            throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        NextTarget();
+      }
+    }
+
+    unsigned int GetFirst(unsigned int target) const
+    {
+      return first_[target];
+    }
+
+    unsigned int GetCount(unsigned int target) const
+    {
+      return static_cast<unsigned int>(offsets_[target + 1] - offsets_[target]);
+    }
+
+    const float* GetWeights(unsigned int target) const
+    {
+      return &weights_[offsets_[target]];
+    }
+  };
+
+
+  template <typename TargetType>
+  static inline TargetType ResizeToPixel(float value,
+                                         float offset,
+                                         float scaling)
+  {
+    const float minValue = static_cast<float>(std::numeric_limits<TargetType>::min());
+    const float maxValue = static_cast<float>(std::numeric_limits<TargetType>::max());
+
+    float v = (value + offset) * scaling;
+
+    if (v > maxValue)
+    {
+      return std::numeric_limits<TargetType>::max();
+    }
+    else if (v < minValue)
+    {
+      return std::numeric_limits<TargetType>::min();
+    }
+    else
+    {
+      return static_cast<TargetType>(boost::math::iround(v));
+    }
+  }
+
+
+  template <typename TargetType, typename SourceType, unsigned int Channels>
+  class IntegerFactorResizeOperation : public IBandOperation
+  {
+  private:
+    ImageAccessor& target_;
+    const ImageAccessor& source_;
+    unsigned int factorX_;
+    unsigned int factorY_;
+    float offset_;
+    float scaling_;
+
+  public:
+    IntegerFactorResizeOperation(ImageAccessor& target,
+                                 const ImageAccessor& source,
+                                 float offset,
+                                 float scaling) :
+      target_(target),
+      source_(source),
+      factorX_(source.GetWidth() / target.GetWidth()),
+      factorY_(source.GetHeight() / target.GetHeight()),
+      offset_(offset),
+      scaling_(scaling)
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height)
+    {
+      const unsigned int width = target_.GetWidth();
+      const double count = static_cast<double>(factorX_) * static_cast<double>(factorY_);
+
+      std::vector<int64_t> sums(width * Channels);
+
+      for (unsigned int ty = y; ty < y + height; ty++)
+      {
+        std::fill(sums.begin(), sums.end(), 0);
+
+        for (unsigned int sy = ty * factorY_; sy < (ty + 1) * factorY_; sy++)
+        {
+          const SourceType* s = reinterpret_cast<const SourceType*>(source_.GetConstRow(sy));
+          int64_t* sum = &sums[0];
+
+          for (unsigned int tx = 0; tx < width; tx++, sum += Channels)
+          {
+            for (unsigned int i = 0; i < factorX_; i++)
+            {
+              for (unsigned int c = 0; c < Channels; c++, s++)
+              {
+                sum[c] += *s;
+              }
+            }
+          }
+        }
+
+        TargetType* t = reinterpret_cast<TargetType*>(target_.GetRow(ty));
+        for (size_t i = 0; i < sums.size(); i++, t++)
+        {
+          *t = ResizeToPixel<TargetType>(static_cast<float>(static_cast<double>(sums[i]) / count),
+                                         offset_, scaling_);
+        }
+      }
+    }
+  };
+
+
+  template <typename SourceType, unsigned int Channels>
+  class HorizontalResizeOperation : public IBandOperation
+  {
+  private:
+    std::vector<float>& target_;  // Intermediate image, one row per source row
+    const ImageAccessor& source_;
+    const ResizeKernel& kernel_;
+    unsigned int targetWidth_;
+
+  public:
+    HorizontalResizeOperation(std::vector<float>& target,
+                              const ImageAccessor& source,
+                              const ResizeKernel& kernel,
+                              unsigned int targetWidth) :
+      target_(target),
+      source_(source),
+      kernel_(kernel),
+      targetWidth_(targetWidth)
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height)
+    {
+      for (unsigned int sy = y; sy < y + height; sy++)
+      {
+        const SourceType* s = reinterpret_cast<const SourceType*>(source_.GetConstRow(sy));
+        float* t = &target_[static_cast<size_t>(sy) * targetWidth_ * Channels];
+
+        for (unsigned int tx = 0; tx < targetWidth_; tx++, t += Channels)
+        {
+          const SourceType* p = s + kernel_.GetFirst(tx) * Channels;
+          const float* w = kernel_.GetWeights(tx);
+          const unsigned int count = kernel_.GetCount(tx);
+
+          for (unsigned int c = 0; c < Channels; c++)
+          {
+            t[c] = 0;
+          }
+
+          for (unsigned int i = 0; i < count; i++, p += Channels)
+          {
+            for (unsigned int c = 0; c < Channels; c++)
+            {
+              t[c] += w[i] * static_cast<float>(p[c]);
+            }
+          }
+        }
+      }
+    }
+  };
+
+
+  template <typename TargetType, unsigned int Channels>
+  class VerticalResizeOperation : public IBandOperation
+  {
+  private:
+    ImageAccessor& target_;
+    const std::vector<float>& source_;  // Intermediate image
+    const ResizeKernel& kernel_;
+    float offset_;
+    float scaling_;
+
+  public:
+    VerticalResizeOperation(ImageAccessor& target,
+                            const std::vector<float>& source,
+                            const ResizeKernel& kernel,
+                            float offset,
+                            float scaling) :
+      target_(target),
+      source_(source),
+      kernel_(kernel),
+      offset_(offset),
+      scaling_(scaling)
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height)
+    {
+      const size_t rowSize = target_.GetWidth() * Channels;
+      std::vector<float> sums(rowSize);
+
+      for (unsigned int ty = y; ty < y + height; ty++)
+      {
+        std::fill(sums.begin(), sums.end(), 0.0f);
+
+        const float* w = kernel_.GetWeights(ty);
+        for (unsigned int i = 0; i < kernel_.GetCount(ty); i++)
+        {
+          const float* s = &source_[(kernel_.GetFirst(ty) + i) * rowSize];
+          for (size_t j = 0; j < rowSize; j++)
+          {
+            sums[j] += w[i] * s[j];
+          }
+        }
+
+        TargetType* t = reinterpret_cast<TargetType*>(target_.GetRow(ty));
+        for (size_t j = 0; j < rowSize; j++)
+        {
+          t[j] = ResizeToPixel<TargetType>(sums[j], offset_, scaling_);
+        }
+      }
+    }
+  };
+
+
+  template <typename TargetType, typename SourceType, unsigned int Channels>
+  static void ResizeInternal(ImageAccessor& target,
+                             const ImageAccessor& source,
+                             ImageInterpolation interpolation,
+                             float offset,
+                             float scaling)
+  {
+    const unsigned int countBands = GetBandsCount(source);
+
+    if (interpolation == ImageInterpolation_Box &&
+        source.GetWidth() % target.GetWidth() == 0 &&
+        source.GetHeight() % target.GetHeight() == 0)
+    {
+      // Fast path for integer downscaling factors: Plain integer sums
+      // over blocks of source pixels, without intermediate image
+      IntegerFactorResizeOperation<TargetType, SourceType, Channels> operation(target, source, offset, scaling);
+      ApplyByBands(operation, std::min(countBands, target.GetHeight()), target.GetHeight());
+      return;
+    }
+
+    ResizeKernel horizontal(source.GetWidth(), target.GetWidth(), interpolation);
+    ResizeKernel vertical(source.GetHeight(), target.GetHeight(), interpolation);
+
+    std::vector<float> intermediate(static_cast<size_t>(source.GetHeight()) * target.GetWidth() * Channels);
+
+    {
+      HorizontalResizeOperation<SourceType, Channels> operation(intermediate, source, horizontal, target.GetWidth());
+      ApplyByBands(operation, countBands, source.GetHeight());
+    }
+
+    {
+      VerticalResizeOperation<TargetType, Channels> operation(target, intermediate, vertical, offset, scaling);
+      ApplyByBands(operation, std::min(countBands, target.GetHeight()), target.GetHeight());
+    }
+  }
+
+
+  template <typename TargetType>
+  static void ResizeGrayscale(ImageAccessor& target,
+                              const ImageAccessor& source,
+                              ImageInterpolation interpolation,
+                              float offset,
+                              float scaling)
+  {
+    switch (source.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+        ResizeInternal<TargetType, uint8_t, 1>(target, source, interpolation, offset, scaling);
+        return;
+
+      case PixelFormat_Grayscale16:
+        ResizeInternal<TargetType, uint16_t, 1>(target, source, interpolation, offset, scaling);
+        return;
+
+      case PixelFormat_SignedGrayscale16:
+        ResizeInternal<TargetType, int16_t, 1>(target, source, interpolation, offset, scaling);
+        return;
+
+      default:
+        throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+  }
+
+
+  void ImageProcessing::ResizeAndShiftScale(ImageAccessor& target,
+                                            const ImageAccessor& source,
+                                            ImageInterpolation interpolation,
+                                            float offset,
+                                            float scaling)
+  {
+    if (target.GetWidth() == 0 ||
+        target.GetHeight() == 0)
+    {
+      return;
+    }
+
+    if (source.GetWidth() == 0 ||
+        source.GetHeight() == 0)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    switch (target.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+        ResizeGrayscale<uint8_t>(target, source, interpolation, offset, scaling);
+        return;
+
+      case PixelFormat_Grayscale16:
+        ResizeGrayscale<uint16_t>(target, source, interpolation, offset, scaling);
+        return;
+
+      case PixelFormat_SignedGrayscale16:
+        ResizeGrayscale<int16_t>(target, source, interpolation, offset, scaling);
+        return;
+
+      case PixelFormat_RGB24:
+        if (source.GetFormat() != PixelFormat_RGB24)
+        {
+          throw OrthancException(ErrorCode_IncompatibleImageFormat);
+        }
+
+        ResizeInternal<uint8_t, uint8_t, 3>(target, source, interpolation, offset, scaling);
+        return;
+
+      case PixelFormat_RGBA32:
+        if (source.GetFormat() != PixelFormat_RGBA32)
+        {
+          throw OrthancException(ErrorCode_IncompatibleImageFormat);
+        }
+
+        ResizeInternal<uint8_t, uint8_t, 4>(target, source, interpolation, offset, scaling);
+        return;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  void ImageProcessing::Resize(ImageAccessor& target,
+                               const ImageAccessor& source,
+                               ImageInterpolation interpolation)
+  {
+    if (target.GetFormat() != source.GetFormat())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    if (target.GetWidth() == source.GetWidth() &&
+        target.GetHeight() == source.GetHeight())
+    {
+      Copy(target, source);
+    }
+    else
+    {
+      ResizeAndShiftScale(target, source, interpolation, 0.0f, 1.0f);
+    }
+  }
+
+
+  void ImageProcessing::FitSize(unsigned int& targetWidth,
+                                unsigned int& targetHeight,
+                                unsigned int sourceWidth,
+                                unsigned int sourceHeight,
+                                unsigned int maxWidth,
+                                unsigned int maxHeight)
+  {
+    targetWidth = sourceWidth;
+    targetHeight = sourceHeight;
+
+    if (sourceWidth == 0 ||
+        sourceHeight == 0)
+    {
+      return;
+    }
+
+    // Compare the ratios "maxWidth / sourceWidth" and "maxHeight /
+    // sourceHeight" using integer arithmetics
+    const uint64_t a = static_cast<uint64_t>(maxWidth) * sourceHeight;
+    const uint64_t b = static_cast<uint64_t>(maxHeight) * sourceWidth;
+
+    if (maxWidth != 0 &&
+        maxWidth < sourceWidth &&
+        (maxHeight == 0 || a <= b))
+    {
+      targetWidth = maxWidth;
+      targetHeight = static_cast<unsigned int>((static_cast<uint64_t>(sourceHeight) * maxWidth + sourceWidth / 2) / sourceWidth);
+    }
+    else if (maxHeight != 0 &&
+             maxHeight < sourceHeight)
+    {
+      targetHeight = maxHeight;
+      targetWidth = static_cast<unsigned int>((static_cast<uint64_t>(sourceWidth) * maxHeight + sourceHeight / 2) / sourceHeight);
+    }
+
+    targetWidth = std::max(1u, targetWidth);
+    targetHeight = std::max(1u, targetHeight);
+  }
+
+
+
+  /**
+   * Windowing through a lookup table that is indexed by the stored
+   * pixel values. Signed values are shifted so that the table index
+   * is always positive.
+   **/
+
+  template <typename SourceType>
+  class LookupTableOperation : public IBandOperation
+  {
+  private:
+    ImageAccessor&        target_;
+    const ImageAccessor&  source_;
+    const uint8_t*        table_;
+
+  public:
+    LookupTableOperation(ImageAccessor& target,
+                         const ImageAccessor& source,
+                         const uint8_t* table) :
+      target_(target),
+      source_(source),
+      table_(table)
+    {
+    }
+
+    virtual void Apply(unsigned int band,
+                       unsigned int y,
+                       unsigned int height)
+    {
+      const int32_t shift = -static_cast<int32_t>(std::numeric_limits<SourceType>::min());
+      const unsigned int width = source_.GetWidth();
+
+      for (unsigned int i = y; i < y + height; i++)
+      {
+        uint8_t* t = reinterpret_cast<uint8_t*>(target_.GetRow(i));
+        const SourceType* s = reinterpret_cast<const SourceType*>(source_.GetConstRow(i));
+
+        for (unsigned int x = 0; x < width; x++)
+        {
+          t[x] = table_[static_cast<int32_t>(s[x]) + shift];
+        }
+      }
+    }
+  };
+
+
+  static uint8_t ComputeWindowing(float value,
+                                  float windowCenter,
+                                  float windowWidth)
+  {
+    // http://dicom.nema.org/medical/dicom/current/output/html/part03.html#sect_C.11.2.1.2.1
+    const float center = windowCenter - 0.5f;
+    const float width = windowWidth - 1.0f;
+
+    if (value <= center - width / 2.0f)
+    {
+      return 0;
+    }
+    else if (value > center + width / 2.0f)
+    {
+      return 255;
+    }
+    else
+    {
+      float v = ((value - center) / width + 0.5f) * 255.0f;
+      return static_cast<uint8_t>(boost::math::iround(std::max(0.0f, std::min(255.0f, v))));
+    }
+  }
+
+
+  template <typename SourceType>
+  static void ApplyWindowingInternal(ImageAccessor& target,
+                                     const ImageAccessor& source,
+                                     float windowCenter,
+                                     float windowWidth,
+                                     float rescaleSlope,
+                                     float rescaleIntercept,
+                                     bool invert)
+  {
+    const int32_t minValue = static_cast<int32_t>(std::numeric_limits<SourceType>::min());
+    const int32_t maxValue = static_cast<int32_t>(std::numeric_limits<SourceType>::max());
+
+    std::vector<uint8_t> table(maxValue - minValue + 1);
+    for (int32_t i = minValue; i <= maxValue; i++)
+    {
+      uint8_t v = ComputeWindowing(rescaleSlope * static_cast<float>(i) + rescaleIntercept,
+                                   windowCenter, windowWidth);
+      table[i - minValue] = (invert ? 255 - v : v);
+    }
+
+    LookupTableOperation<SourceType> operation(target, source, &table[0]);
+    ApplyByBands(operation, GetBandsCount(source), source.GetHeight());
+  }
+
+
+  void ImageProcessing::ApplyWindowing(ImageAccessor& target,
+                                       const ImageAccessor& source,
+                                       float windowCenter,
+                                       float windowWidth,
+                                       float rescaleSlope,
+                                       float rescaleIntercept,
+                                       bool invert)
+  {
+    if (target.GetWidth() != source.GetWidth() ||
+        target.GetHeight() != source.GetHeight())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    if (target.GetFormat() != PixelFormat_Grayscale8)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    if (windowWidth < 1.0f)
+    {
+      // The DICOM standard requires the window width to be >= 1
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    switch (source.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+        ApplyWindowingInternal<uint8_t>(target, source, windowCenter, windowWidth,
+                                        rescaleSlope, rescaleIntercept, invert);
+        return;
+
+      case PixelFormat_Grayscale16:
+        ApplyWindowingInternal<uint16_t>(target, source, windowCenter, windowWidth,
+                                         rescaleSlope, rescaleIntercept, invert);
+        return;
+
+      case PixelFormat_SignedGrayscale16:
+        ApplyWindowingInternal<int16_t>(target, source, windowCenter, windowWidth,
+                                        rescaleSlope, rescaleIntercept, invert);
+        return;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
 }
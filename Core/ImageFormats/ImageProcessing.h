@@ -38,9 +38,33 @@
 
 namespace Orthanc
 {
+  class ThreadPool;
+
   class ImageProcessing
   {
   public:
+    /**
+     * The SIMD implementations of the kernels are enabled by default
+     * if the CPU supports SSE2. Disabling them forces the use of the
+     * scalar implementations (mostly useful for testing).
+     **/
+    static bool IsSimdEnabled();
+
+    static void SetSimdEnabled(bool enabled);
+
+    /**
+     * Large images are split into bands of rows, that are processed
+     * in parallel by a pool of threads shared by all the
+     * operations. This sets the number of threads of this pool ("0"
+     * means the number of CPU cores, "1" disables parallelism). This
+     * method must not be called while images are being processed.
+     **/
+    static void SetThreadsCount(unsigned int count);
+
+    // The pool of threads, for other modules that process images by
+    // blocks of rows (e.g. PNG compression)
+    static ThreadPool& GetThreadPool();
+
     static void Copy(ImageAccessor& target,
                      const ImageAccessor& source);
 
@@ -66,5 +90,52 @@ namespace Orthanc
     static void ShiftScale(ImageAccessor& image,
                            float offset,
                            float scaling);
+
+    // The target and the source must have the same format
+    static void Resize(ImageAccessor& target,
+                       const ImageAccessor& source,
+                       ImageInterpolation interpolation);
+
+    /**
+     * Resizes the source image into the target image, then applies a
+     * shift-scale transform to the result, without any intermediate
+     * image buffer. The formats of the target and the source can be
+     * different grayscale formats, in which case the values are
+     * truncated to the range of the target format.
+     **/
+    static void ResizeAndShiftScale(ImageAccessor& target,
+                                    const ImageAccessor& source,
+                                    ImageInterpolation interpolation,
+                                    float offset,
+                                    float scaling);
+
+    /**
+     * Computes the size of an image that fits into a box of size
+     * "maxWidth x maxHeight", while preserving the aspect ratio of
+     * the source image. Images are never upscaled. A "0" maximum
+     * size leaves the corresponding dimension unconstrained.
+     **/
+    static void FitSize(unsigned int& targetWidth,
+                        unsigned int& targetHeight,
+                        unsigned int sourceWidth,
+                        unsigned int sourceHeight,
+                        unsigned int maxWidth,
+                        unsigned int maxHeight);
+
+    /**
+     * Renders a grayscale image into a Grayscale8 image of the same
+     * size, in one single pass over the source. The stored values are
+     * first converted by the rescale slope/intercept, then windowed
+     * using the linear function of the DICOM standard (PS 3.3,
+     * C.11.2.1.2), and finally inverted if "invert" is true (as for
+     * MONOCHROME1 images). This is implemented as a lookup table.
+     **/
+    static void ApplyWindowing(ImageAccessor& target,
+                               const ImageAccessor& source,
+                               float windowCenter,
+                               float windowWidth,
+                               float rescaleSlope,
+                               float rescaleIntercept,
+                               bool invert);
   };
 }
@@ -0,0 +1,281 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "JpegWriter.h"
+
+#include "../OrthancException.h"
+#include "../ChunkedBuffer.h"
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <vector>
+#include <glog/logging.h>
+
+extern "C"
+{
+#if ORTHANC_JPEG_USE_DCMTK_IJG == 1
+  // Use the 8-bit IJG library that is embedded within DCMTK. The
+  // "boolean" type is renamed the same way as in DCMTK, to avoid a
+  // clash with the Windows headers.
+#  define boolean ijg_boolean
+#  include <jpeglib8.h>
+#else
+#  include <jpeglib.h>
+#endif
+}
+
+
+// http://www.ijg.org/files/ (see "example.c" and "libjpeg.txt")
+
+namespace Orthanc
+{
+  namespace
+  {
+    struct ErrorManager
+    {
+      struct jpeg_error_mgr  pub_;  // Must be the first member
+      jmp_buf                setjmpBuffer_;
+    };
+
+
+    static const size_t BUFFER_SIZE = 16384;
+
+    struct MemoryDestination
+    {
+      struct jpeg_destination_mgr  pub_;  // Must be the first member
+      ChunkedBuffer*               chunks_;
+      JOCTET                       buffer_[BUFFER_SIZE];
+    };
+  }
+
+
+  static void ErrorExit(j_common_ptr cinfo)
+  {
+    // Return control to the setjmp() point of the writer
+    ErrorManager* error = reinterpret_cast<ErrorManager*>(cinfo->err);
+    longjmp(error->setjmpBuffer_, 1);
+  }
+
+
+  static void OutputMessage(j_common_ptr cinfo)
+  {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message) (cinfo, message);
+
+    LOG(WARNING) << "JPEG compression: " << message;
+  }
+
+
+  static void InitDestination(j_compress_ptr cinfo)
+  {
+    MemoryDestination* destination = reinterpret_cast<MemoryDestination*>(cinfo->dest);
+    destination->pub_.next_output_byte = destination->buffer_;
+    destination->pub_.free_in_buffer = BUFFER_SIZE;
+  }
+
+
+  static boolean EmptyOutputBuffer(j_compress_ptr cinfo)
+  {
+    // The whole buffer must be flushed, whatever the value of "free_in_buffer"
+    MemoryDestination* destination = reinterpret_cast<MemoryDestination*>(cinfo->dest);
+    destination->chunks_->AddChunk(reinterpret_cast<const char*>(destination->buffer_), BUFFER_SIZE);
+    destination->pub_.next_output_byte = destination->buffer_;
+    destination->pub_.free_in_buffer = BUFFER_SIZE;
+    return TRUE;
+  }
+
+
+  static void TermDestination(j_compress_ptr cinfo)
+  {
+    MemoryDestination* destination = reinterpret_cast<MemoryDestination*>(cinfo->dest);
+    size_t size = BUFFER_SIZE - destination->pub_.free_in_buffer;
+    destination->chunks_->AddChunk(reinterpret_cast<const char*>(destination->buffer_), size);
+  }
+
+
+  static void GetLines(std::vector<JSAMPROW>& lines,
+                       unsigned int height,
+                       unsigned int pitch,
+                       PixelFormat format,
+                       const void* buffer)
+  {
+    if (format != PixelFormat_Grayscale8 &&
+        format != PixelFormat_RGB24)
+    {
+      // JPEG baseline only handles 8 bits per sample
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    lines.resize(height);
+
+    uint8_t* base = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(buffer));
+    for (unsigned int y = 0; y < height; y++)
+    {
+      lines[y] = base + static_cast<intptr_t>(y) * pitch;
+    }
+  }
+
+
+  static void SetupErrorManager(struct jpeg_compress_struct& cinfo,
+                                ErrorManager& error)
+  {
+    cinfo.err = jpeg_std_error(&error.pub_);
+    error.pub_.error_exit = ErrorExit;
+    error.pub_.output_message = OutputMessage;
+  }
+
+
+  static void Compress(struct jpeg_compress_struct& cinfo,
+                       std::vector<JSAMPROW>& lines,
+                       unsigned int width,
+                       unsigned int height,
+                       PixelFormat format,
+                       int quality)
+  {
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+
+    switch (format)
+    {
+      case PixelFormat_Grayscale8:
+        cinfo.input_components = 1;
+        cinfo.in_color_space = JCS_GRAYSCALE;
+        break;
+
+      case PixelFormat_RGB24:
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_InternalError);
+    }
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    if (height > 0)
+    {
+      jpeg_write_scanlines(&cinfo, &lines[0], height);
+    }
+
+    jpeg_finish_compress(&cinfo);
+  }
+
+
+  void JpegWriter::SetQuality(uint8_t quality)
+  {
+    if (quality == 0 || quality > 100)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    quality_ = quality;
+  }
+
+
+  void JpegWriter::WriteToFile(const char* filename,
+                               unsigned int width,
+                               unsigned int height,
+                               unsigned int pitch,
+                               PixelFormat format,
+                               const void* buffer)
+  {
+    std::vector<JSAMPROW> lines;
+    GetLines(lines, height, pitch, format, buffer);
+
+    FILE* fp = fopen(filename, "wb");
+    if (!fp)
+    {
+      throw OrthancException(ErrorCode_CannotWriteFile);
+    }
+
+    struct jpeg_compress_struct cinfo;
+    ErrorManager error;
+    SetupErrorManager(cinfo, error);
+
+    if (setjmp(error.setjmpBuffer_))
+    {
+      // Error during writing JPEG
+      jpeg_destroy_compress(&cinfo);
+      fclose(fp);
+      throw OrthancException(ErrorCode_CannotWriteFile);
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, fp);
+    Compress(cinfo, lines, width, height, format, quality_);
+    jpeg_destroy_compress(&cinfo);
+
+    fclose(fp);
+  }
+
+
+  void JpegWriter::WriteToMemory(std::string& jpeg,
+                                 unsigned int width,
+                                 unsigned int height,
+                                 unsigned int pitch,
+                                 PixelFormat format,
+                                 const void* buffer)
+  {
+    std::vector<JSAMPROW> lines;
+    GetLines(lines, height, pitch, format, buffer);
+
+    ChunkedBuffer chunks;
+
+    MemoryDestination destination;
+    destination.chunks_ = &chunks;
+    destination.pub_.init_destination = InitDestination;
+    destination.pub_.empty_output_buffer = EmptyOutputBuffer;
+    destination.pub_.term_destination = TermDestination;
+
+    struct jpeg_compress_struct cinfo;
+    ErrorManager error;
+    SetupErrorManager(cinfo, error);
+
+    if (setjmp(error.setjmpBuffer_))
+    {
+      // Error during writing JPEG
+      jpeg_destroy_compress(&cinfo);
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    jpeg_create_compress(&cinfo);
+    cinfo.dest = &destination.pub_;
+    Compress(cinfo, lines, width, height, format, quality_);
+    jpeg_destroy_compress(&cinfo);
+
+    chunks.Flatten(jpeg);
+  }
+}
@@ -35,10 +35,20 @@
 
 #include <vector>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <png.h>
+#include <zlib.h>
 #include "../OrthancException.h"
 #include "../ChunkedBuffer.h"
 #include "../Toolbox.h"
+#include "../BufferPool.h"
+#include "../ICommand.h"
+#include "../MultiThreading/ThreadPool.h"
+#include "ImageProcessing.h"
+
+#include <memory>
+#include <boost/noncopyable.hpp>
 
 
 // http://www.libpng.org/pub/png/libpng-1.2.5-manual.html#section-4
@@ -87,7 +97,11 @@ namespace Orthanc
 
 
 
-  PngWriter::PngWriter() : pimpl_(new PImpl)
+  PngWriter::PngWriter() : 
+    pimpl_(new PImpl),
+    compressionLevel_(6),
+    filter_(PngFilter_Adaptive),
+    parallel_(true)
   {
     pimpl_->png_ = NULL;
     pimpl_->info_ = NULL;
@@ -122,6 +136,54 @@ namespace Orthanc
 
 
 
+  void PngWriter::SetCompressionLevel(unsigned int level)
+  {
+    if (level > 9)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    compressionLevel_ = level;
+  }
+
+
+  void PngWriter::SetFastPreset()
+  {
+    // The "Sub" filter is cheap, and most of the time nearly as good
+    // as the adaptive filtering at such a low compression level
+    compressionLevel_ = 1;
+    filter_ = PngFilter_Sub;
+  }
+
+
+  static int GetLibPngFilters(PngFilter filter)
+  {
+    switch (filter)
+    {
+    case PngFilter_Adaptive:
+      return PNG_ALL_FILTERS;
+
+    case PngFilter_None:
+      return PNG_FILTER_NONE;
+
+    case PngFilter_Sub:
+      return PNG_FILTER_SUB;
+
+    case PngFilter_Up:
+      return PNG_FILTER_UP;
+
+    case PngFilter_Average:
+      return PNG_FILTER_AVG;
+
+    case PngFilter_Paeth:
+      return PNG_FILTER_PAETH;
+
+    default:
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   void PngWriter::Prepare(unsigned int width,
                           unsigned int height,
                           unsigned int pitch,
@@ -172,6 +234,9 @@ namespace Orthanc
                  pimpl_->bitDepth_, pimpl_->colorType_, PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
+    png_set_compression_level(pimpl_->png_, compressionLevel_);
+    png_set_filter(pimpl_->png_, PNG_FILTER_TYPE_BASE, GetLibPngFilters(filter_));
+
     png_write_info(pimpl_->png_, pimpl_->info_);
 
     if (height > 0)
@@ -202,6 +267,450 @@ namespace Orthanc
   }
 
 
+  /**
+   * Parallel compression. The filtered rows of the image are split
+   * into blocks that are deflated independently. All the blocks but
+   * the last one end with a sync flush, so that the concatenation of
+   * the raw deflate streams is itself a valid deflate stream. Each
+   * block is stored in its own IDAT chunk, which is allowed by the
+   * PNG specification. The Adler-32 checksum of the whole zlib stream
+   * is recombined from those of the blocks.
+   **/
+
+  static const size_t MIN_BYTES_PER_BLOCK = 512 * 1024;
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+
+  static uint8_t PaethPredictor(int a,
+                                int b,
+                                int c)
+  {
+    // http://www.w3.org/TR/PNG/#9Filter-type-4-Paeth
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+    {
+      return static_cast<uint8_t>(a);
+    }
+    else if (pb <= pc)
+    {
+      return static_cast<uint8_t>(b);
+    }
+    else
+    {
+      return static_cast<uint8_t>(c);
+    }
+  }
+
+
+  static void ApplyFilter(uint8_t* target,   // Of size "rowBytes + 1"
+                          const uint8_t* row,
+                          const uint8_t* previous,  // NULL for the first row
+                          size_t rowBytes,
+                          size_t bpp,
+                          PngFilter filter)
+  {
+    target[0] = static_cast<uint8_t>(filter - PngFilter_None);
+    target++;
+
+    for (size_t i = 0; i < rowBytes; i++)
+    {
+      int a = (i >= bpp ? row[i - bpp] : 0);
+      int b = (previous != NULL ? previous[i] : 0);
+      int c = (i >= bpp && previous != NULL ? previous[i - bpp] : 0);
+
+      switch (filter)
+      {
+      case PngFilter_None:
+        target[i] = row[i];
+        break;
+
+      case PngFilter_Sub:
+        target[i] = static_cast<uint8_t>(row[i] - a);
+        break;
+
+      case PngFilter_Up:
+        target[i] = static_cast<uint8_t>(row[i] - b);
+        break;
+
+      case PngFilter_Average:
+        target[i] = static_cast<uint8_t>(row[i] - ((a + b) >> 1));
+        break;
+
+      case PngFilter_Paeth:
+        target[i] = static_cast<uint8_t>(row[i] - PaethPredictor(a, b, c));
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+  }
+
+
+  static uint64_t GetFilterCost(const uint8_t* filtered,
+                                size_t size)
+  {
+    // Heuristic of libpng: Minimum sum of absolute differences, the
+    // filtered bytes being considered as signed values
+    uint64_t cost = 0;
+    for (size_t i = 1; i < size; i++)
+    {
+      cost += abs(static_cast<int8_t>(filtered[i]));
+    }
+
+    return cost;
+  }
+
+
+  namespace
+  {
+    class DeflateBlockCommand : public ICommand
+    {
+    private:
+      const uint8_t*  buffer_;
+      unsigned int    pitch_;
+      size_t          rowBytes_;
+      size_t          bpp_;
+      bool            swap16_;
+      unsigned int    y_;
+      unsigned int    height_;
+      bool            isLast_;
+      PngFilter       filter_;
+      int             level_;
+
+      // The compressed output is not taken from the BufferPool: its
+      // size is unknown in advance, and it is moved into the answer
+      std::string     compressed_;
+      uLong           adler_;
+      uLong           uncompressedSize_;
+
+      void GetRow(uint8_t* target,
+                  unsigned int y) const
+      {
+        memcpy(target, buffer_ + y * pitch_, rowBytes_);
+
+        if (swap16_)
+        {
+          // 16bpp samples are stored in big endian in PNG
+          for (size_t i = 0; i + 1 < rowBytes_; i += 2)
+          {
+            std::swap(target[i], target[i + 1]);
+          }
+        }
+      }
+
+      void FilterRow(uint8_t* target,     // Of size "rowBytes + 1"
+                     uint8_t* candidate,  // Scratch memory of the same size
+                     const uint8_t* row,
+                     const uint8_t* previous) const
+      {
+        if (filter_ != PngFilter_Adaptive)
+        {
+          ApplyFilter(target, row, previous, rowBytes_, bpp_, filter_);
+          return;
+        }
+
+        uint64_t bestCost = 0;
+
+        for (int f = PngFilter_None; f <= PngFilter_Paeth; f++)
+        {
+          ApplyFilter(candidate, row, previous, rowBytes_, bpp_, static_cast<PngFilter>(f));
+
+          uint64_t cost = GetFilterCost(candidate, rowBytes_ + 1);
+          if (f == PngFilter_None ||
+              cost < bestCost)
+          {
+            bestCost = cost;
+            memcpy(target, candidate, rowBytes_ + 1);
+          }
+        }
+      }
+
+      void Deflate(z_stream& stream,
+                   uint8_t* chunk,
+                   const uint8_t* data,
+                   size_t size,
+                   int flush)
+      {
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = static_cast<uInt>(size);
+
+        do
+        {
+          stream.next_out = chunk;
+          stream.avail_out = CHUNK_SIZE;
+
+          int code = deflate(&stream, flush);
+          if (code != Z_OK &&
+              code != Z_STREAM_END &&
+              code != Z_BUF_ERROR)
+          {
+            throw OrthancException(ErrorCode_InternalError);
+          }
+
+          compressed_.append(reinterpret_cast<const char*>(chunk), CHUNK_SIZE - stream.avail_out);
+        }
+        while (stream.avail_out == 0);
+      }
+
+    public:
+      DeflateBlockCommand(const uint8_t* buffer,
+                          unsigned int pitch,
+                          size_t rowBytes,
+                          size_t bpp,
+                          bool swap16,
+                          unsigned int y,
+                          unsigned int height,
+                          bool isLast,
+                          PngFilter filter,
+                          int level) :
+        buffer_(buffer),
+        pitch_(pitch),
+        rowBytes_(rowBytes),
+        bpp_(bpp),
+        swap16_(swap16),
+        y_(y),
+        height_(height),
+        isLast_(isLast),
+        filter_(filter),
+        level_(level),
+        adler_(adler32(0, Z_NULL, 0)),
+        uncompressedSize_(0)
+      {
+      }
+
+      virtual bool Execute()
+      {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+
+        // Negative window bits: Raw deflate stream, without zlib header
+        if (deflateInit2(&stream, level_, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+
+        try
+        {
+          // All the scratch memory is taken from the pool
+          const size_t filteredSize = rowBytes_ + 1;
+          BufferPool::Buffer scratch(2 * rowBytes_ + 2 * filteredSize + CHUNK_SIZE);
+
+          uint8_t* previous = reinterpret_cast<uint8_t*>(scratch.GetData());
+          uint8_t* current = previous + rowBytes_;
+          uint8_t* filtered = current + rowBytes_;
+          uint8_t* candidate = filtered + filteredSize;
+          uint8_t* chunk = candidate + filteredSize;
+
+          if (y_ > 0)
+          {
+            // The filters of the first row depend on the previous row
+            GetRow(previous, y_ - 1);
+          }
+
+          for (unsigned int y = y_; y < y_ + height_; y++)
+          {
+            GetRow(current, y);
+            FilterRow(filtered, candidate, current, y == 0 ? NULL : previous);
+
+            adler_ = adler32(adler_, filtered, filteredSize);
+            uncompressedSize_ += filteredSize;
+
+            Deflate(stream, chunk, filtered, filteredSize, Z_NO_FLUSH);
+            std::swap(previous, current);
+          }
+
+          Deflate(stream, chunk, NULL, 0, isLast_ ? Z_FINISH : Z_SYNC_FLUSH);
+        }
+        catch (...)
+        {
+          deflateEnd(&stream);
+          throw;
+        }
+
+        deflateEnd(&stream);
+        return true;
+      }
+
+      const std::string& GetCompressed() const
+      {
+        return compressed_;
+      }
+
+      uLong GetAdler32() const
+      {
+        return adler_;
+      }
+
+      uLong GetUncompressedSize() const
+      {
+        return uncompressedSize_;
+      }
+    };
+
+
+    // Owns the blocks, so that they are freed whatever the exception
+    class DeflateBlocks : public boost::noncopyable
+    {
+    private:
+      std::vector<DeflateBlockCommand*>  blocks_;
+
+    public:
+      ~DeflateBlocks()
+      {
+        for (size_t i = 0; i < blocks_.size(); i++)
+        {
+          delete blocks_[i];
+        }
+      }
+
+      void Add(DeflateBlockCommand* block)   // Takes the ownership
+      {
+        std::auto_ptr<DeflateBlockCommand> protection(block);
+        blocks_.push_back(block);
+        protection.release();
+      }
+
+      size_t GetSize() const
+      {
+        return blocks_.size();
+      }
+
+      const DeflateBlockCommand& GetBlock(size_t i) const
+      {
+        return *blocks_[i];
+      }
+
+      void GetCommands(std::vector<ICommand*>& commands) const
+      {
+        commands.assign(blocks_.begin(), blocks_.end());
+      }
+    };
+  }
+
+
+  static void AppendUInt32(std::string& target,
+                           uint32_t value)
+  {
+    target.push_back(static_cast<char>((value >> 24) & 0xff));
+    target.push_back(static_cast<char>((value >> 16) & 0xff));
+    target.push_back(static_cast<char>((value >> 8) & 0xff));
+    target.push_back(static_cast<char>(value & 0xff));
+  }
+
+
+  static void AppendChunk(std::string& png,
+                          const char* type,
+                          const std::string& data)
+  {
+    // http://www.w3.org/TR/PNG/#5Chunk-layout
+    AppendUInt32(png, static_cast<uint32_t>(data.size()));
+
+    std::string s = std::string(type, 4) + data;
+    png += s;
+
+    AppendUInt32(png, crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(s.c_str()), s.size()));
+  }
+
+
+  bool PngWriter::WriteParallel(std::string& png,
+                                unsigned int width,
+                                unsigned int height,
+                                unsigned int pitch,
+                                PixelFormat format,
+                                const void* buffer)
+  {
+    if (!parallel_ ||
+        height == 0)
+    {
+      return false;
+    }
+
+    const size_t bpp = GetBytesPerPixel(format);
+    const size_t rowBytes = bpp * width;
+    const uint64_t totalBytes = static_cast<uint64_t>(rowBytes + 1) * height;
+
+    ThreadPool& pool = ImageProcessing::GetThreadPool();
+
+    uint64_t countBlocks = std::min(static_cast<uint64_t>(pool.GetWorkersCount() + 1),
+                                    totalBytes / MIN_BYTES_PER_BLOCK);
+    countBlocks = std::min(countBlocks, static_cast<uint64_t>(height));
+
+    if (countBlocks <= 1)
+    {
+      return false;
+    }
+
+    const bool swap16 = (pimpl_->bitDepth_ == 16 &&
+                         Toolbox::DetectEndianness() == Endianness_Little);
+    const unsigned int blockHeight = (height + countBlocks - 1) / countBlocks;
+
+    DeflateBlocks blocks;
+
+    for (unsigned int y = 0; y < height; y += blockHeight)
+    {
+      unsigned int h = std::min(blockHeight, height - y);
+      blocks.Add(new DeflateBlockCommand
+                 (reinterpret_cast<const uint8_t*>(buffer), pitch, rowBytes, bpp, swap16,
+                  y, h, y + h == height, filter_, compressionLevel_));
+    }
+
+    std::vector<ICommand*> commands;
+    blocks.GetCommands(commands);
+    pool.ExecuteBatch(commands);
+
+    // http://www.w3.org/TR/PNG/#11IHDR
+    std::string header;
+    AppendUInt32(header, width);
+    AppendUInt32(header, height);
+    header.push_back(static_cast<char>(pimpl_->bitDepth_));
+    header.push_back(static_cast<char>(pimpl_->colorType_));
+    header.push_back(0);   // Compression method
+    header.push_back(0);   // Filter method
+    header.push_back(0);   // No interlace
+
+    png = "\x89PNG\r\n\x1a\n";
+    AppendChunk(png, "IHDR", header);
+
+    uLong adler = adler32(0, Z_NULL, 0);
+
+    for (size_t i = 0; i < blocks.GetSize(); i++)
+    {
+      const DeflateBlockCommand& block = blocks.GetBlock(i);
+      std::string data;
+
+      if (i == 0)
+      {
+        // zlib header (RFC 1950), with a 32KB window
+        static const uint8_t LEVELS[10] = { 0, 0, 1, 1, 1, 1, 2, 3, 3, 3 };
+        unsigned int cmf = 0x78;
+        unsigned int flg = LEVELS[compressionLevel_] << 6;
+        flg += 31 - (cmf * 256 + flg) % 31;
+        data.push_back(static_cast<char>(cmf));
+        data.push_back(static_cast<char>(flg));
+      }
+
+      data += block.GetCompressed();
+      adler = adler32_combine(adler, block.GetAdler32(), block.GetUncompressedSize());
+
+      if (i + 1 == blocks.GetSize())
+      {
+        AppendUInt32(data, adler);
+      }
+
+      AppendChunk(png, "IDAT", data);
+    }
+
+    AppendChunk(png, "IEND", "");
+
+    return true;
+  }
+
+
   void PngWriter::WriteToFile(const char* filename,
                               unsigned int width,
                               unsigned int height,
@@ -211,6 +720,13 @@ namespace Orthanc
   {
     Prepare(width, height, pitch, format, buffer);
 
+    std::string png;
+    if (WriteParallel(png, width, height, pitch, format, buffer))
+    {
+      Toolbox::WriteFile(png, filename);
+      return;
+    }
+
     FILE* fp = fopen(filename, "wb");
     if (!fp)
     {
@@ -250,10 +766,15 @@ namespace Orthanc
                                 PixelFormat format,
                                 const void* buffer)
   {
-    ChunkedBuffer chunks;
-
     Prepare(width, height, pitch, format, buffer);
 
+    if (WriteParallel(png, width, height, pitch, format, buffer))
+    {
+      return;
+    }
+
+    ChunkedBuffer chunks;
+
     if (setjmp(png_jmpbuf(pimpl_->png_)))
     {
       // Error during writing PNG
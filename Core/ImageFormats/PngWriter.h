@@ -45,6 +45,10 @@ namespace Orthanc
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
 
+    unsigned int compressionLevel_;
+    PngFilter filter_;
+    bool parallel_;
+
     void Compress(unsigned int width,
                   unsigned int height,
                   unsigned int pitch,
@@ -56,11 +60,57 @@ namespace Orthanc
                  PixelFormat format,
                  const void* buffer);
 
+    // Must be called after Prepare()
+    bool WriteParallel(std::string& png,
+                       unsigned int width,
+                       unsigned int height,
+                       unsigned int pitch,
+                       PixelFormat format,
+                       const void* buffer);
+
   public:
     PngWriter();
 
     ~PngWriter();
 
+    // The zlib compression level, from 0 (no compression) to 9
+    // (best compression). The default is 6, as in libpng.
+    void SetCompressionLevel(unsigned int level);
+
+    unsigned int GetCompressionLevel() const
+    {
+      return compressionLevel_;
+    }
+
+    void SetFilter(PngFilter filter)
+    {
+      filter_ = filter;
+    }
+
+    PngFilter GetFilter() const
+    {
+      return filter_;
+    }
+
+    // Favors speed over size, for interactive previews
+    void SetFastPreset();
+
+    /**
+     * Large images are compressed in parallel by the thread pool of
+     * ImageProcessing: Blocks of rows are deflated independently,
+     * then stitched into one single zlib stream. This is enabled by
+     * default.
+     **/
+    void SetParallelEnabled(bool enabled)
+    {
+      parallel_ = enabled;
+    }
+
+    bool IsParallelEnabled() const
+    {
+      return parallel_;
+    }
+
     void WriteToFile(const char* filename,
                      unsigned int width,
                      unsigned int height,
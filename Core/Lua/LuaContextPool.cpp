@@ -0,0 +1,238 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "LuaContextPool.h"
+
+#include <glog/logging.h>
+
+namespace Orthanc
+{
+  void LuaContextPool::WaitAllIdle(boost::mutex::scoped_lock& lock)
+  {
+    for (;;)
+    {
+      bool idle = true;
+      for (size_t i = 0; i < busy_.size(); i++)
+      {
+        if (busy_[i])
+        {
+          idle = false;
+          break;
+        }
+      }
+
+      if (idle)
+      {
+        return;
+      }
+
+      released_.wait(lock);
+    }
+  }
+
+
+  LuaContextPool::Locker::Locker(LuaContextPool& pool) : pool_(pool)
+  {
+    boost::mutex::scoped_lock lock(pool.mutex_);
+
+    for (;;)
+    {
+      // In serialized mode, only the first interpreter is used
+      size_t count = (pool.serialized_ ? 1 : pool.contexts_.size());
+
+      for (size_t i = 0; i < count; i++)
+      {
+        if (!pool.busy_[i])
+        {
+          pool.busy_[i] = true;
+          index_ = i;
+          return;
+        }
+      }
+
+      pool.released_.wait(lock);
+    }
+  }
+
+
+  LuaContextPool::Locker::~Locker()
+  {
+    boost::mutex::scoped_lock lock(pool_.mutex_);
+    pool_.busy_[index_] = false;
+    pool_.released_.notify_all();
+  }
+
+
+  LuaContextPool::LuaContextPool(size_t size) : serialized_(false)
+  {
+    if (size == 0)
+    {
+      size = boost::thread::hardware_concurrency();
+      if (size == 0)
+      {
+        size = 1;
+      }
+    }
+
+    try
+    {
+      for (size_t i = 0; i < size; i++)
+      {
+        contexts_.push_back(new LuaContext);
+      }
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < contexts_.size(); i++)
+      {
+        delete contexts_[i];
+      }
+
+      throw;
+    }
+
+    busy_.resize(size, false);
+  }
+
+
+  LuaContextPool::~LuaContextPool()
+  {
+    for (size_t i = 0; i < contexts_.size(); i++)
+    {
+      delete contexts_[i];
+    }
+  }
+
+
+  void LuaContextPool::SetSerialized(bool serialized)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    serialized_ = serialized;
+
+    if (serialized)
+    {
+      LOG(WARNING) << "The Lua callbacks are serialized into one single interpreter";
+    }
+    else
+    {
+      LOG(WARNING) << "The Lua callbacks are run by a pool of " << contexts_.size() << " interpreter(s)";
+    }
+  }
+
+
+  bool LuaContextPool::IsSerialized()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return serialized_;
+  }
+
+
+  void LuaContextPool::Execute(const std::string& script)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    WaitAllIdle(lock);
+
+    for (size_t i = 0; i < contexts_.size(); i++)
+    {
+      contexts_[i]->Execute(script);
+    }
+  }
+
+
+  void LuaContextPool::Execute(EmbeddedResources::FileResourceId resource)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    WaitAllIdle(lock);
+
+    for (size_t i = 0; i < contexts_.size(); i++)
+    {
+      contexts_[i]->Execute(resource);
+    }
+  }
+
+
+  void LuaContextPool::Broadcast(std::string& output,
+                                 const std::string& script)
+  {
+    for (size_t i = 0; i < contexts_.size(); i++)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (busy_[i])
+        {
+          released_.wait(lock);
+        }
+
+        busy_[i] = true;
+      }
+
+      // The mutex is not kept during the execution, as the script
+      // might call the REST API, which might in turn run callbacks
+      try
+      {
+        std::string s;
+        contexts_[i]->Execute(s, script);
+
+        if (i == 0)
+        {
+          output.swap(s);
+        }
+      }
+      catch (...)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        busy_[i] = false;
+        released_.notify_all();
+        throw;
+      }
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        busy_[i] = false;
+        released_.notify_all();
+      }
+    }
+  }
+
+
+  void LuaContextPool::SetHttpProxy(const std::string& proxy)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    WaitAllIdle(lock);
+
+    for (size_t i = 0; i < contexts_.size(); i++)
+    {
+      contexts_[i]->SetHttpProxy(proxy);
+    }
+  }
+}
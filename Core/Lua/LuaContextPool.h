@@ -0,0 +1,113 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "LuaContext.h"
+
+#include <vector>
+#include <boost/thread.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Set of independent Lua interpreters, loaded with the same
+   * scripts, so that several threads can run Lua callbacks at the
+   * same time. The global variables of the scripts are NOT shared
+   * between the interpreters: Scripts that rely on global state must
+   * switch the pool to serialized mode, in which one single
+   * interpreter is used by all the threads.
+   **/
+  class LuaContextPool : public boost::noncopyable
+  {
+  private:
+    std::vector<LuaContext*>  contexts_;
+    std::vector<bool>         busy_;
+    bool                      serialized_;
+    boost::mutex              mutex_;
+    boost::condition_variable released_;
+
+    // Waits until no interpreter is in use. The mutex must be locked.
+    void WaitAllIdle(boost::mutex::scoped_lock& lock);
+
+  public:
+    class Locker : public boost::noncopyable
+    {
+    private:
+      LuaContextPool& pool_;
+      size_t          index_;
+
+    public:
+      // Waits until some interpreter is available
+      explicit Locker(LuaContextPool& pool);
+
+      ~Locker();
+
+      LuaContext& GetLua()
+      {
+        return *pool_.contexts_[index_];
+      }
+    };
+
+    // "size == 0" means one interpreter per core
+    explicit LuaContextPool(size_t size);
+
+    ~LuaContextPool();
+
+    size_t GetSize() const
+    {
+      return contexts_.size();
+    }
+
+    void SetSerialized(bool serialized);
+
+    bool IsSerialized();
+
+    // Executes a script in all the interpreters, once none of them is
+    // in use. This is meant to load the scripts at startup.
+    void Execute(const std::string& script);
+
+    void Execute(EmbeddedResources::FileResourceId resource);
+
+    // Executes a script in all the interpreters, each of them being
+    // reserved in turn as soon as it is idle, without blocking the
+    // whole pool. This is meant to (re)define callbacks while they
+    // are running. "output" receives the output of the first
+    // interpreter. The side effects of the script are repeated once
+    // per interpreter. If an interpreter fails, the execution stops,
+    // and the previous interpreters keep the effects of the script.
+    void Broadcast(std::string& output,
+                   const std::string& script);
+
+    void SetHttpProxy(const std::string& proxy);
+  };
+}
@@ -0,0 +1,233 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "ThreadPool.h"
+
+#include "../OrthancException.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+namespace Orthanc
+{
+  class ThreadPool::Batch : public boost::noncopyable
+  {
+  private:
+    std::vector<ICommand*> commands_;  // Copy, as workers can outlive the call
+    size_t next_;
+    size_t remaining_;
+    bool success_;
+    ErrorCode error_;
+    boost::mutex mutex_;
+    boost::condition_variable done_;
+
+    void Execute(ICommand& command)
+    {
+      bool success;
+      ErrorCode error = ErrorCode_Success;
+
+      try
+      {
+        success = command.Execute();
+      }
+      catch (OrthancException& e)
+      {
+        success = false;
+        error = e.GetErrorCode();
+      }
+      catch (std::bad_alloc&)
+      {
+        success = false;
+        error = ErrorCode_NotEnoughMemory;
+      }
+      catch (...)
+      {
+        success = false;
+        error = ErrorCode_InternalError;
+      }
+
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!success)
+      {
+        success_ = false;
+        if (error_ == ErrorCode_Success)
+        {
+          error_ = error;
+        }
+      }
+
+      assert(remaining_ > 0);
+      remaining_--;
+
+      if (remaining_ == 0)
+      {
+        done_.notify_all();
+      }
+    }
+
+  public:
+    explicit Batch(const std::vector<ICommand*>& commands) :
+      commands_(commands),
+      next_(0),
+      remaining_(commands.size()),
+      success_(true),
+      error_(ErrorCode_Success)
+    {
+    }
+
+    // Executes the pending commands of this batch, until none is left
+    void Run()
+    {
+      for (;;)
+      {
+        ICommand* command;
+
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          if (next_ == commands_.size())
+          {
+            return;
+          }
+
+          command = commands_[next_++];
+        }
+
+        Execute(*command);
+      }
+    }
+
+    bool Wait()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      while (remaining_ > 0)
+      {
+        done_.wait(lock);
+      }
+
+      if (error_ != ErrorCode_Success)
+      {
+        throw OrthancException(error_);
+      }
+
+      return success_;
+    }
+  };
+
+
+  void ThreadPool::Worker(ThreadPool* that)
+  {
+    for (;;)
+    {
+      boost::shared_ptr<Batch> batch;
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        while (that->continue_ && that->queue_.empty())
+        {
+          that->queueNotEmpty_.wait(lock);
+        }
+
+        if (!that->continue_)
+        {
+          return;
+        }
+
+        batch = that->queue_.front();
+        that->queue_.pop_front();
+      }
+
+      batch->Run();
+    }
+  }
+
+
+  ThreadPool::ThreadPool(unsigned int countWorkers) : continue_(true)
+  {
+    workers_.resize(countWorkers);
+
+    for (unsigned int i = 0; i < countWorkers; i++)
+    {
+      workers_[i] = new boost::thread(Worker, this);
+    }
+  }
+
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      continue_ = false;
+      queueNotEmpty_.notify_all();
+    }
+
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+      if (workers_[i]->joinable())
+      {
+        workers_[i]->join();
+      }
+
+      delete workers_[i];
+    }
+  }
+
+
+  bool ThreadPool::ExecuteBatch(const std::vector<ICommand*>& commands)
+  {
+    boost::shared_ptr<Batch> batch(new Batch(commands));
+
+    if (commands.size() > 1 &&
+        !workers_.empty())
+    {
+      // Wake up as many workers as there are commands that will not
+      // be executed by the calling thread
+      size_t count = std::min(commands.size() - 1, workers_.size());
+
+      boost::mutex::scoped_lock lock(mutex_);
+
+      for (size_t i = 0; i < count; i++)
+      {
+        queue_.push_back(batch);
+        queueNotEmpty_.notify_one();
+      }
+    }
+
+    batch->Run();
+
+    return batch->Wait();
+  }
+}
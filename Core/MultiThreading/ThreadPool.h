@@ -0,0 +1,82 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../ICommand.h"
+
+#include <vector>
+#include <list>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Fixed set of worker threads that execute batches of commands. The
+   * thread that submits a batch also takes part in its execution, and
+   * waits until all the commands of the batch are done. As a
+   * consequence, a batch always completes even if all the workers are
+   * busy, and batches can be nested.
+   **/
+  class ThreadPool : public boost::noncopyable
+  {
+  private:
+    class Batch;
+    typedef std::list< boost::shared_ptr<Batch> >  Queue;
+
+    bool continue_;
+    std::vector<boost::thread*> workers_;
+    Queue queue_;
+    boost::mutex mutex_;
+    boost::condition_variable queueNotEmpty_;
+
+    static void Worker(ThreadPool* that);
+
+  public:
+    // A pool with "countWorkers == 0" executes everything in the
+    // calling thread
+    explicit ThreadPool(unsigned int countWorkers);
+
+    ~ThreadPool();
+
+    unsigned int GetWorkersCount() const
+    {
+      return workers_.size();
+    }
+
+    // The commands remain owned by the caller. If some command throws
+    // an OrthancException, it is rethrown once the batch is done.
+    // Returns "false" iff some command returned "false".
+    bool ExecuteBatch(const std::vector<ICommand*>& commands);
+  };
+}
@@ -128,6 +128,24 @@ namespace Orthanc
     alreadySent_ = true;
   }
 
+  void RestApiOutput::AnswerBufferRange(const std::string& buffer,
+                                        const std::string& contentType,
+                                        uint64_t start,
+                                        uint64_t end)
+  {
+    CheckStatus();
+    output_.SetContentType(contentType.c_str());
+    output_.SendBodyRange(buffer, start, end);
+    alreadySent_ = true;
+  }
+
+  void RestApiOutput::SignalRangeNotSatisfiable(uint64_t size)
+  {
+    CheckStatus();
+    output_.SendRangeNotSatisfiable(size);
+    alreadySent_ = true;
+  }
+
   void RestApiOutput::Redirect(const std::string& path)
   {
     CheckStatus();
@@ -140,7 +158,9 @@ namespace Orthanc
     if (status != HttpStatus_400_BadRequest &&
         status != HttpStatus_403_Forbidden &&
         status != HttpStatus_500_InternalServerError &&
-        status != HttpStatus_415_UnsupportedMediaType)
+        status != HttpStatus_413_RequestEntityTooLarge &&
+        status != HttpStatus_415_UnsupportedMediaType &&
+        status != HttpStatus_503_ServiceUnavailable)
     {
       throw OrthancException("This HTTP status is not allowed in a REST API");
     }
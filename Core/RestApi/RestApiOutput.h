@@ -86,8 +86,15 @@ namespace Orthanc
                       size_t length,
                       const std::string& contentType);
 
+    void AnswerBufferRange(const std::string& buffer,
+                           const std::string& contentType,
+                           uint64_t start,
+                           uint64_t end);
+
     void SignalError(HttpStatus status);
 
+    void SignalRangeNotSatisfiable(uint64_t size);
+
     void Redirect(const std::string& path);
 
     void SetCookie(const std::string& name,
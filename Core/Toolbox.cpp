@@ -82,6 +82,34 @@
 
 #include <boost/locale.hpp>
 
+#if ORTHANC_ICONV_ENABLED == 1
+#include <iconv.h>
+#include <errno.h>
+#include <map>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/tss.hpp>
+#endif
+
+/**
+ * The SHA extensions of the x86 CPUs are used to compute SHA-1, if
+ * the compiler knows their intrinsics. The decision is taken at
+ * runtime by checking the CPU.
+ **/
+#if ORTHANC_SSE2_ENABLED == 1 &&                                        \
+  ((defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 5) ||       \
+   (defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))) || \
+   (defined(_MSC_VER) && _MSC_VER >= 1900))
+#  define ORTHANC_SHA_INTRINSICS 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#else
+#  define ORTHANC_SHA_INTRINSICS 0
+#endif
+
 #include "../Resources/ThirdParty/md5/md5.h"
 #include "../Resources/ThirdParty/base64/base64.h"
 
@@ -557,6 +585,137 @@ namespace Orthanc
   }
 
 
+#if ORTHANC_ICONV_ENABLED == 1
+  namespace
+  {
+    /**
+     * Cache of the iconv descriptors that convert to UTF-8, indexed
+     * by the source encoding. Opening a descriptor is much more
+     * costly than converting a short DICOM value, and as a descriptor
+     * carries a conversion state, each thread has its own cache.
+     **/
+    class IconvCache : public boost::noncopyable
+    {
+    private:
+      typedef std::map<Encoding, iconv_t>  Descriptors;
+
+      Descriptors  descriptors_;
+
+    public:
+      ~IconvCache()
+      {
+        for (Descriptors::iterator it = descriptors_.begin(); 
+             it != descriptors_.end(); ++it)
+        {
+          if (it->second != reinterpret_cast<iconv_t>(-1))
+          {
+            iconv_close(it->second);
+          }
+        }
+      }
+
+      // Returns "(iconv_t) -1" if iconv does not support the encoding
+      iconv_t GetDescriptor(Encoding encoding,
+                            const char* name)
+      {
+        Descriptors::iterator found = descriptors_.find(encoding);
+        if (found != descriptors_.end())
+        {
+          // Reset the conversion state, in case the previous input
+          // was incomplete
+          if (found->second != reinterpret_cast<iconv_t>(-1))
+          {
+            iconv(found->second, NULL, NULL, NULL, NULL);
+          }
+
+          return found->second;
+        }
+
+        iconv_t descriptor = iconv_open("UTF-8", name);
+        descriptors_[encoding] = descriptor;
+        return descriptor;
+      }
+    };
+  }
+
+
+  static boost::thread_specific_ptr<IconvCache>  iconvCache_;
+
+
+  static bool ConvertToUtf8WithIconv(std::string& target,
+                                     const std::string& source,
+                                     Encoding encoding,
+                                     const char* name)
+  {
+    if (iconvCache_.get() == NULL)
+    {
+      iconvCache_.reset(new IconvCache);
+    }
+
+    iconv_t descriptor = iconvCache_->GetDescriptor(encoding, name);
+    if (descriptor == reinterpret_cast<iconv_t>(-1))
+    {
+      return false;
+    }
+
+    // One source byte produces at most 3 bytes in UTF-8 for all the
+    // supported encodings, the buffer is grown below if ever needed
+    target.resize(3 * source.size() + 16);
+
+    char* input = const_cast<char*>(source.c_str());
+    size_t inputLeft = source.size();
+    size_t written = 0;
+
+    while (inputLeft > 0)
+    {
+      char* output = &target[written];
+      size_t outputLeft = target.size() - written;
+
+      size_t result = iconv(descriptor, &input, &inputLeft, &output, &outputLeft);
+      written = target.size() - outputLeft;
+
+      if (result == static_cast<size_t>(-1))
+      {
+        switch (errno)
+        {
+          case E2BIG:
+            target.resize(2 * target.size());
+            break;
+
+          case EILSEQ:
+          case EINVAL:
+            // Skip the invalid byte, as boost::locale does by default
+            input++;
+            inputLeft--;
+            iconv(descriptor, NULL, NULL, NULL, NULL);
+            break;
+
+          default:
+            return false;
+        }
+      }
+    }
+
+    target.resize(written);
+    return true;
+  }
+#endif
+
+
+  static bool IsPureAscii(const std::string& source)
+  {
+    for (size_t i = 0; i < source.size(); i++)
+    {
+      if (static_cast<uint8_t>(source[i]) >= 0x80)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
   std::string Toolbox::ConvertToUtf8(const std::string& source,
                                      const Encoding sourceEncoding)
   {
@@ -629,6 +788,22 @@ namespace Orthanc
         throw OrthancException(ErrorCode_NotImplemented);
     }
 
+    // All the encodings above but Shift-JIS (where 0x5c is the yen
+    // sign) coincide with ASCII on the 7-bit characters
+    if (sourceEncoding != Encoding_Japanese &&
+        IsPureAscii(source))
+    {
+      return source;
+    }
+
+#if ORTHANC_ICONV_ENABLED == 1
+    std::string result;
+    if (ConvertToUtf8WithIconv(result, source, sourceEncoding, encoding))
+    {
+      return result;
+    }
+#endif
+
     try
     {
       return boost::locale::conv::to_utf<char>(source, encoding);
@@ -657,22 +832,229 @@ namespace Orthanc
     return result;
   }
 
-  void Toolbox::ComputeSHA1(std::string& result,
-                            const std::string& data)
+#if ORTHANC_SHA_INTRINSICS == 1
+  static bool HasShaExtensions()
   {
-    boost::uuids::detail::sha1 sha1;
+    // CPUID leaf 1: SSSE3 (ECX bit 9) and SSE4.1 (ECX bit 19)
+    // CPUID leaf 7: SHA (EBX bit 29)
+#  if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+      return false;
+    }
 
-    if (data.size() > 0)
+    __cpuid(info, 1);
+    bool hasSse = ((info[2] & (1 << 9)) != 0 &&
+                   (info[2] & (1 << 19)) != 0);
+
+    __cpuidex(info, 7, 0);
+    return hasSse && (info[1] & (1 << 29)) != 0;
+#  else
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7 ||
+        !__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+        (ecx & (1 << 9)) == 0 ||
+        (ecx & (1 << 19)) == 0)
+    {
+      return false;
+    }
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1 << 29)) != 0;
+#  endif
+  }
+
+  static const bool hasShaExtensions_ = HasShaExtensions();
+  static bool useShaExtensions_ = hasShaExtensions_;
+
+
+#  if defined(_MSC_VER)
+#    define ORTHANC_SHA_TARGET
+#  else
+#    define ORTHANC_SHA_TARGET __attribute__((target("sha,sse4.1")))
+#  endif
+
+  /**
+   * Four rounds of SHA-1, following the reference code of Intel
+   * ("Intel SHA Extensions", July 2013). "G" is the index of the
+   * group of 4 rounds (from 0 to 19): The message schedule is
+   * interleaved with the rounds, and the "E" registers alternate.
+   **/
+#  define ORTHANC_SHA1_ROUNDS(G, E, ENext, Msg)                         \
+  {                                                                     \
+    if (G == 0)                                                         \
+    {                                                                   \
+      E = _mm_add_epi32(E, Msg[0]);                                     \
+    }                                                                   \
+    else                                                                \
+    {                                                                   \
+      E = _mm_sha1nexte_epu32(E, Msg[G % 4]);                           \
+    }                                                                   \
+                                                                        \
+    ENext = abcd;                                                       \
+                                                                        \
+    if (G >= 3 && G <= 18)                                              \
+    {                                                                   \
+      Msg[(G + 1) % 4] = _mm_sha1msg2_epu32(Msg[(G + 1) % 4], Msg[G % 4]); \
+    }                                                                   \
+                                                                        \
+    abcd = _mm_sha1rnds4_epu32(abcd, E, G / 5);                         \
+                                                                        \
+    if (G >= 1 && G <= 16)                                              \
+    {                                                                   \
+      Msg[(G + 3) % 4] = _mm_sha1msg1_epu32(Msg[(G + 3) % 4], Msg[G % 4]); \
+    }                                                                   \
+                                                                        \
+    if (G >= 2 && G <= 17)                                              \
+    {                                                                   \
+      Msg[(G + 2) % 4] = _mm_xor_si128(Msg[(G + 2) % 4], Msg[G % 4]);   \
+    }                                                                   \
+  }
+
+  ORTHANC_SHA_TARGET
+  static void ProcessSHA1Blocks(uint32_t state[5],
+                                const uint8_t* data,
+                                size_t countBlocks)
+  {
+    // Converts the big-endian words of the message
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ll, 0x08090a0b0c0d0e0fll);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1b);
+    __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+    __m128i e1;
+    __m128i msg[4];
+
+    for (size_t block = 0; block < countBlocks; block++, data += 64)
+    {
+      const __m128i abcdSave = abcd;
+      const __m128i e0Save = e0;
+
+      for (unsigned int i = 0; i < 4; i++)
+      {
+        msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), mask);
+      }
+
+      ORTHANC_SHA1_ROUNDS(0, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(1, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(2, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(3, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(4, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(5, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(6, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(7, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(8, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(9, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(10, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(11, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(12, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(13, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(14, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(15, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(16, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(17, e1, e0, msg);
+      ORTHANC_SHA1_ROUNDS(18, e0, e1, msg);
+      ORTHANC_SHA1_ROUNDS(19, e1, e0, msg);
+
+      e0 = _mm_sha1nexte_epu32(e0, e0Save);
+      abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+  }
+
+#  undef ORTHANC_SHA1_ROUNDS
+#  undef ORTHANC_SHA_TARGET
+
+
+  static void ComputeSHA1WithShaExtensions(uint32_t digest[5],
+                                           const std::string& data)
+  {
+    digest[0] = 0x67452301;
+    digest[1] = 0xefcdab89;
+    digest[2] = 0x98badcfe;
+    digest[3] = 0x10325476;
+    digest[4] = 0xc3d2e1f0;
+
+    const size_t countBlocks = data.size() / 64;
+    if (countBlocks > 0)
+    {
+      ProcessSHA1Blocks(digest, reinterpret_cast<const uint8_t*>(data.c_str()), countBlocks);
+    }
+
+    // Padding: The remaining bytes, the "1" bit, then the size of
+    // the message in bits (big-endian) at the end of the last block
+    const size_t remaining = data.size() % 64;
+
+    uint8_t tail[128];
+    memset(tail, 0, sizeof(tail));
+    if (remaining > 0)
     {
-      sha1.process_bytes(&data[0], data.size());
+      memcpy(tail, data.c_str() + 64 * countBlocks, remaining);
     }
 
+    tail[remaining] = 0x80;
+
+    const size_t tailSize = (remaining < 56 ? 64 : 128);
+    const uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+
+    ProcessSHA1Blocks(digest, tail, tailSize / 64);
+  }
+#endif
+
+
+  bool Toolbox::IsSHA1Accelerated()
+  {
+#if ORTHANC_SHA_INTRINSICS == 1
+    return useShaExtensions_;
+#else
+    return false;
+#endif
+  }
+
+
+  void Toolbox::SetSHA1Accelerated(bool enabled)
+  {
+#if ORTHANC_SHA_INTRINSICS == 1
+    // The acceleration can only be enabled if the CPU supports it
+    useShaExtensions_ = (enabled && hasShaExtensions_);
+#endif
+  }
+
+
+  void Toolbox::ComputeSHA1(std::string& result,
+                            const std::string& data)
+  {
     unsigned int digest[5];
 
     // Sanity check for the memory layout: A SHA-1 digest is 160 bits wide
     assert(sizeof(unsigned int) == 4 && sizeof(digest) == (160 / 8)); 
-    
-    sha1.get_digest(digest);
+
+#if ORTHANC_SHA_INTRINSICS == 1
+    if (useShaExtensions_)
+    {
+      uint32_t tmp[5];
+      ComputeSHA1WithShaExtensions(tmp, data);
+      std::copy(tmp, tmp + 5, digest);
+    }
+    else
+#endif
+    {
+      boost::uuids::detail::sha1 sha1;
+
+      if (data.size() > 0)
+      {
+        sha1.process_bytes(&data[0], data.size());
+      }
+
+      sha1.get_digest(digest);
+    }
 
     result.resize(8 * 5 + 4);
     sprintf(&result[0], "%08x-%08x-%08x-%08x-%08x",
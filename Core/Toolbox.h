@@ -103,6 +103,15 @@ namespace Orthanc
     void ComputeSHA1(std::string& result,
                      const std::string& data);
 
+    /**
+     * SHA-1 is computed with the SHA extensions of the x86 CPUs if
+     * they are available. Disabling them forces the use of the
+     * portable implementation (mostly useful for testing).
+     **/
+    bool IsSHA1Accelerated();
+
+    void SetSHA1Accelerated(bool enabled);
+
     bool IsSHA1(const std::string& str);
 
     void DecodeBase64(std::string& result, 
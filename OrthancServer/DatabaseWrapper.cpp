@@ -36,6 +36,7 @@
 #include "../Core/DicomFormat/DicomArray.h"
 #include "../Core/Uuid.h"
 #include "EmbeddedResources.h"
+#include "ServerToolbox.h"
 
 #include <glog/logging.h>
 #include <stdio.h>
@@ -570,8 +571,8 @@ namespace Orthanc
   }
 
 
-  void DatabaseWrapper::LogChange(int64_t internalId,
-                                  const ServerIndexChange& change)
+  int64_t DatabaseWrapper::LogChange(int64_t internalId,
+                                     const ServerIndexChange& change)
   {
     SQLite::Statement s(db_, SQLITE_FROM_HERE, "INSERT INTO Changes VALUES(NULL, ?, ?, ?, ?)");
     s.BindInt(0, change.GetChangeType());
@@ -579,6 +580,8 @@ namespace Orthanc
     s.BindInt(2, change.GetResourceType());
     s.BindString(3, change.GetDate());
     s.Run();
+
+    return db_.GetLastInsertRowId();
   }
 
 
@@ -998,4 +1001,46 @@ namespace Orthanc
     }
   }
 
+
+
+  bool DatabaseWrapper::CreateInstance(CreateInstanceResult& result,
+                                       int64_t& instanceId,
+                                       const std::string& patient,
+                                       const std::string& study,
+                                       const std::string& series,
+                                       const std::string& instance)
+  {
+    return CreateInstanceGeneric(result, instanceId, *this, patient, study, series, instance);
+  }
+
+
+  void DatabaseWrapper::LookupResourceContent(DicomMap& mainDicomTags,
+                                              std::list<std::string>& children,
+                                              std::map<MetadataType, std::string>& metadata,
+                                              int64_t id)
+  {
+    LookupResourceContentGeneric(mainDicomTags, children, metadata, *this, id);
+  }
+
+
+  void DatabaseWrapper::GetAllAttachments(std::list<FileInfo>& target,
+                                          int64_t id)
+  {
+    target.clear();
+
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "SELECT uuid, fileType, uncompressedSize, compressionType, compressedSize, uncompressedMD5, compressedMD5 FROM AttachedFiles WHERE id=?");
+    s.BindInt64(0, id);
+
+    while (s.Step())
+    {
+      target.push_back(FileInfo(s.ColumnString(0),
+                                static_cast<FileContentType>(s.ColumnInt(1)),
+                                s.ColumnInt64(2),
+                                s.ColumnString(5),
+                                static_cast<CompressionType>(s.ColumnInt(3)),
+                                s.ColumnInt64(4),
+                                s.ColumnString(6)));
+    }
+  }
 }
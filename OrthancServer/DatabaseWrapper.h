@@ -142,8 +142,8 @@ namespace Orthanc
     virtual void GetChildrenInternalId(std::list<int64_t>& target,
                                        int64_t id);
 
-    virtual void LogChange(int64_t internalId,
-                           const ServerIndexChange& change);
+    virtual int64_t LogChange(int64_t internalId,
+                              const ServerIndexChange& change);
 
     virtual void GetChanges(std::list<ServerIndexChange>& target /*out*/,
                             bool& done /*out*/,
@@ -217,6 +217,26 @@ namespace Orthanc
     virtual void GetAllMetadata(std::map<MetadataType, std::string>& target,
                                 int64_t id);
 
+    virtual bool CreateInstance(CreateInstanceResult& result,
+                                int64_t& instanceId,
+                                const std::string& patient,
+                                const std::string& study,
+                                const std::string& series,
+                                const std::string& instance);
+
+    virtual void SetResourcesContent(const ResourcesContent& content)
+    {
+      // The SQLite database is embedded: No round trip to save
+      content.Store(*this);
+    }
+
+    virtual void LookupResourceContent(DicomMap& mainDicomTags,
+                                       std::list<std::string>& children,
+                                       std::map<MetadataType, std::string>& metadata,
+                                       int64_t id);
+
+    virtual void GetAllAttachments(std::list<FileInfo>& target,
+                                   int64_t id);
 
 
 
@@ -33,6 +33,7 @@
 #include "DicomInstanceToStore.h"
 
 #include "FromDcmtkBridge.h"
+#include "ServerToolbox.h"
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <glog/logging.h>
@@ -46,6 +47,42 @@ namespace Orthanc
   }
 
 
+  static DcmDataset& GetHeader(ParsedDicomFile& file)
+  {
+    return *reinterpret_cast<DcmFileFormat*>(file.GetDcmtkHeader())->getDataset();
+  }
+
+
+  namespace
+  {
+    // Reads the pixel data from the buffer of the instance to be
+    // stored, that outlives the parsed file
+    class BufferPixelDataLoader : public ParsedDicomFile::IPixelDataLoader
+    {
+    private:
+      const std::string&  buffer_;
+
+    public:
+      BufferPixelDataLoader(const std::string& buffer) : buffer_(buffer)
+      {
+      }
+
+      virtual void ReadRange(std::string& target,
+                             uint64_t start,
+                             uint64_t end)
+      {
+        if (start > end ||
+            end > buffer_.size())
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        target = buffer_.substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
+      }
+    };
+  }
+
+
   void DicomInstanceToStore::AddMetadata(ResourceType level,
                                          MetadataType metadata,
                                          const std::string& value)
@@ -94,22 +131,45 @@ namespace Orthanc
 
     if (!parsed_.HasContent())
     {
-      parsed_.TakeOwnership(new ParsedDicomFile(buffer_.GetConstContent()));
+      // Only the tags before the pixel data are needed to compute
+      // the summary and the JSON version of the file
+      const std::string& buffer = buffer_.GetConstContent();
+      parsed_.TakeOwnership(new ParsedDicomFile(buffer, new BufferPixelDataLoader(buffer)));
     }
 
     // At this point, we have parsed the DICOM file
     
+    // The summary, the JSON version and the simplified JSON version
+    // are computed together, with one single traversal of the
+    // dataset. The ones that were already provided are computed
+    // into scratch variables, and discarded.
+    DicomMap scratchSummary;
+    Json::Value scratchJson, scratchSimplified;
+
+    DicomMap* summary = &scratchSummary;
+    Json::Value* json = &scratchJson;
+    Json::Value* simplified = &scratchSimplified;
+
     if (!summary_.HasContent())
     {
       summary_.Allocate();
-      FromDcmtkBridge::Convert(summary_.GetContent(), GetDataset(parsed_.GetContent()));
+      summary = &summary_.GetContent();
     }
     
     if (!json_.HasContent())
     {
       json_.Allocate();
-      FromDcmtkBridge::ToJson(json_.GetContent(), GetDataset(parsed_.GetContent()));
+      json = &json_.GetContent();
     }
+
+    if (!simplified_.HasContent())
+    {
+      simplified_.Allocate();
+      simplified = &simplified_.GetContent();
+    }
+
+    FromDcmtkBridge::ExtractDicomSummaryAndJson(*summary, *json, *simplified,
+                                                GetHeader(parsed_.GetContent()));
   }
 
 
@@ -171,4 +231,25 @@ namespace Orthanc
 
     return json_.GetConstContent();
   }
+
+
+  const Json::Value& DicomInstanceToStore::GetSimplifiedJson()
+  {
+    if (!simplified_.HasContent())
+    {
+      if (json_.HasContent())
+      {
+        // Only the simplification is missing: Avoid parsing the file
+        simplified_.Allocate();
+        SimplifyTags(simplified_.GetContent(), json_.GetConstContent());
+      }
+      else
+      {
+        ComputeMissingInformation();
+      }
+    }
+
+    return simplified_.GetConstContent();
+  }
+
 }
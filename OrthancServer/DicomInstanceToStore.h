@@ -142,6 +142,7 @@ namespace Orthanc
     SmartContainer<ParsedDicomFile>  parsed_;
     SmartContainer<DicomMap>  summary_;
     SmartContainer<Json::Value>  json_;
+    SmartContainer<Json::Value>  simplified_;
 
     std::string remoteAet_;
     std::string calledAet_;
@@ -170,6 +171,11 @@ namespace Orthanc
       json_.SetConstReference(json);
     }
 
+    void SetSimplifiedJson(const Json::Value& simplified)
+    {
+      simplified_.SetConstReference(simplified);
+    }
+
     const std::string& GetRemoteAet() const
     {
       return remoteAet_;
@@ -211,5 +217,7 @@ namespace Orthanc
     const DicomMap& GetSummary();
     
     const Json::Value& GetJson();
+
+    const Json::Value& GetSimplifiedJson();
   };
 }
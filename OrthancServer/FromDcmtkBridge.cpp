@@ -403,35 +403,62 @@ namespace Orthanc
   }
 
 
-  static void StoreElement(Json::Value& target,
+  static void StoreElement(Json::Value* json,
+                           Json::Value* simplified,
+                           DicomMap* summary,
                            DcmElement& element,
                            unsigned int maxStringLength,
                            Encoding encoding);
 
-  static void StoreItem(Json::Value& target,
+  static void StoreItem(Json::Value* json,
+                        Json::Value* simplified,
+                        DicomMap* summary,
                         DcmItem& item,
                         unsigned int maxStringLength,
                         Encoding encoding)
   {
-    target = Json::Value(Json::objectValue);
+    /**
+     * Each of the "json", "simplified" and "summary" targets is
+     * optional (NULL if not needed). They are all filled during one
+     * single traversal of the item, so that the (possibly costly)
+     * conversion of the character set is done only once per value.
+     * The summary only receives the top-level leaf elements.
+     **/
+
+    if (json != NULL)
+    {
+      *json = Json::Value(Json::objectValue);
+    }
+
+    if (simplified != NULL)
+    {
+      *simplified = Json::Value(Json::objectValue);
+    }
+
+    if (summary != NULL)
+    {
+      summary->Clear();
+    }
 
     for (unsigned long i = 0; i < item.card(); i++)
     {
       DcmElement* element = item.getElement(i);
-      StoreElement(target, *element, maxStringLength, encoding);
+      StoreElement(json, simplified, summary, *element, maxStringLength, encoding);
     }
   }
 
 
-  static void StoreElement(Json::Value& target,
+  static void StoreElement(Json::Value* json,
+                           Json::Value* simplified,
+                           DicomMap* summary,
                            DcmElement& element,
                            unsigned int maxStringLength,
                            Encoding encoding)
   {
-    assert(target.type() == Json::objectValue);
+    assert(json == NULL || json->type() == Json::objectValue);
+    assert(simplified == NULL || simplified->type() == Json::objectValue);
 
     DicomTag tag(FromDcmtkBridge::GetTag(element));
-    const std::string formattedTag = tag.Format();
 
 #if 0
     const std::string tagName = FromDcmtkBridge::GetName(tag);
@@ -443,41 +470,91 @@ namespace Orthanc
 
     if (element.isLeaf())
     {
-      Json::Value value(Json::objectValue);
-      value["Name"] = tagName;
+      std::auto_ptr<DicomValue> v(FromDcmtkBridge::ConvertLeafElement(element, encoding));
 
-      if (tagbis.getPrivateCreator() != NULL)
+      bool isNull = v->IsNull();
+      std::string s;
+      if (!isNull)
       {
-        value["PrivateCreator"] = tagbis.getPrivateCreator();
+        s = v->AsString();
       }
 
-      std::auto_ptr<DicomValue> v(FromDcmtkBridge::ConvertLeafElement(element, encoding));
-      if (v->IsNull())
-      {
-        value["Type"] = "Null";
-        value["Value"] = Json::nullValue;
-      }
-      else
+      bool isTooLong = (!isNull &&
+                        maxStringLength != 0 &&
+                        s.size() > maxStringLength);
+
+      if (json != NULL)
       {
-        std::string s = v->AsString();
-        if (maxStringLength == 0 ||
-            s.size() <= maxStringLength)
+        Json::Value& value = (*json)[tag.Format()];
+        value = Json::Value(Json::objectValue);
+        value["Name"] = tagName;
+
+        if (tagbis.getPrivateCreator() != NULL)
+        {
+          value["PrivateCreator"] = tagbis.getPrivateCreator();
+        }
+
+        if (isNull)
+        {
+          value["Type"] = "Null";
+          value["Value"] = Json::nullValue;
+        }
+        else if (isTooLong)
+        {
+          value["Type"] = "TooLong";
+          value["Value"] = Json::nullValue;
+        }
+        else
         {
           value["Type"] = "String";
           value["Value"] = s;
         }
+      }
+
+      if (simplified != NULL)
+      {
+        if (isNull || isTooLong)
+        {
+          (*simplified)[tagName] = Json::nullValue;
+        }
         else
         {
-          value["Type"] = "TooLong";
-          value["Value"] = Json::nullValue;
+          (*simplified)[tagName] = s;
         }
       }
 
-      target[formattedTag] = value;
+      if (summary != NULL)
+      {
+        // The summary is not truncated by "maxStringLength"
+        if (isNull)
+        {
+          summary->SetValue(tag.GetGroup(), tag.GetElement(), *v);
+        }
+        else
+        {
+          summary->SetValue(tag.GetGroup(), tag.GetElement(), s);
+        }
+      }
     }
     else
     {
-      Json::Value children(Json::arrayValue);
+      Json::Value* jsonChildren = NULL;
+      Json::Value* simplifiedChildren = NULL;
+
+      if (json != NULL)
+      {
+        Json::Value& value = (*json)[tag.Format()];
+        value["Name"] = tagName;
+        value["Type"] = "Sequence";
+        value["Value"] = Json::Value(Json::arrayValue);
+        jsonChildren = &value["Value"];
+      }
+
+      if (simplified != NULL)
+      {
+        simplifiedChildren = &(*simplified)[tagName];
+        *simplifiedChildren = Json::Value(Json::arrayValue);
+      }
 
       // "All subclasses of DcmElement except for DcmSequenceOfItems
       // are leaf nodes, while DcmSequenceOfItems, DcmItem, DcmDataset
@@ -487,13 +564,10 @@ namespace Orthanc
       for (unsigned long i = 0; i < sequence.card(); i++)
       {
         DcmItem* child = sequence.getItem(i);
-        Json::Value& v = children.append(Json::objectValue);
-        StoreItem(v, *child, maxStringLength, encoding);
+        StoreItem(jsonChildren == NULL ? NULL : &jsonChildren->append(Json::objectValue),
+                  simplifiedChildren == NULL ? NULL : &simplifiedChildren->append(Json::objectValue),
+                  NULL, *child, maxStringLength, encoding);
       }  
-
-      target[formattedTag]["Name"] = tagName;
-      target[formattedTag]["Type"] = "Sequence";
-      target[formattedTag]["Value"] = children;
     }
   }
 
@@ -502,7 +576,25 @@ namespace Orthanc
                                DcmDataset& dataset,
                                unsigned int maxStringLength)
   {
-    StoreItem(root, dataset, maxStringLength, DetectEncoding(dataset));
+    StoreItem(&root, NULL, NULL, dataset, maxStringLength, DetectEncoding(dataset));
+  }
+
+
+  void FromDcmtkBridge::ToSimplifiedJson(Json::Value& target, 
+                                         DcmDataset& dataset,
+                                         unsigned int maxStringLength)
+  {
+    StoreItem(NULL, &target, NULL, dataset, maxStringLength, DetectEncoding(dataset));
+  }
+
+
+  void FromDcmtkBridge::ExtractDicomSummaryAndJson(DicomMap& summary,
+                                                   Json::Value& json,
+                                                   Json::Value& simplified,
+                                                   DcmDataset& dataset,
+                                                   unsigned int maxStringLength)
+  {
+    StoreItem(&json, &simplified, &summary, dataset, maxStringLength, DetectEncoding(dataset));
   }
 
 
@@ -613,11 +705,11 @@ namespace Orthanc
 
   void FromDcmtkBridge::Print(FILE* fp, const DicomMap& m)
   {
-    for (DicomMap::Map::const_iterator 
-           it = m.map_.begin(); it != m.map_.end(); ++it)
+    for (DicomMap::Content::const_iterator 
+           it = m.content_.begin(); it != m.content_.end(); ++it)
     {
-      DicomTag t = it->first;
-      std::string s = it->second->AsString();
+      DicomTag t = it->GetTag();
+      std::string s = it->value_.AsString();
       fprintf(fp, "0x%04x 0x%04x (%s) [%s]\n", t.GetGroup(), t.GetElement(), GetName(t).c_str(), s.c_str());
     }
   }
@@ -634,20 +726,22 @@ namespace Orthanc
 
     result.clear();
 
-    for (DicomMap::Map::const_iterator 
-           it = values.map_.begin(); it != values.map_.end(); ++it)
+    for (DicomMap::Content::const_iterator 
+           it = values.content_.begin(); it != values.content_.end(); ++it)
     {
+      const DicomTag tag = it->GetTag();
+
       if (simplify)
       {
-        result[GetName(it->first)] = it->second->AsString();
+        result[GetName(tag)] = it->value_.AsString();
       }
       else
       {
         Json::Value value = Json::objectValue;
 
-        value["Name"] = GetName(it->first);
+        value["Name"] = GetName(tag);
 
-        if (it->second->IsNull())
+        if (it->value_.IsNull())
         {
           value["Type"] = "Null";
           value["Value"] = Json::nullValue;
@@ -655,10 +749,10 @@ namespace Orthanc
         else
         {
           value["Type"] = "String";
-          value["Value"] = it->second->AsString();
+          value["Value"] = it->value_.AsString();
         }
 
-        result[it->first.Format()] = value;
+        result[tag.Format()] = value;
       }
     }
   }
@@ -714,6 +808,14 @@ namespace Orthanc
       xfer = EXS_LittleEndianExplicit;
     }
 
+    return SaveToMemoryBuffer(buffer, dataSet, xfer);
+  }
+
+
+  bool FromDcmtkBridge::SaveToMemoryBuffer(std::string& buffer,
+                                           DcmDataset& dataSet,
+                                           E_TransferSyntax xfer)
+  {
     E_EncodingType encodingType = /*opt_sequenceType*/ EET_ExplicitLength;
 
     // Create the meta-header information
@@ -67,6 +67,22 @@ namespace Orthanc
                        const std::string& path,
                        unsigned int maxStringLength = 256);
 
+    // Same as "SimplifyTags(target, ToJson(dataset))", without the
+    // intermediate JSON dump
+    static void ToSimplifiedJson(Json::Value& target, 
+                                 DcmDataset& dataset,
+                                 unsigned int maxStringLength = 256);
+
+    // Computes the summary, the JSON dump and the simplified JSON of
+    // a dataset in one single pass, which is the same as calling
+    // "Convert()", "ToJson()" and "ToSimplifiedJson()" one after
+    // the other
+    static void ExtractDicomSummaryAndJson(DicomMap& summary,
+                                           Json::Value& json,
+                                           Json::Value& simplified,
+                                           DcmDataset& dataset,
+                                           unsigned int maxStringLength = 256);
+
     static std::string GetName(const DicomTag& tag);
 
     static DicomTag ParseTag(const char* name);
@@ -107,6 +123,12 @@ namespace Orthanc
     static bool SaveToMemoryBuffer(std::string& buffer,
                                    DcmDataset& dataSet);
 
+    // Same as above, but writes the dataset with the given transfer
+    // syntax instead of the original one
+    static bool SaveToMemoryBuffer(std::string& buffer,
+                                   DcmDataset& dataSet,
+                                   E_TransferSyntax xfer);
+
     static ValueRepresentation GetValueRepresentation(const DicomTag& tag);
   };
 }
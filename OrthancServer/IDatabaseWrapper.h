@@ -37,6 +37,7 @@
 #include "../Core/FileStorage/FileInfo.h"
 #include "IServerIndexListener.h"
 #include "ExportedResource.h"
+#include "ResourcesContent.h"
 
 #include <list>
 #include <boost/noncopyable.hpp>
@@ -46,6 +47,16 @@ namespace Orthanc
   class IDatabaseWrapper : public boost::noncopyable
   {
   public:
+    struct CreateInstanceResult
+    {
+      bool     isNewPatient_;
+      bool     isNewStudy_;
+      bool     isNewSeries_;
+      int64_t  patientId_;
+      int64_t  studyId_;
+      int64_t  seriesId_;
+    };
+
     virtual ~IDatabaseWrapper()
     {
     }
@@ -125,8 +136,10 @@ namespace Orthanc
     virtual void ListAvailableAttachments(std::list<FileContentType>& target,
                                           int64_t id) = 0;
 
-    virtual void LogChange(int64_t internalId,
-                           const ServerIndexChange& change) = 0;
+    // Returns the sequence number of the logged change, or "-1" if
+    // the database back-end does not report it
+    virtual int64_t LogChange(int64_t internalId,
+                              const ServerIndexChange& change) = 0;
 
     virtual void LogExportedResource(const ExportedResource& resource) = 0;
     
@@ -176,6 +189,32 @@ namespace Orthanc
 
     virtual SQLite::ITransaction* StartTransaction() = 0;
 
+    // Compound operations, that are meant to be executed by one
+    // single round trip to the database back-end
+
+    // Creates an instance together with its missing parent
+    // resources, and links them. Returns "false" iff the instance
+    // already exists, in which case only "instanceId" is set.
+    virtual bool CreateInstance(CreateInstanceResult& result,
+                                int64_t& instanceId,
+                                const std::string& patient,
+                                const std::string& study,
+                                const std::string& series,
+                                const std::string& instance) = 0;
+
+    virtual void SetResourcesContent(const ResourcesContent& content) = 0;
+
+    // Reads at once the main DICOM tags, the public IDs of the
+    // children and the metadata of one resource
+    virtual void LookupResourceContent(DicomMap& mainDicomTags,
+                                       std::list<std::string>& children,
+                                       std::map<MetadataType, std::string>& metadata,
+                                       int64_t id) = 0;
+
+    // Lists the information about all the attachments of one resource
+    virtual void GetAllAttachments(std::list<FileInfo>& target,
+                                   int64_t id) = 0;
+
     virtual void SetListener(IServerIndexListener& listener) = 0;
   };
 }
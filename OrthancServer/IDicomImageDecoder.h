@@ -0,0 +1,70 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../Core/DicomFormat/DicomImageInformation.h"
+#include "../Core/ImageFormats/ImageBuffer.h"
+
+#include <string>
+#include <boost/noncopyable.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Decoder of compressed DICOM frames that is provided from outside
+   * the built-in decoders (typically by a plugin). The registered
+   * decoders are consulted by "DicomImageDecoder::Decode()" before
+   * the built-in decoders, thus for all the images that are extracted
+   * by Orthanc. They can be invoked concurrently by several threads.
+   **/
+  class IDicomImageDecoder : public boost::noncopyable
+  {
+  public:
+    virtual ~IDicomImageDecoder()
+    {
+    }
+
+    // Fast check that is done before extracting the frame
+    virtual bool IsTransferSyntaxSupported(const std::string& transferSyntax) = 0;
+
+    // "frame" points to the content of the fragments of the frame,
+    // concatenated. Returns "false" if this decoder does not support
+    // the image, in which case the next decoders are tried.
+    virtual bool Decode(ImageBuffer& target,
+                        const DicomImageInformation& info,
+                        const std::string& transferSyntax,
+                        unsigned int frameIndex,
+                        const void* frame,
+                        size_t size) = 0;
+  };
+}
@@ -90,6 +90,14 @@
 #include <glog/logging.h>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cmath>
+#include <list>
+#include <vector>
+
+#include <dcmtk/dcmdata/dcpixel.h>
+#include <dcmtk/dcmdata/dcpixseq.h>
+#include <dcmtk/dcmdata/dcpxitem.h>
 
 #if ORTHANC_JPEG_LOSSLESS_ENABLED == 1
 #include <dcmtk/dcmjpls/djcodecd.h>
@@ -103,6 +111,9 @@ namespace Orthanc
   static const DicomTag DICOM_TAG_CONTENT(0x07a1, 0x100a);
   static const DicomTag DICOM_TAG_COMPRESSION_TYPE(0x07a1, 0x1011);
 
+  static boost::mutex externalDecodersMutex_;
+  static std::list<IDicomImageDecoder*> externalDecoders_;
+
 
   static bool IsJpegLossless(const DcmDataset& dataset)
   {
@@ -531,6 +542,249 @@ namespace Orthanc
 
 
 
+  void DicomImageDecoder::RegisterExternalDecoder(IDicomImageDecoder& decoder)
+  {
+    boost::mutex::scoped_lock lock(externalDecodersMutex_);
+    externalDecoders_.push_back(&decoder);
+  }
+
+
+  void DicomImageDecoder::UnregisterExternalDecoder(IDicomImageDecoder& decoder)
+  {
+    boost::mutex::scoped_lock lock(externalDecodersMutex_);
+    externalDecoders_.remove(&decoder);
+  }
+
+
+  static uint64_t ReadOffset(const Uint8* offsets,
+                             unsigned int index)
+  {
+    // The Basic Offset Table is encoded in little endian
+    const Uint8* p = offsets + 4 * index;
+    return (static_cast<uint64_t>(p[0]) |
+            (static_cast<uint64_t>(p[1]) << 8) |
+            (static_cast<uint64_t>(p[2]) << 16) |
+            (static_cast<uint64_t>(p[3]) << 24));
+  }
+
+
+  bool DicomImageDecoder::ExtractFragments(std::vector<DcmPixelItem*>& fragments,
+                                           DcmPixelSequence& sequence,
+                                           unsigned int frame,
+                                           unsigned int numberOfFrames)
+  {
+    // The first item of the sequence is the Basic Offset Table
+    const unsigned long count = sequence.card();
+    if (count < 2 ||
+        frame >= numberOfFrames)
+    {
+      return false;
+    }
+
+    fragments.clear();
+
+    if (numberOfFrames == 1 ||
+        count - 1 == numberOfFrames)
+    {
+      // Either one single frame, or one fragment per frame
+      unsigned long start = (numberOfFrames == 1 ? 1 : frame + 1);
+      unsigned long end = (numberOfFrames == 1 ? count : frame + 2);
+
+      for (unsigned long i = start; i < end; i++)
+      {
+        DcmPixelItem* item = NULL;
+        if (!sequence.getItem(item, i).good() || item == NULL)
+        {
+          return false;
+        }
+
+        fragments.push_back(item);
+      }
+
+      return true;
+    }
+
+    // Several fragments per frame: Use the Basic Offset Table, whose
+    // offsets are relative to the first byte of the first fragment
+    DcmPixelItem* table = NULL;
+    Uint8* offsets = NULL;
+    if (!sequence.getItem(table, 0).good() || 
+        table == NULL ||
+        table->getLength() != 4 * numberOfFrames ||
+        !table->getUint8Array(offsets).good() ||
+        offsets == NULL)
+    {
+      return false;
+    }
+
+    const uint64_t start = ReadOffset(offsets, frame);
+    const bool isLastFrame = (frame + 1 == numberOfFrames);
+    const uint64_t end = (isLastFrame ? 0 : ReadOffset(offsets, frame + 1));
+
+    uint64_t position = 0;
+    for (unsigned long i = 1; i < count; i++)
+    {
+      if (!isLastFrame && position >= end)
+      {
+        break;
+      }
+
+      DcmPixelItem* item = NULL;
+      if (!sequence.getItem(item, i).good() || item == NULL)
+      {
+        return false;
+      }
+
+      if (position == start ||
+          (position > start && !fragments.empty()))
+      {
+        fragments.push_back(item);
+      }
+
+      // Each fragment is preceded by an item header of 8 bytes
+      position += 8 + item->getLength();
+    }
+
+    return !fragments.empty();
+  }
+
+
+  static void ExtractImageTags(DicomMap& target,
+                               DcmDataset& dataset)
+  {
+    // Only convert the tags that are read by "DicomImageInformation",
+    // instead of the whole dataset. These tags are all ASCII.
+    static const DicomTag TAGS[] = {
+      DICOM_TAG_PHOTOMETRIC_INTERPRETATION,
+      DICOM_TAG_COLUMNS,
+      DICOM_TAG_ROWS,
+      DICOM_TAG_BITS_ALLOCATED,
+      DICOM_TAG_SAMPLES_PER_PIXEL,
+      DICOM_TAG_BITS_STORED,
+      DICOM_TAG_HIGH_BIT,
+      DICOM_TAG_PIXEL_REPRESENTATION,
+      DICOM_TAG_PLANAR_CONFIGURATION,
+      DICOM_TAG_NUMBER_OF_FRAMES
+    };
+
+    target.Clear();
+
+    for (size_t i = 0; i < sizeof(TAGS) / sizeof(DicomTag); i++)
+    {
+      DcmElement* element = NULL;
+      if (dataset.findAndGetElement(ToDcmtkBridge::Convert(TAGS[i]), element).good() &&
+          element != NULL &&
+          element->isLeaf())
+      {
+        std::auto_ptr<DicomValue> value(FromDcmtkBridge::ConvertLeafElement(*element, Encoding_Ascii));
+        target.SetValue(TAGS[i], *value);
+      }
+    }
+  }
+
+
+  bool DicomImageDecoder::DecodeWithExternalDecoders(ImageBuffer& target,
+                                                     DcmDataset& dataset,
+                                                     unsigned int frame)
+  {
+    const std::string transferSyntax = DcmXfer(dataset.getOriginalXfer()).getXferID();
+
+    // Only keep the decoders that support this transfer syntax, so
+    // that nothing is extracted if no decoder is interested
+    std::list<IDicomImageDecoder*> decoders;
+
+    {
+      boost::mutex::scoped_lock lock(externalDecodersMutex_);
+
+      for (std::list<IDicomImageDecoder*>::const_iterator
+             it = externalDecoders_.begin(); it != externalDecoders_.end(); ++it)
+      {
+        if ((*it)->IsTransferSyntaxSupported(transferSyntax))
+        {
+          decoders.push_back(*it);
+        }
+      }
+    }
+
+    if (decoders.empty())
+    {
+      return false;
+    }
+
+    DcmElement *element = NULL;
+    if (!dataset.findAndGetElement(ToDcmtkBridge::Convert(DICOM_TAG_PIXEL_DATA), element).good() ||
+        element == NULL)
+    {
+      return false;
+    }
+
+    DcmPixelData& pixelData = dynamic_cast<DcmPixelData&>(*element);
+    DcmPixelSequence* pixelSequence = NULL;
+    if (!pixelData.getEncapsulatedRepresentation
+        (dataset.getOriginalXfer(), NULL, pixelSequence).good() ||
+        pixelSequence == NULL)
+    {
+      return false;
+    }
+
+    DicomMap m;
+    ExtractImageTags(m, dataset);
+    DicomImageInformation info(m);
+
+    std::vector<DcmPixelItem*> fragments;
+    if (!ExtractFragments(fragments, *pixelSequence, frame, info.GetNumberOfFrames()))
+    {
+      // Typically an empty or inconsistent Basic Offset Table: This
+      // is not an error, as the built-in decoders will be used
+      LOG(INFO) << "Cannot locate the fragments of frame " << frame 
+                << ", the external decoders are not used";
+      return false;
+    }
+
+    // Only concatenate the fragments if the frame is split
+    const void* content = NULL;
+    size_t size = 0;
+    std::string concatenated;
+
+    for (size_t i = 0; i < fragments.size(); i++)
+    {
+      Uint8* buffer = NULL;
+      if (fragments[i]->getLength() > 0 &&
+          (!fragments[i]->getUint8Array(buffer).good() || buffer == NULL))
+      {
+        return false;
+      }
+
+      if (fragments.size() == 1)
+      {
+        content = buffer;
+        size = fragments[i]->getLength();
+      }
+      else
+      {
+        concatenated.append(reinterpret_cast<const char*>(buffer), fragments[i]->getLength());
+      }
+    }
+
+    if (fragments.size() > 1)
+    {
+      content = concatenated.empty() ? NULL : concatenated.c_str();
+      size = concatenated.size();
+    }
+
+    for (std::list<IDicomImageDecoder*>::const_iterator
+           it = decoders.begin(); it != decoders.end(); ++it)
+    {
+      if ((*it)->Decode(target, info, transferSyntax, frame, content, size))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
   bool DicomImageDecoder::Decode(ImageBuffer& target,
                                  DcmDataset& dataset,
                                  unsigned int frame)
@@ -542,6 +796,14 @@ namespace Orthanc
     }
 
 
+    // The external decoders (e.g. from plugins) have precedence over
+    // the built-in decoders of compressed images
+    if (DecodeWithExternalDecoders(target, dataset, frame))
+    {
+      return true;
+    }
+
+
 #if ORTHANC_JPEG_LOSSLESS_ENABLED == 1
     if (IsJpegLossless(dataset))
     {
@@ -589,11 +851,77 @@ namespace Orthanc
   }
 
 
+  static void SetupResizedImage(ImageBuffer& target,
+                                const ImageBuffer& source,
+                                PixelFormat format,
+                                unsigned int maxWidth,
+                                unsigned int maxHeight)
+  {
+    unsigned int width, height;
+    ImageProcessing::FitSize(width, height, source.GetWidth(), source.GetHeight(), maxWidth, maxHeight);
+
+    target.SetFormat(format);
+    target.SetWidth(width);
+    target.SetHeight(height);
+  }
+
+
+  static bool IsResized(const ImageBuffer& target,
+                        const ImageBuffer& source)
+  {
+    return (target.GetWidth() != source.GetWidth() ||
+            target.GetHeight() != source.GetHeight());
+  }
+
+
+  static void ResizeColorImage(ImageBuffer& target,
+                               ImageBuffer& source,
+                               unsigned int maxWidth,
+                               unsigned int maxHeight,
+                               ImageInterpolation interpolation)
+  {
+    SetupResizedImage(target, source, source.GetFormat(), maxWidth, maxHeight);
+
+    if (IsResized(target, source))
+    {
+      ImageAccessor targetAccessor(target.GetAccessor());
+      ImageAccessor sourceAccessor(source.GetAccessor());
+      ImageProcessing::Resize(targetAccessor, sourceAccessor, interpolation);
+    }
+    else
+    {
+      target.AcquireOwnership(source);
+    }
+  }
+
+
   bool DicomImageDecoder::DecodeAndTruncate(ImageBuffer& target,
                                             DcmDataset& dataset,
                                             unsigned int frame,
                                             PixelFormat format,
                                             bool allowColorConversion)
+  {
+    return DecodeAndTruncate(target, dataset, frame, format, allowColorConversion,
+                             0, 0, ImageInterpolation_Box);
+  }
+
+
+  bool DicomImageDecoder::DecodePreview(ImageBuffer& target,
+                                        DcmDataset& dataset,
+                                        unsigned int frame)
+  {
+    return DecodePreview(target, dataset, frame, 0, 0, ImageInterpolation_Box);
+  }
+
+
+  bool DicomImageDecoder::DecodeAndTruncate(ImageBuffer& target,
+                                            DcmDataset& dataset,
+                                            unsigned int frame,
+                                            PixelFormat format,
+                                            bool allowColorConversion,
+                                            unsigned int maxWidth,
+                                            unsigned int maxHeight,
+                                            ImageInterpolation interpolation)
   {
     // TODO Special case for uncompressed images
     
@@ -616,20 +944,37 @@ namespace Orthanc
       }
     }
 
-    if (source.GetFormat() == format)
+    SetupResizedImage(target, source, format, maxWidth, maxHeight);
+
+    if (!IsResized(target, source) &&
+        source.GetFormat() == format)
     {
       // No conversion is required, return the temporary image
       target.AcquireOwnership(source);
       return true;
     }
 
-    target.SetFormat(format);
-    target.SetWidth(source.GetWidth());
-    target.SetHeight(source.GetHeight());
-
     ImageAccessor targetAccessor(target.GetAccessor());
     ImageAccessor sourceAccessor(source.GetAccessor());
-    ImageProcessing::Convert(targetAccessor, sourceAccessor);
+
+    if (!IsResized(target, source))
+    {
+      ImageProcessing::Convert(targetAccessor, sourceAccessor);
+    }
+    else if (source.GetFormat() == format ||
+             (!isSourceColor && !isTargetColor))
+    {
+      // The truncation to the target format is done by the resizing
+      ImageProcessing::ResizeAndShiftScale(targetAccessor, sourceAccessor, interpolation, 0.0f, 1.0f);
+    }
+    else
+    {
+      // Conversion between color and grayscale, then resizing
+      ImageBuffer converted(source.GetWidth(), source.GetHeight(), format);
+      ImageAccessor convertedAccessor(converted.GetAccessor());
+      ImageProcessing::Convert(convertedAccessor, sourceAccessor);
+      ImageProcessing::Resize(targetAccessor, convertedAccessor, interpolation);
+    }
 
     return true;
   }
@@ -637,7 +982,10 @@ namespace Orthanc
 
   bool DicomImageDecoder::DecodePreview(ImageBuffer& target,
                                         DcmDataset& dataset,
-                                        unsigned int frame)
+                                        unsigned int frame,
+                                        unsigned int maxWidth,
+                                        unsigned int maxHeight,
+                                        ImageInterpolation interpolation)
   {
     // TODO Special case for uncompressed images
     
@@ -650,20 +998,16 @@ namespace Orthanc
     switch (source.GetFormat())
     {
       case PixelFormat_RGB24:
-      {
-        // Directly return color images (RGB)
-        target.AcquireOwnership(source);
+        // Directly return color images (RGB), possibly resized
+        ResizeColorImage(target, source, maxWidth, maxHeight, interpolation);
         return true;
-      }
 
       case PixelFormat_Grayscale8:
       case PixelFormat_Grayscale16:
       case PixelFormat_SignedGrayscale16:
       {
         // Grayscale image: Stretch its dynamics to the [0,255] range
-        target.SetFormat(PixelFormat_Grayscale8);
-        target.SetWidth(source.GetWidth());
-        target.SetHeight(source.GetHeight());
+        SetupResizedImage(target, source, PixelFormat_Grayscale8, maxWidth, maxHeight);
 
         ImageAccessor targetAccessor(target.GetAccessor());
         ImageAccessor sourceAccessor(source.GetAccessor());
@@ -675,6 +1019,13 @@ namespace Orthanc
         {
           ImageProcessing::Set(targetAccessor, 0);
         }
+        else if (IsResized(target, source))
+        {
+          // Fusion of the resizing with the stretching, which avoids
+          // to stretch the pixels that are discarded by the resizing
+          ImageProcessing::ResizeAndShiftScale(targetAccessor, sourceAccessor, interpolation,
+                                               static_cast<float>(-a), 255.0f / static_cast<float>(b - a));
+        }
         else
         {
           ImageProcessing::ShiftScale(sourceAccessor, static_cast<float>(-a), 255.0f / static_cast<float>(b - a));
@@ -696,4 +1047,104 @@ namespace Orthanc
         throw OrthancException(ErrorCode_NotImplemented);
     }
   }
+
+
+  static bool GetFloatValue(float& result,
+                            DcmDataset& dataset,
+                            const DicomTag& tag)
+  {
+    // Only the first value of multi-valued tags is considered
+    Float64 value;
+    if (dataset.findAndGetFloat64(ToDcmtkBridge::Convert(tag), value, 0).good())
+    {
+      result = static_cast<float>(value);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  bool DicomImageDecoder::DecodeRendered(ImageBuffer& target,
+                                         DcmDataset& dataset,
+                                         unsigned int frame,
+                                         float windowCenter,
+                                         float windowWidth,
+                                         unsigned int maxWidth,
+                                         unsigned int maxHeight,
+                                         ImageInterpolation interpolation)
+  {
+    ImageBuffer source;
+    if (!Decode(source, dataset, frame))
+    {
+      return false;
+    }
+
+    switch (source.GetFormat())
+    {
+      case PixelFormat_RGB24:
+        // Color images are not windowed, only resized
+        ResizeColorImage(target, source, maxWidth, maxHeight, interpolation);
+        return true;
+
+      case PixelFormat_Grayscale8:
+      case PixelFormat_Grayscale16:
+      case PixelFormat_SignedGrayscale16:
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    float slope, intercept;
+    if (!GetFloatValue(slope, dataset, DICOM_TAG_RESCALE_SLOPE) ||
+        !GetFloatValue(intercept, dataset, DICOM_TAG_RESCALE_INTERCEPT))
+    {
+      slope = 1.0f;
+      intercept = 0.0f;
+    }
+
+    OFString photometric;
+    bool invert = (dataset.findAndGetOFString(ToDcmtkBridge::Convert(DICOM_TAG_PHOTOMETRIC_INTERPRETATION), photometric).good() &&
+                   photometric == "MONOCHROME1");
+
+    if (windowWidth <= 0.0f &&
+        (!GetFloatValue(windowCenter, dataset, DICOM_TAG_WINDOW_CENTER) ||
+         !GetFloatValue(windowWidth, dataset, DICOM_TAG_WINDOW_WIDTH) ||
+         windowWidth < 1.0f))
+    {
+      // No windowing is available, use the full range of the rescaled values
+      int64_t a, b;
+      ImageProcessing::GetMinMaxValue(a, b, source.GetConstAccessor());
+
+      float x = slope * static_cast<float>(a) + intercept;
+      float y = slope * static_cast<float>(b) + intercept;
+      windowCenter = (x + y) / 2.0f + 0.5f;
+      windowWidth = std::fabs(y - x) + 1.0f;
+    }
+
+    ImageAccessor sourceAccessor(source.GetConstAccessor());
+    SetupResizedImage(target, source, PixelFormat_Grayscale8, maxWidth, maxHeight);
+    ImageAccessor targetAccessor(target.GetAccessor());
+
+    if (IsResized(target, source))
+    {
+      // Resize the stored values before the windowing, so that the
+      // lookup table is only applied to the downscaled image
+      ImageBuffer resized(target.GetWidth(), target.GetHeight(), source.GetFormat());
+      ImageAccessor resizedAccessor(resized.GetAccessor());
+      ImageProcessing::Resize(resizedAccessor, sourceAccessor, interpolation);
+      ImageProcessing::ApplyWindowing(targetAccessor, resizedAccessor, windowCenter, windowWidth,
+                                      slope, intercept, invert);
+    }
+    else
+    {
+      ImageProcessing::ApplyWindowing(targetAccessor, sourceAccessor, windowCenter, windowWidth,
+                                      slope, intercept, invert);
+    }
+
+    return true;
+  }
 }
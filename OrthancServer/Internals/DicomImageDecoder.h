@@ -33,8 +33,12 @@
 #pragma once
 
 #include <dcmtk/dcmdata/dcfilefo.h>
+#include <dcmtk/dcmdata/dcpixseq.h>
+#include <dcmtk/dcmdata/dcpxitem.h>
+#include <vector>
 
 #include "../../Core/ImageFormats/ImageBuffer.h"
+#include "../IDicomImageDecoder.h"
 
 namespace Orthanc
 {
@@ -58,6 +62,10 @@ namespace Orthanc
                                         DcmDataset& dataset,
                                         unsigned int frame);
 
+    static bool DecodeWithExternalDecoders(ImageBuffer& target,
+                                           DcmDataset& dataset,
+                                           unsigned int frame);
+
 #if ORTHANC_JPEG_LOSSLESS_ENABLED == 1
     static void DecodeJpegLossless(ImageBuffer& target,
                                    DcmDataset& dataset,
@@ -65,6 +73,26 @@ namespace Orthanc
 #endif
 
   public:
+    /**
+     * The external decoders are consulted, in the order of their
+     * registration, for the compressed transfer syntaxes. The caller
+     * keeps the ownership of the decoder, that must be unregistered
+     * before being destructed.
+     **/
+    static void RegisterExternalDecoder(IDicomImageDecoder& decoder);
+
+    static void UnregisterExternalDecoder(IDicomImageDecoder& decoder);
+
+    /**
+     * Locates the fragments of one frame in the encapsulated pixel
+     * data, using the Basic Offset Table if the frames span several
+     * fragments. Returns "false" if the frame cannot be located.
+     **/
+    static bool ExtractFragments(std::vector<DcmPixelItem*>& fragments,
+                                 DcmPixelSequence& sequence,
+                                 unsigned int frame,
+                                 unsigned int numberOfFrames);
+
     static bool Decode(ImageBuffer& target,
                        DcmDataset& dataset,
                        unsigned int frame);
@@ -78,5 +106,45 @@ namespace Orthanc
     static bool DecodePreview(ImageBuffer& target,
                               DcmDataset& dataset,
                               unsigned int frame);
+
+    /**
+     * The two methods below downscale the decoded image so that it
+     * fits into a box of size "maxWidth x maxHeight" (a "0" maximum
+     * size leaves the corresponding dimension unconstrained). The
+     * resizing is fused with the conversion of the pixel values.
+     **/
+
+    static bool DecodeAndTruncate(ImageBuffer& target,
+                                  DcmDataset& dataset,
+                                  unsigned int frame,
+                                  PixelFormat format,
+                                  bool allowColorConversion,
+                                  unsigned int maxWidth,
+                                  unsigned int maxHeight,
+                                  ImageInterpolation interpolation);
+
+    static bool DecodePreview(ImageBuffer& target,
+                              DcmDataset& dataset,
+                              unsigned int frame,
+                              unsigned int maxWidth,
+                              unsigned int maxHeight,
+                              ImageInterpolation interpolation);
+
+    /**
+     * Renders the frame as an 8-bit image, by applying the rescale
+     * slope/intercept, the windowing and the photometric
+     * interpretation (MONOCHROME1 images are inverted). If
+     * "windowWidth" is zero, the default windowing of the DICOM file
+     * is used, or the full range of the pixel values if the file has
+     * no windowing. Color images are not windowed.
+     **/
+    static bool DecodeRendered(ImageBuffer& target,
+                               DcmDataset& dataset,
+                               unsigned int frame,
+                               float windowCenter,
+                               float windowWidth,
+                               unsigned int maxWidth,
+                               unsigned int maxHeight,
+                               ImageInterpolation interpolation);
   };
 }
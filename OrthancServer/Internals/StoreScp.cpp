@@ -161,13 +161,12 @@ namespace Orthanc
         if ((imageDataSet != NULL) && (*imageDataSet != NULL))
         {
           DicomMap summary;
-          Json::Value dicomJson;
+          Json::Value dicomJson, simplifiedJson;
           std::string buffer;
 
           try
           {
-            FromDcmtkBridge::Convert(summary, **imageDataSet);
-            FromDcmtkBridge::ToJson(dicomJson, **imageDataSet);       
+            FromDcmtkBridge::ExtractDicomSummaryAndJson(summary, dicomJson, simplifiedJson, **imageDataSet);
 
             if (!FromDcmtkBridge::SaveToMemoryBuffer(buffer, **imageDataSet))
             {
@@ -202,7 +201,7 @@ namespace Orthanc
             {
               try
               {
-                cbdata->handler->Handle(buffer, summary, dicomJson, cbdata->remoteAET, cbdata->calledAET);
+                cbdata->handler->Handle(buffer, summary, dicomJson, simplifiedJson, cbdata->remoteAET, cbdata->calledAET);
               }
               catch (OrthancException& e)
               {
@@ -515,6 +515,23 @@ namespace Orthanc
   }
 
 
+  void Configuration::GetGlobalJsonParameter(Json::Value& target,
+                                             const std::string& key)
+  {
+    boost::mutex::scoped_lock lock(globalMutex_);
+
+    if (configuration_.get() != NULL &&
+        configuration_->isMember(key))
+    {
+      target = (*configuration_) [key];
+    }
+    else
+    {
+      target = Json::nullValue;
+    }
+  }
+
+
   bool Configuration::IsSameAETitle(const std::string& aet1,
                                     const std::string& aet2)
   {
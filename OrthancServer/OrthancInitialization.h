@@ -84,6 +84,9 @@ namespace Orthanc
     static void GetGlobalListOfStringsParameter(std::list<std::string>& target,
                                                 const std::string& key);
 
+    static void GetGlobalJsonParameter(Json::Value& target,
+                                       const std::string& key);
+
     static bool IsKnownAETitle(const std::string& aet);
 
     static bool IsSameAETitle(const std::string& aet1,
@@ -34,22 +34,28 @@
 #include "OrthancRestApi.h"
 
 #include <glog/logging.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread_time.hpp>
 
 namespace Orthanc
 {
   // Changes API --------------------------------------------------------------
  
-  static void GetSinceAndLimit(int64_t& since,
+  // Returns "false" if the arguments cannot be parsed
+  static bool GetSinceAndLimit(int64_t& since,
                                unsigned int& limit,
                                bool& last,
                                const RestApiGetCall& call)
   {
     static const unsigned int MAX_RESULTS = 100;
+
+    since = 0;
+    limit = MAX_RESULTS;
     
     if (call.HasArgument("last"))
     {
       last = true;
-      return;
+      return true;
     }
 
     last = false;
@@ -59,17 +65,41 @@ namespace Orthanc
       since = boost::lexical_cast<int64_t>(call.GetArgument("since", "0"));
       limit = boost::lexical_cast<unsigned int>(call.GetArgument("limit", "0"));
     }
-    catch (boost::bad_lexical_cast)
+    catch (boost::bad_lexical_cast&)
     {
-      return;
+      return false;
     }
 
     if (limit == 0 || limit > MAX_RESULTS)
     {
       limit = MAX_RESULTS;
     }
+
+    return true;
+  }
+
+  static bool GetTimeout(unsigned int& timeout,
+                         const RestApiGetCall& call)
+  {
+    // The timeouts are given in seconds, and are bounded so that the
+    // HTTP threads are eventually released
+    static const unsigned int MAX_TIMEOUT = 60;
+
+    try
+    {
+      timeout = boost::lexical_cast<unsigned int>
+        (call.GetArgument("timeout", boost::lexical_cast<std::string>(MAX_TIMEOUT)));
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;
+    }
+
+    timeout = std::min(timeout, MAX_TIMEOUT);
+    return true;
   }
 
+
   static void GetChanges(RestApiGetCall& call)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
@@ -78,13 +108,29 @@ namespace Orthanc
     int64_t since;
     unsigned int limit;
     bool last;
-    GetSinceAndLimit(since, limit, last, call);
+    if (!GetSinceAndLimit(since, limit, last, call))
+    {
+      call.GetOutput().SignalError(HttpStatus_400_BadRequest);
+      return;
+    }
 
     Json::Value result;
+    unsigned int timeout;
     if (last)
     {
       context.GetIndex().GetLastChange(result);
     }
+    else if (call.HasArgument("timeout"))
+    {
+      // Long polling: Wait for a new change if none is available
+      if (!GetTimeout(timeout, call))
+      {
+        call.GetOutput().SignalError(HttpStatus_400_BadRequest);
+        return;
+      }
+
+      context.GetIndex().WaitForChanges(result, since, limit, 1000 * timeout);
+    }
     else
     {
       context.GetIndex().GetChanges(result, since, limit);
@@ -94,6 +140,136 @@ namespace Orthanc
   }
 
 
+  static void StreamChanges(RestApiGetCall& call)
+  {
+    // Heartbeat to detect the broken connections, in seconds
+    static const unsigned int HEARTBEAT = 15;
+
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    int64_t since;
+    unsigned int limit;
+    bool last;
+    if (!GetSinceAndLimit(since, limit, last, call))
+    {
+      call.GetOutput().SignalError(HttpStatus_400_BadRequest);
+      return;
+    }
+
+    if (last)
+    {
+      // Only follow the changes that are to come
+      Json::Value result;
+      context.GetIndex().GetLastChange(result);
+      since = result["Last"].asInt();
+    }
+
+    // Header sent by "EventSource" clients when they reconnect
+    std::string lastEventId = call.GetHttpHeader("last-event-id", "");
+    if (!lastEventId.empty())
+    {
+      try
+      {
+        since = boost::lexical_cast<int64_t>(lastEventId);
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        call.GetOutput().SignalError(HttpStatus_400_BadRequest);
+        return;
+      }
+    }
+
+    unsigned int timeout;
+    if (!GetTimeout(timeout, call))
+    {
+      call.GetOutput().SignalError(HttpStatus_400_BadRequest);
+      return;
+    }
+
+    ServerContext::ChangesStreamLocker locker(context);
+    if (!locker.IsAcquired())
+    {
+      LOG(WARNING) << "Too many concurrent streams of changes, check option \"MaximumChangesStreams\"";
+      call.GetOutput().SignalError(HttpStatus_503_ServiceUnavailable);
+      return;
+    }
+
+    const boost::system_time deadline = (boost::get_system_time() + 
+                                         boost::posix_time::seconds(timeout));
+
+    HttpOutput& output = call.GetOutput().GetLowLevelOutput();
+    call.GetOutput().MarkLowLevelOutputDone();
+
+    output.SetContentType("text/event-stream");
+    output.AddHeader("Cache-Control", "no-cache");
+    output.StartChunkedTransfer();
+
+    bool connected = true;
+
+    try
+    {
+      // The stream is closed once the timeout is over: Ask the
+      // clients to reconnect immediately
+      output.SendChunk("retry: 1000\n\n");
+
+      Json::FastWriter writer;
+
+      for (;;)
+      {
+        boost::posix_time::time_duration remaining = deadline - boost::get_system_time();
+        if (remaining.is_negative())
+        {
+          break;
+        }
+
+        unsigned int wait = std::min(static_cast<unsigned int>(remaining.total_milliseconds()),
+                                     1000 * HEARTBEAT);
+
+        Json::Value result;
+        context.GetIndex().WaitForChanges(result, since, limit, wait);
+
+        const Json::Value& changes = result["Changes"];
+        if (changes.size() == 0)
+        {
+          output.SendChunk(": heartbeat\n\n");
+        }
+        else
+        {
+          std::string chunk;
+          for (Json::Value::ArrayIndex i = 0; i < changes.size(); i++)
+          {
+            // "FastWriter" ends the JSON with a newline
+            chunk += ("id: " + boost::lexical_cast<std::string>(changes[i]["Seq"].asInt()) + 
+                      "\nevent: change\ndata: " + writer.write(changes[i]) + "\n");
+          }
+
+          output.SendChunk(chunk);
+          since = result["Last"].asInt();
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      if (e.GetErrorCode() == ErrorCode_NetworkProtocol)
+      {
+        // Writing to the connection has failed: Stop streaming
+        LOG(INFO) << "The client of the stream of changes has disconnected";
+        connected = false;
+      }
+      else
+      {
+        // The HTTP header is already sent, so the error cannot be reported
+        LOG(ERROR) << "Error while streaming the changes: " << e.What();
+      }
+    }
+
+    if (connected)
+    {
+      output.CloseChunkedTransfer();
+    }
+  }
+
+
   static void DeleteChanges(RestApiDeleteCall& call)
   {
     OrthancRestApi::GetIndex(call).DeleteChanges();
@@ -110,7 +286,11 @@ namespace Orthanc
     int64_t since;
     unsigned int limit;
     bool last;
-    GetSinceAndLimit(since, limit, last, call);
+    if (!GetSinceAndLimit(since, limit, last, call))
+    {
+      call.GetOutput().SignalError(HttpStatus_400_BadRequest);
+      return;
+    }
 
     Json::Value result;
     if (last)
@@ -137,6 +317,7 @@ namespace Orthanc
   {
     Register("/changes", GetChanges);
     Register("/changes", DeleteChanges);
+    Register("/changes/stream", StreamChanges);
     Register("/exports", GetExports);
     Register("/exports", DeleteExports);
   }
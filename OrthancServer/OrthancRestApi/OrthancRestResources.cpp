@@ -33,12 +33,20 @@
 #include "../PrecompiledHeadersServer.h"
 #include "OrthancRestApi.h"
 
+#include "../OrthancInitialization.h"
+#include "../../Core/ImageFormats/ImageProcessing.h"
+#include "../../Core/ImageFormats/PngWriter.h"
+#if ORTHANC_JPEG_ENABLED == 1
+#include "../../Core/ImageFormats/JpegWriter.h"
+#endif
 #include "../ServerToolbox.h"
 #include "../FromDcmtkBridge.h"
 #include "../ResourceFinder.h"
 #include "../DicomFindQuery.h"
+#include "../SliceOrdering.h"
 
 #include <glog/logging.h>
+#include <sstream>
 
 namespace Orthanc
 {
@@ -230,6 +238,148 @@ namespace Orthanc
   }
 
 
+  static bool GetResizeArguments(unsigned int& maxWidth,
+                                 unsigned int& maxHeight,
+                                 ImageInterpolation& interpolation,
+                                 const RestApiGetCall& call)
+  {
+    // The optional "width" and "height" GET arguments bound the size
+    // of the answered image, whose aspect ratio is preserved
+    try
+    {
+      maxWidth = boost::lexical_cast<unsigned int>(call.GetArgument("width", "0"));
+      maxHeight = boost::lexical_cast<unsigned int>(call.GetArgument("height", "0"));
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return false;
+    }
+
+    /**
+     * The "resize-quality" GET argument is a hint about the trade-off
+     * between speed and quality: "high" (the default) averages all
+     * the source pixels (box), whereas "fast" only samples 4 source
+     * pixels per target pixel (bilinear), which may alias but is much
+     * cheaper for large reduction factors. An explicit
+     * "interpolation" argument takes precedence over this hint.
+     **/
+    std::string hint = call.GetArgument("resize-quality", "high");
+    std::string defaultInterpolation;
+    if (hint == "high")
+    {
+      defaultInterpolation = "box";
+    }
+    else if (hint == "fast")
+    {
+      defaultInterpolation = "bilinear";
+    }
+    else
+    {
+      return false;
+    }
+
+    try
+    {
+      interpolation = StringToImageInterpolation(call.GetArgument("interpolation", defaultInterpolation).c_str());
+      return true;
+    }
+    catch (OrthancException&)
+    {
+      return false;
+    }
+  }
+
+
+#if ORTHANC_JPEG_ENABLED == 1
+  static bool IsJpegRequested(RestApiGetCall& call)
+  {
+    // Content negotiation through the "Accept" HTTP header: JPEG is
+    // only answered if it is preferred over PNG, which is the
+    // default. As the format of the answer depends on this header,
+    // shared caches must be told so.
+    call.GetOutput().GetLowLevelOutput().AddHeader("Vary", "Accept");
+
+    std::vector<std::string> candidates;
+    candidates.push_back("image/png");
+    candidates.push_back("image/jpeg");
+
+    size_t selected;
+    return (HttpHandler::SelectMediaType(selected, call.GetHttpHeader("accept", ""), candidates) &&
+            selected == 1);
+  }
+
+
+  static bool GetJpegQuality(uint8_t& quality,
+                             const RestApiGetCall& call)
+  {
+    // The "JpegQuality" configuration option can be overridden by
+    // the "quality" GET argument
+    int value;
+
+    try
+    {
+      value = boost::lexical_cast<int>(call.GetArgument("quality", "-1"));
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return false;
+    }
+
+    if (value == -1)
+    {
+      value = Configuration::GetGlobalIntegerParameter("JpegQuality", 90);
+    }
+
+    if (value <= 0 || value > 100)
+    {
+      return false;
+    }
+
+    quality = static_cast<uint8_t>(value);
+    return true;
+  }
+#endif
+
+
+  static void AnswerImageError(RestApiGetCall& call,
+                               const OrthancException& e)
+  {
+    if (e.GetErrorCode() == ErrorCode_ParameterOutOfRange)
+    {
+      // The frame number is out of the range for this DICOM
+      // instance, the resource is not existent
+    }
+    else
+    {
+      std::string root = "";
+      for (size_t i = 1; i < call.GetFullUri().size(); i++)
+      {
+        root += "../";
+      }
+
+      call.GetOutput().Redirect(root + "app/images/unsupported.png");
+    }
+  }
+
+
+  static void ReadFrame(std::string& dicomContent,
+                        unsigned int& frame,
+                        ServerContext& context,
+                        const std::string& publicId)
+  {
+    // Try and only read the requested frame from the storage area,
+    // which avoids loading the whole dataset of multiframe instances
+    if (context.ReadDicomFrame(dicomContent, publicId, frame))
+    {
+      frame = 0;
+    }
+    else
+    {
+      context.ReadFile(dicomContent, publicId, FileContentType_Dicom);
+    }
+  }
+
+
   template <enum ImageExtractionMode mode>
   static void GetImage(RestApiGetCall& call)
   {
@@ -247,34 +397,222 @@ namespace Orthanc
       return;
     }
 
+    unsigned int maxWidth, maxHeight;
+    ImageInterpolation interpolation;
+    if (!GetResizeArguments(maxWidth, maxHeight, interpolation, call))
+    {
+      return;
+    }
+
+    bool jpeg = false;
+    uint8_t quality = 0;
+
+#if ORTHANC_JPEG_ENABLED == 1
+    if ((mode == ImageExtractionMode_Preview ||
+         mode == ImageExtractionMode_UInt8) &&
+        IsJpegRequested(call))
+    {
+      jpeg = true;
+      if (!GetJpegQuality(quality, call))
+      {
+        return;
+      }
+    }
+#endif
+
     std::string publicId = call.GetUriComponent("id", "");
-    std::string dicomContent, png;
-    context.ReadFile(dicomContent, publicId, FileContentType_Dicom);
+    std::string dicomContent, image;
+    ReadFrame(dicomContent, frame, context, publicId);
 
     ParsedDicomFile dicom(dicomContent);
 
     try
     {
-      dicom.ExtractPngImage(png, frame, mode);
-      call.GetOutput().AnswerBuffer(png, "image/png");
+      if (jpeg)
+      {
+        dicom.ExtractJpegImage(image, frame, mode, maxWidth, maxHeight, interpolation, quality);
+        call.GetOutput().AnswerBuffer(image, "image/jpeg");
+      }
+      else
+      {
+        dicom.ExtractPngImage(image, frame, mode, maxWidth, maxHeight, interpolation);
+        call.GetOutput().AnswerBuffer(image, "image/png");
+      }
     }
     catch (OrthancException& e)
     {
-      if (e.GetErrorCode() == ErrorCode_ParameterOutOfRange)
+      AnswerImageError(call, e);
+    }
+  }
+
+
+  static void GetRenderedImage(RestApiGetCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    std::string frameId = call.GetUriComponent("frame", "0");
+
+    unsigned int frame;
+    try
+    {
+      frame = boost::lexical_cast<unsigned int>(frameId);
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return;
+    }
+
+    unsigned int maxWidth, maxHeight;
+    ImageInterpolation interpolation;
+    if (!GetResizeArguments(maxWidth, maxHeight, interpolation, call))
+    {
+      return;
+    }
+
+    // By default, use the windowing of the DICOM file
+    float windowCenter = 0, windowWidth = 0;
+    if (call.HasArgument("window-center") ||
+        call.HasArgument("window-width"))
+    {
+      try
       {
-        // The frame number is out of the range for this DICOM
-        // instance, the resource is not existent
+        windowCenter = boost::lexical_cast<float>(call.GetArgument("window-center", ""));
+        windowWidth = boost::lexical_cast<float>(call.GetArgument("window-width", ""));
       }
-      else
+      catch (boost::bad_lexical_cast)
       {
-        std::string root = "";
-        for (size_t i = 1; i < call.GetFullUri().size(); i++)
-        {
-          root += "../";
-        }
+        return;
+      }
+
+      if (windowWidth < 1.0f)
+      {
+        return;
+      }
+    }
+
+#if ORTHANC_JPEG_ENABLED == 1
+    bool jpeg = IsJpegRequested(call);
+    uint8_t quality = 0;
+    if (jpeg && !GetJpegQuality(quality, call))
+    {
+      return;
+    }
+#endif
+
+    std::string publicId = call.GetUriComponent("id", "");
+    std::string dicomContent;
+    ReadFrame(dicomContent, frame, context, publicId);
+
+    ParsedDicomFile dicom(dicomContent);
+
+    try
+    {
+      ImageBuffer buffer;
+      dicom.ExtractRenderedImage(buffer, frame, windowCenter, windowWidth, maxWidth, maxHeight, interpolation);
 
-        call.GetOutput().Redirect(root + "app/images/unsupported.png");
+      ImageAccessor accessor(buffer.GetConstAccessor());
+      std::string image;
+
+#if ORTHANC_JPEG_ENABLED == 1
+      if (jpeg)
+      {
+        JpegWriter writer;
+        writer.SetQuality(quality);
+        writer.WriteToMemory(image, accessor);
+        call.GetOutput().AnswerBuffer(image, "image/jpeg");
+        return;
+      }
+#endif
+
+      PngWriter writer;
+      writer.SetFastPreset();
+      writer.WriteToMemory(image, accessor);
+      call.GetOutput().AnswerBuffer(image, "image/png");
+    }
+    catch (OrthancException& e)
+    {
+      AnswerImageError(call, e);
+    }
+  }
+
+
+  static void GetRawFrame(RestApiGetCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    std::string frameId = call.GetUriComponent("frame", "0");
+
+    unsigned int frame;
+    try
+    {
+      frame = boost::lexical_cast<unsigned int>(frameId);
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return;
+    }
+
+    std::string publicId = call.GetUriComponent("id", "");
+    std::string raw;
+    boost::shared_ptr<DicomFrameIndex> index;
+
+    try
+    {
+      context.ReadRawFrame(raw, index, publicId, frame);
+    }
+    catch (OrthancException& e)
+    {
+      if (e.GetErrorCode() == ErrorCode_ParameterOutOfRange)
+      {
+        // No such frame
+        return;
+      }
+
+      throw;
+    }
+
+    if (index->IsEncapsulated())
+    {
+      // Strip the item headers, so as to answer the compressed
+      // bitstream of the frame as it is stored in the DICOM file
+      DicomFrameIndex::Fragments fragments;
+      DicomFrameIndex::ParseFragments(fragments, raw.c_str(), raw.size());
+
+      std::string bitstream;
+      for (size_t i = 0; i < fragments.size(); i++)
+      {
+        bitstream.append(raw, fragments[i].first, fragments[i].second);
       }
+
+      raw.swap(bitstream);
+    }
+
+    // The shape and the type of the pixel data are given in the HTTP headers
+    HttpOutput& output = call.GetOutput().GetLowLevelOutput();
+    output.AddHeader("Accept-Ranges", "bytes");
+    output.AddHeader("X-Orthanc-Transfer-Syntax", index->GetTransferSyntax());
+    output.AddHeader("X-Orthanc-Encapsulated", index->IsEncapsulated() ? "true" : "false");
+    output.AddHeader("X-Orthanc-Rows", boost::lexical_cast<std::string>(index->GetRows()));
+    output.AddHeader("X-Orthanc-Columns", boost::lexical_cast<std::string>(index->GetColumns()));
+    output.AddHeader("X-Orthanc-Samples-Per-Pixel", boost::lexical_cast<std::string>(index->GetSamplesPerPixel()));
+    output.AddHeader("X-Orthanc-Bits-Allocated", boost::lexical_cast<std::string>(index->GetBitsAllocated()));
+    output.AddHeader("X-Orthanc-Pixel-Representation", boost::lexical_cast<std::string>(index->GetPixelRepresentation()));
+
+    // An invalid or unsupported "Range" header is ignored, and the
+    // full frame is answered (RFC 7233)
+    bool satisfiable;
+    uint64_t start, end;
+    if (!HttpHandler::ParseRange(satisfiable, start, end, call.GetHttpHeader("range", ""), raw.size()))
+    {
+      call.GetOutput().AnswerBuffer(raw, "application/octet-stream");
+    }
+    else if (satisfiable)
+    {
+      call.GetOutput().AnswerBufferRange(raw, "application/octet-stream", start, end);
+    }
+    else
+    {
+      call.GetOutput().SignalRangeNotSatisfiable(raw.size());
     }
   }
 
@@ -297,7 +635,7 @@ namespace Orthanc
 
     std::string publicId = call.GetUriComponent("id", "");
     std::string dicomContent;
-    context.ReadFile(dicomContent, publicId, FileContentType_Dicom);
+    ReadFrame(dicomContent, frame, context, publicId);
 
     ParsedDicomFile dicom(dicomContent);
     ImageBuffer buffer;
@@ -312,6 +650,361 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    // Decodes one slice of a volume directly into its location
+    // inside the buffer of the volume
+    class VolumeSliceCommand : public ICommand
+    {
+    private:
+      ServerContext&       context_;
+      std::string          instanceId_;
+      unsigned int         frame_;
+      ImageExtractionMode  mode_;
+      ImageInterpolation   interpolation_;
+      ImageAccessor        target_;
+
+    public:
+      VolumeSliceCommand(ServerContext& context,
+                         const std::string& instanceId,
+                         unsigned int frame,
+                         ImageExtractionMode mode,
+                         ImageInterpolation interpolation,
+                         const ImageAccessor& target) :
+        context_(context),
+        instanceId_(instanceId),
+        frame_(frame),
+        mode_(mode),
+        interpolation_(interpolation),
+        target_(target)
+      {
+      }
+
+      virtual bool Execute()
+      {
+        std::string dicomContent;
+        unsigned int frame = frame_;
+        ReadFrame(dicomContent, frame, context_, instanceId_);
+
+        ParsedDicomFile dicom(dicomContent);
+        ImageBuffer buffer;
+        dicom.ExtractImage(buffer, frame, mode_);
+
+        ImageAccessor source(buffer.GetConstAccessor());
+
+        if (source.GetWidth() == target_.GetWidth() &&
+            source.GetHeight() == target_.GetHeight())
+        {
+          ImageProcessing::Copy(target_, source);
+        }
+        else
+        {
+          ImageProcessing::Resize(target_, source, interpolation_);
+        }
+
+        return true;
+      }
+    };
+  }
+
+
+  static std::string FormatVector(const double* values,
+                                  size_t size)
+  {
+    std::ostringstream s;
+    s.precision(10);
+
+    for (size_t i = 0; i < size; i++)
+    {
+      if (i > 0)
+      {
+        s << "\\";
+      }
+
+      s << values[i];
+    }
+
+    return s.str();
+  }
+
+
+  static bool GetVolumeFormat(ImageExtractionMode& mode,
+                              PixelFormat& format,
+                              const std::string& s)
+  {
+    if (s == "int16")
+    {
+      mode = ImageExtractionMode_Int16;
+      format = PixelFormat_SignedGrayscale16;
+    }
+    else if (s == "uint16")
+    {
+      mode = ImageExtractionMode_UInt16;
+      format = PixelFormat_Grayscale16;
+    }
+    else if (s == "uint8")
+    {
+      mode = ImageExtractionMode_UInt8;
+      format = PixelFormat_Grayscale8;
+    }
+    else
+    {
+      return false;
+    }
+
+    return true;
+  }
+
+
+  static void GetSeriesVolume(RestApiGetCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    ImageExtractionMode mode;
+    PixelFormat format;
+    if (!GetVolumeFormat(mode, format, call.GetArgument("format", "int16")))
+    {
+      return;
+    }
+
+    // The optional "downsample" GET argument divides the size of the
+    // volume by an integer factor along each of the three axes
+    unsigned int downsample;
+    ImageInterpolation interpolation;
+    try
+    {
+      downsample = boost::lexical_cast<unsigned int>(call.GetArgument("downsample", "1"));
+      interpolation = StringToImageInterpolation(call.GetArgument("interpolation", "box").c_str());
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return;
+    }
+    catch (OrthancException&)
+    {
+      return;
+    }
+
+    if (downsample == 0)
+    {
+      return;
+    }
+
+    std::string publicId = call.GetUriComponent("id", "");
+
+    typedef std::list<std::string> Instances;
+    Instances instances;
+    context.GetIndex().GetChildInstances(instances, publicId);
+
+    if (instances.empty())
+    {
+      return;
+    }
+
+    // Bound the memory that is allocated for the volume, as the
+    // number of frames is read from untrusted DICOM files
+    int maxFrames = Configuration::GetGlobalIntegerParameter("MaximumFramesPerInstance", 10000);
+    int maxSize = Configuration::GetGlobalIntegerParameter("MaximumVolumeSize", 1024);  // In MB
+    if (maxFrames < 0 ||
+        maxSize < 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    // Sort the slices using the JSON summaries of the instances,
+    // which avoids parsing the DICOM files
+    SliceOrdering ordering(static_cast<unsigned int>(maxFrames));
+    unsigned int columns = 0, rows = 0;
+    double pixelSpacing[2] = { 1, 1 };
+    bool hasPixelSpacing = false;
+
+    for (Instances::const_iterator it = instances.begin(); it != instances.end(); ++it)
+    {
+      Json::Value full, tags;
+      context.ReadJson(full, *it);
+      SimplifyTags(tags, full);
+
+      if (tags["Columns"].type() != Json::stringValue ||
+          tags["Rows"].type() != Json::stringValue)
+      {
+        // Not an image (e.g. a structured report): Skip it
+        continue;
+      }
+
+      unsigned int c, r;
+      try
+      {
+        c = boost::lexical_cast<unsigned int>(Toolbox::StripSpaces(tags["Columns"].asString()));
+        r = boost::lexical_cast<unsigned int>(Toolbox::StripSpaces(tags["Rows"].asString()));
+      }
+      catch (boost::bad_lexical_cast)
+      {
+        continue;
+      }
+
+      if (c == 0 || r == 0)
+      {
+        continue;
+      }
+
+      if (columns == 0)
+      {
+        columns = c;
+        rows = r;
+
+        std::vector<std::string> tokens;
+        if (tags["PixelSpacing"].type() == Json::stringValue)
+        {
+          Toolbox::TokenizeString(tokens, tags["PixelSpacing"].asString(), '\\');
+        }
+
+        if (tokens.size() == 2)
+        {
+          try
+          {
+            pixelSpacing[0] = boost::lexical_cast<double>(Toolbox::StripSpaces(tokens[0]));
+            pixelSpacing[1] = boost::lexical_cast<double>(Toolbox::StripSpaces(tokens[1]));
+            hasPixelSpacing = true;
+          }
+          catch (boost::bad_lexical_cast)
+          {
+          }
+        }
+      }
+      else if (c != columns || r != rows)
+      {
+        // The slices of a volume must share the same size
+        throw OrthancException(ErrorCode_IncompatibleImageSize);
+      }
+
+      if (!ordering.AddInstance(*it, tags))
+      {
+        LOG(ERROR) << "Too many frames in instance " << *it << " (check the \"MaximumFramesPerInstance\" option)";
+        call.GetOutput().SignalError(HttpStatus_400_BadRequest);
+        return;
+      }
+    }
+
+    if (columns == 0 ||
+        rows == 0)
+    {
+      // No image in this series
+      return;
+    }
+
+    const unsigned int width = std::max(1u, columns / downsample);
+    const unsigned int height = std::max(1u, rows / downsample);
+    const unsigned int pitch = width * GetBytesPerPixel(format);
+
+    // Check the size of the volume before sorting, as sorting
+    // allocates one entry per frame
+    const uint64_t depth = (ordering.GetFramesCount() + downsample - 1) / downsample;
+    const uint64_t size = static_cast<uint64_t>(pitch) * height * depth;
+    if (maxSize != 0 &&
+        size > static_cast<uint64_t>(maxSize) * 1024 * 1024)
+    {
+      LOG(ERROR) << "The volume of series " << publicId << " would use " << (size / (1024 * 1024))
+                 << "MB (check the \"MaximumVolumeSize\" option)";
+      call.GetOutput().SignalError(HttpStatus_413_RequestEntityTooLarge);
+      return;
+    }
+
+    if (size != static_cast<uint64_t>(static_cast<size_t>(size)))
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    ordering.Sort();
+    assert(ordering.GetSlicesCount() == ordering.GetFramesCount());
+
+    std::string volume;
+    volume.resize(static_cast<size_t>(size));
+
+    // Decode the slices in parallel, each worker writing into its own
+    // region of the volume
+    std::vector<ICommand*> commands;
+
+    try
+    {
+      for (size_t z = 0; z < depth; z++)
+      {
+        size_t slice = z * downsample;
+
+        ImageAccessor target;
+        target.AssignWritable(format, width, height, pitch, 
+                              &volume[0] + z * static_cast<size_t>(pitch) * height);
+
+        commands.push_back(new VolumeSliceCommand(context, ordering.GetInstanceId(slice),
+                                                  ordering.GetFrame(slice), mode, interpolation, target));
+      }
+
+      ImageProcessing::GetThreadPool().ExecuteBatch(commands);
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < commands.size(); i++)
+      {
+        delete commands[i];
+      }
+
+      throw;
+    }
+
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+      delete commands[i];
+    }
+
+    // The geometry of the volume is given in the HTTP headers
+    HttpOutput& output = call.GetOutput().GetLowLevelOutput();
+    output.AddHeader("X-Orthanc-Width", boost::lexical_cast<std::string>(width));
+    output.AddHeader("X-Orthanc-Height", boost::lexical_cast<std::string>(height));
+    output.AddHeader("X-Orthanc-Depth", boost::lexical_cast<std::string>(depth));
+    output.AddHeader("X-Orthanc-Format", call.GetArgument("format", "int16"));
+    output.AddHeader("X-Orthanc-Endianness", 
+                     Toolbox::DetectEndianness() == Endianness_Little ? "Little" : "Big");
+
+    if (hasPixelSpacing)
+    {
+      // Take the in-plane downsampling into account
+      double spacing[2] = {
+        pixelSpacing[0] * static_cast<double>(rows) / static_cast<double>(height),
+        pixelSpacing[1] * static_cast<double>(columns) / static_cast<double>(width)
+      };
+
+      output.AddHeader("X-Orthanc-Pixel-Spacing", FormatVector(spacing, 2));
+    }
+
+    switch (ordering.GetMethod())
+    {
+      case SliceOrdering::Method_Position:
+      {
+        output.AddHeader("X-Orthanc-Slice-Ordering", "Position");
+        output.AddHeader("X-Orthanc-Image-Position-Patient", FormatVector(ordering.GetPosition(0), 3));
+        output.AddHeader("X-Orthanc-Image-Orientation-Patient", FormatVector(ordering.GetOrientation(), 6));
+
+        double spacing;
+        if (ordering.ComputeSpacingBetweenSlices(spacing))
+        {
+          spacing *= static_cast<double>(downsample);
+          output.AddHeader("X-Orthanc-Spacing-Between-Slices", FormatVector(&spacing, 1));
+        }
+
+        break;
+      }
+
+      case SliceOrdering::Method_InstanceNumber:
+        output.AddHeader("X-Orthanc-Slice-Ordering", "InstanceNumber");
+        break;
+
+      default:
+        output.AddHeader("X-Orthanc-Slice-Ordering", "None");
+        break;
+    }
+
+    call.GetOutput().AnswerBuffer(volume, "application/octet-stream");
+  }
+
 
   static void GetResourceStatistics(RestApiGetCall& call)
   {
@@ -1065,6 +1758,7 @@ namespace Orthanc
 
     Register("/patients/{id}/shared-tags", GetSharedTags);
     Register("/series/{id}/shared-tags", GetSharedTags);
+    Register("/series/{id}/volume", GetSeriesVolume);
     Register("/studies/{id}/shared-tags", GetSharedTags);
 
     Register("/instances/{id}/module", GetModule<ResourceType_Instance, DicomModule_Instance>);
@@ -1084,11 +1778,14 @@ namespace Orthanc
     Register("/instances/{id}/frames/{frame}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/frames/{frame}/image-int16", GetImage<ImageExtractionMode_Int16>);
     Register("/instances/{id}/frames/{frame}/matlab", GetMatlabImage);
+    Register("/instances/{id}/frames/{frame}/rendered", GetRenderedImage);
+    Register("/instances/{id}/frames/{frame}/raw", GetRawFrame);
     Register("/instances/{id}/preview", GetImage<ImageExtractionMode_Preview>);
     Register("/instances/{id}/image-uint8", GetImage<ImageExtractionMode_UInt8>);
     Register("/instances/{id}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/image-int16", GetImage<ImageExtractionMode_Int16>);
     Register("/instances/{id}/matlab", GetMatlabImage);
+    Register("/instances/{id}/rendered", GetRenderedImage);
 
     Register("/patients/{id}/protected", IsProtectedPatient);
     Register("/patients/{id}/protected", SetPatientProtection);
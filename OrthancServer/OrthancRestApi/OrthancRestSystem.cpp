@@ -34,6 +34,7 @@
 #include "OrthancRestApi.h"
 
 #include "../OrthancInitialization.h"
+#include "../../Core/BufferPool.h"
 #include "../FromDcmtkBridge.h"
 #include "../../Plugins/Engine/PluginsManager.h"
 #include "../../Plugins/Engine/OrthancPlugins.h"
@@ -73,6 +74,36 @@ namespace Orthanc
     call.GetOutput().AnswerJson(result);
   }
 
+  static void GetBufferPoolStatistics(RestApiGetCall& call)
+  {
+    BufferPool::Statistics statistics;
+    BufferPool::GetInstance().GetStatistics(statistics);
+
+    // The sizes are expressed in MB, as in the "BufferPoolSize"
+    // option. The 64-bit counters are reported as strings, as in
+    // "/statistics", so as not to truncate them.
+    static const uint64_t MEGA_BYTES = 1024 * 1024;
+
+    Json::Value result = Json::objectValue;
+    result["Allocations"] = boost::lexical_cast<std::string>(statistics.allocations_);
+    result["Hits"] = boost::lexical_cast<std::string>(statistics.hits_);
+    result["UsedSizeMB"] = boost::lexical_cast<std::string>(statistics.usedSize_ / MEGA_BYTES);
+    result["IdleSizeMB"] = boost::lexical_cast<std::string>(statistics.idleSize_ / MEGA_BYTES);
+    result["IdleCount"] = boost::lexical_cast<std::string>(statistics.idleCount_);
+    result["MaximumIdleSizeMB"] = boost::lexical_cast<std::string>(statistics.maximumIdleSize_ / MEGA_BYTES);
+
+    call.GetOutput().AnswerJson(result);
+  }
+
+  static void GetStoredInstanceStatistics(RestApiGetCall& call)
+  {
+    Json::Value result;
+    if (OrthancRestApi::GetContext(call).GetStoredInstanceStatistics(result))
+    {
+      call.GetOutput().AnswerJson(result);
+    }
+  }
+
   static void GenerateUid(RestApiGetCall& call)
   {
     std::string level = call.GetArgument("level", "");
@@ -100,6 +131,7 @@ namespace Orthanc
     ServerContext& context = OrthancRestApi::GetContext(call);
 
     {
+      // The script is run by one single interpreter of the pool
       ServerContext::LuaContextLocker locker(context);
       locker.GetLua().Execute(result, call.GetPostBody());
     }
@@ -107,6 +139,19 @@ namespace Orthanc
     call.GetOutput().AnswerBuffer(result, "text/plain");
   }
 
+  static void DefineCallbacks(RestApiPostCall& call)
+  {
+    std::string result;
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    // The script is run by all the interpreters of the pool, so that
+    // the callbacks it defines are seen by all the threads. Its side
+    // effects (e.g. HTTP requests) are repeated in each interpreter.
+    context.GetLuaPool().Broadcast(result, call.GetPostBody());
+
+    call.GetOutput().AnswerBuffer(result, "text/plain");
+  }
+
   static void GetNowIsoString(RestApiGetCall& call)
   {
     call.GetOutput().AnswerBuffer(Toolbox::GetNowIsoString(), "text/plain");
@@ -215,8 +260,11 @@ namespace Orthanc
     Register("/", ServeRoot);
     Register("/system", GetSystemInformation);
     Register("/statistics", GetStatistics);
+    Register("/statistics/buffer-pool", GetBufferPoolStatistics);
+    Register("/statistics/stored-instances", GetStoredInstanceStatistics);
     Register("/tools/generate-uid", GenerateUid);
     Register("/tools/execute-script", ExecuteScript);
+    Register("/tools/define-callbacks", DefineCallbacks);
     Register("/tools/now", GetNowIsoString);
     Register("/tools/dicom-conformance", GetDicomConformanceStatement);
 
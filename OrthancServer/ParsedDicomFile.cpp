@@ -80,14 +80,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ParsedDicomFile.h"
 
-#include "ServerToolbox.h"
 #include "FromDcmtkBridge.h"
 #include "ToDcmtkBridge.h"
 #include "Internals/DicomImageDecoder.h"
 #include "../Core/Toolbox.h"
+#include "../Core/DicomFormat/DicomFrameIndex.h"
 #include "../Core/OrthancException.h"
 #include "../Core/ImageFormats/ImageBuffer.h"
 #include "../Core/ImageFormats/PngWriter.h"
+#if ORTHANC_JPEG_ENABLED == 1
+#include "../Core/ImageFormats/JpegWriter.h"
+#endif
 #include "../Core/Uuid.h"
 #include "../Core/DicomFormat/DicomString.h"
 #include "../Core/DicomFormat/DicomNullValue.h"
@@ -148,6 +151,11 @@ namespace Orthanc
   {
     std::auto_ptr<DcmFileFormat> file_;
     Encoding encoding_;
+
+    // Only set if the pixel data was not parsed yet
+    std::auto_ptr<IPixelDataLoader> pixelDataLoader_;
+    uint64_t pixelDataStart_;
+    uint64_t pixelDataEnd_;
   };
 
 
@@ -426,6 +434,8 @@ namespace Orthanc
       if (tag.getGroup() == DICOM_TAG_PIXEL_DATA.GetGroup() &&
           tag.getElement() == DICOM_TAG_PIXEL_DATA.GetElement())
       {
+        // Only the pixel data needs to be loaded, not the other tags
+        LoadPixelData();
         AnswerPixelData(output, *dicom, transferSyntax, uri.size() == 1 ? NULL : &uri[1]);
         return;
       }
@@ -748,6 +758,11 @@ namespace Orthanc
 
   void ParsedDicomFile::Remove(const DicomTag& tag)
   {
+    if (tag == DICOM_TAG_PIXEL_DATA)
+    {
+      LoadPixelData();
+    }
+
     DcmTagKey key(tag.GetGroup(), tag.GetElement());
     DcmElement* element = pimpl_->file_->getDataset()->remove(key);
     if (element != NULL)
@@ -811,6 +826,11 @@ namespace Orthanc
   void ParsedDicomFile::Insert(const DicomTag& tag,
                                const std::string& value)
   {
+    if (tag == DICOM_TAG_PIXEL_DATA)
+    {
+      LoadPixelData();
+    }
+
     OFCondition cond;
 
     if (FromDcmtkBridge::IsPrivateTag(tag))
@@ -842,6 +862,11 @@ namespace Orthanc
                                 const std::string& value,
                                 DicomReplaceMode mode)
   {
+    if (tag == DICOM_TAG_PIXEL_DATA)
+    {
+      LoadPixelData();
+    }
+
     DcmTagKey key(tag.GetGroup(), tag.GetElement());
     DcmElement* element = NULL;
 
@@ -901,6 +926,8 @@ namespace Orthanc
     
   void ParsedDicomFile::Answer(RestApiOutput& output)
   {
+    LoadPixelData();
+
     std::string serialized;
     if (FromDcmtkBridge::SaveToMemoryBuffer(serialized, *pimpl_->file_->getDataset()))
     {
@@ -1013,6 +1040,7 @@ namespace Orthanc
 
   void ParsedDicomFile::SaveToMemoryBuffer(std::string& buffer)
   {
+    LoadPixelData();
     FromDcmtkBridge::SaveToMemoryBuffer(buffer, *pimpl_->file_->getDataset());
   }
 
@@ -1055,6 +1083,99 @@ namespace Orthanc
   }
 
 
+  ParsedDicomFile::ParsedDicomFile(const std::string& content,
+                                   IPixelDataLoader* loader) : 
+    pimpl_(new PImpl)
+  {
+    std::auto_ptr<IPixelDataLoader> tmp(loader);
+
+    uint64_t start, end;
+    if (loader == NULL ||
+        content.size() == 0 ||
+        !DicomFrameIndex::LocatePixelData(start, end, content.c_str(), content.size()))
+    {
+      Setup(content.size() == 0 ? NULL : &content[0], content.size());
+      return;
+    }
+
+    if (end == content.size())
+    {
+      Setup(&content[0], static_cast<size_t>(start));
+    }
+    else
+    {
+      // Some tags follow the pixel data (e.g. trailing padding)
+      std::string header = (content.substr(0, static_cast<size_t>(start)) + 
+                            content.substr(static_cast<size_t>(end)));
+      Setup(&header[0], header.size());
+    }
+
+    // Insert an empty placeholder, so that the JSON and the summary
+    // of the header are the same as those of the full file
+    if (!pimpl_->file_->getDataset()->insert(new DcmPixelData(DCM_PixelData), false, false).good())
+    {
+      delete pimpl_;  // Avoid a memory leak, as we are in the constructor
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    pimpl_->pixelDataLoader_ = tmp;
+    pimpl_->pixelDataStart_ = start;
+    pimpl_->pixelDataEnd_ = end;
+  }
+
+
+  void ParsedDicomFile::LoadPixelData()
+  {
+    if (pimpl_->pixelDataLoader_.get() == NULL)
+    {
+      return;  // Already loaded
+    }
+
+    std::string buffer;
+    pimpl_->pixelDataLoader_->ReadRange(buffer, pimpl_->pixelDataStart_, pimpl_->pixelDataEnd_);
+
+    DcmInputBufferStream is;
+    if (buffer.size() > 0)
+    {
+      is.setBuffer(&buffer[0], buffer.size());
+    }
+    is.setEos();
+
+    // The pixel data element is parsed as a standalone dataset,
+    // using the transfer syntax of the header
+    DcmDataset& dataset = *pimpl_->file_->getDataset();
+    DcmDataset elements;
+    elements.transferInit();
+    if (!elements.read(is, dataset.getOriginalXfer()).good())
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+    elements.loadAllDataIntoMemory();
+    elements.transferEnd();
+
+    DcmElement* pixelData = elements.remove(DCM_PixelData);
+    if (pixelData == NULL)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    // Replace the empty placeholder
+    if (!dataset.insert(pixelData, true, false).good())
+    {
+      delete pixelData;
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    pimpl_->pixelDataLoader_.reset(NULL);
+  }
+
+
+  bool ParsedDicomFile::IsPixelDataLoaded() const
+  {
+    return pimpl_->pixelDataLoader_.get() == NULL;
+  }
+
+
   ParsedDicomFile::ParsedDicomFile(ParsedDicomFile& other) : 
     pimpl_(new PImpl)
   {
@@ -1071,6 +1192,13 @@ namespace Orthanc
 
 
   void* ParsedDicomFile::GetDcmtkObject()
+  {
+    LoadPixelData();
+    return pimpl_->file_.get();
+  }
+
+
+  void* ParsedDicomFile::GetDcmtkHeader()
   {
     return pimpl_->file_.get();
   }
@@ -1078,6 +1206,7 @@ namespace Orthanc
 
   ParsedDicomFile* ParsedDicomFile::Clone()
   {
+    LoadPixelData();
     return new ParsedDicomFile(*this);
   }
 
@@ -1105,6 +1234,8 @@ namespace Orthanc
 
   void ParsedDicomFile::EmbedImage(const ImageAccessor& accessor)
   {
+    LoadPixelData();
+
     if (accessor.GetFormat() != PixelFormat_Grayscale8 &&
         accessor.GetFormat() != PixelFormat_Grayscale16 &&
         accessor.GetFormat() != PixelFormat_RGB24 &&
@@ -1209,6 +1340,8 @@ namespace Orthanc
   void ParsedDicomFile::ExtractImage(ImageBuffer& result,
                                      unsigned int frame)
   {
+    LoadPixelData();
+
     DcmDataset& dataset = *pimpl_->file_->getDataset();
 
     if (!DicomImageDecoder::Decode(result, dataset, frame))
@@ -1222,6 +1355,19 @@ namespace Orthanc
                                      unsigned int frame,
                                      ImageExtractionMode mode)
   {
+    ExtractImage(result, frame, mode, 0, 0, ImageInterpolation_Box);
+  }
+
+
+  void ParsedDicomFile::ExtractImage(ImageBuffer& result,
+                                     unsigned int frame,
+                                     ImageExtractionMode mode,
+                                     unsigned int maxWidth,
+                                     unsigned int maxHeight,
+                                     ImageInterpolation interpolation)
+  {
+    LoadPixelData();
+
     DcmDataset& dataset = *pimpl_->file_->getDataset();
 
     bool ok = false;
@@ -1229,19 +1375,22 @@ namespace Orthanc
     switch (mode)
     {
       case ImageExtractionMode_UInt8:
-        ok = DicomImageDecoder::DecodeAndTruncate(result, dataset, frame, PixelFormat_Grayscale8, false);
+        ok = DicomImageDecoder::DecodeAndTruncate(result, dataset, frame, PixelFormat_Grayscale8, false,
+                                                  maxWidth, maxHeight, interpolation);
         break;
 
       case ImageExtractionMode_UInt16:
-        ok = DicomImageDecoder::DecodeAndTruncate(result, dataset, frame, PixelFormat_Grayscale16, false);
+        ok = DicomImageDecoder::DecodeAndTruncate(result, dataset, frame, PixelFormat_Grayscale16, false,
+                                                  maxWidth, maxHeight, interpolation);
         break;
 
       case ImageExtractionMode_Int16:
-        ok = DicomImageDecoder::DecodeAndTruncate(result, dataset, frame, PixelFormat_SignedGrayscale16, false);
+        ok = DicomImageDecoder::DecodeAndTruncate(result, dataset, frame, PixelFormat_SignedGrayscale16, false,
+                                                  maxWidth, maxHeight, interpolation);
         break;
 
       case ImageExtractionMode_Preview:
-        ok = DicomImageDecoder::DecodePreview(result, dataset, frame);
+        ok = DicomImageDecoder::DecodePreview(result, dataset, frame, maxWidth, maxHeight, interpolation);
         break;
 
       default:
@@ -1258,16 +1407,83 @@ namespace Orthanc
   void ParsedDicomFile::ExtractPngImage(std::string& result,
                                         unsigned int frame,
                                         ImageExtractionMode mode)
+  {
+    ExtractPngImage(result, frame, mode, 0, 0, ImageInterpolation_Box);
+  }
+
+
+  void ParsedDicomFile::ExtractPngImage(std::string& result,
+                                        unsigned int frame,
+                                        ImageExtractionMode mode,
+                                        unsigned int maxWidth,
+                                        unsigned int maxHeight,
+                                        ImageInterpolation interpolation)
   {
     ImageBuffer buffer;
-    ExtractImage(buffer, frame, mode);
+    ExtractImage(buffer, frame, mode, maxWidth, maxHeight, interpolation);
 
     ImageAccessor accessor(buffer.GetConstAccessor());
     PngWriter writer;
+
+    if (mode == ImageExtractionMode_Preview)
+    {
+      // Previews are interactive, favor speed over size
+      writer.SetFastPreset();
+    }
+
     writer.WriteToMemory(result, accessor);
   }
 
 
+  void ParsedDicomFile::ExtractRenderedImage(ImageBuffer& result,
+                                             unsigned int frame,
+                                             float windowCenter,
+                                             float windowWidth,
+                                             unsigned int maxWidth,
+                                             unsigned int maxHeight,
+                                             ImageInterpolation interpolation)
+  {
+    LoadPixelData();
+
+    DcmDataset& dataset = *pimpl_->file_->getDataset();
+
+    if (!DicomImageDecoder::DecodeRendered(result, dataset, frame, windowCenter, windowWidth,
+                                           maxWidth, maxHeight, interpolation))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+  }
+
+
+  void ParsedDicomFile::ExtractJpegImage(std::string& result,
+                                         unsigned int frame,
+                                         ImageExtractionMode mode,
+                                         unsigned int maxWidth,
+                                         unsigned int maxHeight,
+                                         ImageInterpolation interpolation,
+                                         uint8_t quality)
+  {
+#if ORTHANC_JPEG_ENABLED == 1
+    if (mode != ImageExtractionMode_UInt8 &&
+        mode != ImageExtractionMode_Preview)
+    {
+      // JPEG baseline only handles 8 bits per sample
+      throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    ImageBuffer buffer;
+    ExtractImage(buffer, frame, mode, maxWidth, maxHeight, interpolation);
+
+    ImageAccessor accessor(buffer.GetConstAccessor());
+    JpegWriter writer;
+    writer.SetQuality(quality);
+    writer.WriteToMemory(result, accessor);
+#else
+    throw OrthancException(ErrorCode_NotImplemented);
+#endif
+  }
+
+
   Encoding ParsedDicomFile::GetEncoding() const
   {
     return pimpl_->encoding_;
@@ -1350,9 +1566,7 @@ namespace Orthanc
   {
     if (simplify)
     {
-      Json::Value tmp;
-      FromDcmtkBridge::ToJson(tmp, *pimpl_->file_->getDataset());
-      SimplifyTags(target, tmp);
+      FromDcmtkBridge::ToSimplifiedJson(target, *pimpl_->file_->getDataset());
     }
     else
     {
@@ -42,6 +42,24 @@ namespace Orthanc
 {
   class ParsedDicomFile : public IDynamicObject
   {
+  public:
+    /**
+     * Source of the bytes of a DICOM file that was parsed without its
+     * pixel data. It is used to load the pixel data on demand.
+     **/
+    class IPixelDataLoader : public boost::noncopyable
+    {
+    public:
+      virtual ~IPixelDataLoader()
+      {
+      }
+
+      // Reads the bytes [start, end) of the original DICOM file
+      virtual void ReadRange(std::string& target,
+                             uint64_t start,
+                             uint64_t end) = 0;
+    };
+
   private:
     struct PImpl;
     PImpl* pimpl_;
@@ -53,6 +71,8 @@ namespace Orthanc
 
     void RemovePrivateTagsInternal(const std::set<DicomTag>* toKeep);
 
+    void LoadPixelData();
+
   public:
     ParsedDicomFile();  // Create a minimal DICOM instance
 
@@ -61,10 +81,27 @@ namespace Orthanc
 
     ParsedDicomFile(const std::string& content);
 
+    /**
+     * Only parses the DICOM tags that are located before the pixel
+     * data. The pixel data (and the tags after it) are read through
+     * "loader" the first time they are needed (e.g. to extract an
+     * image or to serialize the file). This object takes the
+     * ownership of "loader". The full file is parsed if the pixel
+     * data cannot be located by scanning "content".
+     **/
+    ParsedDicomFile(const std::string& content,
+                    IPixelDataLoader* loader);
+
     ~ParsedDicomFile();
 
     void* GetDcmtkObject();
 
+    // Same as "GetDcmtkObject()", but does not load the pixel data if
+    // it was not parsed yet: The pixel data element is then empty
+    void* GetDcmtkHeader();
+
+    bool IsPixelDataLoaded() const;
+
     ParsedDicomFile* Clone();
 
     void SendPathValue(RestApiOutput& output,
@@ -115,6 +152,41 @@ namespace Orthanc
                          unsigned int frame,
                          ImageExtractionMode mode);
 
+    // Downscaled versions, "0" meaning no constraint on the dimension
+    void ExtractImage(ImageBuffer& result,
+                      unsigned int frame,
+                      ImageExtractionMode mode,
+                      unsigned int maxWidth,
+                      unsigned int maxHeight,
+                      ImageInterpolation interpolation);
+
+    void ExtractPngImage(std::string& result,
+                         unsigned int frame,
+                         ImageExtractionMode mode,
+                         unsigned int maxWidth,
+                         unsigned int maxHeight,
+                         ImageInterpolation interpolation);
+
+    // Windowed rendering to an 8-bit image, "windowWidth == 0"
+    // meaning the default windowing of the DICOM file
+    void ExtractRenderedImage(ImageBuffer& result,
+                              unsigned int frame,
+                              float windowCenter,
+                              float windowWidth,
+                              unsigned int maxWidth,
+                              unsigned int maxHeight,
+                              ImageInterpolation interpolation);
+
+    // Only available if Orthanc is built with JPEG support. The
+    // extraction mode must produce 8-bit images.
+    void ExtractJpegImage(std::string& result,
+                          unsigned int frame,
+                          ImageExtractionMode mode,
+                          unsigned int maxWidth,
+                          unsigned int maxHeight,
+                          ImageInterpolation interpolation,
+                          uint8_t quality);
+
     Encoding GetEncoding() const;
 
     void SetEncoding(Encoding encoding);
@@ -0,0 +1,70 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "ResourcesContent.h"
+
+#include "IDatabaseWrapper.h"
+#include "../Core/DicomFormat/DicomArray.h"
+
+namespace Orthanc
+{
+  void ResourcesContent::AddMainDicomTags(int64_t resource,
+                                          const DicomMap& tags)
+  {
+    DicomArray flattened(tags);
+    for (size_t i = 0; i < flattened.GetSize(); i++)
+    {
+      const DicomElement& element = flattened.GetElement(i);
+      tags_.push_back(TagValue(resource, element.GetTag(), element.GetValue().AsString()));
+    }
+  }
+
+
+  void ResourcesContent::Store(IDatabaseWrapper& database) const
+  {
+    for (ListTags::const_iterator it = tags_.begin(); it != tags_.end(); ++it)
+    {
+      database.SetMainDicomTag(it->resource_, it->tag_, it->value_);
+    }
+
+    for (ListMetadata::const_iterator it = metadata_.begin(); it != metadata_.end(); ++it)
+    {
+      database.SetMetadata(it->resource_, it->metadata_, it->value_);
+    }
+
+    for (ListAttachments::const_iterator it = attachments_.begin(); it != attachments_.end(); ++it)
+    {
+      database.AddAttachment(it->first, it->second);
+    }
+  }
+}
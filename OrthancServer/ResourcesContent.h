@@ -0,0 +1,130 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../Core/DicomFormat/DicomMap.h"
+#include "../Core/FileStorage/FileInfo.h"
+#include "ServerEnumerations.h"
+
+#include <list>
+
+namespace Orthanc
+{
+  class IDatabaseWrapper;
+
+  /**
+   * The content (main DICOM tags, metadata and attachments) that is
+   * attached to a set of resources by one compound operation of the
+   * database back-end, typically when storing a new instance.
+   **/
+  class ResourcesContent
+  {
+  public:
+    struct TagValue
+    {
+      int64_t      resource_;
+      DicomTag     tag_;
+      std::string  value_;
+
+      TagValue(int64_t resource,
+               const DicomTag& tag,
+               const std::string& value) :
+        resource_(resource),
+        tag_(tag),
+        value_(value)
+      {
+      }
+    };
+
+    struct Metadata
+    {
+      int64_t       resource_;
+      MetadataType  metadata_;
+      std::string   value_;
+
+      Metadata(int64_t resource,
+               MetadataType metadata,
+               const std::string& value) :
+        resource_(resource),
+        metadata_(metadata),
+        value_(value)
+      {
+      }
+    };
+
+    typedef std::list<TagValue>                        ListTags;
+    typedef std::list<Metadata>                        ListMetadata;
+    typedef std::list< std::pair<int64_t, FileInfo> >  ListAttachments;
+
+  private:
+    ListTags         tags_;
+    ListMetadata     metadata_;
+    ListAttachments  attachments_;
+
+  public:
+    void AddMainDicomTags(int64_t resource,
+                          const DicomMap& tags);
+
+    void AddMetadata(int64_t resource,
+                     MetadataType metadata,
+                     const std::string& value)
+    {
+      metadata_.push_back(Metadata(resource, metadata, value));
+    }
+
+    void AddAttachment(int64_t resource,
+                       const FileInfo& attachment)
+    {
+      attachments_.push_back(std::make_pair(resource, attachment));
+    }
+
+    const ListTags& GetMainDicomTags() const
+    {
+      return tags_;
+    }
+
+    const ListMetadata& GetMetadata() const
+    {
+      return metadata_;
+    }
+
+    const ListAttachments& GetAttachments() const
+    {
+      return attachments_;
+    }
+
+    // Generic implementation for the back-ends that have no compound
+    // operation: One call to the back-end per item
+    void Store(IDatabaseWrapper& database) const;
+  };
+}
@@ -0,0 +1,440 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "RoutingRules.h"
+
+#include "../Core/OrthancException.h"
+#include "../Core/Toolbox.h"
+#include "FromDcmtkBridge.h"
+
+#include <memory>
+#include <set>
+#include <glog/logging.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/regex.hpp>
+
+namespace Orthanc
+{
+  static const char* const REMOTE_AET = "RemoteAET";
+  static const char* const CALLED_AET = "CalledAET";
+
+
+  class RoutingRules::ValuePredicate : public RoutingRules::IPredicate
+  {
+  private:
+    enum Source
+    {
+      Source_Tag,
+      Source_RemoteAet,
+      Source_CalledAet
+    };
+
+    Source                 source_;
+    DicomTag               tag_;
+    std::set<std::string>  values_;
+    bool                   isWildcard_;
+    boost::regex           pattern_;
+
+    bool Apply(const std::string& value) const
+    {
+      if (isWildcard_)
+      {
+        return boost::regex_match(value, pattern_);
+      }
+      else
+      {
+        return values_.find(value) != values_.end();
+      }
+    }
+
+  public:
+    ValuePredicate(const Json::Value& condition) :
+      source_(Source_Tag),
+      tag_(0, 0),
+      isWildcard_(false)
+    {
+      if (condition["Tag"].type() != Json::stringValue)
+      {
+        LOG(ERROR) << "A condition of a routing rule has no \"Tag\"";
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      std::string tag = condition["Tag"].asString();
+      if (tag == REMOTE_AET)
+      {
+        source_ = Source_RemoteAet;
+      }
+      else if (tag == CALLED_AET)
+      {
+        source_ = Source_CalledAet;
+      }
+      else
+      {
+        tag_ = FromDcmtkBridge::ParseTag(tag);
+      }
+
+      if (condition.isMember("Equals") &&
+          condition["Equals"].type() == Json::stringValue)
+      {
+        values_.insert(condition["Equals"].asString());
+      }
+      else if (condition.isMember("In") &&
+               condition["In"].type() == Json::arrayValue)
+      {
+        const Json::Value& values = condition["In"];
+        for (Json::Value::ArrayIndex i = 0; i < values.size(); i++)
+        {
+          values_.insert(values[i].asString());
+        }
+      }
+      else if (condition.isMember("Matches") &&
+               condition["Matches"].type() == Json::stringValue)
+      {
+        isWildcard_ = true;
+        pattern_ = boost::regex(Toolbox::WildcardToRegularExpression(condition["Matches"].asString()));
+      }
+      else
+      {
+        LOG(ERROR) << "The condition on \"" << tag << "\" of a routing rule must "
+                   << "contain either \"Equals\", \"In\" or \"Matches\"";
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+    }
+
+    virtual bool Apply(const DicomMap& summary,
+                       const std::string& remoteAet,
+                       const std::string& calledAet) const
+    {
+      switch (source_)
+      {
+        case Source_RemoteAet:
+          return Apply(remoteAet);
+
+        case Source_CalledAet:
+          return Apply(calledAet);
+
+        case Source_Tag:
+        {
+          const DicomValue* value = summary.TestAndGetValue(tag_);
+          return (value != NULL &&
+                  !value->IsNull() &&
+                  Apply(value->AsString()));
+        }
+
+        default:
+          throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+  };
+
+
+  class RoutingRules::CompositePredicate : public RoutingRules::IPredicate
+  {
+  private:
+    bool                      isConjunction_;
+    std::vector<IPredicate*>  children_;
+
+  public:
+    CompositePredicate(bool isConjunction,
+                       const Json::Value& children) :
+      isConjunction_(isConjunction)
+    {
+      if (children.type() != Json::arrayValue)
+      {
+        LOG(ERROR) << "The \"And\" and \"Or\" conditions of a routing rule must be arrays";
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      try
+      {
+        for (Json::Value::ArrayIndex i = 0; i < children.size(); i++)
+        {
+          children_.push_back(Compile(children[i]));
+        }
+      }
+      catch (OrthancException&)
+      {
+        for (size_t i = 0; i < children_.size(); i++)
+        {
+          delete children_[i];
+        }
+
+        throw;
+      }
+    }
+
+    virtual ~CompositePredicate()
+    {
+      for (size_t i = 0; i < children_.size(); i++)
+      {
+        delete children_[i];
+      }
+    }
+
+    virtual bool Apply(const DicomMap& summary,
+                       const std::string& remoteAet,
+                       const std::string& calledAet) const
+    {
+      // Short-circuit evaluation
+      for (size_t i = 0; i < children_.size(); i++)
+      {
+        if (children_[i]->Apply(summary, remoteAet, calledAet) != isConjunction_)
+        {
+          return !isConjunction_;
+        }
+      }
+
+      return isConjunction_;
+    }
+  };
+
+
+  class RoutingRules::NotPredicate : public RoutingRules::IPredicate
+  {
+  private:
+    std::auto_ptr<IPredicate>  child_;
+
+  public:
+    NotPredicate(const Json::Value& child) : 
+      child_(Compile(child))
+    {
+    }
+
+    virtual bool Apply(const DicomMap& summary,
+                       const std::string& remoteAet,
+                       const std::string& calledAet) const
+    {
+      return !child_->Apply(summary, remoteAet, calledAet);
+    }
+  };
+
+
+  struct RoutingRules::Rule
+  {
+    std::string                name_;
+    std::auto_ptr<IPredicate>  condition_;   // NULL means "always"
+    Json::Value                actions_;
+  };
+
+
+  RoutingRules::IPredicate* RoutingRules::Compile(const Json::Value& condition)
+  {
+    if (condition.type() != Json::objectValue)
+    {
+      LOG(ERROR) << "A condition of a routing rule must be a JSON object";
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    if (condition.isMember("And"))
+    {
+      return new CompositePredicate(true, condition["And"]);
+    }
+    else if (condition.isMember("Or"))
+    {
+      return new CompositePredicate(false, condition["Or"]);
+    }
+    else if (condition.isMember("Not"))
+    {
+      return new NotPredicate(condition["Not"]);
+    }
+    else
+    {
+      return new ValuePredicate(condition);
+    }
+  }
+
+
+  void RoutingRules::CheckActions(const Json::Value& actions)
+  {
+    if (actions.type() != Json::arrayValue ||
+        actions.size() == 0)
+    {
+      LOG(ERROR) << "A routing rule must have a non-empty array of \"Actions\"";
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    bool modified = false;
+
+    for (Json::Value::ArrayIndex i = 0; i < actions.size(); i++)
+    {
+      if (actions[i].type() != Json::objectValue ||
+          actions[i]["Operation"].type() != Json::stringValue)
+      {
+        LOG(ERROR) << "Each action of a routing rule must have an \"Operation\"";
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      std::string operation = actions[i]["Operation"].asString();
+      if (operation != "delete" &&
+          operation != "store-scu" &&
+          operation != "store-peer" &&
+          operation != "modify" &&
+          operation != "call-system")
+      {
+        LOG(ERROR) << "Unknown operation in a routing rule: " << operation;
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      if (operation == "modify")
+      {
+        if (modified)
+        {
+          LOG(ERROR) << "Cannot modify twice an instance in a routing rule";
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        modified = true;
+      }
+    }
+  }
+
+
+  void RoutingRules::Clear()
+  {
+    for (size_t i = 0; i < rules_.size(); i++)
+    {
+      delete rules_[i];
+    }
+
+    rules_.clear();
+  }
+
+
+  void RoutingRules::AddRule(const Json::Value& rule)
+  {
+    if (rule.type() != Json::objectValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    std::auto_ptr<Rule> compiled(new Rule);
+
+    if (rule.isMember("Name"))
+    {
+      compiled->name_ = rule["Name"].asString();
+    }
+    else
+    {
+      compiled->name_ = "Rule " + boost::lexical_cast<std::string>(rules_.size() + 1);
+    }
+
+    if (rule.isMember("Condition"))
+    {
+      compiled->condition_.reset(Compile(rule["Condition"]));
+    }
+
+    CheckActions(rule["Actions"]);
+    compiled->actions_ = rule["Actions"];
+
+    rules_.push_back(compiled.release());
+  }
+
+
+  void RoutingRules::Load(const Json::Value& rules)
+  {
+    Clear();
+
+    if (rules.type() == Json::nullValue)
+    {
+      return;
+    }
+
+    if (rules.type() != Json::arrayValue)
+    {
+      LOG(ERROR) << "The routing rules must be given as a JSON array";
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    for (Json::Value::ArrayIndex i = 0; i < rules.size(); i++)
+    {
+      AddRule(rules[i]);
+    }
+  }
+
+
+  const std::string& RoutingRules::GetName(size_t rule) const
+  {
+    if (rule >= rules_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return rules_[rule]->name_;
+  }
+
+
+  bool RoutingRules::Match(size_t rule,
+                           const DicomMap& summary,
+                           const std::string& remoteAet,
+                           const std::string& calledAet) const
+  {
+    if (rule >= rules_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const IPredicate* condition = rules_[rule]->condition_.get();
+    return (condition == NULL ||
+            condition->Apply(summary, remoteAet, calledAet));
+  }
+
+
+  void RoutingRules::FormatOperations(Json::Value& operations,
+                                      size_t rule,
+                                      const std::string& instanceId) const
+  {
+    if (rule >= rules_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const Json::Value& actions = rules_[rule]->actions_;
+
+    operations = Json::arrayValue;
+
+    std::string current = instanceId;
+    for (Json::Value::ArrayIndex i = 0; i < actions.size(); i++)
+    {
+      Json::Value operation = actions[i];
+      operation["Instance"] = current;
+      operations.append(operation);
+
+      if (actions[i]["Operation"].asString() == "modify")
+      {
+        // The next actions apply to the output of the modification
+        // (cf. "ModifyInstance()" in "Resources/Toolbox.lua")
+        current = "";
+      }
+    }
+  }
+}
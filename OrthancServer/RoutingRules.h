@@ -0,0 +1,119 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../Core/DicomFormat/DicomMap.h"
+
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+
+namespace Orthanc
+{
+  /**
+   * Declarative routing rules, as an alternative to the
+   * "OnStoredInstance()" Lua callback for simple routing scenarios.
+   * The conditions of the rules are compiled once into predicate
+   * trees, that are directly evaluated against the summary of the
+   * received instance (no conversion to JSON or to Lua). The actions
+   * of a matching rule are formatted as the operations that are
+   * produced by the Lua scripts, so that they are turned into the
+   * same server jobs.
+   **/
+  class RoutingRules : public boost::noncopyable
+  {
+  private:
+    class IPredicate : public boost::noncopyable
+    {
+    public:
+      virtual ~IPredicate()
+      {
+      }
+
+      virtual bool Apply(const DicomMap& summary,
+                         const std::string& remoteAet,
+                         const std::string& calledAet) const = 0;
+    };
+
+    class ValuePredicate;
+    class CompositePredicate;
+    class NotPredicate;
+
+    struct Rule;
+
+    std::vector<Rule*>  rules_;
+
+    static IPredicate* Compile(const Json::Value& condition);
+
+    static void CheckActions(const Json::Value& actions);
+
+  public:
+    ~RoutingRules()
+    {
+      Clear();
+    }
+
+    void Clear();
+
+    void AddRule(const Json::Value& rule);
+
+    // Loads an array of rules, as found in the "RoutingRules"
+    // option of the configuration file
+    void Load(const Json::Value& rules);
+
+    size_t GetSize() const
+    {
+      return rules_.size();
+    }
+
+    bool IsEmpty() const
+    {
+      return rules_.empty();
+    }
+
+    const std::string& GetName(size_t rule) const;
+
+    bool Match(size_t rule,
+               const DicomMap& summary,
+               const std::string& remoteAet,
+               const std::string& calledAet) const;
+
+    // Fills "operations" with the actions of the rule, applied to
+    // the given instance. Like in the Lua scripts, the actions that
+    // follow a modification apply to the modified instance.
+    void FormatOperations(Json::Value& operations,
+                          size_t rule,
+                          const std::string& instanceId) const;
+  };
+}
@@ -59,6 +59,7 @@ static const char* RECEIVED_INSTANCE_FILTER = "ReceivedInstanceFilter";
 static const char* ON_STORED_INSTANCE = "OnStoredInstance";
 
 static const size_t DICOM_CACHE_SIZE = 2;
+static const size_t FRAME_INDEX_CACHE_SIZE = 16;
 
 /**
  * IMPORTANT: We make the assumption that the same instance of
@@ -71,15 +72,34 @@ static const size_t DICOM_CACHE_SIZE = 2;
 
 namespace Orthanc
 {
+  static unsigned int GetLuaThreadsCount()
+  {
+    int count = Configuration::GetGlobalIntegerParameter("LuaThreads", 0);
+    if (count < 0)
+    {
+      LOG(ERROR) << "The configuration option \"LuaThreads\" must be positive or zero";
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return static_cast<unsigned int>(count);
+  }
+
+
   ServerContext::ServerContext(IDatabaseWrapper& database) :
     index_(*this, database),
     compressionEnabled_(false),
     provider_(*this),
     dicomCache_(provider_, DICOM_CACHE_SIZE),
+    frameIndexProvider_(*this),
+    frameIndexCache_(frameIndexProvider_, FRAME_INDEX_CACHE_SIZE),
     scheduler_(Configuration::GetGlobalIntegerParameter("LimitJobs", 10)),
+    lua_(GetLuaThreadsCount()),
     plugins_(NULL),
     pluginsManager_(NULL),
-    queryRetrieveArchive_(Configuration::GetGlobalIntegerParameter("QueryRetrieveSize", 10))
+    queryRetrieveArchive_(Configuration::GetGlobalIntegerParameter("QueryRetrieveSize", 10)),
+    maximumChangesStreams_(0),
+    countChangesStreams_(0),
+    storedInstanceHandler_(*this)
   {
     scu_.SetLocalApplicationEntityTitle(Configuration::GetGlobalStringParameter("DicomAet", "ORTHANC"));
 
@@ -88,6 +108,31 @@ namespace Orthanc
 
     lua_.Execute(Orthanc::EmbeddedResources::LUA_TOOLBOX);
     lua_.SetHttpProxy(Configuration::GetGlobalStringParameter("HttpProxy", ""));
+    lua_.SetSerialized(Configuration::GetGlobalBoolParameter("LuaSerialized", false));
+
+    Json::Value rules;
+    Configuration::GetGlobalJsonParameter(rules, "RoutingRules");
+    routingRules_.Load(rules);
+
+    if (!routingRules_.IsEmpty())
+    {
+      LOG(WARNING) << "Number of routing rules: " << routingRules_.GetSize();
+    }
+
+    if (Configuration::GetGlobalBoolParameter("AsynchronousOnStoredInstance", true))
+    {
+      storedInstanceDispatcher_.reset
+        (new StoredInstanceDispatcher(index_, storedInstanceHandler_,
+                                      std::max(0, Configuration::GetGlobalIntegerParameter("OnStoredInstanceThreads", 0)),
+                                      std::max(0, Configuration::GetGlobalIntegerParameter("OnStoredInstanceQueueSize", 1000))));
+    }
+    else
+    {
+      // Forget the position in the log of changes, otherwise all the
+      // instances received in the meantime would be delivered if the
+      // asynchronous mode is enabled again
+      index_.SetGlobalProperty(GlobalProperty_OnStoredInstanceSequence, "");
+    }
   }
 
   void ServerContext::SetCompressionEnabled(bool enabled)
@@ -107,16 +152,15 @@ namespace Orthanc
   }
 
 
-  bool ServerContext::ApplyReceivedInstanceFilter(const Json::Value& simplified,
-                                                  const std::string& remoteAet)
+  bool ServerContext::ApplyReceivedInstanceFilter(DicomInstanceToStore& dicom)
   {
     LuaContextLocker locker(*this);
 
     if (locker.GetLua().IsExistingFunction(RECEIVED_INSTANCE_FILTER))
     {
       LuaFunctionCall call(locker.GetLua(), RECEIVED_INSTANCE_FILTER);
-      call.PushJson(simplified);
-      call.PushString(remoteAet);
+      call.PushJson(dicom.GetSimplifiedJson());
+      call.PushString(dicom.GetRemoteAet());
 
       if (!call.ExecutePredicate())
       {
@@ -213,34 +257,49 @@ namespace Orthanc
 
 
   void ServerContext::ApplyLuaOnStoredInstance(const std::string& instanceId,
-                                               const Json::Value& simplifiedDicom,
-                                               const Json::Value& metadata,
-                                               const std::string& remoteAet,
-                                               const std::string& calledAet)
+                                               DicomInstanceToStore& dicom,
+                                               const InstanceMetadata& metadata)
   {
     LuaContextLocker locker(*this);
 
     if (locker.GetLua().IsExistingFunction(ON_STORED_INSTANCE))
     {
+      Json::Value metadataJson = Json::objectValue;
+      for (InstanceMetadata::const_iterator it = metadata.begin(); 
+           it != metadata.end(); ++it)
+      {
+        metadataJson[EnumerationToString(it->first)] = it->second;
+      }
+
       locker.GetLua().Execute("_InitializeJob()");
 
       LuaFunctionCall call(locker.GetLua(), ON_STORED_INSTANCE);
       call.PushString(instanceId);
-      call.PushJson(simplifiedDicom);
-      call.PushJson(metadata);
-      call.PushJson(remoteAet);
-      call.PushJson(calledAet);
+      call.PushJson(dicom.GetSimplifiedJson());
+      call.PushJson(metadataJson);
+      call.PushJson(dicom.GetRemoteAet());
+      call.PushJson(dicom.GetCalledAet());
       call.Execute();
 
       Json::Value operations;
       LuaFunctionCall call2(locker.GetLua(), "_AccessJob");
       call2.ExecuteToJson(operations);
-     
-      if (operations.type() != Json::arrayValue)
-      {
-        throw OrthancException(ErrorCode_InternalError);
-      }
 
+      SubmitOperations(operations, std::string("Lua script: ") + ON_STORED_INSTANCE);
+    }
+  }
+
+
+  void ServerContext::SubmitOperations(const Json::Value& operations,
+                                       const std::string& description)
+  {
+    if (operations.type() != Json::arrayValue)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    if (operations.size() > 0)
+    {
       ServerJob job;
       ServerCommandInstance* previousCommand = NULL;
 
@@ -275,12 +334,160 @@ namespace Orthanc
         previousCommand = &command;
       }
 
-      job.SetDescription(std::string("Lua script: ") + ON_STORED_INSTANCE);
+      job.SetDescription(description);
       scheduler_.Submit(job);
     }
   }
 
 
+  void ServerContext::ApplyRoutingRules(const std::string& instanceId,
+                                        DicomInstanceToStore& dicom)
+  {
+    for (size_t i = 0; i < routingRules_.GetSize(); i++)
+    {
+      if (routingRules_.Match(i, dicom.GetSummary(), dicom.GetRemoteAet(), dicom.GetCalledAet()))
+      {
+        LOG(INFO) << "Applying routing rule \"" << routingRules_.GetName(i) 
+                  << "\" to instance " << instanceId;
+
+        Json::Value operations;
+        routingRules_.FormatOperations(operations, i, instanceId);
+        SubmitOperations(operations, "Routing rule: " + routingRules_.GetName(i));
+      }
+    }
+  }
+
+
+  void ServerContext::DeliverStoredInstance(const std::string& instanceId,
+                                            const std::string& remoteAet,
+                                            const std::string& calledAet)
+  {
+    bool hasLua;
+
+    {
+      LuaContextLocker locker(*this);
+      hasLua = locker.GetLua().IsExistingFunction(ON_STORED_INSTANCE);
+    }
+
+    const bool hasPlugins = (plugins_ != NULL &&
+                             plugins_->HasStoredInstanceCallbacks());
+
+    if (!hasLua && !hasPlugins)
+    {
+      // Nobody is listening, don't read the JSON from the storage area
+      return;
+    }
+
+    Json::Value json, metadataJson;
+    ReadJson(json, instanceId);
+
+    if (!index_.GetMetadata(metadataJson, instanceId))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    InstanceMetadata metadata;
+
+    Json::Value::Members names = metadataJson.getMemberNames();
+    for (size_t i = 0; i < names.size(); i++)
+    {
+      try
+      {
+        metadata[StringToMetadata(names[i])] = metadataJson[names[i]].asString();
+      }
+      catch (OrthancException&)
+      {
+        // Unregistered user-defined metadata
+      }
+    }
+
+    // The summary is not accessible to Lua and to the plugins:
+    // Providing an empty one avoids parsing the DICOM file
+    DicomMap summary;
+
+    DicomInstanceToStore instance;
+    instance.SetJson(json);
+    instance.SetSummary(summary);
+    instance.SetRemoteAet(remoteAet);
+    instance.SetCalledAet(calledAet);
+
+    if (hasLua)
+    {
+      try
+      {
+        ApplyLuaOnStoredInstance(instanceId, instance, metadata);
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Error in " << ON_STORED_INSTANCE << " callback (Lua): " << e.What();
+      }
+    }
+
+    if (hasPlugins)
+    {
+      // Only the plugins can access the DICOM file
+      std::string buffer;
+      ReadFile(buffer, instanceId, FileContentType_Dicom);
+      instance.SetBuffer(buffer);
+
+      for (InstanceMetadata::const_iterator it = metadata.begin(); 
+           it != metadata.end(); ++it)
+      {
+        instance.GetMetadata()[std::make_pair(ResourceType_Instance, it->first)] = it->second;
+      }
+
+      try
+      {
+        plugins_->SignalStoredInstance(instance, instanceId);
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Error in " << ON_STORED_INSTANCE << " callback (plugins): " << e.What();
+      }
+    }
+  }
+
+
+  void ServerContext::StoredInstanceHandler::SignalStoredInstance(const std::string& instanceId,
+                                                                  const std::string& remoteAet,
+                                                                  const std::string& calledAet)
+  {
+    context_.DeliverStoredInstance(instanceId, remoteAet, calledAet);
+  }
+
+
+  void ServerContext::StartStoredInstanceDispatcher()
+  {
+    if (storedInstanceDispatcher_.get() != NULL)
+    {
+      storedInstanceDispatcher_->Start();
+    }
+  }
+
+
+  void ServerContext::StopStoredInstanceDispatcher()
+  {
+    if (storedInstanceDispatcher_.get() != NULL)
+    {
+      storedInstanceDispatcher_->Stop();
+    }
+  }
+
+
+  bool ServerContext::GetStoredInstanceStatistics(Json::Value& target)
+  {
+    if (storedInstanceDispatcher_.get() != NULL)
+    {
+      storedInstanceDispatcher_->GetStatistics(target);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
   StoreStatus ServerContext::Store(std::string& resultPublicId,
                                    DicomInstanceToStore& dicom)
   {
@@ -289,11 +496,8 @@ namespace Orthanc
       DicomInstanceHasher hasher(dicom.GetSummary());
       resultPublicId = hasher.HashInstance();
 
-      Json::Value simplified;
-      SimplifyTags(simplified, dicom.GetJson());
-
       // Test if the instance must be filtered out
-      if (!ApplyReceivedInstanceFilter(simplified, dicom.GetRemoteAet()))
+      if (!ApplyReceivedInstanceFilter(dicom))
       {
         LOG(INFO) << "An incoming instance has been discarded by the filter";
         return StoreStatus_FilteredOut;
@@ -315,7 +519,10 @@ namespace Orthanc
       attachments.push_back(dicomInfo);
       attachments.push_back(jsonInfo);
 
-      typedef std::map<MetadataType, std::string>  InstanceMetadata;
+      // Remember the called AET, which is needed to deliver the
+      // asynchronous OnStoredInstance events after a restart
+      dicom.GetMetadata()[std::make_pair(ResourceType_Instance, MetadataType_Instance_CalledAet)] = dicom.GetCalledAet();
+
       InstanceMetadata  instanceMetadata;
       StoreStatus status = index_.Store(instanceMetadata, dicom.GetSummary(), attachments, 
                                         dicom.GetRemoteAet(), dicom.GetMetadata());
@@ -357,18 +564,37 @@ namespace Orthanc
       if (status == StoreStatus_Success ||
           status == StoreStatus_AlreadyStored)
       {
-        Json::Value metadata = Json::objectValue;
-        for (std::map<MetadataType, std::string>::const_iterator 
-               it = instanceMetadata.begin(); 
-             it != instanceMetadata.end(); ++it)
+        // The routing rules are cheap, they are always applied
+        // synchronously, without the asynchronous dispatcher
+        try
+        {
+          ApplyRoutingRules(resultPublicId, dicom);
+        }
+        catch (OrthancException& e)
         {
-          metadata[EnumerationToString(it->first)] = it->second;
+          LOG(ERROR) << "Error while applying the routing rules: " << e.What();
         }
+      }
 
+      if (storedInstanceDispatcher_.get() != NULL)
+      {
+        // The callbacks will be invoked by the dispatcher, once this
+        // method has returned
+        if (status == StoreStatus_Success)
+        {
+          storedInstanceDispatcher_->SignalNewInstance();
+        }
+        else if (status == StoreStatus_AlreadyStored)
+        {
+          storedInstanceDispatcher_->SignalDuplicateInstance(resultPublicId, dicom.GetRemoteAet(), dicom.GetCalledAet());
+        }
+      }
+      else if (status == StoreStatus_Success ||
+               status == StoreStatus_AlreadyStored)
+      {
         try
         {
-          ApplyLuaOnStoredInstance(resultPublicId, simplified, metadata, 
-                                   dicom.GetRemoteAet(), dicom.GetCalledAet());
+          ApplyLuaOnStoredInstance(resultPublicId, dicom, instanceMetadata);
         }
         catch (OrthancException& e)
         {
@@ -462,12 +688,204 @@ namespace Orthanc
 
   IDynamicObject* ServerContext::DicomCacheProvider::Provide(const std::string& instancePublicId)
   {
+    // The whole file is parsed, as the users of the cache (images,
+    // modifications, raw tags) need the pixel data anyway: Loading
+    // it lazily would read and uncompress the file twice
     std::string content;
     context_.ReadFile(content, instancePublicId, FileContentType_Dicom);
     return new ParsedDicomFile(content);
   }
 
 
+  namespace
+  {
+    class FrameIndexEntry : public IDynamicObject
+    {
+    private:
+      boost::shared_ptr<DicomFrameIndex>  index_;
+      std::string                         header_;
+      std::string                         trailer_;
+
+    public:
+      FrameIndexEntry(const std::string& dicom)
+      {
+        try
+        {
+          index_.reset(new DicomFrameIndex(dicom.c_str(), dicom.size()));
+          index_->GetSingleFrameEnvelope(header_, trailer_, dicom.c_str(), dicom.size());
+        }
+        catch (OrthancException&)
+        {
+          // The frames of this file cannot be indexed
+          index_.reset();
+        }
+      }
+
+      const boost::shared_ptr<DicomFrameIndex>& GetIndex() const
+      {
+        return index_;
+      }
+
+      const std::string& GetHeader() const
+      {
+        return header_;
+      }
+
+      const std::string& GetTrailer() const
+      {
+        return trailer_;
+      }
+    };
+  }
+
+
+  IDynamicObject* ServerContext::FrameIndexProvider::Provide(const std::string& attachmentUuid)
+  {
+    std::string content;
+    context_.accessor_.SetCompressionForNextOperations(CompressionType_None);
+    context_.accessor_.Read(content, attachmentUuid, FileContentType_Dicom);
+    return new FrameIndexEntry(content);
+  }
+
+
+  bool ServerContext::LocateFrame(FileInfo& attachment,
+                                  boost::shared_ptr<DicomFrameIndex>& index,
+                                  std::string* header,
+                                  std::string* trailer,
+                                  const std::string& instancePublicId,
+                                  unsigned int frame)
+  {
+    if (!index_.LookupAttachment(attachment, instancePublicId, FileContentType_Dicom))
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    if (attachment.GetCompressionType() != CompressionType_None)
+    {
+      // No random access to compressed attachments
+      return false;
+    }
+
+    // The cache is indexed by the attachment UUID (and not by the
+    // instance ID), as the same instance might be stored again
+    boost::mutex::scoped_lock lock(frameIndexCacheMutex_);
+    const FrameIndexEntry& entry = dynamic_cast<FrameIndexEntry&>
+      (frameIndexCache_.Access(attachment.GetUuid()));
+
+    if (entry.GetIndex().get() == NULL)
+    {
+      return false;
+    }
+
+    if (frame >= entry.GetIndex()->GetFramesCount())
+    {
+      // The frames are known: Do not read the full file to find out
+      // that this frame does not exist
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    index = entry.GetIndex();
+
+    if (header != NULL)
+    {
+      *header = entry.GetHeader();
+    }
+
+    if (trailer != NULL)
+    {
+      *trailer = entry.GetTrailer();
+    }
+
+    return true;
+  }
+
+
+  bool ServerContext::ReadDicomFrame(std::string& result,
+                                     const std::string& instancePublicId,
+                                     unsigned int frame)
+  {
+    FileInfo attachment;
+    boost::shared_ptr<DicomFrameIndex> index;
+    std::string trailer;
+
+    if (!LocateFrame(attachment, index, &result, &trailer, instancePublicId, frame))
+    {
+      return false;
+    }
+
+    uint64_t start, end;
+    index->GetFrameRange(start, end, frame);
+
+    std::string content;
+    accessor_.SetCompressionForNextOperations(CompressionType_None);
+    accessor_.ReadRange(content, attachment.GetUuid(), attachment.GetContentType(), start, end);
+
+    result += content;
+    result += trailer;
+    return true;
+  }
+
+
+  void ServerContext::ReadRawFrame(std::string& result,
+                                   boost::shared_ptr<DicomFrameIndex>& index,
+                                   const std::string& instancePublicId,
+                                   unsigned int frame)
+  {
+    FileInfo attachment;
+    uint64_t start, end;
+
+    if (LocateFrame(attachment, index, NULL, NULL, instancePublicId, frame))
+    {
+      index->GetFrameRange(start, end, frame);
+      accessor_.SetCompressionForNextOperations(CompressionType_None);
+      accessor_.ReadRange(result, attachment.GetUuid(), attachment.GetContentType(), start, end);
+    }
+    else
+    {
+      // No random access is available (compressed attachment, or
+      // transfer syntax that cannot be indexed): Index the full file
+      std::string dicom;
+      ReadFile(dicom, instancePublicId, FileContentType_Dicom);
+
+      try
+      {
+        index.reset(new DicomFrameIndex(dicom.c_str(), dicom.size()));
+      }
+      catch (OrthancException& e)
+      {
+        if (e.GetErrorCode() != ErrorCode_NotImplemented)
+        {
+          throw;
+        }
+
+        // The raw bytes cannot be scanned (big endian or deflated
+        // transfer syntax): Let DCMTK rewrite the native pixel data
+        // as explicit little endian, which can be indexed
+        ParsedDicomFile parsed(dicom);
+        DcmDataset& dataset = *reinterpret_cast<DcmFileFormat*>(parsed.GetDcmtkObject())->getDataset();
+
+        if (DcmXfer(dataset.getOriginalXfer()).isEncapsulated())
+        {
+          throw;
+        }
+
+        LOG(INFO) << "Converting instance " << instancePublicId
+                  << " to little endian to extract the raw frame " << frame;
+
+        if (!FromDcmtkBridge::SaveToMemoryBuffer(dicom, dataset, EXS_LittleEndianExplicit))
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        index.reset(new DicomFrameIndex(dicom.c_str(), dicom.size()));
+      }
+
+      index->GetFrameRange(start, end, frame);
+      result = dicom.substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
+    }
+  }
+
+
   ServerContext::DicomCacheLocker::DicomCacheLocker(ServerContext& that,
                                                     const std::string& instancePublicId) : 
     that_(that),
@@ -488,6 +906,38 @@ namespace Orthanc
   }
 
 
+  ServerContext::ChangesStreamLocker::ChangesStreamLocker(ServerContext& that) :
+    that_(that)
+  {
+    boost::mutex::scoped_lock lock(that_.changesStreamsMutex_);
+
+    acquired_ = (that_.maximumChangesStreams_ == 0 ||
+                 that_.countChangesStreams_ < that_.maximumChangesStreams_);
+
+    if (acquired_)
+    {
+      that_.countChangesStreams_++;
+    }
+  }
+
+
+  ServerContext::ChangesStreamLocker::~ChangesStreamLocker()
+  {
+    if (acquired_)
+    {
+      boost::mutex::scoped_lock lock(that_.changesStreamsMutex_);
+      that_.countChangesStreams_--;
+    }
+  }
+
+
+  void ServerContext::SetMaximumChangesStreams(unsigned int count)
+  {
+    boost::mutex::scoped_lock lock(changesStreamsMutex_);
+    maximumChangesStreams_ = count;
+  }
+
+
   void ServerContext::SetStoreMD5ForAttachments(bool storeMD5)
   {
     LOG(INFO) << "Storing MD5 for attachments: " << (storeMD5 ? "yes" : "no");
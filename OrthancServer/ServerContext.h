@@ -33,19 +33,23 @@
 #pragma once
 
 #include "../Core/Cache/MemoryCache.h"
+#include "../Core/DicomFormat/DicomFrameIndex.h"
 #include "../Core/FileStorage/CompressedFileStorageAccessor.h"
 #include "../Core/FileStorage/IStorageArea.h"
 #include "../Core/RestApi/RestApiOutput.h"
-#include "../Core/Lua/LuaContext.h"
+#include "../Core/Lua/LuaContextPool.h"
 #include "ServerIndex.h"
 #include "ParsedDicomFile.h"
 #include "DicomProtocol/ReusableDicomUserConnection.h"
 #include "Scheduler/ServerScheduler.h"
 #include "DicomInstanceToStore.h"
 #include "ServerIndexChange.h"
+#include "StoredInstanceDispatcher.h"
+#include "RoutingRules.h"
 #include "../Core/Cache/SharedArchive.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace Orthanc
 {
@@ -73,14 +77,60 @@ namespace Orthanc
       virtual IDynamicObject* Provide(const std::string& id);
     };
 
-    bool ApplyReceivedInstanceFilter(const Json::Value& simplified,
-                                     const std::string& remoteAet);
+    class FrameIndexProvider : public ICachePageProvider
+    {
+    private:
+      ServerContext& context_;
+
+    public:
+      FrameIndexProvider(ServerContext& context) : context_(context)
+      {
+      }
+      
+      virtual IDynamicObject* Provide(const std::string& attachmentUuid);
+    };
+
+    class StoredInstanceHandler : public StoredInstanceDispatcher::IHandler
+    {
+    private:
+      ServerContext& context_;
+
+    public:
+      StoredInstanceHandler(ServerContext& context) : context_(context)
+      {
+      }
+
+      virtual void SignalStoredInstance(const std::string& instanceId,
+                                        const std::string& remoteAet,
+                                        const std::string& calledAet);
+    };
+
+    bool LocateFrame(FileInfo& attachment,
+                     boost::shared_ptr<DicomFrameIndex>& index,
+                     std::string* header,
+                     std::string* trailer,
+                     const std::string& instancePublicId,
+                     unsigned int frame);
+
+    typedef std::map<MetadataType, std::string>  InstanceMetadata;
+
+    // The payloads of the Lua callbacks (simplified tags and
+    // metadata) are only computed if the callbacks exist
+    bool ApplyReceivedInstanceFilter(DicomInstanceToStore& dicom);
+
+    void SubmitOperations(const Json::Value& operations,
+                          const std::string& description);
+
+    void ApplyRoutingRules(const std::string& instanceId,
+                           DicomInstanceToStore& dicom);
 
     void ApplyLuaOnStoredInstance(const std::string& instanceId,
-                                  const Json::Value& simplifiedDicom,
-                                  const Json::Value& metadata,
-                                  const std::string& remoteAet,
-                                  const std::string& calledAet);
+                                  DicomInstanceToStore& dicom,
+                                  const InstanceMetadata& metadata);
+
+    void DeliverStoredInstance(const std::string& instanceId,
+                               const std::string& remoteAet,
+                               const std::string& calledAet);
 
     ServerIndex index_;
     CompressedFileStorageAccessor accessor_;
@@ -89,16 +139,28 @@ namespace Orthanc
     DicomCacheProvider provider_;
     boost::mutex dicomCacheMutex_;
     MemoryCache dicomCache_;
+    FrameIndexProvider frameIndexProvider_;
+    boost::mutex frameIndexCacheMutex_;
+    MemoryCache frameIndexCache_;
     ReusableDicomUserConnection scu_;
     ServerScheduler scheduler_;
 
-    boost::mutex luaMutex_;
-    LuaContext lua_;
+    LuaContextPool lua_;
+    RoutingRules routingRules_;
     OrthancPlugins* plugins_;  // TODO Turn it into a listener pattern (idem for Lua callbacks)
     const PluginsManager* pluginsManager_;
 
     SharedArchive  queryRetrieveArchive_;
 
+    boost::mutex  changesStreamsMutex_;
+    unsigned int  maximumChangesStreams_;
+    unsigned int  countChangesStreams_;
+
+    // Declared last, so that the dispatcher is stopped before the
+    // other members are destroyed
+    StoredInstanceHandler storedInstanceHandler_;
+    std::auto_ptr<StoredInstanceDispatcher> storedInstanceDispatcher_;
+
   public:
     class DicomCacheLocker : public boost::noncopyable
     {
@@ -119,25 +181,43 @@ namespace Orthanc
       }
     };
 
+    // Gives access to one of the Lua interpreters of the pool
     class LuaContextLocker : public boost::noncopyable
     {
     private:
-      ServerContext& that_;
+      LuaContextPool::Locker locker_;
 
     public:
-      LuaContextLocker(ServerContext& that) : that_(that)
+      LuaContextLocker(ServerContext& that) : locker_(that.lua_)
       {
-        that.luaMutex_.lock();
       }
 
-      ~LuaContextLocker()
+      LuaContext& GetLua()
       {
-        that_.luaMutex_.unlock();
+        return locker_.GetLua();
       }
+    };
 
-      LuaContext& GetLua()
+
+    /**
+     * Reserves one of the concurrent streams of changes. Their number
+     * is bounded, as each of them keeps one HTTP thread busy.
+     **/
+    class ChangesStreamLocker : public boost::noncopyable
+    {
+    private:
+      ServerContext& that_;
+      bool           acquired_;
+
+    public:
+      ChangesStreamLocker(ServerContext& that);
+
+      ~ChangesStreamLocker();
+
+      // "false" if the maximum number of streams is reached
+      bool IsAcquired() const
       {
-        return that_.lua_;
+        return acquired_;
       }
     };
 
@@ -156,6 +236,9 @@ namespace Orthanc
 
     void SetCompressionEnabled(bool enabled);
 
+    // "0" means no limit
+    void SetMaximumChangesStreams(unsigned int count);
+
     bool IsCompressionEnabled() const
     {
       return compressionEnabled_;
@@ -185,6 +268,35 @@ namespace Orthanc
                   FileContentType content,
                   bool uncompressIfNeeded = true);
 
+    /**
+     * Creates a DICOM file that only contains one frame of an
+     * instance, by reading this frame with random access to the
+     * storage area. The location of the frames is cached. Returns
+     * "false" if this is not possible (e.g. compressed attachment, or
+     * unsupported transfer syntax), in which case the full DICOM file
+     * must be read. Throws "ErrorCode_ParameterOutOfRange" if the
+     * frames are indexed and the requested one does not exist.
+     **/
+    bool ReadDicomFrame(std::string& result,
+                        const std::string& instancePublicId,
+                        unsigned int frame);
+
+    /**
+     * Reads the raw bytes of one frame of an instance, without
+     * decoding them. For encapsulated transfer syntaxes, the result
+     * contains the fragment items of the frame. The index gives the
+     * shape and the type of the pixel data. Big endian and deflated
+     * files are first converted to explicit little endian by DCMTK,
+     * which is reflected by the transfer syntax of the index. Throws
+     * "ErrorCode_ParameterOutOfRange" if the frame does not exist,
+     * and "ErrorCode_NotImplemented" if the frames cannot be located
+     * (encapsulated frames without a Basic Offset Table).
+     **/
+    void ReadRawFrame(std::string& result,
+                      boost::shared_ptr<DicomFrameIndex>& index,
+                      const std::string& instancePublicId,
+                      unsigned int frame);
+
     void SetStoreMD5ForAttachments(bool storeMD5);
 
     bool IsStoreMD5ForAttachments() const
@@ -202,6 +314,11 @@ namespace Orthanc
       return scheduler_;
     }
 
+    LuaContextPool& GetLuaPool()
+    {
+      return lua_;
+    }
+
     void SetOrthancPlugins(const PluginsManager& manager,
                            OrthancPlugins& plugins)
     {
@@ -231,5 +348,15 @@ namespace Orthanc
     {
       return queryRetrieveArchive_;
     }
+
+    // The asynchronous delivery of OnStoredInstance must be started
+    // once the storage area and the plugins are set up, and stopped
+    // before the plugins are unloaded
+    void StartStoredInstanceDispatcher();
+
+    void StopStoredInstanceDispatcher();
+
+    // Returns "false" if OnStoredInstance is delivered synchronously
+    bool GetStoredInstanceStatistics(Json::Value& target);
   };
 }
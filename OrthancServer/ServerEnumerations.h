@@ -110,7 +110,8 @@ namespace Orthanc
   {
     GlobalProperty_DatabaseSchemaVersion = 1,
     GlobalProperty_FlushSleep = 2,
-    GlobalProperty_AnonymizationSequence = 3
+    GlobalProperty_AnonymizationSequence = 3,
+    GlobalProperty_OnStoredInstanceSequence = 4
   };
 
   enum MetadataType
@@ -122,6 +123,7 @@ namespace Orthanc
     MetadataType_ModifiedFrom = 5,
     MetadataType_AnonymizedFrom = 6,
     MetadataType_LastUpdate = 7,
+    MetadataType_Instance_CalledAet = 8,
 
     // Make sure that the value "65535" can be stored into this enumeration
     MetadataType_StartUser = 1024,
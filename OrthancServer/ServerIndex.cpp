@@ -455,7 +455,16 @@ namespace Orthanc
 
     if (changeType <= ChangeType_INTERNAL_LastLogged)
     {
-      db_.LogChange(internalId, change);
+      int64_t seq = db_.LogChange(internalId, change);
+
+      // Forward the sequence number of the change to the listeners
+      change = ServerIndexChange(seq, changeType, resourceType, publicId, change.GetDate());
+
+      // Wake up the clients that are waiting for changes. They will
+      // only access the database once the mutex is released, i.e. once
+      // the current transaction is over.
+      loggedChangesCount_++;
+      changeLogged_.notify_all();
     }
 
     assert(listener_.get() != NULL);
@@ -492,59 +501,10 @@ namespace Orthanc
 
 
 
-  void ServerIndex::SetMainDicomTags(int64_t resource,
-                                     const DicomMap& tags)
-  {
-    DicomArray flattened(tags);
-    for (size_t i = 0; i < flattened.GetSize(); i++)
-    {
-      const DicomElement& element = flattened.GetElement(i);
-      db_.SetMainDicomTag(resource, element.GetTag(), element.GetValue().AsString());
-    }
-  }
-
-
-  int64_t ServerIndex::CreateResource(const std::string& publicId,
-                                      ResourceType type)
-  {
-    int64_t id = db_.CreateResource(publicId, type);
-
-    ChangeType changeType;
-    switch (type)
-    {
-    case ResourceType_Patient: 
-      changeType = ChangeType_NewPatient; 
-      break;
-
-    case ResourceType_Study: 
-      changeType = ChangeType_NewStudy; 
-      break;
-
-    case ResourceType_Series: 
-      changeType = ChangeType_NewSeries; 
-      break;
-
-    case ResourceType_Instance: 
-      changeType = ChangeType_NewInstance; 
-      break;
-
-    default:
-      throw OrthancException(ErrorCode_InternalError);
-    }
-
-    ServerIndexChange change(changeType, type, publicId);
-    db_.LogChange(id, change);
-
-    assert(listener_.get() != NULL);
-    listener_->SignalChange(change);
-
-    return id;
-  }
-
-
   ServerIndex::ServerIndex(ServerContext& context,
                            IDatabaseWrapper& db) : 
     done_(false),
+    loggedChangesCount_(0),
     db_(db),
     maximumStorageSize_(0),
     maximumPatients_(0)
@@ -600,19 +560,24 @@ namespace Orthanc
     {
       Transaction t(*this);
 
+      IDatabaseWrapper::CreateInstanceResult status;
+      int64_t instance;
+
       // Do nothing if the instance already exists
       {
         ResourceType type;
-        int64_t tmp;
-        if (db_.LookupResource(tmp, type, hasher.HashInstance()))
+        if (db_.LookupResource(instance, type, hasher.HashInstance()))
         {
           assert(type == ResourceType_Instance);
-          db_.GetAllMetadata(instanceMetadata, tmp);
+          db_.GetAllMetadata(instanceMetadata, instance);
           return StoreStatus_AlreadyStored;
         }
       }
 
-      // Ensure there is enough room in the storage for the new instance
+      // Ensure there is enough room in the storage for the new
+      // instance. This must be done before creating the new
+      // resources, so that "MaximumPatientCount" does not take the
+      // patient of the new instance into account.
       uint64_t instanceSize = 0;
       for (Attachments::const_iterator it = attachments.begin();
            it != attachments.end(); ++it)
@@ -622,107 +587,53 @@ namespace Orthanc
 
       Recycle(instanceSize, hasher.HashPatient());
 
-      // Create the instance
-      int64_t instance = CreateResource(hasher.HashInstance(), ResourceType_Instance);
+      // Create the missing parts of the patient/study/series/instance
+      // hierarchy, as one single operation of the database back-end
+      if (!db_.CreateInstance(status, instance, hasher.HashPatient(),
+                              hasher.HashStudy(), hasher.HashSeries(), hasher.HashInstance()))
+      {
+        // Cannot happen, as the instance was looked up above within
+        // the same transaction
+        throw OrthancException(ErrorCode_InternalError);
+      }
 
-      DicomMap dicom;
-      dicomSummary.ExtractInstanceInformation(dicom);
-      SetMainDicomTags(instance, dicom);
+      const int64_t patient = status.patientId_;
+      const int64_t study = status.studyId_;
+      const int64_t series = status.seriesId_;
 
-      // Detect up to which level the patient/study/series/instance
-      // hierarchy must be created
-      int64_t patient = -1, study = -1, series = -1;
-      bool isNewPatient = false;
-      bool isNewStudy = false;
-      bool isNewSeries = false;
+      // Gather the main DICOM tags, the attachments and the metadata
+      // of the new resources, so that they are written at once
+      ResourcesContent content;
 
       {
-        ResourceType dummy;
+        DicomMap dicom;
+        dicomSummary.ExtractInstanceInformation(dicom);
+        content.AddMainDicomTags(instance, dicom);
 
-        if (db_.LookupResource(series, dummy, hasher.HashSeries()))
+        if (status.isNewSeries_)
         {
-          assert(dummy == ResourceType_Series);
-          // The patient, the study and the series already exist
-
-          bool ok = (db_.LookupResource(patient, dummy, hasher.HashPatient()) &&
-                     db_.LookupResource(study, dummy, hasher.HashStudy()));
-          assert(ok);
+          dicomSummary.ExtractSeriesInformation(dicom);
+          content.AddMainDicomTags(series, dicom);
         }
-        else if (db_.LookupResource(study, dummy, hasher.HashStudy()))
-        {
-          assert(dummy == ResourceType_Study);
-
-          // New series: The patient and the study already exist
-          isNewSeries = true;
 
-          bool ok = db_.LookupResource(patient, dummy, hasher.HashPatient());
-          assert(ok);
-        }
-        else if (db_.LookupResource(patient, dummy, hasher.HashPatient()))
+        if (status.isNewStudy_)
         {
-          assert(dummy == ResourceType_Patient);
-
-          // New study and series: The patient already exist
-          isNewStudy = true;
-          isNewSeries = true;
+          dicomSummary.ExtractStudyInformation(dicom);
+          content.AddMainDicomTags(study, dicom);
         }
-        else
+
+        if (status.isNewPatient_)
         {
-          // New patient, study and series: Nothing exists
-          isNewPatient = true;
-          isNewStudy = true;
-          isNewSeries = true;
+          dicomSummary.ExtractPatientInformation(dicom);
+          content.AddMainDicomTags(patient, dicom);
         }
       }
 
-      // Create the series if needed
-      if (isNewSeries)
-      {
-        series = CreateResource(hasher.HashSeries(), ResourceType_Series);
-        dicomSummary.ExtractSeriesInformation(dicom);
-        SetMainDicomTags(series, dicom);
-      }
-
-      // Create the study if needed
-      if (isNewStudy)
-      {
-        study = CreateResource(hasher.HashStudy(), ResourceType_Study);
-        dicomSummary.ExtractStudyInformation(dicom);
-        SetMainDicomTags(study, dicom);
-      }
-
-      // Create the patient if needed
-      if (isNewPatient)
-      {
-        patient = CreateResource(hasher.HashPatient(), ResourceType_Patient);
-        dicomSummary.ExtractPatientInformation(dicom);
-        SetMainDicomTags(patient, dicom);
-      }
-
-      // Create the parent-to-child links
-      db_.AttachChild(series, instance);
-
-      if (isNewSeries)
-      {
-        db_.AttachChild(study, series);
-      }
-
-      if (isNewStudy)
-      {
-        db_.AttachChild(patient, study);
-      }
-
-      // Sanity checks
-      assert(patient != -1);
-      assert(study != -1);
-      assert(series != -1);
-      assert(instance != -1);
-
       // Attach the files to the newly created instance
       for (Attachments::const_iterator it = attachments.begin();
            it != attachments.end(); ++it)
       {
-        db_.AddAttachment(instance, *it);
+        content.AddAttachment(instance, *it);
       }
 
       // Attach the user-specified metadata
@@ -732,19 +643,19 @@ namespace Orthanc
         switch (it->first.first)
         {
           case ResourceType_Patient:
-            db_.SetMetadata(patient, it->first.second, it->second);
+            content.AddMetadata(patient, it->first.second, it->second);
             break;
 
           case ResourceType_Study:
-            db_.SetMetadata(study, it->first.second, it->second);
+            content.AddMetadata(study, it->first.second, it->second);
             break;
 
           case ResourceType_Series:
-            db_.SetMetadata(series, it->first.second, it->second);
+            content.AddMetadata(series, it->first.second, it->second);
             break;
 
           case ResourceType_Instance:
-            db_.SetMetadata(instance, it->first.second, it->second);
+            content.AddMetadata(instance, it->first.second, it->second);
             instanceMetadata[it->first.second] = it->second;
             break;
 
@@ -755,28 +666,48 @@ namespace Orthanc
 
       // Attach the auto-computed metadata for the patient/study/series levels
       std::string now = Toolbox::GetNowIsoString();
-      db_.SetMetadata(series, MetadataType_LastUpdate, now);
-      db_.SetMetadata(study, MetadataType_LastUpdate, now);
-      db_.SetMetadata(patient, MetadataType_LastUpdate, now);
+      content.AddMetadata(series, MetadataType_LastUpdate, now);
+      content.AddMetadata(study, MetadataType_LastUpdate, now);
+      content.AddMetadata(patient, MetadataType_LastUpdate, now);
 
       // Attach the auto-computed metadata for the instance level,
       // reflecting these additions into the input metadata map
-      db_.SetMetadata(instance, MetadataType_Instance_ReceptionDate, now);
+      content.AddMetadata(instance, MetadataType_Instance_ReceptionDate, now);
       instanceMetadata[MetadataType_Instance_ReceptionDate] = now;
 
-      db_.SetMetadata(instance, MetadataType_Instance_RemoteAet, remoteAet);
+      content.AddMetadata(instance, MetadataType_Instance_RemoteAet, remoteAet);
       instanceMetadata[MetadataType_Instance_RemoteAet] = remoteAet;
 
       const DicomValue* value;
       if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||
           (value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)
       {
-        db_.SetMetadata(instance, MetadataType_Instance_IndexInSeries, value->AsString());
+        content.AddMetadata(instance, MetadataType_Instance_IndexInSeries, value->AsString());
         instanceMetadata[MetadataType_Instance_IndexInSeries] = value->AsString();
       }
 
+      db_.SetResourcesContent(content);
+
+      // Signal the creation of the new resources
+      LogChange(instance, ChangeType_NewInstance, ResourceType_Instance, hasher.HashInstance());
+
+      if (status.isNewSeries_)
+      {
+        LogChange(series, ChangeType_NewSeries, ResourceType_Series, hasher.HashSeries());
+      }
+
+      if (status.isNewStudy_)
+      {
+        LogChange(study, ChangeType_NewStudy, ResourceType_Study, hasher.HashStudy());
+      }
+
+      if (status.isNewPatient_)
+      {
+        LogChange(patient, ChangeType_NewPatient, ResourceType_Patient, hasher.HashPatient());
+      }
+
       // Check whether the series of this new instance is now completed
-      if (isNewSeries)
+      if (status.isNewSeries_)
       {
         ComputeExpectedNumberOfInstances(db_, series, dicomSummary);
       }
@@ -878,14 +809,52 @@ namespace Orthanc
 
 
   void ServerIndex::MainDicomTagsToJson(Json::Value& target,
-                                        int64_t resourceId)
+                                        const DicomMap& tags)
   {
-    DicomMap tags;
-    db_.GetMainDicomTags(tags, resourceId);
     target["MainDicomTags"] = Json::objectValue;
     FromDcmtkBridge::ToJson(target["MainDicomTags"], tags, true);
   }
 
+  static bool LookupStringMetadata(std::string& result,
+                                   const std::map<MetadataType, std::string>& metadata,
+                                   MetadataType type)
+  {
+    std::map<MetadataType, std::string>::const_iterator found = metadata.find(type);
+
+    if (found == metadata.end())
+    {
+      return false;
+    }
+    else
+    {
+      result = found->second;
+      return true;
+    }
+  }
+
+
+  static bool LookupIntegerMetadata(int64_t& result,
+                                    const std::map<MetadataType, std::string>& metadata,
+                                    MetadataType type)
+  {
+    std::string s;
+    if (!LookupStringMetadata(s, metadata, type))
+    {
+      return false;
+    }
+
+    try
+    {
+      result = boost::lexical_cast<int64_t>(s);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;
+    }
+  }
+
+
   bool ServerIndex::LookupResource(Json::Value& result,
                                    const std::string& publicId,
                                    ResourceType expectedType)
@@ -933,9 +902,12 @@ namespace Orthanc
       }
     }
 
-    // List the children resources
+    // Read the main DICOM tags, the children and the metadata in one
+    // single round trip to the database
+    DicomMap tags;
     std::list<std::string> children;
-    db_.GetChildrenPublicId(children, id);
+    std::map<MetadataType, std::string> metadata;
+    db_.LookupResourceContent(tags, children, metadata, id);
 
     if (type != ResourceType_Instance)
     {
@@ -983,7 +955,7 @@ namespace Orthanc
         result["Status"] = EnumerationToString(GetSeriesStatus(id));
 
         int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Series_ExpectedNumberOfInstances))
+        if (LookupIntegerMetadata(i, metadata, MetadataType_Series_ExpectedNumberOfInstances))
           result["ExpectedNumberOfInstances"] = static_cast<int>(i);
         else
           result["ExpectedNumberOfInstances"] = Json::nullValue;
@@ -1005,7 +977,7 @@ namespace Orthanc
         result["FileUuid"] = attachment.GetUuid();
 
         int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Instance_IndexInSeries))
+        if (LookupIntegerMetadata(i, metadata, MetadataType_Instance_IndexInSeries))
           result["IndexInSeries"] = static_cast<int>(i);
         else
           result["IndexInSeries"] = Json::nullValue;
@@ -1019,16 +991,16 @@ namespace Orthanc
 
     // Record the remaining information
     result["ID"] = publicId;
-    MainDicomTagsToJson(result, id);
+    MainDicomTagsToJson(result, tags);
 
     std::string tmp;
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_AnonymizedFrom))
+    if (LookupStringMetadata(tmp, metadata, MetadataType_AnonymizedFrom))
     {
       result["AnonymizedFrom"] = tmp;
     }
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_ModifiedFrom))
+    if (LookupStringMetadata(tmp, metadata, MetadataType_ModifiedFrom))
     {
       result["ModifiedFrom"] = tmp;
     }
@@ -1039,7 +1011,7 @@ namespace Orthanc
     {
       result["IsStable"] = !unstableResources_.Contains(id);
 
-      if (db_.LookupMetadata(tmp, id, MetadataType_LastUpdate))
+      if (LookupStringMetadata(tmp, metadata, MetadataType_LastUpdate))
       {
         result["LastUpdate"] = tmp;
       }
@@ -1114,10 +1086,52 @@ namespace Orthanc
   {
     std::list<ServerIndexChange> changes;
     bool done;
+    GetChanges(changes, done, since, maxResults);
+
+    FormatLog(target, changes, "Changes", done, since);
+  }
+
+
+  void ServerIndex::GetChanges(std::list<ServerIndexChange>& target,
+                               bool& done,
+                               int64_t since,
+                               unsigned int maxResults)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    db_.GetChanges(target, done, since, maxResults);
+  }
+
+
+  void ServerIndex::WaitForChanges(Json::Value& target,
+                                   int64_t since,
+                                   unsigned int maxResults,
+                                   unsigned int timeout)
+  {
+    std::list<ServerIndexChange> changes;
+    bool done = true;
 
     {
       boost::mutex::scoped_lock lock(mutex_);
-      db_.GetChanges(changes, done, since, maxResults);
+
+      const boost::system_time deadline = (boost::get_system_time() + 
+                                           boost::posix_time::milliseconds(timeout));
+      bool expired = false;
+
+      while (!expired)
+      {
+        db_.GetChanges(changes, done, since, maxResults);
+        if (!changes.empty())
+        {
+          break;
+        }
+
+        uint64_t count = loggedChangesCount_;
+        while (!expired &&
+               count == loggedChangesCount_)
+        {
+          expired = !changeLogged_.timed_wait(lock, deadline);
+        }
+      }
     }
 
     FormatLog(target, changes, "Changes", done, since);
@@ -1660,18 +1674,14 @@ namespace Orthanc
 
       ResourceType thisType = db_.GetResourceType(resource);
 
-      std::list<FileContentType> f;
-      db_.ListAvailableAttachments(f, resource);
+      std::list<FileInfo> attachments;
+      db_.GetAllAttachments(attachments, resource);
 
-      for (std::list<FileContentType>::const_iterator
-             it = f.begin(); it != f.end(); ++it)
+      for (std::list<FileInfo>::const_iterator
+             it = attachments.begin(); it != attachments.end(); ++it)
       {
-        FileInfo attachment;
-        if (db_.LookupAttachment(attachment, resource, *it))
-        {
-          compressedSize += attachment.GetCompressedSize();
-          uncompressedSize += attachment.GetUncompressedSize();
-        }
+        compressedSize += it->GetCompressedSize();
+        uncompressedSize += it->GetUncompressedSize();
       }
 
       if (thisType == ResourceType_Instance)
@@ -64,6 +64,8 @@ namespace Orthanc
 
     bool done_;
     boost::mutex mutex_;
+    boost::condition_variable changeLogged_;
+    uint64_t loggedChangesCount_;
     boost::thread flushThread_;
     boost::thread unstableResourcesMonitorThread_;
 
@@ -79,8 +81,8 @@ namespace Orthanc
 
     static void UnstableResourcesMonitorThread(ServerIndex* that);
 
-    void MainDicomTagsToJson(Json::Value& result,
-                             int64_t resourceId);
+    static void MainDicomTagsToJson(Json::Value& result,
+                                    const DicomMap& tags);
 
     SeriesStatus GetSeriesStatus(int64_t id);
 
@@ -114,12 +116,6 @@ namespace Orthanc
 
     uint64_t IncrementGlobalSequenceInternal(GlobalProperty property);
 
-    void SetMainDicomTags(int64_t resource,
-                          const DicomMap& tags);
-
-    int64_t CreateResource(const std::string& publicId,
-                           ResourceType type);
-
   public:
     ServerIndex(ServerContext& context,
                 IDatabaseWrapper& database);
@@ -169,6 +165,19 @@ namespace Orthanc
                     int64_t since,
                     unsigned int maxResults);
 
+    void GetChanges(std::list<ServerIndexChange>& target,
+                    bool& done,
+                    int64_t since,
+                    unsigned int maxResults);
+
+    // Same as "GetChanges()", but if no change has been logged after
+    // "since", waits for at most "timeout" milliseconds for a new
+    // change, without querying the database in the meantime
+    void WaitForChanges(Json::Value& target,
+                        int64_t since,
+                        unsigned int maxResults,
+                        unsigned int timeout);
+
     void GetLastChange(Json::Value& target);
 
     void LogExportedResource(const std::string& publicId,
@@ -151,4 +151,114 @@ namespace Orthanc
       LOG(ERROR) << "Store has failed because required tags (" << s << ") are missing for the following instance: " << t;
     }
   }
+
+
+  bool CreateInstanceGeneric(IDatabaseWrapper::CreateInstanceResult& result,
+                             int64_t& instanceId,
+                             IDatabaseWrapper& database,
+                             const std::string& patient,
+                             const std::string& study,
+                             const std::string& series,
+                             const std::string& instance)
+  {
+    ResourceType type;
+
+    if (database.LookupResource(instanceId, type, instance))
+    {
+      assert(type == ResourceType_Instance);
+      return false;
+    }
+
+    instanceId = database.CreateResource(instance, ResourceType_Instance);
+
+    result.isNewPatient_ = false;
+    result.isNewStudy_ = false;
+    result.isNewSeries_ = false;
+
+    // Detect up to which level the patient/study/series/instance
+    // hierarchy must be created
+    if (database.LookupResource(result.seriesId_, type, series))
+    {
+      assert(type == ResourceType_Series);
+    }
+    else
+    {
+      result.isNewSeries_ = true;
+      result.seriesId_ = database.CreateResource(series, ResourceType_Series);
+
+      if (database.LookupResource(result.studyId_, type, study))
+      {
+        assert(type == ResourceType_Study);
+      }
+      else
+      {
+        result.isNewStudy_ = true;
+        result.studyId_ = database.CreateResource(study, ResourceType_Study);
+
+        if (database.LookupResource(result.patientId_, type, patient))
+        {
+          assert(type == ResourceType_Patient);
+        }
+        else
+        {
+          result.isNewPatient_ = true;
+          result.patientId_ = database.CreateResource(patient, ResourceType_Patient);
+        }
+
+        database.AttachChild(result.patientId_, result.studyId_);
+      }
+
+      database.AttachChild(result.studyId_, result.seriesId_);
+    }
+
+    // The identifiers of the existing ancestors are also needed
+    if (!result.isNewSeries_ &&
+        !database.LookupResource(result.studyId_, type, study))
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    if (!result.isNewStudy_ &&
+        !database.LookupResource(result.patientId_, type, patient))
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    database.AttachChild(result.seriesId_, instanceId);
+
+    return true;
+  }
+
+
+  void LookupResourceContentGeneric(DicomMap& mainDicomTags,
+                                    std::list<std::string>& children,
+                                    std::map<MetadataType, std::string>& metadata,
+                                    IDatabaseWrapper& database,
+                                    int64_t id)
+  {
+    database.GetMainDicomTags(mainDicomTags, id);
+    database.GetChildrenPublicId(children, id);
+    database.GetAllMetadata(metadata, id);
+  }
+
+
+  void GetAllAttachmentsGeneric(std::list<FileInfo>& target,
+                                IDatabaseWrapper& database,
+                                int64_t id)
+  {
+    std::list<FileContentType> types;
+    database.ListAvailableAttachments(types, id);
+
+    target.clear();
+
+    for (std::list<FileContentType>::const_iterator
+           it = types.begin(); it != types.end(); ++it)
+    {
+      FileInfo attachment;
+      if (database.LookupAttachment(attachment, id, *it))
+      {
+        target.push_back(attachment);
+      }
+    }
+  }
 }
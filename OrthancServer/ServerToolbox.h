@@ -33,6 +33,7 @@
 #pragma once
 
 #include "../Core/DicomFormat/DicomMap.h"
+#include "IDatabaseWrapper.h"
 
 #include <json/json.h>
 
@@ -42,4 +43,26 @@ namespace Orthanc
                     const Json::Value& source);
 
   void LogMissingRequiredTag(const DicomMap& summary);
+
+  // Generic implementation of "IDatabaseWrapper::CreateInstance()",
+  // for the back-ends that have no dedicated compound operation
+  bool CreateInstanceGeneric(IDatabaseWrapper::CreateInstanceResult& result,
+                             int64_t& instanceId,
+                             IDatabaseWrapper& database,
+                             const std::string& patient,
+                             const std::string& study,
+                             const std::string& series,
+                             const std::string& instance);
+
+  // Generic implementations of "IDatabaseWrapper::LookupResourceContent()"
+  // and "IDatabaseWrapper::GetAllAttachments()", using the primitives
+  void LookupResourceContentGeneric(DicomMap& mainDicomTags,
+                                    std::list<std::string>& children,
+                                    std::map<MetadataType, std::string>& metadata,
+                                    IDatabaseWrapper& database,
+                                    int64_t id);
+
+  void GetAllAttachmentsGeneric(std::list<FileInfo>& target,
+                                IDatabaseWrapper& database,
+                                int64_t id);
 }
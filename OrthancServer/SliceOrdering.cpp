@@ -0,0 +1,346 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "SliceOrdering.h"
+
+#include "../Core/OrthancException.h"
+#include "../Core/Toolbox.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <boost/lexical_cast.hpp>
+
+namespace Orthanc
+{
+  static bool ParseVector(double* target,
+                          size_t size,
+                          const Json::Value& tags,
+                          const char* name)
+  {
+    if (!tags.isMember(name) ||
+        tags[name].type() != Json::stringValue)
+    {
+      return false;
+    }
+
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, tags[name].asString(), '\\');
+
+    if (tokens.size() != size)
+    {
+      return false;
+    }
+
+    try
+    {
+      for (size_t i = 0; i < size; i++)
+      {
+        target[i] = boost::lexical_cast<double>(Toolbox::StripSpaces(tokens[i]));
+      }
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return false;
+    }
+
+    return true;
+  }
+
+
+  static bool ParseInteger(long& target,
+                           const Json::Value& tags,
+                           const char* name)
+  {
+    if (!tags.isMember(name) ||
+        tags[name].type() != Json::stringValue)
+    {
+      return false;
+    }
+
+    try
+    {
+      target = boost::lexical_cast<long>(Toolbox::StripSpaces(tags[name].asString()));
+      return true;
+    }
+    catch (boost::bad_lexical_cast)
+    {
+      return false;
+    }
+  }
+
+
+  bool SliceOrdering::IsSameOrientation(const Instance& a,
+                                        const Instance& b)
+  {
+    static const double THRESHOLD = 0.0001;
+
+    for (size_t i = 0; i < 6; i++)
+    {
+      if (fabs(a.orientation_[i] - b.orientation_[i]) > THRESHOLD)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  bool SliceOrdering::CompareProjection(const Instance& a,
+                                        const Instance& b)
+  {
+    if (a.projection_ != b.projection_)
+    {
+      return a.projection_ < b.projection_;
+    }
+    else
+    {
+      return CompareNumber(a, b);
+    }
+  }
+
+
+  bool SliceOrdering::CompareNumber(const Instance& a,
+                                    const Instance& b)
+  {
+    if (a.hasNumber_ && 
+        b.hasNumber_ &&
+        a.number_ != b.number_)
+    {
+      return a.number_ < b.number_;
+    }
+    else
+    {
+      return CompareIndex(a, b);
+    }
+  }
+
+
+  bool SliceOrdering::CompareIndex(const Instance& a,
+                                   const Instance& b)
+  {
+    return a.index_ < b.index_;
+  }
+
+
+  bool SliceOrdering::IsOrderedByPosition()
+  {
+    if (instances_.empty())
+    {
+      return false;
+    }
+
+    for (size_t i = 0; i < instances_.size(); i++)
+    {
+      if (!instances_[i].hasPosition_ ||
+          !instances_[i].hasOrientation_ ||
+          !IsSameOrientation(instances_[0], instances_[i]))
+      {
+        return false;
+      }
+    }
+
+    // The normal is the cross product of the row and column vectors
+    const double* o = instances_[0].orientation_;
+    normal_[0] = o[1] * o[5] - o[2] * o[4];
+    normal_[1] = o[2] * o[3] - o[0] * o[5];
+    normal_[2] = o[0] * o[4] - o[1] * o[3];
+
+    for (size_t i = 0; i < instances_.size(); i++)
+    {
+      const double* p = instances_[i].position_;
+      instances_[i].projection_ = p[0] * normal_[0] + p[1] * normal_[1] + p[2] * normal_[2];
+    }
+
+    return true;
+  }
+
+
+  bool SliceOrdering::AddInstance(const std::string& instanceId,
+                                  const Json::Value& tags)
+  {
+    Instance instance;
+    instance.id_ = instanceId;
+    instance.index_ = instances_.size();
+    instance.hasPosition_ = ParseVector(instance.position_, 3, tags, "ImagePositionPatient");
+    instance.hasOrientation_ = ParseVector(instance.orientation_, 6, tags, "ImageOrientationPatient");
+    instance.hasNumber_ = ParseInteger(instance.number_, tags, "InstanceNumber");
+    instance.projection_ = 0;
+
+    long frames;
+    if (ParseInteger(frames, tags, "NumberOfFrames") &&
+        frames > 1)
+    {
+      if (static_cast<unsigned long>(frames) > std::numeric_limits<unsigned int>::max() ||
+          (maxFramesPerInstance_ != 0 &&
+           static_cast<unsigned long>(frames) > maxFramesPerInstance_))
+      {
+        return false;
+      }
+
+      instance.framesCount_ = static_cast<unsigned int>(frames);
+    }
+    else
+    {
+      instance.framesCount_ = 1;
+    }
+
+    instances_.push_back(instance);
+    framesCount_ += instance.framesCount_;
+    slices_.clear();
+
+    return true;
+  }
+
+
+  void SliceOrdering::Sort()
+  {
+    if (IsOrderedByPosition())
+    {
+      method_ = Method_Position;
+      std::sort(instances_.begin(), instances_.end(), CompareProjection);
+    }
+    else
+    {
+      method_ = (instances_.empty() ? Method_None : Method_InstanceNumber);
+
+      for (size_t i = 0; i < instances_.size(); i++)
+      {
+        if (!instances_[i].hasNumber_)
+        {
+          method_ = Method_None;
+          break;
+        }
+      }
+
+      if (method_ == Method_InstanceNumber)
+      {
+        std::sort(instances_.begin(), instances_.end(), CompareNumber);
+      }
+      else
+      {
+        std::sort(instances_.begin(), instances_.end(), CompareIndex);
+      }
+    }
+
+    slices_.clear();
+
+    for (size_t i = 0; i < instances_.size(); i++)
+    {
+      for (unsigned int frame = 0; frame < instances_[i].framesCount_; frame++)
+      {
+        Slice slice;
+        slice.instance_ = i;
+        slice.frame_ = frame;
+        slices_.push_back(slice);
+      }
+    }
+  }
+
+
+  const std::string& SliceOrdering::GetInstanceId(size_t slice) const
+  {
+    if (slice >= slices_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return instances_[slices_[slice].instance_].id_;
+  }
+
+
+  unsigned int SliceOrdering::GetFrame(size_t slice) const
+  {
+    if (slice >= slices_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return slices_[slice].frame_;
+  }
+
+
+  const double* SliceOrdering::GetNormal() const
+  {
+    if (method_ != Method_Position)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    return normal_;
+  }
+
+
+  const double* SliceOrdering::GetPosition(size_t slice) const
+  {
+    if (method_ != Method_Position)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (slice >= slices_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    return instances_[slices_[slice].instance_].position_;
+  }
+
+
+  const double* SliceOrdering::GetOrientation() const
+  {
+    if (method_ != Method_Position)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    return instances_[0].orientation_;
+  }
+
+
+  bool SliceOrdering::ComputeSpacingBetweenSlices(double& spacing) const
+  {
+    if (method_ != Method_Position ||
+        instances_.size() < 2 ||
+        instances_.size() != slices_.size())
+    {
+      return false;
+    }
+
+    spacing = ((instances_.back().projection_ - instances_.front().projection_) / 
+               static_cast<double>(instances_.size() - 1));
+
+    return spacing > 0;
+  }
+}
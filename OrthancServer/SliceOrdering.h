@@ -0,0 +1,155 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <json/value.h>
+
+namespace Orthanc
+{
+  /**
+   * Sorts the instances of a series so as to reconstruct a volume.
+   * The instances are sorted by their position along the normal of
+   * the slices (given by "ImagePositionPatient" and
+   * "ImageOrientationPatient") if all of them share the same
+   * orientation, otherwise by "InstanceNumber" if all of them have
+   * one, otherwise in the order of insertion. The frames of
+   * multiframe instances are consecutive slices.
+   **/
+  class SliceOrdering
+  {
+  public:
+    enum Method
+    {
+      Method_Position,
+      Method_InstanceNumber,
+      Method_None
+    };
+
+  private:
+    struct Instance
+    {
+      std::string  id_;
+      size_t       index_;
+      unsigned int framesCount_;
+      bool         hasPosition_;
+      double       position_[3];
+      bool         hasOrientation_;
+      double       orientation_[6];
+      bool         hasNumber_;
+      long         number_;
+      double       projection_;
+    };
+
+    struct Slice
+    {
+      size_t       instance_;
+      unsigned int frame_;
+    };
+
+    std::vector<Instance>  instances_;
+    std::vector<Slice>     slices_;
+    Method                 method_;
+    double                 normal_[3];
+    unsigned int           maxFramesPerInstance_;
+    uint64_t               framesCount_;
+
+    static bool IsSameOrientation(const Instance& a,
+                                  const Instance& b);
+
+    static bool CompareProjection(const Instance& a,
+                                  const Instance& b);
+
+    static bool CompareNumber(const Instance& a,
+                              const Instance& b);
+
+    static bool CompareIndex(const Instance& a,
+                             const Instance& b);
+
+    bool IsOrderedByPosition();
+
+  public:
+    // "maxFramesPerInstance == 0" means no limit
+    explicit SliceOrdering(unsigned int maxFramesPerInstance = 0) :
+      method_(Method_None),
+      maxFramesPerInstance_(maxFramesPerInstance),
+      framesCount_(0)
+    {
+    }
+
+    // "tags" are the simplified tags of the instance. Returns "false"
+    // (and ignores the instance) if its "NumberOfFrames" is above the
+    // limit, as this is a malformed or unreasonably large instance.
+    bool AddInstance(const std::string& instanceId,
+                     const Json::Value& tags);
+
+    // Total number of frames of the instances, that is available
+    // before sorting, in order to bound the size of the volume
+    uint64_t GetFramesCount() const
+    {
+      return framesCount_;
+    }
+
+    void Sort();
+
+    Method GetMethod() const
+    {
+      return method_;
+    }
+
+    size_t GetSlicesCount() const
+    {
+      return slices_.size();
+    }
+
+    const std::string& GetInstanceId(size_t slice) const;
+
+    unsigned int GetFrame(size_t slice) const;
+
+    // Only available if the slices are ordered by position
+    const double* GetNormal() const;
+
+    const double* GetPosition(size_t slice) const;
+
+    const double* GetOrientation() const;
+
+    /**
+     * Average distance between the successive instances along the
+     * normal. Returns "false" if this distance is unknown, for
+     * instance in the presence of multiframe instances.
+     **/
+    bool ComputeSpacingBetweenSlices(double& spacing) const;
+  };
+}
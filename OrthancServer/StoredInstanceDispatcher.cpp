@@ -0,0 +1,474 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "StoredInstanceDispatcher.h"
+
+#include "../Core/OrthancException.h"
+
+#include <glog/logging.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace Orthanc
+{
+  static const unsigned int BATCH_SIZE = 100;
+  static const unsigned int POLLING_SECONDS = 1;
+
+
+  class StoredInstanceDispatcher::DeliverCommand : public ICommand
+  {
+  private:
+    StoredInstanceDispatcher&  that_;
+    const Event&               event_;
+    size_t                     position_;
+
+  public:
+    DeliverCommand(StoredInstanceDispatcher& that,
+                   const Event& event,
+                   size_t position) :
+      that_(that),
+      event_(event),
+      position_(position)
+    {
+    }
+
+    virtual bool Execute()
+    {
+      if (that_.insideCallback_.get() == NULL)
+      {
+        that_.insideCallback_.reset(new bool(false));
+      }
+
+      // An error in one callback must neither stop the delivery of
+      // the other events, nor block the progress in the log
+      *that_.insideCallback_ = true;
+
+      try
+      {
+        that_.handler_.SignalStoredInstance(event_.instanceId_, event_.remoteAet_, event_.calledAet_);
+      }
+      catch (OrthancException& e)
+      {
+        // For instance, the instance has been deleted in the meantime
+        LOG(ERROR) << "Error while delivering OnStoredInstance for instance "
+                   << event_.instanceId_ << ": " << e.What();
+      }
+      catch (std::exception& e)
+      {
+        LOG(ERROR) << "Error while delivering OnStoredInstance for instance "
+                   << event_.instanceId_ << ": " << e.what();
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Unknown error while delivering OnStoredInstance for instance "
+                   << event_.instanceId_;
+      }
+
+      *that_.insideCallback_ = false;
+      that_.SignalDelivered(position_);
+      return true;
+    }
+  };
+
+
+  static unsigned int GetWorkersCount(unsigned int threads)
+  {
+    if (threads == 0)
+    {
+      threads = boost::thread::hardware_concurrency();
+    }
+
+    // The dispatcher thread also takes part in the delivery
+    return (threads > 1 ? threads - 1 : 0);
+  }
+
+
+  void StoredInstanceDispatcher::Worker(StoredInstanceDispatcher* that)
+  {
+    for (;;)
+    {
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        while (that->continue_ &&
+               !that->signaled_ &&
+               that->duplicates_.empty())
+        {
+          // Periodically scan the log of changes, even if not signaled
+          if (!that->wakeUp_.timed_wait(lock, boost::posix_time::seconds(POLLING_SECONDS)))
+          {
+            break;
+          }
+        }
+
+        if (!that->continue_)
+        {
+          return;
+        }
+
+        that->signaled_ = false;
+      }
+
+      try
+      {
+        that->ProcessDuplicates();
+
+        while (that->ProcessChanges())
+        {
+        }
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Error in the dispatcher of OnStoredInstance: " << e.What();
+      }
+      catch (std::exception& e)
+      {
+        LOG(ERROR) << "Error in the dispatcher of OnStoredInstance: " << e.what();
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Unknown error in the dispatcher of OnStoredInstance";
+      }
+    }
+  }
+
+
+  void StoredInstanceDispatcher::SignalDelivered(size_t position)
+  {
+    // The position in the log is saved as soon as all the events that
+    // precede it in the batch are delivered, so that a restart does
+    // not deliver again the events that are already done
+    boost::mutex::scoped_lock progressLock(progressMutex_);
+
+    delivered_[position] = true;
+
+    int64_t last = -1;
+    size_t count = 0;
+    while (firstPending_ < delivered_.size() &&
+           delivered_[firstPending_])
+    {
+      if ((*batch_)[firstPending_].seq_ >= 0)
+      {
+        last = (*batch_)[firstPending_].seq_;
+      }
+
+      firstPending_++;
+      count++;
+    }
+
+    if (last >= 0)
+    {
+      index_.SetGlobalProperty(GlobalProperty_OnStoredInstanceSequence, 
+                               boost::lexical_cast<std::string>(last));
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    countDelivered_ += count;
+
+    if (last >= 0)
+    {
+      sequence_ = last;
+    }
+  }
+
+
+  void StoredInstanceDispatcher::Deliver(const std::vector<Event>& events)
+  {
+    {
+      boost::mutex::scoped_lock progressLock(progressMutex_);
+      batch_ = &events;
+      delivered_.assign(events.size(), false);
+      firstPending_ = 0;
+    }
+
+    std::vector<ICommand*> commands;
+
+    try
+    {
+      for (size_t i = 0; i < events.size(); i++)
+      {
+        commands.push_back(new DeliverCommand(*this, events[i], i));
+      }
+
+      pool_.ExecuteBatch(commands);
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < commands.size(); i++)
+      {
+        delete commands[i];
+      }
+
+      throw;
+    }
+
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+      delete commands[i];
+    }
+  }
+
+
+  bool StoredInstanceDispatcher::ProcessChanges()
+  {
+    Json::Value changes;
+    index_.GetChanges(changes, sequence_, BATCH_SIZE);
+
+    const Json::Value& items = changes["Changes"];
+    if (items.size() == 0)
+    {
+      return false;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      pendingDate_ = items[0]["Date"].asString();
+    }
+
+    std::vector<Event> events;
+    events.reserve(items.size());
+
+    for (Json::Value::ArrayIndex i = 0; i < items.size(); i++)
+    {
+      if (items[i]["ChangeType"].asString() == EnumerationToString(ChangeType_NewInstance))
+      {
+        Event event;
+        event.instanceId_ = items[i]["ID"].asString();
+        event.seq_ = items[i]["Seq"].asInt();
+
+        if (!index_.LookupMetadata(event.remoteAet_, event.instanceId_, MetadataType_Instance_RemoteAet))
+        {
+          event.remoteAet_.clear();
+        }
+
+        if (!index_.LookupMetadata(event.calledAet_, event.instanceId_, MetadataType_Instance_CalledAet))
+        {
+          event.calledAet_.clear();
+        }
+
+        events.push_back(event);
+      }
+    }
+
+    Deliver(events);
+
+    // Skip the other types of changes at the end of the batch
+    int64_t last = changes["Last"].asInt();
+    index_.SetGlobalProperty(GlobalProperty_OnStoredInstanceSequence, 
+                             boost::lexical_cast<std::string>(last));
+
+    boost::mutex::scoped_lock lock(mutex_);
+    sequence_ = last;
+    pendingDate_.clear();
+
+    return (continue_ && !changes["Done"].asBool());
+  }
+
+
+  void StoredInstanceDispatcher::ProcessDuplicates()
+  {
+    std::vector<Event> events;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      events.assign(duplicates_.begin(), duplicates_.end());
+      duplicates_.clear();
+      queueNotFull_.notify_all();
+    }
+
+    if (!events.empty())
+    {
+      Deliver(events);
+    }
+  }
+
+
+  StoredInstanceDispatcher::StoredInstanceDispatcher(ServerIndex& index,
+                                                     IHandler& handler,
+                                                     unsigned int threads,
+                                                     size_t maxDuplicates) :
+    index_(index),
+    handler_(handler),
+    pool_(GetWorkersCount(threads)),
+    maxDuplicates_(std::max(static_cast<size_t>(1), maxDuplicates)),
+    continue_(false),
+    signaled_(false),
+    sequence_(0),
+    countDelivered_(0),
+    countDropped_(0),
+    batch_(NULL),
+    firstPending_(0)
+  {
+  }
+
+
+  StoredInstanceDispatcher::~StoredInstanceDispatcher()
+  {
+    Stop();
+  }
+
+
+  void StoredInstanceDispatcher::Start()
+  {
+    if (continue_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    std::string s = index_.GetGlobalProperty(GlobalProperty_OnStoredInstanceSequence, "");
+
+    try
+    {
+      sequence_ = boost::lexical_cast<int64_t>(s);
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      // First startup: Only the instances received from now on are
+      // delivered, not the content of the log of changes
+      Json::Value last;
+      index_.GetLastChange(last);
+      sequence_ = last["Last"].asInt();
+      index_.SetGlobalProperty(GlobalProperty_OnStoredInstanceSequence, 
+                               boost::lexical_cast<std::string>(sequence_));
+    }
+
+    LOG(WARNING) << "OnStoredInstance is delivered asynchronously, starting after change " << sequence_;
+
+    continue_ = true;
+    signaled_ = true;
+    worker_ = boost::thread(Worker, this);
+  }
+
+
+  void StoredInstanceDispatcher::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!continue_)
+      {
+        return;
+      }
+
+      continue_ = false;
+      wakeUp_.notify_all();
+      queueNotFull_.notify_all();
+    }
+
+    if (worker_.joinable())
+    {
+      worker_.join();
+    }
+  }
+
+
+  void StoredInstanceDispatcher::SignalNewInstance()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    signaled_ = true;
+    wakeUp_.notify_one();
+  }
+
+
+  void StoredInstanceDispatcher::SignalDuplicateInstance(const std::string& instanceId,
+                                                         const std::string& remoteAet,
+                                                         const std::string& calledAet)
+  {
+    // A callback that stores a duplicate instance must not wait for
+    // the dispatcher, as the dispatcher is waiting for this callback
+    const bool mustWait = (insideCallback_.get() == NULL || !*insideCallback_);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    // Back-pressure on the thread that stores the instance
+    while (mustWait &&
+           continue_ &&
+           duplicates_.size() >= maxDuplicates_)
+    {
+      queueNotFull_.wait(lock);
+    }
+
+    if (!continue_ &&
+        duplicates_.size() >= maxDuplicates_)
+    {
+      // Nobody would make room in the queue
+      LOG(WARNING) << "The dispatcher of OnStoredInstance is stopped, dropping the event for instance " << instanceId;
+      countDropped_++;
+      return;
+    }
+
+    Event event;
+    event.instanceId_ = instanceId;
+    event.remoteAet_ = remoteAet;
+    event.calledAet_ = calledAet;
+    event.seq_ = -1;
+    duplicates_.push_back(event);
+
+    wakeUp_.notify_one();
+  }
+
+
+  void StoredInstanceDispatcher::GetStatistics(Json::Value& target)
+  {
+    Json::Value last;
+    index_.GetLastChange(last);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    int64_t lastSequence = last["Last"].asInt();
+
+    // The lag is the age of the oldest change that is being delivered
+    int lag = 0;
+    if (!pendingDate_.empty())
+    {
+      try
+      {
+        boost::posix_time::ptime date = boost::posix_time::from_iso_string(pendingDate_);
+        boost::posix_time::ptime now = boost::posix_time::second_clock::local_time();
+        lag = std::max(0, static_cast<int>((now - date).total_seconds()));
+      }
+      catch (std::exception&)
+      {
+      }
+    }
+
+    target = Json::objectValue;
+    target["LastSequence"] = static_cast<int>(lastSequence);
+    target["DeliveredSequence"] = static_cast<int>(sequence_);
+    target["PendingChanges"] = static_cast<int>(std::max(static_cast<int64_t>(0), lastSequence - sequence_));
+    target["PendingDuplicates"] = static_cast<unsigned int>(duplicates_.size());
+    target["Lag"] = lag;
+    target["Delivered"] = boost::lexical_cast<std::string>(countDelivered_);
+    target["Dropped"] = boost::lexical_cast<std::string>(countDropped_);
+  }
+}
@@ -0,0 +1,149 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "ServerIndex.h"
+#include "../Core/MultiThreading/ThreadPool.h"
+
+#include <list>
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Delivers the "OnStoredInstance" events on worker threads, once
+   * the instances are committed to the index, so that the callbacks
+   * do not delay the answer to the sender of the instances.
+   *
+   * The queue of events is the log of changes of the index: The
+   * sequence number of the last delivered change is saved as a global
+   * property as soon as this change and all the changes before it
+   * are delivered, hence the new instances that are pending when
+   * Orthanc stops are delivered at the next startup ("at-least-once"
+   * delivery), and the memory usage does not depend on the length of
+   * the queue.
+   *
+   * The instances that are received again while already stored do
+   * not appear in the log of changes: They are queued in memory, and
+   * are lost if Orthanc stops before their delivery. The queue is
+   * bounded by applying back-pressure on the threads that store the
+   * instances, which wait for room in the queue instead of dropping
+   * the events.
+   **/
+  class StoredInstanceDispatcher : public boost::noncopyable
+  {
+  public:
+    class IHandler : public boost::noncopyable
+    {
+    public:
+      virtual ~IHandler()
+      {
+      }
+
+      virtual void SignalStoredInstance(const std::string& instanceId,
+                                        const std::string& remoteAet,
+                                        const std::string& calledAet) = 0;
+    };
+
+  private:
+    struct Event
+    {
+      std::string instanceId_;
+      std::string remoteAet_;
+      std::string calledAet_;
+      int64_t     seq_;   // Position in the log of changes, -1 for duplicates
+    };
+
+    class DeliverCommand;
+
+    ServerIndex&               index_;
+    IHandler&                  handler_;
+    ThreadPool                 pool_;
+    size_t                     maxDuplicates_;
+    boost::mutex               mutex_;
+    boost::condition_variable  wakeUp_;
+    boost::condition_variable  queueNotFull_;
+    bool                       continue_;
+    bool                       signaled_;
+    std::list<Event>           duplicates_;
+    boost::thread              worker_;
+    int64_t                    sequence_;
+    std::string                pendingDate_;
+    uint64_t                   countDelivered_;
+    uint64_t                   countDropped_;
+
+    // Progress of the batch being delivered
+    boost::mutex               progressMutex_;
+    const std::vector<Event>*  batch_;
+    std::vector<bool>          delivered_;
+    size_t                     firstPending_;
+
+    // Set in the threads that are running a callback
+    boost::thread_specific_ptr<bool>  insideCallback_;
+
+    static void Worker(StoredInstanceDispatcher* that);
+
+    void SignalDelivered(size_t position);
+
+    void Deliver(const std::vector<Event>& events);
+
+    bool ProcessChanges();
+
+    void ProcessDuplicates();
+
+  public:
+    // "threads == 0" means one thread per core
+    StoredInstanceDispatcher(ServerIndex& index,
+                             IHandler& handler,
+                             unsigned int threads,
+                             size_t maxDuplicates);
+
+    ~StoredInstanceDispatcher();
+
+    void Start();
+
+    void Stop();
+
+    // Wakes up the dispatcher after some instance has been stored
+    void SignalNewInstance();
+
+    // Blocks while the queue of duplicates is full. The event is only
+    // dropped if the dispatcher is stopped and its queue is full.
+    void SignalDuplicateInstance(const std::string& instanceId,
+                                 const std::string& remoteAet,
+                                 const std::string& calledAet);
+
+    void GetStatistics(Json::Value& target);
+  };
+}
@@ -49,11 +49,11 @@ namespace Orthanc
   {
     std::auto_ptr<DcmDataset> result(new DcmDataset);
 
-    for (DicomMap::Map::const_iterator 
-           it = map.map_.begin(); it != map.map_.end(); ++it)
+    for (DicomMap::Content::const_iterator 
+           it = map.content_.begin(); it != map.content_.end(); ++it)
     {
-      std::string s = it->second->AsString();
-      DU_putStringDOElement(result.get(), Convert(it->first), s.c_str());
+      std::string s = it->value_.AsString();
+      DU_putStringDOElement(result.get(), Convert(it->GetTag()), s.c_str());
     }
 
     return result.release();
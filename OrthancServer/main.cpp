@@ -37,11 +37,13 @@
 #include <glog/logging.h>
 #include <boost/algorithm/string/predicate.hpp>
 
+#include "../Core/BufferPool.h"
 #include "../Core/Uuid.h"
 #include "../Core/HttpServer/EmbeddedResourceHttpHandler.h"
 #include "../Core/HttpServer/FilesystemHttpHandler.h"
 #include "../Core/Lua/LuaFunctionCall.h"
 #include "../Core/DicomFormat/DicomArray.h"
+#include "../Core/ImageFormats/ImageProcessing.h"
 #include "DicomProtocol/DicomServer.h"
 #include "DicomProtocol/ReusableDicomUserConnection.h"
 #include "OrthancInitialization.h"
@@ -73,6 +75,7 @@ public:
   virtual void Handle(const std::string& dicomFile,
                       const DicomMap& dicomSummary,
                       const Json::Value& dicomJson,
+                      const Json::Value& simplifiedJson,
                       const std::string& remoteAet,
                       const std::string& calledAet)
   {
@@ -82,6 +85,7 @@ public:
       toStore.SetBuffer(dicomFile);
       toStore.SetSummary(dicomSummary);
       toStore.SetJson(dicomJson);
+      toStore.SetSimplifiedJson(simplifiedJson);
       toStore.SetRemoteAet(remoteAet);
       toStore.SetCalledAet(calledAet);
 
@@ -363,8 +367,7 @@ static void LoadLuaScripts(ServerContext& context)
     std::string script;
     Toolbox::ReadFile(script, path);
 
-    ServerContext::LuaContextLocker locker(context);
-    locker.GetLua().Execute(script);
+    context.GetLuaPool().Execute(script);
   }
 }
 
@@ -383,6 +386,20 @@ static void LoadPlugins(PluginsManager& pluginsManager)
 }
 
 
+static unsigned int GetUnsignedIntegerParameter(const std::string& parameter,
+                                                unsigned int defaultValue)
+{
+  int value = Configuration::GetGlobalIntegerParameter(parameter, defaultValue);
+  if (value < 0)
+  {
+    LOG(ERROR) << "The configuration option \"" << parameter << "\" must be positive or zero";
+    throw OrthancException(ErrorCode_ParameterOutOfRange);
+  }
+
+  return static_cast<unsigned int>(value);
+}
+
+
 
 
 
@@ -414,6 +431,11 @@ static bool StartOrthanc(int argc, char *argv[])
 
   context->SetCompressionEnabled(Configuration::GetGlobalBoolParameter("StorageCompression", false));
   context->SetStoreMD5ForAttachments(Configuration::GetGlobalBoolParameter("StoreMD5ForAttachments", true));
+  context->SetMaximumChangesStreams(GetUnsignedIntegerParameter("MaximumChangesStreams", 10));
+
+  ImageProcessing::SetThreadsCount(GetUnsignedIntegerParameter("ImageProcessingThreads", 0));
+  BufferPool::GetInstance().SetMaximumIdleSize
+    (static_cast<uint64_t>(GetUnsignedIntegerParameter("BufferPoolSize", 64)) * 1024 * 1024);
 
   LoadLuaScripts(*context);
 
@@ -506,6 +528,7 @@ static bool StartOrthanc(int argc, char *argv[])
     }
     
     context->SetStorageArea(*storage);
+    context->StartStoredInstanceDispatcher();
 
 
     // GO !!! Start the requested servers
@@ -546,6 +569,8 @@ static bool StartOrthanc(int argc, char *argv[])
     // We're done
     LOG(WARNING) << "Orthanc is stopping";
 
+    context->StopStoredInstanceDispatcher();
+
 #if ENABLE_PLUGINS == 1
     context->ResetOrthancPlugins();
     orthancPlugins.Stop();
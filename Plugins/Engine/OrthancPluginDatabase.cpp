@@ -33,8 +33,12 @@
 #include "OrthancPluginDatabase.h"
 
 #include "../../Core/OrthancException.h"
+#include "../../OrthancServer/ServerToolbox.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <vector>
 #include <glog/logging.h>
 
 namespace Orthanc
@@ -102,7 +106,9 @@ namespace Orthanc
     answerDicomMap_ = NULL;
     answerChanges_ = NULL;
     answerExportedResources_ = NULL;
+    answerMetadata_ = NULL;
     answerDone_ = NULL;
+    compoundAnswer_ = false;
   }
 
 
@@ -195,8 +201,22 @@ namespace Orthanc
     answerDicomMap_(NULL),
     answerChanges_(NULL),
     answerExportedResources_(NULL),
-    answerDone_(NULL)
+    answerMetadata_(NULL),
+    answerDone_(NULL),
+    compoundAnswer_(false)
   {
+    memset(&extensions_, 0, sizeof(extensions_));
+  }
+
+
+  void OrthancPluginDatabase::SetExtensions(const OrthancPluginDatabaseExtensions& extensions,
+                                            size_t size)
+  {
+    // The plugin might have been compiled against an older version
+    // of the SDK, that has fewer extensions: The missing extensions
+    // are left to NULL, which triggers the generic implementation
+    memset(&extensions_, 0, sizeof(extensions_));
+    memcpy(&extensions_, &extensions, std::min(size, sizeof(extensions_)));
   }
 
 
@@ -293,6 +313,26 @@ namespace Orthanc
   void OrthancPluginDatabase::GetAllMetadata(std::map<MetadataType, std::string>& target,
                                              int64_t id)
   {
+    if (extensions_.getAllMetadata != NULL)
+    {
+      ResetAnswers();
+      answerMetadata_ = &target;
+      target.clear();
+
+      if (extensions_.getAllMetadata(GetContext(), payload_, id) != 0)
+      {
+        throw OrthancException(ErrorCode_Plugin);
+      }
+
+      if (type_ != _OrthancPluginDatabaseAnswerType_None &&
+          type_ != _OrthancPluginDatabaseAnswerType_Metadata)
+      {
+        throw OrthancException(ErrorCode_Plugin);
+      }
+
+      return;
+    }
+
     std::list<MetadataType> metadata;
     ListAvailableMetadata(metadata, id);
 
@@ -583,8 +623,8 @@ namespace Orthanc
   }
 
 
-  void OrthancPluginDatabase::LogChange(int64_t internalId,
-                                        const ServerIndexChange& change)
+  int64_t OrthancPluginDatabase::LogChange(int64_t internalId,
+                                           const ServerIndexChange& change)
   {
     OrthancPluginChange tmp;
     tmp.seq = change.GetSeq();
@@ -597,6 +637,14 @@ namespace Orthanc
     {
       throw OrthancException(ErrorCode_Plugin);
     }
+
+    // The SDK of the database back-ends does not report the sequence
+    // number that was allocated to the change: As we are inside the
+    // transaction that logged it, it is the last change of the log
+    std::list<ServerIndexChange> last;
+    GetLastChange(last);
+
+    return last.empty() ? -1 : last.front().GetSeq();
   }
 
 
@@ -887,6 +935,123 @@ namespace Orthanc
   }
 
 
+  bool OrthancPluginDatabase::CreateInstance(CreateInstanceResult& result,
+                                             int64_t& instanceId,
+                                             const std::string& patient,
+                                             const std::string& study,
+                                             const std::string& series,
+                                             const std::string& instance)
+  {
+    if (extensions_.createInstance == NULL)
+    {
+      return CreateInstanceGeneric(result, instanceId, *this, patient, study, series, instance);
+    }
+
+    OrthancPluginCreateInstanceResult output;
+    memset(&output, 0, sizeof(output));
+
+    if (extensions_.createInstance(&output, payload_, patient.c_str(),
+                                   study.c_str(), series.c_str(), instance.c_str()) != 0)
+    {
+      throw OrthancException(ErrorCode_Plugin);
+    }
+
+    instanceId = output.instanceId;
+
+    if (output.isNewInstance)
+    {
+      result.isNewPatient_ = (output.isNewPatient != 0);
+      result.isNewStudy_ = (output.isNewStudy != 0);
+      result.isNewSeries_ = (output.isNewSeries != 0);
+      result.patientId_ = output.patientId;
+      result.studyId_ = output.studyId;
+      result.seriesId_ = output.seriesId;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void OrthancPluginDatabase::SetResourcesContent(const ResourcesContent& content)
+  {
+    if (extensions_.setResourcesContent == NULL)
+    {
+      content.Store(*this);
+      return;
+    }
+
+    // The C structures below only point to the strings owned by
+    // "content", that remains alive during the call to the plugin
+    std::vector<OrthancPluginResourcesContentTags> mainDicomTags, identifierTags;
+    mainDicomTags.reserve(content.GetMainDicomTags().size());
+
+    for (ResourcesContent::ListTags::const_iterator
+           it = content.GetMainDicomTags().begin(); it != content.GetMainDicomTags().end(); ++it)
+    {
+      OrthancPluginResourcesContentTags tmp;
+      tmp.resource = it->resource_;
+      tmp.group = it->tag_.GetGroup();
+      tmp.element = it->tag_.GetElement();
+      tmp.value = it->value_.c_str();
+
+      if (it->tag_.IsIdentifier())
+      {
+        identifierTags.push_back(tmp);
+      }
+      else
+      {
+        mainDicomTags.push_back(tmp);
+      }
+    }
+
+    std::vector<OrthancPluginResourcesContentMetadata> metadata;
+    metadata.reserve(content.GetMetadata().size());
+
+    for (ResourcesContent::ListMetadata::const_iterator
+           it = content.GetMetadata().begin(); it != content.GetMetadata().end(); ++it)
+    {
+      OrthancPluginResourcesContentMetadata tmp;
+      tmp.resource = it->resource_;
+      tmp.metadata = static_cast<int32_t>(it->metadata_);
+      tmp.value = it->value_.c_str();
+      metadata.push_back(tmp);
+    }
+
+    std::vector<OrthancPluginResourcesContentAttachment> attachments;
+    attachments.reserve(content.GetAttachments().size());
+
+    for (ResourcesContent::ListAttachments::const_iterator
+           it = content.GetAttachments().begin(); it != content.GetAttachments().end(); ++it)
+    {
+      const FileInfo& info = it->second;
+
+      OrthancPluginResourcesContentAttachment tmp;
+      tmp.resource = it->first;
+      tmp.attachment.uuid = info.GetUuid().c_str();
+      tmp.attachment.contentType = static_cast<int32_t>(info.GetContentType());
+      tmp.attachment.uncompressedSize = info.GetUncompressedSize();
+      tmp.attachment.uncompressedHash = info.GetUncompressedMD5().c_str();
+      tmp.attachment.compressionType = static_cast<int32_t>(info.GetCompressionType());
+      tmp.attachment.compressedSize = info.GetCompressedSize();
+      tmp.attachment.compressedHash = info.GetCompressedMD5().c_str();
+      attachments.push_back(tmp);
+    }
+
+    if (extensions_.setResourcesContent
+        (payload_,
+         static_cast<uint32_t>(mainDicomTags.size()), mainDicomTags.empty() ? NULL : &mainDicomTags[0],
+         static_cast<uint32_t>(identifierTags.size()), identifierTags.empty() ? NULL : &identifierTags[0],
+         static_cast<uint32_t>(metadata.size()), metadata.empty() ? NULL : &metadata[0],
+         static_cast<uint32_t>(attachments.size()), attachments.empty() ? NULL : &attachments[0]) != 0)
+    {
+      throw OrthancException(ErrorCode_Plugin);
+    }
+  }
+
+
   static void ProcessEvent(IServerIndexListener& listener,
                            const _OrthancPluginDatabaseAnswer& answer)
   {
@@ -921,6 +1086,71 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::LookupResourceContent(DicomMap& mainDicomTags,
+                                                    std::list<std::string>& children,
+                                                    std::map<MetadataType, std::string>& metadata,
+                                                    int64_t id)
+  {
+    if (extensions_.lookupResourceContent == NULL)
+    {
+      LookupResourceContentGeneric(mainDicomTags, children, metadata, *this, id);
+      return;
+    }
+
+    ResetAnswers();
+    mainDicomTags.Clear();
+    metadata.clear();
+    answerStrings_.clear();
+
+    answerDicomMap_ = &mainDicomTags;
+    answerMetadata_ = &metadata;
+    compoundAnswer_ = true;
+
+    int32_t error = extensions_.lookupResourceContent(GetContext(), payload_, id);
+    compoundAnswer_ = false;
+
+    if (error != 0)
+    {
+      throw OrthancException(ErrorCode_Plugin);
+    }
+
+    children.swap(answerStrings_);
+    answerStrings_.clear();
+  }
+
+
+  void OrthancPluginDatabase::GetAllAttachments(std::list<FileInfo>& target,
+                                                int64_t id)
+  {
+    if (extensions_.getAllAttachments == NULL)
+    {
+      GetAllAttachmentsGeneric(target, *this, id);
+      return;
+    }
+
+    ResetAnswers();
+
+    if (extensions_.getAllAttachments(GetContext(), payload_, id) != 0)
+    {
+      throw OrthancException(ErrorCode_Plugin);
+    }
+
+    if (type_ == _OrthancPluginDatabaseAnswerType_None)
+    {
+      target.clear();
+    }
+    else if (type_ == _OrthancPluginDatabaseAnswerType_Attachment)
+    {
+      target.swap(answerAttachments_);
+      answerAttachments_.clear();
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_Plugin);
+    }
+  }
+
+
   void OrthancPluginDatabase::AnswerReceived(const _OrthancPluginDatabaseAnswer& answer)
   {
     if (answer.type == _OrthancPluginDatabaseAnswerType_None)
@@ -928,6 +1158,47 @@ namespace Orthanc
       throw OrthancException(ErrorCode_Plugin);
     }
 
+    if (answer.type == _OrthancPluginDatabaseAnswerType_StringArray ||
+        answer.type == _OrthancPluginDatabaseAnswerType_Int64Array ||
+        answer.type == _OrthancPluginDatabaseAnswerType_DicomTagArray)
+    {
+      // Bulk answer: Unfold it as a sequence of scalar answers
+      if (answer.valueUint32 != 0 &&
+          answer.valueGeneric == NULL)
+      {
+        throw OrthancException(ErrorCode_Plugin);
+      }
+
+      _OrthancPluginDatabaseAnswer item = answer;
+      item.valueGeneric = NULL;
+      item.valueUint32 = 0;
+
+      for (uint32_t i = 0; i < answer.valueUint32; i++)
+      {
+        switch (answer.type)
+        {
+          case _OrthancPluginDatabaseAnswerType_StringArray:
+            item.type = _OrthancPluginDatabaseAnswerType_String;
+            item.valueString = reinterpret_cast<const char* const*>(answer.valueGeneric) [i];
+            break;
+
+          case _OrthancPluginDatabaseAnswerType_Int64Array:
+            item.type = _OrthancPluginDatabaseAnswerType_Int64;
+            item.valueInt64 = reinterpret_cast<const int64_t*>(answer.valueGeneric) [i];
+            break;
+
+          default:
+            item.type = _OrthancPluginDatabaseAnswerType_DicomTag;
+            item.valueGeneric = reinterpret_cast<const OrthancPluginDicomTag*>(answer.valueGeneric) + i;
+            break;
+        }
+
+        AnswerReceived(item);
+      }
+
+      return;
+    }
+
     if (answer.type == _OrthancPluginDatabaseAnswerType_DeletedAttachment ||
         answer.type == _OrthancPluginDatabaseAnswerType_DeletedResource ||
         answer.type == _OrthancPluginDatabaseAnswerType_RemainingAncestor)
@@ -937,7 +1208,21 @@ namespace Orthanc
       return;
     }
 
-    if (type_ == _OrthancPluginDatabaseAnswerType_None)
+    if (compoundAnswer_)
+    {
+      // The targets of a compound answer are cleared before the call
+      // to the plugin, and the answer types can be interleaved
+      if (answer.type != _OrthancPluginDatabaseAnswerType_DicomTag &&
+          answer.type != _OrthancPluginDatabaseAnswerType_String &&
+          answer.type != _OrthancPluginDatabaseAnswerType_Metadata)
+      {
+        LOG(ERROR) << "Unhandled type of answer for a compound read of custom index plugin: " << answer.type;
+        throw OrthancException(ErrorCode_Plugin);
+      }
+
+      type_ = answer.type;
+    }
+    else if (type_ == _OrthancPluginDatabaseAnswerType_None)
     {
       type_ = answer.type;
 
@@ -978,6 +1263,15 @@ namespace Orthanc
           answerExportedResources_->clear();
           break;
 
+        case _OrthancPluginDatabaseAnswerType_Metadata:
+          if (answerMetadata_ == NULL)
+          {
+            throw OrthancException(ErrorCode_Plugin);
+          }
+
+          answerMetadata_->clear();
+          break;
+
         default:
           LOG(ERROR) << "Unhandled type of answer for custom index plugin: " << answer.type;
           throw OrthancException(ErrorCode_Plugin);
@@ -1027,6 +1321,18 @@ namespace Orthanc
         break;
       }
 
+      case _OrthancPluginDatabaseAnswerType_Metadata:
+      {
+        if (answer.valueString == NULL)
+        {
+          throw OrthancException(ErrorCode_Plugin);
+        }
+
+        assert(answerMetadata_ != NULL);
+        (*answerMetadata_) [static_cast<MetadataType>(answer.valueInt32)] = answer.valueString;
+        break;
+      }
+
       case _OrthancPluginDatabaseAnswerType_String:
       {
         if (answer.valueString == NULL)
@@ -1034,6 +1340,12 @@ namespace Orthanc
           throw OrthancException(ErrorCode_Plugin);
         }
 
+        if (compoundAnswer_)
+        {
+          answerStrings_.push_back(std::string(answer.valueString));
+          break;
+        }
+
         if (type_ == _OrthancPluginDatabaseAnswerType_None)
         {
           type_ = _OrthancPluginDatabaseAnswerType_String;
@@ -46,6 +46,7 @@ namespace Orthanc
 
     _OrthancPluginDatabaseAnswerType type_;
     OrthancPluginDatabaseBackend backend_;
+    OrthancPluginDatabaseExtensions extensions_;
     void* payload_;
     IServerIndexListener* listener_;
 
@@ -58,8 +59,13 @@ namespace Orthanc
     DicomMap*                      answerDicomMap_;
     std::list<ServerIndexChange>*  answerChanges_;
     std::list<ExportedResource>*   answerExportedResources_;
+    std::map<MetadataType, std::string>*  answerMetadata_;
     bool*                          answerDone_;
 
+    // Set during "lookupResourceContent()", whose answers are of
+    // several types
+    bool                           compoundAnswer_;
+
     OrthancPluginDatabaseContext* GetContext()
     {
       return reinterpret_cast<OrthancPluginDatabaseContext*>(this);
@@ -79,6 +85,9 @@ namespace Orthanc
     OrthancPluginDatabase(const OrthancPluginDatabaseBackend& backend,
                           void *payload);
 
+    void SetExtensions(const OrthancPluginDatabaseExtensions& extensions,
+                       size_t size);
+
     virtual void AddAttachment(int64_t id,
                                const FileInfo& attachment);
 
@@ -159,8 +168,8 @@ namespace Orthanc
     virtual void ListAvailableAttachments(std::list<FileContentType>& target,
                                           int64_t id);
 
-    virtual void LogChange(int64_t internalId,
-                           const ServerIndexChange& change);
+    virtual int64_t LogChange(int64_t internalId,
+                              const ServerIndexChange& change);
 
     virtual void LogExportedResource(const ExportedResource& resource);
     
@@ -210,6 +219,23 @@ namespace Orthanc
 
     virtual SQLite::ITransaction* StartTransaction();
 
+    virtual bool CreateInstance(CreateInstanceResult& result,
+                                int64_t& instanceId,
+                                const std::string& patient,
+                                const std::string& study,
+                                const std::string& series,
+                                const std::string& instance);
+
+    virtual void SetResourcesContent(const ResourcesContent& content);
+
+    virtual void LookupResourceContent(DicomMap& mainDicomTags,
+                                       std::list<std::string>& children,
+                                       std::map<MetadataType, std::string>& metadata,
+                                       int64_t id);
+
+    virtual void GetAllAttachments(std::list<FileInfo>& target,
+                                   int64_t id);
+
     virtual void SetListener(IServerIndexListener& listener)
     {
       listener_ = &listener;
@@ -36,17 +36,30 @@
 #include "../../Core/OrthancException.h"
 #include "../../Core/Toolbox.h"
 #include "../../Core/HttpServer/HttpOutput.h"
+#include "../../Core/ImageFormats/ImageProcessing.h"
 #include "../../Core/ImageFormats/PngWriter.h"
+#if ORTHANC_JPEG_ENABLED == 1
+#include "../../Core/ImageFormats/JpegWriter.h"
+#endif
 #include "../../OrthancServer/ServerToolbox.h"
+#include "../../OrthancServer/Internals/DicomImageDecoder.h"
 #include "../../OrthancServer/OrthancInitialization.h"
 #include "../../Core/MultiThreading/SharedMessageQueue.h"
+#include "PluginsChangesDispatcher.h"
 
 #include <boost/thread.hpp>
 #include <boost/regex.hpp> 
+#include <algorithm>
+#include <set>
 #include <glog/logging.h>
 
 namespace Orthanc
 {
+  // Maximum number of changes that are queued for one "OnChanges"
+  // callback, before reading them from the log of changes
+  static const unsigned int MAX_PENDING_CHANGES = 10000;
+
+
   static OrthancPluginResourceType Convert(ResourceType type)
   {
     switch (type)
@@ -138,6 +151,51 @@ namespace Orthanc
           buffer_.AddChunk(reinterpret_cast<const char*>(buffer), length);
         }
       }
+
+      virtual bool IsChunkedTransferEncoding() const
+      {
+        return false;
+      }
+    };
+
+
+    /**
+     * The object behind the handles of type
+     * "OrthancPluginSharedBuffer". Each handle owns one reference to
+     * the content, that is freed together with the last handle.
+     **/
+    class SharedBuffer
+    {
+    private:
+      boost::shared_ptr<std::string>  content_;
+
+    public:
+      SharedBuffer() :
+        content_(new std::string)
+      {
+      }
+
+      // Copying a handle shares the content, which is never modified
+      // once it has been handed to a plugin
+      SharedBuffer(const SharedBuffer& other) :
+        content_(other.content_)
+      {
+      }
+
+      std::string& GetContent()
+      {
+        return *content_;
+      }
+
+      const void* GetData() const
+      {
+        return content_->empty() ? NULL : content_->c_str();
+      }
+
+      uint64_t GetSize() const
+      {
+        return static_cast<uint64_t>(content_->size());
+      }
     };
 
 
@@ -166,18 +224,95 @@ namespace Orthanc
         }
       }
     };
+
+
+    /**
+     * The target of an image decoding callback, that is seen as an
+     * opaque "OrthancPluginDecodedImage" by the plugins.
+     **/
+    class DecodedImage : public boost::noncopyable
+    {
+    private:
+      ImageBuffer&                  target_;
+      const DicomImageInformation&  info_;
+      bool                          done_;
+
+      bool IsExpectedFormat(PixelFormat format) const
+      {
+        PixelFormat expected;
+        if (info_.ExtractPixelFormat(expected))
+        {
+          return format == expected;
+        }
+
+        // Color images that are not stored as RGB (e.g. YBR) must be
+        // converted to RGB by the decoder
+        return (format == PixelFormat_RGB24 &&
+                info_.GetChannelCount() == 3 &&
+                info_.GetBitsStored() == 8 &&
+                !info_.IsSigned());
+      }
+
+    public:
+      DecodedImage(ImageBuffer& target,
+                   const DicomImageInformation& info) : 
+        target_(target),
+        info_(info),
+        done_(false)
+      {
+      }
+
+      bool IsDone() const
+      {
+        return done_;
+      }
+
+      void Set(const ImageAccessor& source)
+      {
+        if (source.GetWidth() != info_.GetWidth() ||
+            source.GetHeight() != info_.GetHeight())
+        {
+          LOG(ERROR) << "The image decoded by a plugin does not have the size of the DICOM frame";
+          throw OrthancException(ErrorCode_IncompatibleImageSize);
+        }
+
+        if (!IsExpectedFormat(source.GetFormat()))
+        {
+          LOG(ERROR) << "The image decoded by a plugin does not have the format of the DICOM frame";
+          throw OrthancException(ErrorCode_IncompatibleImageFormat);
+        }
+
+        target_.SetFormat(source.GetFormat());
+        target_.SetWidth(source.GetWidth());
+        target_.SetHeight(source.GetHeight());
+
+        ImageAccessor accessor = target_.GetAccessor();
+        ImageProcessing::Copy(accessor, source);
+
+        done_ = true;
+      }
+    };
   }
 
 
 
-  struct OrthancPlugins::PImpl
+  struct OrthancPlugins::PImpl : public PluginsChangesDispatcher::IChangesLog
   {
     typedef std::pair<std::string, _OrthancPluginProperty>  Property;
 
-    typedef std::pair<boost::regex*, OrthancPluginRestCallback> RestCallback;
+    struct RestCallback
+    {
+      boost::regex*              regex_;
+      OrthancPluginRestCallback  callback_;
+      bool                       lock_;  // Whether "callbackMutex_" is taken
+    };
+
     typedef std::list<RestCallback>  RestCallbacks;
     typedef std::list<OrthancPluginOnStoredInstanceCallback>  OnStoredCallbacks;
     typedef std::list<OrthancPluginOnChangeCallback>  OnChangeCallbacks;
+    typedef std::list<PluginsChangesDispatcher*>  ChangesDispatchers;
+    typedef std::pair<OrthancPluginDecodeImageCallback, std::set<std::string> >  DecodeImageCallback;
+    typedef std::list<DecodeImageCallback>  DecodeImageCallbacks;
     typedef std::map<Property, std::string>  Properties;
 
     ServerContext* context_;
@@ -185,6 +320,8 @@ namespace Orthanc
     OrthancRestApi* restApi_;
     OnStoredCallbacks  onStoredCallbacks_;
     OnChangeCallbacks  onChangeCallbacks_;
+    ChangesDispatchers  changesDispatchers_;
+    DecodeImageCallbacks  decodeImageCallbacks_;
     bool hasStorageArea_;
     _OrthancPluginRegisterStorageArea storageArea_;
     boost::recursive_mutex callbackMutex_;
@@ -208,6 +345,49 @@ namespace Orthanc
     }
 
 
+    // Used by the "OnChanges" callbacks that are too slow to keep
+    // up with their queue of changes
+    virtual bool ReadChanges(std::list<PluginsChangesDispatcher::Change>& target,
+                             int64_t& last,
+                             int64_t since,
+                             size_t maxResults)
+    {
+      target.clear();
+      last = since;
+
+      if (context_ == NULL)
+      {
+        return true;
+      }
+
+      std::list<ServerIndexChange> changes;
+      bool done;
+      context_->GetIndex().GetChanges(changes, done, since, static_cast<unsigned int>(maxResults));
+
+      for (std::list<ServerIndexChange>::const_iterator 
+             it = changes.begin(); it != changes.end(); ++it)
+      {
+        last = it->GetSeq();
+
+        try
+        {
+          PluginsChangesDispatcher::Change change;
+          change.seq_ = it->GetSeq();
+          change.changeType_ = Convert(it->GetChangeType());
+          change.resourceType_ = Convert(it->GetResourceType());
+          change.resourceId_ = it->GetPublicId();
+          change.date_ = it->GetDate();
+          target.push_back(change);
+        }
+        catch (OrthancException&)
+        {
+          // This change type or resource type is not supported by the plugin SDK
+        }
+      }
+
+      return done;
+    }
+
     static void ChangeThread(PImpl* that)
     {
       while (!that->done_)
@@ -269,7 +449,18 @@ namespace Orthanc
          it != pimpl_->restCallbacks_.end(); ++it)
     {
       // Delete the regular expression associated with this callback
-      delete it->first;
+      delete it->regex_;
+    }
+
+    for (PImpl::ChangesDispatchers::iterator it = pimpl_->changesDispatchers_.begin(); 
+         it != pimpl_->changesDispatchers_.end(); ++it)
+    {
+      delete *it;
+    }
+
+    if (!pimpl_->decodeImageCallbacks_.empty())
+    {
+      DicomImageDecoder::UnregisterExternalDecoder(*this);
     }
   }
 
@@ -280,6 +471,12 @@ namespace Orthanc
     {
       pimpl_->done_ = true;
       pimpl_->changeThread_.join();
+
+      for (PImpl::ChangesDispatchers::iterator it = pimpl_->changesDispatchers_.begin(); 
+           it != pimpl_->changesDispatchers_.end(); ++it)
+      {
+        (*it)->Stop();
+      }
     }
   }
 
@@ -327,6 +524,7 @@ namespace Orthanc
   {
     std::string flatUri = Toolbox::FlattenUri(uri);
     OrthancPluginRestCallback callback = NULL;
+    bool mustLock = true;
 
     std::vector<std::string> groups;
     std::vector<const char*> cgroups;
@@ -339,9 +537,10 @@ namespace Orthanc
       // Check whether the regular expression associated to this
       // callback matches the URI
       boost::cmatch what;
-      if (boost::regex_match(flatUri.c_str(), what, *(it->first)))
+      if (boost::regex_match(flatUri.c_str(), what, *(it->regex_)))
       {
-        callback = it->second;
+        callback = it->callback_;
+        mustLock = it->lock_;
 
         // Extract the value of the free parameters of the regular expression
         if (what.size() > 1)
@@ -419,27 +618,57 @@ namespace Orthanc
     assert(callback != NULL);
     int32_t error;
 
+    if (mustLock)
     {
       boost::recursive_mutex::scoped_lock lock(pimpl_->callbackMutex_);
       error = callback(reinterpret_cast<OrthancPluginRestOutput*>(&output), 
                        flatUri.c_str(), 
                        &request);
     }
+    else
+    {
+      // The callback is reentrant
+      error = callback(reinterpret_cast<OrthancPluginRestOutput*>(&output), 
+                       flatUri.c_str(), 
+                       &request);
+    }
+
+    const bool isStreamed = (output.IsWritingMultipart() ||
+                             output.IsWritingChunks());
+
+    if (isStreamed && mustLock)
+    {
+      LOG(WARNING) << "The plugin callback on URI " << flatUri << " has streamed its answer while "
+                   << "holding the global lock of the plugins, use OrthancPluginRegisterRestCallbackNoLock()";
+    }
 
     if (error < 0)
     {
       LOG(ERROR) << "Plugin callback failed with error code " << error;
-      return false;
+
+      // A streamed answer has already been sent to the client: It is
+      // too late to report the error through the HTTP status. The
+      // answer is not terminated, so that the client sees that it is
+      // truncated.
+      return isStreamed;
     }
-    else
+
+    if (error > 0)
     {
-      if (error > 0)
-      {
-        LOG(WARNING) << "Plugin callback finished with warning code " << error;
-      }
+      LOG(WARNING) << "Plugin callback finished with warning code " << error;
+    }
 
-      return true;
+    // Close the streamed answer, if the plugin has started one
+    if (output.IsWritingMultipart())
+    {
+      output.CloseMultipart();
     }
+    else if (output.IsWritingChunks())
+    {
+      output.CloseChunkedTransfer();
+    }
+
+    return true;
   }
 
 
@@ -463,7 +692,26 @@ namespace Orthanc
   {
     try
     {
-      pimpl_->pendingChanges_.Enqueue(new PendingChange(change));
+      if (!pimpl_->onChangeCallbacks_.empty())
+      {
+        pimpl_->pendingChanges_.Enqueue(new PendingChange(change));
+      }
+
+      if (!pimpl_->changesDispatchers_.empty())
+      {
+        OrthancPluginChangeEvent event;
+        event.seq = change.GetSeq();
+        event.changeType = Convert(change.GetChangeType());
+        event.resourceType = Convert(change.GetResourceType());
+        event.resourceId = change.GetPublicId().c_str();
+        event.date = change.GetDate().c_str();
+
+        for (PImpl::ChangesDispatchers::iterator it = pimpl_->changesDispatchers_.begin(); 
+             it != pimpl_->changesDispatchers_.end(); ++it)
+        {
+          (*it)->Enqueue(event);
+        }
+      }
     }
     catch (OrthancException&)
     {
@@ -514,13 +762,20 @@ namespace Orthanc
   }
 
 
-  void OrthancPlugins::RegisterRestCallback(const void* parameters)
+  void OrthancPlugins::RegisterRestCallback(const void* parameters,
+                                            bool lock)
   {
     const _OrthancPluginRestCallback& p = 
       *reinterpret_cast<const _OrthancPluginRestCallback*>(parameters);
 
-    LOG(INFO) << "Plugin has registered a REST callback on: " << p.pathRegularExpression;
-    pimpl_->restCallbacks_.push_back(std::make_pair(new boost::regex(p.pathRegularExpression), p.callback));
+    LOG(INFO) << "Plugin has registered a REST callback " << (lock ? "with" : "without")
+              << " locking on: " << p.pathRegularExpression;
+
+    PImpl::RestCallback callback;
+    callback.regex_ = new boost::regex(p.pathRegularExpression);
+    callback.callback_ = p.callback;
+    callback.lock_ = lock;
+    pimpl_->restCallbacks_.push_back(callback);
   }
 
 
@@ -545,6 +800,57 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::RegisterOnChangesCallback(const void* parameters)
+  {
+    const _OrthancPluginOnChangesCallback& p = 
+      *reinterpret_cast<const _OrthancPluginOnChangesCallback*>(parameters);
+
+    LOG(INFO) << "Plugin has registered an OnChanges callback (batches of at most "
+              << p.maxBatchSize << " changes, latency of " << p.maxLatency << "ms)";
+
+    // Beyond this number of pending changes, the changes are read
+    // again from the log once the plugin has caught up
+    const size_t maxQueueSize = std::max(static_cast<size_t>(MAX_PENDING_CHANGES), 
+                                         static_cast<size_t>(p.maxBatchSize));
+
+    std::auto_ptr<PluginsChangesDispatcher> dispatcher
+      (new PluginsChangesDispatcher(p.callback, p.maxBatchSize, p.maxLatency, maxQueueSize, pimpl_.get()));
+
+    pimpl_->changesDispatchers_.push_back(dispatcher.release());
+  }
+
+
+  void OrthancPlugins::RegisterDecodeImageCallback(const void* parameters)
+  {
+    const _OrthancPluginDecodeImageCallback& p = 
+      *reinterpret_cast<const _OrthancPluginDecodeImageCallback*>(parameters);
+
+    LOG(INFO) << "Plugin has registered a callback to decode DICOM images";
+
+    // The plugins register their callbacks during their
+    // initialization, thus before any image is decoded: The list of
+    // callbacks is read without locking afterwards
+    if (pimpl_->decodeImageCallbacks_.empty())
+    {
+      DicomImageDecoder::RegisterExternalDecoder(*this);
+    }
+
+    std::set<std::string> transferSyntaxes;
+    for (uint32_t i = 0; i < p.countTransferSyntaxes; i++)
+    {
+      if (p.transferSyntaxes == NULL ||
+          p.transferSyntaxes[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      transferSyntaxes.insert(p.transferSyntaxes[i]);
+    }
+
+    pimpl_->decodeImageCallbacks_.push_back(std::make_pair(p.callback, transferSyntaxes));
+  }
+
+
 
   void OrthancPlugins::AnswerBuffer(const void* parameters)
   {
@@ -557,6 +863,63 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::StreamAnswer(_OrthancPluginService service,
+                                    const void* parameters)
+  {
+    switch (service)
+    {
+      case _OrthancPluginService_StartStreamAnswer:
+      case _OrthancPluginService_StartMultipartAnswer:
+      {
+        const _OrthancPluginStartStreamAnswer& p = 
+          *reinterpret_cast<const _OrthancPluginStartStreamAnswer*>(parameters);
+
+        HttpOutput* translatedOutput = reinterpret_cast<HttpOutput*>(p.output);
+
+        if (service == _OrthancPluginService_StartMultipartAnswer)
+        {
+          translatedOutput->StartMultipart(p.subType == NULL ? "" : p.subType,
+                                           p.contentType == NULL ? "" : p.contentType);
+        }
+        else
+        {
+          if (p.contentType != NULL)
+          {
+            translatedOutput->SetContentType(p.contentType);
+          }
+
+          translatedOutput->StartChunkedTransfer();
+        }
+
+        return;
+      }
+
+      case _OrthancPluginService_SendStreamChunk:
+      case _OrthancPluginService_SendMultipartItem:
+      {
+        const _OrthancPluginAnswerBuffer& p = 
+          *reinterpret_cast<const _OrthancPluginAnswerBuffer*>(parameters);
+
+        HttpOutput* translatedOutput = reinterpret_cast<HttpOutput*>(p.output);
+
+        if (service == _OrthancPluginService_SendMultipartItem)
+        {
+          translatedOutput->SendMultipartItem(p.answer, p.answerSize);
+        }
+        else
+        {
+          translatedOutput->SendChunk(p.answer, p.answerSize);
+        }
+
+        return;
+      }
+
+      default:
+        throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+
+
   void OrthancPlugins::Redirect(const void* parameters)
   {
     const _OrthancPluginOutputPlusArgument& p = 
@@ -617,42 +980,40 @@ namespace Orthanc
   }
 
 
-  void OrthancPlugins::CompressAndAnswerPngImage(const void* parameters)
+  static PixelFormat Convert(OrthancPluginPixelFormat format)
   {
-    const _OrthancPluginCompressAndAnswerPngImage& p = 
-      *reinterpret_cast<const _OrthancPluginCompressAndAnswerPngImage*>(parameters);
-
-    HttpOutput* translatedOutput = reinterpret_cast<HttpOutput*>(p.output);
-
-    PixelFormat format;
-    switch (p.format)
+    switch (format)
     {
       case OrthancPluginPixelFormat_Grayscale8:  
-        format = PixelFormat_Grayscale8;
-        break;
+        return PixelFormat_Grayscale8;
 
       case OrthancPluginPixelFormat_Grayscale16:  
-        format = PixelFormat_Grayscale16;
-        break;
+        return PixelFormat_Grayscale16;
 
       case OrthancPluginPixelFormat_SignedGrayscale16:  
-        format = PixelFormat_SignedGrayscale16;
-        break;
+        return PixelFormat_SignedGrayscale16;
 
       case OrthancPluginPixelFormat_RGB24:  
-        format = PixelFormat_RGB24;
-        break;
+        return PixelFormat_RGB24;
 
       case OrthancPluginPixelFormat_RGBA32:  
-        format = PixelFormat_RGBA32;
-        break;
+        return PixelFormat_RGBA32;
 
       default:
         throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
+  }
+
+
+  void OrthancPlugins::CompressAndAnswerPngImage(const void* parameters)
+  {
+    const _OrthancPluginCompressAndAnswerPngImage& p = 
+      *reinterpret_cast<const _OrthancPluginCompressAndAnswerPngImage*>(parameters);
+
+    HttpOutput* translatedOutput = reinterpret_cast<HttpOutput*>(p.output);
 
     ImageAccessor accessor;
-    accessor.AssignReadOnly(format, p.width, p.height, p.pitch, p.buffer);
+    accessor.AssignReadOnly(Convert(p.format), p.width, p.height, p.pitch, p.buffer);
 
     PngWriter writer;
     std::string png;
@@ -663,6 +1024,119 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::CompressAndAnswerJpegImage(const void* parameters)
+  {
+#if ORTHANC_JPEG_ENABLED == 1
+    const _OrthancPluginCompressAndAnswerJpegImage& p = 
+      *reinterpret_cast<const _OrthancPluginCompressAndAnswerJpegImage*>(parameters);
+
+    HttpOutput* translatedOutput = reinterpret_cast<HttpOutput*>(p.output);
+
+    if (p.quality > 100)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    ImageAccessor accessor;
+    accessor.AssignReadOnly(Convert(p.format), p.width, p.height, p.pitch, p.buffer);
+
+    JpegWriter writer;
+    writer.SetQuality(static_cast<uint8_t>(p.quality));
+
+    std::string jpeg;
+    writer.WriteToMemory(jpeg, accessor);
+
+    translatedOutput->SetContentType("image/jpeg");
+    translatedOutput->SendBody(jpeg);
+#else
+    LOG(ERROR) << "This version of Orthanc was built without JPEG support";
+    throw OrthancException(ErrorCode_NotImplemented);
+#endif
+  }
+
+
+  void OrthancPlugins::SetDecodedImage(const void* parameters)
+  {
+    const _OrthancPluginSetDecodedImage& p = 
+      *reinterpret_cast<const _OrthancPluginSetDecodedImage*>(parameters);
+
+    if (p.target == NULL)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    ImageAccessor accessor;
+    accessor.AssignReadOnly(Convert(p.format), p.width, p.height, p.pitch, p.buffer);
+
+    reinterpret_cast<DecodedImage*>(p.target)->Set(accessor);
+  }
+
+
+  bool OrthancPlugins::IsTransferSyntaxSupported(const std::string& transferSyntax)
+  {
+    for (PImpl::DecodeImageCallbacks::const_iterator 
+           callback = pimpl_->decodeImageCallbacks_.begin();
+         callback != pimpl_->decodeImageCallbacks_.end(); ++callback)
+    {
+      if (callback->second.find(transferSyntax) != callback->second.end())
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  bool OrthancPlugins::Decode(ImageBuffer& target,
+                              const DicomImageInformation& info,
+                              const std::string& transferSyntax,
+                              unsigned int frameIndex,
+                              const void* frame,
+                              size_t size)
+  {
+    OrthancPluginFrameInformation description;
+    description.transferSyntax = transferSyntax.c_str();
+    description.frameIndex = frameIndex;
+    description.width = info.GetWidth();
+    description.height = info.GetHeight();
+    description.samplesPerPixel = info.GetChannelCount();
+    description.bitsAllocated = info.GetBitsAllocated();
+    description.bitsStored = info.GetBitsStored();
+    description.highBit = info.GetHighBit();
+    description.isSigned = info.IsSigned();
+    description.isPlanar = info.IsPlanar();
+    description.photometricInterpretation = 
+      EnumerationToString(info.GetPhotometricInterpretation());
+
+    for (PImpl::DecodeImageCallbacks::const_iterator 
+           callback = pimpl_->decodeImageCallbacks_.begin();
+         callback != pimpl_->decodeImageCallbacks_.end(); ++callback)
+    {
+      if (callback->second.find(transferSyntax) == callback->second.end())
+      {
+        continue;
+      }
+
+      DecodedImage decoded(target, info);
+
+      int32_t error = (callback->first) (reinterpret_cast<OrthancPluginDecodedImage*>(&decoded),
+                                         &description, frame, static_cast<uint32_t>(size));
+      if (error != 0)
+      {
+        LOG(ERROR) << "Error in the callback of a plugin while decoding a DICOM image ("
+                   << transferSyntax << "), trying the next decoders";
+      }
+      else if (decoded.IsDone())
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
   void OrthancPlugins::GetDicomForInstance(const void* parameters)
   {
     assert(pimpl_->context_ != NULL);
@@ -676,27 +1150,24 @@ namespace Orthanc
   }
 
 
-  void OrthancPlugins::RestApiGet(const void* parameters,
-                                  bool afterPlugins)
+  void OrthancPlugins::RestApiGetInternal(std::string& result,
+                                          const char* uriString,
+                                          bool afterPlugins)
   {
-    const _OrthancPluginRestApiGet& p = 
-      *reinterpret_cast<const _OrthancPluginRestApiGet*>(parameters);
-        
     HttpHandler::Arguments headers;  // No HTTP header
     std::string body;  // No body for a GET request
 
     UriComponents uri;
     HttpHandler::GetArguments getArguments;
-    HttpHandler::ParseGetQuery(uri, getArguments, p.uri);
+    HttpHandler::ParseGetQuery(uri, getArguments, uriString);
 
     StringHttpOutput stream;
     HttpOutput http(stream, false /* no keep alive */);
 
-    LOG(INFO) << "Plugin making REST GET call on URI " << p.uri
+    LOG(INFO) << "Plugin making REST GET call on URI " << uriString
               << (afterPlugins ? " (after plugins)" : " (built-in API)");
 
     bool ok = false;
-    std::string result;
 
     if (afterPlugins)
     {
@@ -712,7 +1183,6 @@ namespace Orthanc
     if (ok)
     {
       stream.GetOutput(result);
-      CopyToMemoryBuffer(*p.target, result);
     }
     else
     {
@@ -721,6 +1191,82 @@ namespace Orthanc
   }
 
 
+  void OrthancPlugins::RestApiGet(const void* parameters,
+                                  bool afterPlugins)
+  {
+    const _OrthancPluginRestApiGet& p = 
+      *reinterpret_cast<const _OrthancPluginRestApiGet*>(parameters);
+
+    std::string result;
+    RestApiGetInternal(result, p.uri, afterPlugins);
+    CopyToMemoryBuffer(*p.target, result);
+  }
+
+
+  void OrthancPlugins::GetSharedAttachment(const void* parameters)
+  {
+    assert(pimpl_->context_ != NULL);
+
+    const _OrthancPluginGetSharedAttachment& p = 
+      *reinterpret_cast<const _OrthancPluginGetSharedAttachment*>(parameters);
+
+    std::auto_ptr<SharedBuffer> buffer(new SharedBuffer);
+    pimpl_->context_->ReadFile(buffer->GetContent(), p.instanceId,
+                               static_cast<FileContentType>(p.contentType));
+
+    *p.target = reinterpret_cast<OrthancPluginSharedBuffer*>(buffer.release());
+  }
+
+
+  void OrthancPlugins::RestApiGetShared(const void* parameters)
+  {
+    const _OrthancPluginRestApiGetShared& p = 
+      *reinterpret_cast<const _OrthancPluginRestApiGetShared*>(parameters);
+
+    std::auto_ptr<SharedBuffer> buffer(new SharedBuffer);
+    RestApiGetInternal(buffer->GetContent(), p.uri, p.afterPlugins != 0);
+
+    *p.target = reinterpret_cast<OrthancPluginSharedBuffer*>(buffer.release());
+  }
+
+
+  void OrthancPlugins::AccessSharedBuffer(_OrthancPluginService service,
+                                          const void* parameters)
+  {
+    const _OrthancPluginAccessSharedBuffer& p = 
+      *reinterpret_cast<const _OrthancPluginAccessSharedBuffer*>(parameters);
+
+    if (p.buffer == NULL)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    SharedBuffer& buffer = *reinterpret_cast<SharedBuffer*>(p.buffer);
+
+    switch (service)
+    {
+      case _OrthancPluginService_GetSharedBufferData:
+        *p.resultData = buffer.GetData();
+        return;
+
+      case _OrthancPluginService_GetSharedBufferSize:
+        *p.resultSize = buffer.GetSize();
+        return;
+
+      case _OrthancPluginService_AcquireSharedBuffer:
+        *p.resultBuffer = reinterpret_cast<OrthancPluginSharedBuffer*>(new SharedBuffer(buffer));
+        return;
+
+      case _OrthancPluginService_ReleaseSharedBuffer:
+        delete &buffer;
+        return;
+
+      default:
+        throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+
+
   void OrthancPlugins::RestApiPostPut(bool isPost, 
                                       const void* parameters,
                                       bool afterPlugins)
@@ -967,9 +1513,7 @@ namespace Orthanc
         }
         else
         {
-          Json::Value simplified;
-          SimplifyTags(simplified, instance.GetJson());
-          s = writer.write(simplified);
+          s = writer.write(instance.GetSimplifiedJson());
         }
 
         *p.resultStringToFree = CopyString(s);
@@ -1009,7 +1553,11 @@ namespace Orthanc
       }
 
       case _OrthancPluginService_RegisterRestCallback:
-        RegisterRestCallback(parameters);
+        RegisterRestCallback(parameters, true);
+        return true;
+
+      case _OrthancPluginService_RegisterRestCallbackNoLock:
+        RegisterRestCallback(parameters, false);
         return true;
 
       case _OrthancPluginService_RegisterOnStoredInstanceCallback:
@@ -1020,6 +1568,18 @@ namespace Orthanc
         RegisterOnChangeCallback(parameters);
         return true;
 
+      case _OrthancPluginService_RegisterOnChangesCallback:
+        RegisterOnChangesCallback(parameters);
+        return true;
+
+      case _OrthancPluginService_RegisterDecodeImageCallback:
+        RegisterDecodeImageCallback(parameters);
+        return true;
+
+      case _OrthancPluginService_SetDecodedImage:
+        SetDecodedImage(parameters);
+        return true;
+
       case _OrthancPluginService_AnswerBuffer:
         AnswerBuffer(parameters);
         return true;
@@ -1028,6 +1588,17 @@ namespace Orthanc
         CompressAndAnswerPngImage(parameters);
         return true;
 
+      case _OrthancPluginService_StartStreamAnswer:
+      case _OrthancPluginService_SendStreamChunk:
+      case _OrthancPluginService_StartMultipartAnswer:
+      case _OrthancPluginService_SendMultipartItem:
+        StreamAnswer(service, parameters);
+        return true;
+
+      case _OrthancPluginService_CompressAndAnswerJpegImage:
+        CompressAndAnswerJpegImage(parameters);
+        return true;
+
       case _OrthancPluginService_GetDicomForInstance:
         GetDicomForInstance(parameters);
         return true;
@@ -1040,6 +1611,21 @@ namespace Orthanc
         RestApiGet(parameters, true);
         return true;
 
+      case _OrthancPluginService_GetSharedAttachment:
+        GetSharedAttachment(parameters);
+        return true;
+
+      case _OrthancPluginService_RestApiGetShared:
+        RestApiGetShared(parameters);
+        return true;
+
+      case _OrthancPluginService_GetSharedBufferData:
+      case _OrthancPluginService_GetSharedBufferSize:
+      case _OrthancPluginService_AcquireSharedBuffer:
+      case _OrthancPluginService_ReleaseSharedBuffer:
+        AccessSharedBuffer(service, parameters);
+        return true;
+
       case _OrthancPluginService_RestApiPost:
         RestApiPostPut(true, parameters, false);
         return true;
@@ -1189,6 +1775,24 @@ namespace Orthanc
         return true;
       }
 
+      case _OrthancPluginService_RegisterDatabaseBackendV2:
+      {
+        LOG(INFO) << "Plugin has registered a custom database back-end with compound operations";
+        const _OrthancPluginRegisterDatabaseBackendV2& p =
+          *reinterpret_cast<const _OrthancPluginRegisterDatabaseBackendV2*>(parameters);
+
+        std::auto_ptr<OrthancPluginDatabase> database(new OrthancPluginDatabase(*p.backend, p.payload));
+        if (p.extensions != NULL)
+        {
+          database->SetExtensions(*p.extensions, p.extensionsSize);
+        }
+
+        pimpl_->database_.reset(database.release());
+        *(p.result) = reinterpret_cast<OrthancPluginDatabaseContext*>(pimpl_->database_.get());
+
+        return true;
+      }
+
       case _OrthancPluginService_DatabaseAnswer:
       {
         const _OrthancPluginDatabaseAnswer& p =
@@ -1236,6 +1840,13 @@ namespace Orthanc
     return pimpl_->hasStorageArea_;
   }
   
+  bool OrthancPlugins::HasStoredInstanceCallbacks() const
+  {
+    // The callbacks are registered during the initialization of the
+    // plugins, thus before any instance is received
+    return !pimpl_->onStoredCallbacks_.empty();
+  }
+  
   bool OrthancPlugins::HasDatabase() const
   {
     return pimpl_->database_.get() != NULL;
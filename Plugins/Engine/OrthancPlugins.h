@@ -36,6 +36,7 @@
 #include "../../Core/HttpServer/HttpHandler.h"
 #include "../../OrthancServer/ServerContext.h"
 #include "../../OrthancServer/OrthancRestApi/OrthancRestApi.h"
+#include "../../OrthancServer/IDicomImageDecoder.h"
 #include "OrthancPluginDatabase.h"
 
 #include <list>
@@ -43,29 +44,55 @@
 
 namespace Orthanc
 {
-  class OrthancPlugins : public HttpHandler, public IPluginServiceProvider
+  class OrthancPlugins : 
+    public HttpHandler, 
+    public IPluginServiceProvider,
+    public IDicomImageDecoder
   {
   private:
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
 
-    void RegisterRestCallback(const void* parameters);
+    void RegisterRestCallback(const void* parameters,
+                              bool lock);
 
     void RegisterOnStoredInstanceCallback(const void* parameters);
 
     void RegisterOnChangeCallback(const void* parameters);
 
+    void RegisterOnChangesCallback(const void* parameters);
+
+    void RegisterDecodeImageCallback(const void* parameters);
+
+    void SetDecodedImage(const void* parameters);
+
     void AnswerBuffer(const void* parameters);
 
+    void StreamAnswer(_OrthancPluginService service,
+                      const void* parameters);
+
     void Redirect(const void* parameters);
 
     void CompressAndAnswerPngImage(const void* parameters);
 
+    void CompressAndAnswerJpegImage(const void* parameters);
+
     void GetDicomForInstance(const void* parameters);
 
+    void RestApiGetInternal(std::string& result,
+                            const char* uri,
+                            bool afterPlugins);
+
     void RestApiGet(const void* parameters,
                     bool afterPlugins);
 
+    void GetSharedAttachment(const void* parameters);
+
+    void RestApiGetShared(const void* parameters);
+
+    void AccessSharedBuffer(_OrthancPluginService service,
+                            const void* parameters);
+
     void RestApiPostPut(bool isPost, 
                         const void* parameters,
                         bool afterPlugins);
@@ -108,12 +135,23 @@ namespace Orthanc
     void SignalStoredInstance(DicomInstanceToStore& instance,
                               const std::string& instanceId);
 
+    virtual bool IsTransferSyntaxSupported(const std::string& transferSyntax);
+
+    virtual bool Decode(ImageBuffer& target,
+                        const DicomImageInformation& info,
+                        const std::string& transferSyntax,
+                        unsigned int frameIndex,
+                        const void* frame,
+                        size_t size);
+
     void SetOrthancRestApi(OrthancRestApi& restApi);
 
     void ResetOrthancRestApi();
 
     bool HasStorageArea() const;
 
+    bool HasStoredInstanceCallbacks() const;
+
     IStorageArea* GetStorageArea();  // To be freed after use
 
     bool HasDatabase() const;
@@ -0,0 +1,259 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PluginsChangesDispatcher.h"
+
+#include "../../Core/OrthancException.h"
+
+#include <algorithm>
+#include <glog/logging.h>
+
+namespace Orthanc
+{
+  // Waits for a full batch, or for the latency to expire. Returns
+  // "false" iff the dispatcher is stopped, the queue is empty and
+  // there is no change to be read from the log. The batch can be
+  // empty while catching up.
+  bool PluginsChangesDispatcher::DequeueBatch(std::vector<Change>& batch)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    while (queue_.empty() && !gap_ && !done_)
+    {
+      changed_.wait(lock);
+    }
+
+    if (queue_.empty())
+    {
+      if (gap_)
+      {
+        // The queue before the gap is delivered: Read the log, which
+        // might take time, without holding the mutex
+        lock.unlock();
+        CatchUp(batch);
+        return true;
+      }
+
+      return false;
+    }
+
+    boost::system_time deadline = (boost::get_system_time() + 
+                                   boost::posix_time::milliseconds(maxLatency_));
+
+    while (!done_ &&
+           queue_.size() < maxBatchSize_ &&
+           changed_.timed_wait(lock, deadline))
+    {
+    }
+
+    size_t count = std::min(queue_.size(), maxBatchSize_);
+    batch.assign(queue_.begin(), queue_.begin() + count);
+    queue_.erase(queue_.begin(), queue_.begin() + count);
+
+    return true;
+  }
+
+
+  void PluginsChangesDispatcher::CatchUp(std::vector<Change>& batch)
+  {
+    int64_t since;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      since = gapSince_;
+    }
+
+    std::list<Change> changes;
+    int64_t last = since;
+    bool end;
+
+    try
+    {
+      end = log_->ReadChanges(changes, last, since, maxBatchSize_);
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "Cannot read the log of changes for the OnChanges callback of a plugin, "
+                 << "some changes are lost: " << e.What();
+      end = true;
+    }
+
+    batch.assign(changes.begin(), changes.end());
+
+    boost::mutex::scoped_lock lock(mutex_);
+    gapSince_ = last;
+    lastRead_ = last;
+
+    // The changes are signaled after their transaction is committed:
+    // All the signaled changes are already in the log
+    if (end &&
+        latestSignaled_ <= last)
+    {
+      gap_ = false;
+      LOG(INFO) << "The OnChanges callback of a plugin has caught up with the log of changes";
+    }
+  }
+
+
+  void PluginsChangesDispatcher::Worker(PluginsChangesDispatcher* that)
+  {
+    std::vector<Change> batch;
+    std::vector<OrthancPluginChangeEvent> events;
+
+    while (that->DequeueBatch(batch))
+    {
+      if (batch.empty())
+      {
+        continue;
+      }
+
+      events.resize(batch.size());
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        events[i].seq = batch[i].seq_;
+        events[i].changeType = batch[i].changeType_;
+        events[i].resourceType = batch[i].resourceType_;
+        events[i].resourceId = batch[i].resourceId_.c_str();
+        events[i].date = batch[i].date_.c_str();
+      }
+
+      if (that->callback_(&events[0], static_cast<uint32_t>(events.size())) != 0)
+      {
+        LOG(ERROR) << "Error in the OnChanges callback of a plugin";
+      }
+    }
+  }
+
+
+  PluginsChangesDispatcher::PluginsChangesDispatcher(OrthancPluginOnChangesCallback callback,
+                                                     size_t maxBatchSize,
+                                                     unsigned int maxLatency,
+                                                     size_t maxQueueSize,
+                                                     IChangesLog* log) :
+    callback_(callback),
+    maxBatchSize_(maxBatchSize),
+    maxLatency_(maxLatency),
+    maxQueueSize_(maxQueueSize),
+    log_(log),
+    done_(false),
+    gap_(false),
+    gapSince_(0),
+    latestSignaled_(0),
+    lastRead_(-1)
+  {
+    if (maxBatchSize == 0 ||
+        maxQueueSize == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    thread_ = boost::thread(Worker, this);
+  }
+
+
+  PluginsChangesDispatcher::~PluginsChangesDispatcher()
+  {
+    Stop();
+  }
+
+
+  void PluginsChangesDispatcher::Enqueue(const OrthancPluginChangeEvent& change)
+  {
+    Change item;
+    item.seq_ = change.seq;
+    item.changeType_ = change.changeType;
+    item.resourceType_ = change.resourceType;
+    item.resourceId_ = change.resourceId;
+    item.date_ = change.date;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      const bool isLogged = (item.seq_ >= 0);
+
+      if (isLogged &&
+          gap_)
+      {
+        // This change will be read from the log
+        latestSignaled_ = std::max(latestSignaled_, item.seq_);
+        return;
+      }
+
+      if (isLogged &&
+          item.seq_ <= lastRead_)
+      {
+        // Already read from the log while catching up
+        return;
+      }
+
+      if (queue_.size() >= maxQueueSize_ ||
+          gap_)
+      {
+        if (isLogged &&
+            log_ != NULL)
+        {
+          LOG(WARNING) << "The OnChanges callback of a plugin is too slow, "
+                       << "its next changes will be read from the log of changes";
+          gap_ = true;
+          gapSince_ = item.seq_ - 1;
+          latestSignaled_ = item.seq_;
+        }
+        else
+        {
+          LOG(WARNING) << "The OnChanges callback of a plugin is too slow, dropping a change";
+        }
+
+        return;
+      }
+
+      queue_.push_back(item);
+    }
+
+    changed_.notify_one();
+  }
+
+
+  void PluginsChangesDispatcher::Stop()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      done_ = true;
+    }
+
+    changed_.notify_one();
+
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+}
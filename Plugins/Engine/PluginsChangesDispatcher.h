@@ -0,0 +1,124 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../Include/OrthancCPlugin.h"
+
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Delivers the changes to one batched "OnChanges" callback, from
+   * a thread that is dedicated to this callback.
+   *
+   * The queue of pending changes is bounded. If the callback is too
+   * slow and the queue is full, the dispatcher stops queuing the
+   * changes, and catches up later by reading them from the log of
+   * changes, starting after the last queued change. The changes that
+   * are not logged (such as "Deleted") are dropped in this case.
+   **/
+  class PluginsChangesDispatcher : public boost::noncopyable
+  {
+  public:
+    struct Change
+    {
+      int64_t                    seq_;
+      OrthancPluginChangeType    changeType_;
+      OrthancPluginResourceType  resourceType_;
+      std::string                resourceId_;
+      std::string                date_;
+    };
+
+    class IChangesLog : public boost::noncopyable
+    {
+    public:
+      virtual ~IChangesLog()
+      {
+      }
+
+      // Reads at most "maxResults" changes whose sequence number is
+      // above "since". "last" receives the sequence number of the
+      // last change that was read, even if it was not put in
+      // "target". Returns "true" iff the end of the log is reached.
+      virtual bool ReadChanges(std::list<Change>& target,
+                               int64_t& last,
+                               int64_t since,
+                               size_t maxResults) = 0;
+    };
+
+  private:
+    OrthancPluginOnChangesCallback  callback_;
+    size_t                          maxBatchSize_;
+    unsigned int                    maxLatency_;
+    size_t                          maxQueueSize_;
+    IChangesLog*                    log_;
+    boost::mutex                    mutex_;
+    boost::condition_variable       changed_;
+    std::deque<Change>              queue_;
+    bool                            done_;
+    bool                            gap_;             // Changes must be read from the log
+    int64_t                         gapSince_;        // Last change before the gap
+    int64_t                         latestSignaled_;  // Latest change signaled during the gap
+    int64_t                         lastRead_;        // Last change read from the log
+    boost::thread                   thread_;
+
+    bool DequeueBatch(std::vector<Change>& batch);
+
+    void CatchUp(std::vector<Change>& batch);
+
+    static void Worker(PluginsChangesDispatcher* that);
+
+  public:
+    // "log" can be NULL, in which case the changes that do not fit
+    // in the queue are dropped
+    PluginsChangesDispatcher(OrthancPluginOnChangesCallback callback,
+                             size_t maxBatchSize,
+                             unsigned int maxLatency,
+                             size_t maxQueueSize,
+                             IChangesLog* log);
+
+    ~PluginsChangesDispatcher();
+
+    // The strings of "change" are copied
+    void Enqueue(const OrthancPluginChangeEvent& change);
+
+    // The pending changes are delivered before the thread stops
+    void Stop();
+  };
+}
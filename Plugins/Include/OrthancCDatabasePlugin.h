@@ -63,7 +63,13 @@ extern "C"
     _OrthancPluginDatabaseAnswerType_Int32 = 14,
     _OrthancPluginDatabaseAnswerType_Int64 = 15,
     _OrthancPluginDatabaseAnswerType_Resource = 16,
-    _OrthancPluginDatabaseAnswerType_String = 17
+    _OrthancPluginDatabaseAnswerType_String = 17,
+    _OrthancPluginDatabaseAnswerType_Metadata = 18,
+
+    /* Bulk return values (arrays of the values above) */
+    _OrthancPluginDatabaseAnswerType_StringArray = 30,
+    _OrthancPluginDatabaseAnswerType_Int64Array = 31,
+    _OrthancPluginDatabaseAnswerType_DicomTagArray = 32
   } _OrthancPluginDatabaseAnswerType;
 
 
@@ -259,6 +265,74 @@ extern "C"
     context->InvokeService(context, _OrthancPluginService_DatabaseAnswer, &params);
   }
 
+  ORTHANC_PLUGIN_INLINE void OrthancPluginDatabaseAnswerMetadata(
+    OrthancPluginContext*          context,
+    OrthancPluginDatabaseContext*  database,
+    int32_t                        metadata,
+    const char*                    value)
+  {
+    _OrthancPluginDatabaseAnswer params;
+    memset(&params, 0, sizeof(params));
+    params.database = database;
+    params.type = _OrthancPluginDatabaseAnswerType_Metadata;
+    params.valueInt32 = metadata;
+    params.valueString = value;
+    context->InvokeService(context, _OrthancPluginService_DatabaseAnswer, &params);
+  }
+
+  /**
+   * The three functions below answer a whole array of values in one
+   * single call to the Orthanc core, instead of one call per value.
+   * They can be used wherever the corresponding scalar function
+   * (OrthancPluginDatabaseAnswerString(),
+   * OrthancPluginDatabaseAnswerInt64() or
+   * OrthancPluginDatabaseAnswerDicomTag()) is expected.
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginDatabaseAnswerStrings(
+    OrthancPluginContext*          context,
+    OrthancPluginDatabaseContext*  database,
+    const char* const*             values,
+    uint32_t                       count)
+  {
+    _OrthancPluginDatabaseAnswer params;
+    memset(&params, 0, sizeof(params));
+    params.database = database;
+    params.type = _OrthancPluginDatabaseAnswerType_StringArray;
+    params.valueUint32 = count;
+    params.valueGeneric = values;
+    context->InvokeService(context, _OrthancPluginService_DatabaseAnswer, &params);
+  }
+
+  ORTHANC_PLUGIN_INLINE void OrthancPluginDatabaseAnswerInt64s(
+    OrthancPluginContext*          context,
+    OrthancPluginDatabaseContext*  database,
+    const int64_t*                 values,
+    uint32_t                       count)
+  {
+    _OrthancPluginDatabaseAnswer params;
+    memset(&params, 0, sizeof(params));
+    params.database = database;
+    params.type = _OrthancPluginDatabaseAnswerType_Int64Array;
+    params.valueUint32 = count;
+    params.valueGeneric = values;
+    context->InvokeService(context, _OrthancPluginService_DatabaseAnswer, &params);
+  }
+
+  ORTHANC_PLUGIN_INLINE void OrthancPluginDatabaseAnswerDicomTags(
+    OrthancPluginContext*          context,
+    OrthancPluginDatabaseContext*  database,
+    const OrthancPluginDicomTag*   tags,
+    uint32_t                       count)
+  {
+    _OrthancPluginDatabaseAnswer params;
+    memset(&params, 0, sizeof(params));
+    params.database = database;
+    params.type = _OrthancPluginDatabaseAnswerType_DicomTagArray;
+    params.valueUint32 = count;
+    params.valueGeneric = tags;
+    context->InvokeService(context, _OrthancPluginService_DatabaseAnswer, &params);
+  }
+
   ORTHANC_PLUGIN_INLINE void OrthancPluginDatabaseSignalDeletedAttachment(
     OrthancPluginContext*          context,
     OrthancPluginDatabaseContext*  database,
@@ -655,6 +729,161 @@ extern "C"
 
 
 
+  typedef struct
+  {
+    int64_t  resource;
+    uint16_t group;
+    uint16_t element;
+    const char* value;
+  } OrthancPluginResourcesContentTags;
+
+  typedef struct
+  {
+    int64_t  resource;
+    int32_t  metadata;
+    const char* value;
+  } OrthancPluginResourcesContentMetadata;
+
+  typedef struct
+  {
+    int64_t  resource;
+    OrthancPluginAttachment attachment;
+  } OrthancPluginResourcesContentAttachment;
+
+  typedef struct
+  {
+    int32_t  isNewInstance;
+    int32_t  isNewPatient;
+    int32_t  isNewStudy;
+    int32_t  isNewSeries;
+    int64_t  instanceId;
+    int64_t  patientId;
+    int64_t  studyId;
+    int64_t  seriesId;
+  } OrthancPluginCreateInstanceResult;
+
+
+  /**
+   * Optional compound operations of a database back-end. Each of them
+   * replaces a sequence of calls to the primitives of
+   * "OrthancPluginDatabaseBackend", which allows the back-end to
+   * execute them in one single round trip to the database. The
+   * callbacks that are set to NULL are emulated by the Orthanc core
+   * using the primitives. New members will only be appended at the
+   * end of this structure.
+   **/
+  typedef struct
+  {
+    /* Creates the instance together with its missing parents, and
+     * links them. If the instance already exists, "isNewInstance"
+     * must be set to 0 and only "instanceId" is taken into
+     * account. */
+    int32_t  (*createInstance) (
+      /* outputs */
+      OrthancPluginCreateInstanceResult* output,
+      /* inputs */
+      void* payload,
+      const char* hashPatient,
+      const char* hashStudy,
+      const char* hashSeries,
+      const char* hashInstance);
+
+    /* Sets at once the main DICOM tags (as done by
+     * "setMainDicomTag"), the identifier tags (as done by
+     * "setIdentifierTag"), the metadata and the attachments of a set
+     * of resources. */
+    int32_t  (*setResourcesContent) (
+      /* inputs */
+      void* payload,
+      uint32_t countMainDicomTags,
+      const OrthancPluginResourcesContentTags* mainDicomTags,
+      uint32_t countIdentifierTags,
+      const OrthancPluginResourcesContentTags* identifierTags,
+      uint32_t countMetadata,
+      const OrthancPluginResourcesContentMetadata* metadata,
+      uint32_t countAttachments,
+      const OrthancPluginResourcesContentAttachment* attachments);
+
+    /* Output: Use OrthancPluginDatabaseAnswerMetadata() */
+    int32_t  (*getAllMetadata) (
+      /* outputs */
+      OrthancPluginDatabaseContext* context,
+      /* inputs */
+      void* payload,
+      int64_t id);
+
+    /* Reads at once the main DICOM tags (as "getMainDicomTags"), the
+     * public IDs of the children (as "getChildrenPublicId") and the
+     * metadata (as "getAllMetadata") of one resource. Output: Use
+     * OrthancPluginDatabaseAnswerDicomTag(),
+     * OrthancPluginDatabaseAnswerString() and
+     * OrthancPluginDatabaseAnswerMetadata(), in any order. */
+    int32_t  (*lookupResourceContent) (
+      /* outputs */
+      OrthancPluginDatabaseContext* context,
+      /* inputs */
+      void* payload,
+      int64_t id);
+
+    /* Lists all the attachments of one resource, which replaces
+     * "listAvailableAttachments" followed by one "lookupAttachment"
+     * per attachment. Output: Use
+     * OrthancPluginDatabaseAnswerAttachment() */
+    int32_t  (*getAllAttachments) (
+      /* outputs */
+      OrthancPluginDatabaseContext* context,
+      /* inputs */
+      void* payload,
+      int64_t id);
+
+  } OrthancPluginDatabaseExtensions;
+
+
+  typedef struct
+  {
+    OrthancPluginDatabaseContext**          result;
+    const OrthancPluginDatabaseBackend*     backend;
+    void*                                   payload;
+    const OrthancPluginDatabaseExtensions*  extensions;
+    uint32_t                                extensionsSize;
+  } _OrthancPluginRegisterDatabaseBackendV2;
+
+  /**
+   * Register a custom database back-end, together with its optional
+   * compound operations. The "extensions" structure can be NULL, in
+   * which case this function is equivalent to
+   * OrthancPluginRegisterDatabaseBackend().
+   **/
+  ORTHANC_PLUGIN_INLINE OrthancPluginDatabaseContext* OrthancPluginRegisterDatabaseBackendV2(
+    OrthancPluginContext*                   context,
+    const OrthancPluginDatabaseBackend*     backend,
+    const OrthancPluginDatabaseExtensions*  extensions,
+    void*                                   payload)
+  {
+    OrthancPluginDatabaseContext* result = NULL;
+
+    _OrthancPluginRegisterDatabaseBackendV2 params;
+    memset(&params, 0, sizeof(params));
+    params.backend = backend;
+    params.result = &result;
+    params.payload = payload;
+    params.extensions = extensions;
+    params.extensionsSize = sizeof(OrthancPluginDatabaseExtensions);
+
+    if (context->InvokeService(context, _OrthancPluginService_RegisterDatabaseBackendV2, &params) ||
+        result == NULL)
+    {
+      /* Error */
+      return NULL;
+    }
+    else
+    {
+      return result;
+    }
+  }
+
+
+
 #ifdef  __cplusplus
 }
 #endif
@@ -262,6 +262,9 @@ extern "C"
     _OrthancPluginService_RegisterOnStoredInstanceCallback = 1001,
     _OrthancPluginService_RegisterStorageArea = 1002,
     _OrthancPluginService_RegisterOnChangeCallback = 1003,
+    _OrthancPluginService_RegisterOnChangesCallback = 1004,
+    _OrthancPluginService_RegisterDecodeImageCallback = 1005,
+    _OrthancPluginService_RegisterRestCallbackNoLock = 1006,
 
     /* Sending answers to REST calls */
     _OrthancPluginService_AnswerBuffer = 2000,
@@ -272,6 +275,11 @@ extern "C"
     _OrthancPluginService_SendMethodNotAllowed = 2005,
     _OrthancPluginService_SetCookie = 2006,
     _OrthancPluginService_SetHttpHeader = 2007,
+    _OrthancPluginService_CompressAndAnswerJpegImage = 2008,
+    _OrthancPluginService_StartStreamAnswer = 2009,
+    _OrthancPluginService_SendStreamChunk = 2010,
+    _OrthancPluginService_StartMultipartAnswer = 2011,
+    _OrthancPluginService_SendMultipartItem = 2012,
 
     /* Access to the Orthanc database and API */
     _OrthancPluginService_GetDicomForInstance = 3000,
@@ -288,6 +296,8 @@ extern "C"
     _OrthancPluginService_RestApiPostAfterPlugins = 3011,
     _OrthancPluginService_RestApiDeleteAfterPlugins = 3012,
     _OrthancPluginService_RestApiPutAfterPlugins = 3013,
+    _OrthancPluginService_GetSharedAttachment = 3014,
+    _OrthancPluginService_RestApiGetShared = 3015,
 
     /* Access to DICOM instances */
     _OrthancPluginService_GetInstanceRemoteAet = 4000,
@@ -300,7 +310,17 @@ extern "C"
 
     /* Services for plugins implementing a database back-end */
     _OrthancPluginService_RegisterDatabaseBackend = 5000,
-    _OrthancPluginService_DatabaseAnswer = 5001
+    _OrthancPluginService_DatabaseAnswer = 5001,
+    _OrthancPluginService_RegisterDatabaseBackendV2 = 5002,
+
+    /* Access to shared buffers */
+    _OrthancPluginService_GetSharedBufferData = 6000,
+    _OrthancPluginService_GetSharedBufferSize = 6001,
+    _OrthancPluginService_AcquireSharedBuffer = 6002,
+    _OrthancPluginService_ReleaseSharedBuffer = 6003,
+
+    /* Image decoding */
+    _OrthancPluginService_SetDecodedImage = 7000
 
   } _OrthancPluginService;
 
@@ -443,6 +463,19 @@ extern "C"
 
 
 
+  /**
+   * @brief Opaque structure that represents a read-only buffer that
+   * is shared between Orthanc and the plugins.
+   *
+   * The content of a shared buffer is never copied when it is handed
+   * to a plugin. The buffer is reference-counted: It stays alive as
+   * long as one handle to it has not been released by
+   * OrthancPluginReleaseSharedBuffer().
+   **/
+  typedef struct _OrthancPluginSharedBuffer_t OrthancPluginSharedBuffer;
+
+
+
   /**
    * @brief Signature of a callback function that answers to a REST request.
    **/
@@ -472,6 +505,104 @@ extern "C"
 
 
 
+  /**
+   * @brief A change to some DICOM resource, as delivered by ::OrthancPluginOnChangesCallback.
+   **/
+  typedef struct
+  {
+    /**
+     * @brief The sequence number of the change in the log of changes ("-1" if the change is not logged).
+     **/
+    int64_t                    seq;
+
+    /**
+     * @brief The type of the change.
+     **/
+    OrthancPluginChangeType    changeType;
+
+    /**
+     * @brief The type of the resource.
+     **/
+    OrthancPluginResourceType  resourceType;
+
+    /**
+     * @brief The identifier of the resource.
+     **/
+    const char*                resourceId;
+
+    /**
+     * @brief The date of the change (ISO format).
+     **/
+    const char*                date;
+  } OrthancPluginChangeEvent;
+
+
+
+  /**
+   * @brief Signature of a callback function that is triggered with a batch of changes to DICOM resources.
+   *
+   * The array of changes is only valid during the call to the callback.
+   **/
+  typedef int32_t (*OrthancPluginOnChangesCallback) (
+    const OrthancPluginChangeEvent* changes,
+    uint32_t count);
+
+
+
+  /**
+   * @brief Opaque structure that receives the result of a custom image decoder.
+   **/
+  typedef struct _OrthancPluginDecodedImage_t OrthancPluginDecodedImage;
+
+
+
+  /**
+   * @brief The description of a compressed DICOM frame to be decoded.
+   **/
+  typedef struct
+  {
+    const char*  transferSyntax;             /*!< UID of the transfer syntax */
+    uint32_t     frameIndex;                 /*!< Index of the frame in the instance */
+    uint32_t     width;                      /*!< Number of columns */
+    uint32_t     height;                     /*!< Number of rows */
+    uint32_t     samplesPerPixel;            /*!< Number of channels */
+    uint32_t     bitsAllocated;              /*!< Value of "BitsAllocated" */
+    uint32_t     bitsStored;                 /*!< Value of "BitsStored" */
+    uint32_t     highBit;                    /*!< Value of "HighBit" */
+    int32_t      isSigned;                   /*!< Whether "PixelRepresentation" is 1 */
+    int32_t      isPlanar;                   /*!< Whether "PlanarConfiguration" is 1 */
+    const char*  photometricInterpretation;  /*!< Value of "PhotometricInterpretation" */
+  } OrthancPluginFrameInformation;
+
+
+
+  /**
+   * @brief Callback to decode a compressed DICOM frame.
+   *
+   * Signature of a callback function that is invoked by Orthanc
+   * whenever it must decode a frame that is stored with a compressed
+   * transfer syntax that was declared when registering the
+   * callback. The callback is invoked before the built-in
+   * decoders of Orthanc. If the callback supports the image, it must
+   * call OrthancPluginSetDecodedImage() on "target" and return
+   * 0. If it returns 0 without having set the decoded image, the
+   * frame is handed to the next decoders. This callback can be
+   * invoked concurrently by several threads.
+   *
+   * @param target Where to store the decoded image.
+   * @param info The description of the frame.
+   * @param frame The compressed frame (the fragments are concatenated).
+   * @param size The size of the compressed frame.
+   * @return 0 if success (or if the image is not supported), other value if error.
+   **/
+  typedef int32_t (*OrthancPluginDecodeImageCallback) (
+    OrthancPluginDecodedImage* target,
+    const OrthancPluginFrameInformation* info,
+    const void* frame,
+    uint32_t size);
+
+
+
   /**
    * @brief Signature of a function to free dynamic memory.
    **/
@@ -733,6 +864,38 @@ extern "C"
   }
 
 
+  /**
+   * @brief Register a REST callback, without locking.
+   *
+   * This function registers a REST callback against a regular
+   * expression for a URI. Contrarily to
+   * OrthancPluginRegisterRestCallback(), the callback is NOT invoked
+   * under the global lock of the plugins: It can be invoked
+   * concurrently by several threads, and it must be reentrant. This
+   * is the function to be used by the callbacks that stream their
+   * answer (cf. OrthancPluginStartStreamAnswer() and
+   * OrthancPluginStartMultipartAnswer()), as the global lock would
+   * otherwise block the other callbacks of all the plugins during the
+   * whole transfer. This function must be called during the
+   * initialization of the plugin, i.e. inside the
+   * OrthancPluginInitialize() public function.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param pathRegularExpression Regular expression for the URI. May contain groups.
+   * @param callback The callback function to handle the REST call.
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginRegisterRestCallbackNoLock(
+    OrthancPluginContext*     context,
+    const char*               pathRegularExpression,
+    OrthancPluginRestCallback callback)
+  {
+    _OrthancPluginRestCallback params;
+    params.pathRegularExpression = pathRegularExpression;
+    params.callback = callback;
+    context->InvokeService(context, _OrthancPluginService_RegisterRestCallbackNoLock, &params);
+  }
+
+
 
   typedef struct
   {
@@ -843,6 +1006,193 @@ extern "C"
 
 
 
+  typedef struct
+  {
+    OrthancPluginRestOutput*  output;
+    OrthancPluginPixelFormat  format;
+    uint32_t                  width;
+    uint32_t                  height;
+    uint32_t                  pitch;
+    const void*               buffer;
+    uint8_t                   quality;
+  } _OrthancPluginCompressAndAnswerJpegImage;
+
+  /**
+   * @brief Answer to a REST request with a JPEG image.
+   *
+   * This function answers to a REST request with a JPEG image. The
+   * parameters of this function describe a memory buffer that
+   * contains an uncompressed image. The image will be automatically
+   * compressed as a JPEG image by the core system of Orthanc. Only
+   * the ::OrthancPluginPixelFormat_Grayscale8 and
+   * ::OrthancPluginPixelFormat_RGB24 formats are supported. This
+   * function is not available if Orthanc was built without JPEG
+   * support.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param output The HTTP connection to the client application.
+   * @param format The memory layout of the uncompressed image.
+   * @param width The width of the image.
+   * @param height The height of the image.
+   * @param pitch The pitch of the image (i.e. the number of bytes
+   * between 2 successive lines of the image in the memory buffer.
+   * @param buffer The memory buffer containing the uncompressed image.
+   * @param quality The quality of the JPEG encoding, between 1 (worst
+   * quality, best compression) and 100 (best quality, worst
+   * compression).
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginCompressAndAnswerJpegImage(
+    OrthancPluginContext*     context,
+    OrthancPluginRestOutput*  output,
+    OrthancPluginPixelFormat  format,
+    uint32_t                  width,
+    uint32_t                  height,
+    uint32_t                  pitch,
+    const void*               buffer,
+    uint8_t                   quality)
+  {
+    _OrthancPluginCompressAndAnswerJpegImage params;
+    params.output = output;
+    params.format = format;
+    params.width = width;
+    params.height = height;
+    params.pitch = pitch;
+    params.buffer = buffer;
+    params.quality = quality;
+    context->InvokeService(context, _OrthancPluginService_CompressAndAnswerJpegImage, &params);
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginRestOutput*  output;
+    const char*               subType;
+    const char*               contentType;
+  } _OrthancPluginStartStreamAnswer;
+
+  /**
+   * @brief Start a streamed answer to a REST request.
+   *
+   * Start an answer to a REST request whose body is not known in
+   * advance, and that is sent by chunks using the "chunked" transfer
+   * encoding of HTTP/1.1. The chunks are then sent using
+   * OrthancPluginSendStreamChunk(). The answer is closed by Orthanc
+   * once the REST callback returns. If the callback returns an error,
+   * the answer is left unterminated, so that the client application
+   * detects that it is truncated. The callback should be registered
+   * with OrthancPluginRegisterRestCallbackNoLock().
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param output The HTTP connection to the client application.
+   * @param mimeType The MIME type of the answer.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_INLINE int32_t OrthancPluginStartStreamAnswer(
+    OrthancPluginContext*    context,
+    OrthancPluginRestOutput* output,
+    const char*              mimeType)
+  {
+    _OrthancPluginStartStreamAnswer params;
+    params.output = output;
+    params.subType = NULL;
+    params.contentType = mimeType;
+    return context->InvokeService(context, _OrthancPluginService_StartStreamAnswer, &params);
+  }
+
+
+  /**
+   * @brief Send a chunk of a streamed answer.
+   *
+   * Send a chunk of an answer that was started by
+   * OrthancPluginStartStreamAnswer(). The chunk is written to the
+   * HTTP connection before this function returns: A slow client
+   * application thus slows down the plugin, and the memory used by
+   * the answer remains bounded.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param output The HTTP connection to the client application.
+   * @param chunk Pointer to the memory buffer containing the chunk.
+   * @param chunkSize Number of bytes of the chunk.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_INLINE int32_t OrthancPluginSendStreamChunk(
+    OrthancPluginContext*    context,
+    OrthancPluginRestOutput* output,
+    const char*              chunk,
+    uint32_t                 chunkSize)
+  {
+    _OrthancPluginAnswerBuffer params;
+    params.output = output;
+    params.answer = chunk;
+    params.answerSize = chunkSize;
+    params.mimeType = NULL;
+    return context->InvokeService(context, _OrthancPluginService_SendStreamChunk, &params);
+  }
+
+
+  /**
+   * @brief Start a multipart answer to a REST request.
+   *
+   * Start a streamed answer of type "multipart/{subType}" to a REST
+   * request, as used for instance by DICOMweb (WADO-RS). The items of
+   * the answer are then sent one by one using
+   * OrthancPluginSendMultipartItem(). The answer is closed by Orthanc
+   * once the REST callback returns. If the callback returns an error,
+   * the answer is left unterminated, so that the client application
+   * detects that it is truncated. The callback should be registered
+   * with OrthancPluginRegisterRestCallbackNoLock().
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param output The HTTP connection to the client application.
+   * @param subType The sub-type of the multipart answer ("related" or "mixed").
+   * @param contentType The MIME type of the items in the multipart answer.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_INLINE int32_t OrthancPluginStartMultipartAnswer(
+    OrthancPluginContext*    context,
+    OrthancPluginRestOutput* output,
+    const char*              subType,
+    const char*              contentType)
+  {
+    _OrthancPluginStartStreamAnswer params;
+    params.output = output;
+    params.subType = subType;
+    params.contentType = contentType;
+    return context->InvokeService(context, _OrthancPluginService_StartMultipartAnswer, &params);
+  }
+
+
+  /**
+   * @brief Send an item of a multipart answer.
+   *
+   * Send an item of an answer that was started by
+   * OrthancPluginStartMultipartAnswer(). As with
+   * OrthancPluginSendStreamChunk(), the item is written to the HTTP
+   * connection before this function returns.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param output The HTTP connection to the client application.
+   * @param answer Pointer to the memory buffer containing the item.
+   * @param answerSize Number of bytes of the item.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_INLINE int32_t OrthancPluginSendMultipartItem(
+    OrthancPluginContext*    context,
+    OrthancPluginRestOutput* output,
+    const char*              answer,
+    uint32_t                 answerSize)
+  {
+    _OrthancPluginAnswerBuffer params;
+    params.output = output;
+    params.answer = answer;
+    params.answerSize = answerSize;
+    params.mimeType = NULL;
+    return context->InvokeService(context, _OrthancPluginService_SendMultipartItem, &params);
+  }
+
+
+
   typedef struct
   {
     OrthancPluginMemoryBuffer*  target;
@@ -1856,6 +2206,139 @@ extern "C"
 
 
 
+  typedef struct
+  {
+    OrthancPluginOnChangesCallback callback;
+    uint32_t                       maxBatchSize;
+    uint32_t                       maxLatency;
+  } _OrthancPluginOnChangesCallback;
+
+  /**
+   * @brief Register a callback to monitor changes by batches.
+   *
+   * This function registers a callback function that is called with
+   * batches of changes to DICOM resources, in the order of the
+   * changes. A batch is delivered as soon as it contains
+   * "maxBatchSize" changes, or once "maxLatency" milliseconds have
+   * elapsed since the first change of the batch was received. Each
+   * registered callback is invoked from its own thread, so that a
+   * slow callback never delays the other callbacks. If a callback
+   * is too slow, the memory of its pending changes is bounded by
+   * reading them back from the log of changes of Orthanc: In this
+   * case, the changes that are not logged ("Deleted" and
+   * "NewChildInstance") are not delivered.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param callback The callback function.
+   * @param maxBatchSize The maximum number of changes in one batch (must be positive).
+   * @param maxLatency The maximum delay before delivering a non-full batch, in milliseconds.
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginRegisterOnChangesCallback(
+    OrthancPluginContext*           context,
+    OrthancPluginOnChangesCallback  callback,
+    uint32_t                        maxBatchSize,
+    uint32_t                        maxLatency)
+  {
+    _OrthancPluginOnChangesCallback params;
+    params.callback = callback;
+    params.maxBatchSize = maxBatchSize;
+    params.maxLatency = maxLatency;
+
+    context->InvokeService(context, _OrthancPluginService_RegisterOnChangesCallback, &params);
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginDecodeImageCallback callback;
+    const char* const*               transferSyntaxes;
+    uint32_t                         countTransferSyntaxes;
+  } _OrthancPluginDecodeImageCallback;
+
+  /**
+   * @brief Register a callback to decode compressed DICOM frames.
+   *
+   * This function registers a custom decoder of the DICOM frames that
+   * are stored with a compressed transfer syntax (such as JPEG 2000
+   * or JPEG-LS). The registered decoders take precedence over the
+   * built-in decoders of Orthanc, in the order of their registration.
+   * The callback is only invoked for the listed transfer syntaxes, so
+   * that the other images are not extracted for nothing.
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param callback The callback.
+   * @param transferSyntaxes The UIDs of the supported transfer syntaxes (they are copied).
+   * @param countTransferSyntaxes The number of supported transfer syntaxes.
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginRegisterDecodeImageCallback(
+    OrthancPluginContext*             context,
+    OrthancPluginDecodeImageCallback  callback,
+    const char* const*                transferSyntaxes,
+    uint32_t                          countTransferSyntaxes)
+  {
+    _OrthancPluginDecodeImageCallback params;
+    params.callback = callback;
+    params.transferSyntaxes = transferSyntaxes;
+    params.countTransferSyntaxes = countTransferSyntaxes;
+
+    context->InvokeService(context, _OrthancPluginService_RegisterDecodeImageCallback, &params);
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginDecodedImage*  target;
+    OrthancPluginPixelFormat    format;
+    uint32_t                    width;
+    uint32_t                    height;
+    uint32_t                    pitch;
+    const void*                 buffer;
+  } _OrthancPluginSetDecodedImage;
+
+  /**
+   * @brief Provide the result of a custom image decoder.
+   *
+   * This function must be called from within an image decoding
+   * callback (cf. OrthancPluginRegisterDecodeImageCallback()) to
+   * provide Orthanc with the decoded frame. The content of "buffer"
+   * is copied, so that the plugin keeps the ownership of its memory.
+   * The size of the image must match the description of the frame,
+   * and its format must correspond to the image (e.g. RGB24 for
+   * color images, Grayscale16 for unsigned 16bpp images).
+   *
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param target The target that was provided to the decoding callback.
+   * @param format The memory layout of the decoded image.
+   * @param width The width of the decoded image.
+   * @param height The height of the decoded image.
+   * @param pitch The pitch of the decoded image (i.e. the number of bytes between 2 successive lines).
+   * @param buffer The decoded image.
+   * @return 0 if success, other value if error.
+   **/
+  ORTHANC_PLUGIN_INLINE int32_t OrthancPluginSetDecodedImage(
+    OrthancPluginContext*       context,
+    OrthancPluginDecodedImage*  target,
+    OrthancPluginPixelFormat    format,
+    uint32_t                    width,
+    uint32_t                    height,
+    uint32_t                    pitch,
+    const void*                 buffer)
+  {
+    _OrthancPluginSetDecodedImage params;
+    params.target = target;
+    params.format = format;
+    params.width = width;
+    params.height = height;
+    params.pitch = pitch;
+    params.buffer = buffer;
+
+    return context->InvokeService(context, _OrthancPluginService_SetDecodedImage, &params);
+  }
+
+
+
   typedef struct
   {
     const char* plugin;
@@ -2116,6 +2599,250 @@ extern "C"
 
 
 
+  typedef struct
+  {
+    OrthancPluginSharedBuffer**  target;
+    const char*                  instanceId;
+    int32_t                      contentType;
+  } _OrthancPluginGetSharedAttachment;
+
+  /**
+   * @brief Read an attachment of a DICOM instance into a shared buffer.
+   *
+   * Read the uncompressed content of one attachment of a DICOM
+   * instance, as a reference-counted, read-only buffer. Contrarily
+   * to OrthancPluginGetDicomForInstance(), the content is not copied
+   * into a newly allocated memory buffer.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param instanceId The Orthanc identifier of the DICOM instance of interest.
+   * @param contentType The type of the attachment (1 for the DICOM file, 2 for its JSON summary).
+   * @return The shared buffer, or NULL in the case of an error. It
+   * must be released by OrthancPluginReleaseSharedBuffer().
+   **/
+  ORTHANC_PLUGIN_INLINE OrthancPluginSharedBuffer* OrthancPluginGetSharedAttachment(
+    OrthancPluginContext*  context,
+    const char*            instanceId,
+    int32_t                contentType)
+  {
+    OrthancPluginSharedBuffer* target = NULL;
+
+    _OrthancPluginGetSharedAttachment params;
+    params.target = &target;
+    params.instanceId = instanceId;
+    params.contentType = contentType;
+
+    if (context->InvokeService(context, _OrthancPluginService_GetSharedAttachment, &params))
+    {
+      /* Error */
+      return NULL;
+    }
+    else
+    {
+      return target;
+    }
+  }
+
+
+  /**
+   * @brief Retrieve a DICOM instance into a shared buffer.
+   *
+   * Retrieve a DICOM instance using its Orthanc identifier, as a
+   * reference-counted, read-only buffer. This is the zero-copy
+   * counterpart of OrthancPluginGetDicomForInstance().
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param instanceId The Orthanc identifier of the DICOM instance of interest.
+   * @return The shared buffer, or NULL in the case of an error. It
+   * must be released by OrthancPluginReleaseSharedBuffer().
+   **/
+  ORTHANC_PLUGIN_INLINE OrthancPluginSharedBuffer* OrthancPluginGetSharedDicomForInstance(
+    OrthancPluginContext*  context,
+    const char*            instanceId)
+  {
+    return OrthancPluginGetSharedAttachment(context, instanceId, 1);
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginSharedBuffer**  target;
+    const char*                  uri;
+    int32_t                      afterPlugins;
+  } _OrthancPluginRestApiGetShared;
+
+  /**
+   * @brief Make a GET call to the REST API, answering a shared buffer.
+   *
+   * Make a GET call to the REST API of Orthanc. The body of the
+   * answer is handed as a reference-counted, read-only buffer,
+   * without the copy into a newly allocated memory buffer that is
+   * done by OrthancPluginRestApiGet().
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param uri The URI of interest.
+   * @param afterPlugins If nonzero, the REST callbacks of the plugins
+   * are also taken into account (as in OrthancPluginRestApiGetAfterPlugins()).
+   * @return The shared buffer, or NULL in the case of an error. It
+   * must be released by OrthancPluginReleaseSharedBuffer().
+   **/
+  ORTHANC_PLUGIN_INLINE OrthancPluginSharedBuffer* OrthancPluginRestApiGetShared(
+    OrthancPluginContext*  context,
+    const char*            uri,
+    int32_t                afterPlugins)
+  {
+    OrthancPluginSharedBuffer* target = NULL;
+
+    _OrthancPluginRestApiGetShared params;
+    params.target = &target;
+    params.uri = uri;
+    params.afterPlugins = afterPlugins;
+
+    if (context->InvokeService(context, _OrthancPluginService_RestApiGetShared, &params))
+    {
+      /* Error */
+      return NULL;
+    }
+    else
+    {
+      return target;
+    }
+  }
+
+
+
+  typedef struct
+  {
+    OrthancPluginSharedBuffer*   buffer;
+    const void**                 resultData;
+    uint64_t*                    resultSize;
+    OrthancPluginSharedBuffer**  resultBuffer;
+  } _OrthancPluginAccessSharedBuffer;
+
+  /**
+   * @brief Get the content of a shared buffer.
+   *
+   * Get a pointer to the content of a shared buffer. The content is
+   * read-only, and remains valid until the handle is released.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param buffer The shared buffer of interest.
+   * @return The pointer to the content, or NULL in the case of an
+   * error (or if the buffer is empty).
+   **/
+  ORTHANC_PLUGIN_INLINE const void* OrthancPluginGetSharedBufferData(
+    OrthancPluginContext*       context,
+    OrthancPluginSharedBuffer*  buffer)
+  {
+    const void* result = NULL;
+
+    _OrthancPluginAccessSharedBuffer params;
+    memset(&params, 0, sizeof(params));
+    params.buffer = buffer;
+    params.resultData = &result;
+
+    if (context->InvokeService(context, _OrthancPluginService_GetSharedBufferData, &params))
+    {
+      /* Error */
+      return NULL;
+    }
+    else
+    {
+      return result;
+    }
+  }
+
+
+  /**
+   * @brief Get the size of a shared buffer.
+   *
+   * Get the number of bytes in a shared buffer.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param buffer The shared buffer of interest.
+   * @return The size of the buffer, or 0 in the case of an error.
+   **/
+  ORTHANC_PLUGIN_INLINE uint64_t OrthancPluginGetSharedBufferSize(
+    OrthancPluginContext*       context,
+    OrthancPluginSharedBuffer*  buffer)
+  {
+    uint64_t result = 0;
+
+    _OrthancPluginAccessSharedBuffer params;
+    memset(&params, 0, sizeof(params));
+    params.buffer = buffer;
+    params.resultSize = &result;
+
+    if (context->InvokeService(context, _OrthancPluginService_GetSharedBufferSize, &params))
+    {
+      /* Error */
+      return 0;
+    }
+    else
+    {
+      return result;
+    }
+  }
+
+
+  /**
+   * @brief Acquire a new reference to a shared buffer.
+   *
+   * Create a new handle to the content of a shared buffer, without
+   * copying this content. The two handles can be released
+   * independently, for instance by different threads.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param buffer The shared buffer of interest.
+   * @return The new handle, or NULL in the case of an error. It must
+   * be released by OrthancPluginReleaseSharedBuffer().
+   **/
+  ORTHANC_PLUGIN_INLINE OrthancPluginSharedBuffer* OrthancPluginAcquireSharedBuffer(
+    OrthancPluginContext*       context,
+    OrthancPluginSharedBuffer*  buffer)
+  {
+    OrthancPluginSharedBuffer* result = NULL;
+
+    _OrthancPluginAccessSharedBuffer params;
+    memset(&params, 0, sizeof(params));
+    params.buffer = buffer;
+    params.resultBuffer = &result;
+
+    if (context->InvokeService(context, _OrthancPluginService_AcquireSharedBuffer, &params))
+    {
+      /* Error */
+      return NULL;
+    }
+    else
+    {
+      return result;
+    }
+  }
+
+
+  /**
+   * @brief Release a shared buffer.
+   *
+   * Release a handle to a shared buffer. The memory is freed as soon
+   * as all the handles to this buffer are released.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param buffer The shared buffer to be released.
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginReleaseSharedBuffer(
+    OrthancPluginContext*       context,
+    OrthancPluginSharedBuffer*  buffer)
+  {
+    _OrthancPluginAccessSharedBuffer params;
+    memset(&params, 0, sizeof(params));
+    params.buffer = buffer;
+
+    context->InvokeService(context, _OrthancPluginService_ReleaseSharedBuffer, &params);
+  }
+
+
+
 #ifdef  __cplusplus
 }
 #endif
@@ -156,3 +156,14 @@ add_definitions(
   -DBOOST_HAS_DATE_TIME=1
   -DBOOST_HAS_REGEX=1
   )
+
+
+# "Toolbox::ConvertToUtf8()" directly calls iconv to cache its
+# converters. iconv is part of the C library on the UNIX-like systems,
+# and is statically linked on Windows if "USE_BOOST_ICONV" is set.
+if (NOT ${CMAKE_SYSTEM_NAME} STREQUAL "Windows" OR
+    (BOOST_STATIC AND USE_BOOST_ICONV))
+  add_definitions(-DORTHANC_ICONV_ENABLED=1)
+else()
+  add_definitions(-DORTHANC_ICONV_ENABLED=0)
+endif()
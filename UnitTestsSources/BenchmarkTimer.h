@@ -0,0 +1,67 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+/**
+ * Timer for the benchmarks of the unit tests. The benchmarks are
+ * disabled by default, run them with:
+ * "./UnitTests --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*"
+ **/
+class BenchmarkTimer
+{
+private:
+  boost::posix_time::ptime  start_;
+
+public:
+  BenchmarkTimer()
+  {
+    Restart();
+  }
+
+  void Restart()
+  {
+    start_ = boost::posix_time::microsec_clock::universal_time();
+  }
+
+  // Never returns zero, so that the result can be used as a divisor
+  double GetElapsedMicroseconds() const
+  {
+    boost::posix_time::time_duration elapsed = 
+      boost::posix_time::microsec_clock::universal_time() - start_;
+
+    long long us = static_cast<long long>(elapsed.total_microseconds());
+    return static_cast<double>(us > 0 ? us : 1);
+  }
+};
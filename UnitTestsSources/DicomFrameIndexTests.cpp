@@ -0,0 +1,417 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersUnitTests.h"
+#include "gtest/gtest.h"
+
+#include "../Core/DicomFormat/DicomFrameIndex.h"
+#include "../Core/OrthancException.h"
+
+#include <stdint.h>
+#include <string>
+
+using namespace Orthanc;
+
+
+namespace
+{
+  // Writer of raw DICOM files, in little endian
+  class DicomWriter
+  {
+  private:
+    std::string  buffer_;
+    bool         explicitVR_;
+
+  public:
+    DicomWriter(const std::string& transferSyntax,
+                bool explicitVR) :
+      explicitVR_(explicitVR)
+    {
+      buffer_ = std::string(128, '\0') + "DICM";
+
+      std::string ts = transferSyntax;
+      if (ts.size() % 2 == 1)
+      {
+        ts.push_back('\0');
+      }
+
+      AddTag(0x0002, 0x0010);
+      buffer_ += "UI";
+      AddUInt16(ts.size());
+      buffer_ += ts;
+    }
+
+    void AddUInt16(uint16_t value)
+    {
+      buffer_.push_back(static_cast<char>(value & 0xff));
+      buffer_.push_back(static_cast<char>(value >> 8));
+    }
+
+    void AddUInt32(uint32_t value)
+    {
+      AddUInt16(static_cast<uint16_t>(value & 0xffff));
+      AddUInt16(static_cast<uint16_t>(value >> 16));
+    }
+
+    void AddTag(uint16_t group,
+                uint16_t element)
+    {
+      AddUInt16(group);
+      AddUInt16(element);
+    }
+
+    void AddHeader(uint16_t group,
+                   uint16_t element,
+                   const char* vr,
+                   uint32_t length)
+    {
+      AddTag(group, element);
+
+      if (!explicitVR_)
+      {
+        AddUInt32(length);
+      }
+      else if (std::string(vr) == "OB" ||
+               std::string(vr) == "OW" ||
+               std::string(vr) == "SQ" ||
+               std::string(vr) == "UN")
+      {
+        buffer_ += vr;
+        AddUInt16(0);
+        AddUInt32(length);
+      }
+      else
+      {
+        buffer_ += vr;
+        AddUInt16(static_cast<uint16_t>(length));
+      }
+    }
+
+    void AddUnsignedShort(uint16_t group,
+                          uint16_t element,
+                          uint16_t value)
+    {
+      AddHeader(group, element, "US", 2);
+      AddUInt16(value);
+    }
+
+    void AddString(uint16_t group,
+                   uint16_t element,
+                   const char* vr,
+                   std::string value)
+    {
+      if (value.size() % 2 == 1)
+      {
+        value.push_back(' ');
+      }
+
+      AddHeader(group, element, vr, value.size());
+      buffer_ += value;
+    }
+
+    void AddItem(uint32_t length)
+    {
+      AddTag(0xfffe, 0xe000);
+      AddUInt32(length);
+    }
+
+    void AddDelimiter(uint16_t element)
+    {
+      AddTag(0xfffe, element);
+      AddUInt32(0);
+    }
+
+    void AddRaw(const std::string& data)
+    {
+      buffer_ += data;
+    }
+
+    const std::string& GetBuffer() const
+    {
+      return buffer_;
+    }
+
+    size_t GetSize() const
+    {
+      return buffer_.size();
+    }
+  };
+}
+
+
+static void AddImageInformation(DicomWriter& w,
+                                const char* numberOfFrames)
+{
+  // Sequence of undefined length, with one item of undefined length
+  w.AddHeader(0x0008, 0x1115, "SQ", 0xffffffffu);
+  w.AddItem(0xffffffffu);
+  w.AddString(0x0008, 0x1150, "UI", "1.2.3");
+  w.AddDelimiter(0xe00d);
+  w.AddDelimiter(0xe0dd);
+
+  w.AddUnsignedShort(0x0028, 0x0002, 1);
+  w.AddString(0x0028, 0x0008, "IS", numberOfFrames);
+  w.AddUnsignedShort(0x0028, 0x0010, 2);  // Rows
+  w.AddUnsignedShort(0x0028, 0x0011, 3);  // Columns
+  w.AddUnsignedShort(0x0028, 0x0100, 16);
+}
+
+
+TEST(DicomFrameIndex, Native)
+{
+  for (int i = 0; i < 2; i++)
+  {
+    bool explicitVR = (i == 0);
+    DicomWriter w(explicitVR ? "1.2.840.10008.1.2.1" : "1.2.840.10008.1.2", explicitVR);
+    AddImageInformation(w, "3");
+
+    size_t pixelData = w.GetSize();
+    w.AddHeader(0x7fe0, 0x0010, "OW", 36);
+    size_t start = w.GetSize();
+    w.AddRaw(std::string(36, 'a'));
+
+    DicomFrameIndex index(w.GetBuffer().c_str(), w.GetSize());
+    ASSERT_FALSE(index.IsEncapsulated());
+    ASSERT_EQ(pixelData, index.GetPixelDataOffset());
+    ASSERT_EQ(3u, index.GetFramesCount());
+    ASSERT_EQ(2u, index.GetRows());
+    ASSERT_EQ(3u, index.GetColumns());
+    ASSERT_EQ(1u, index.GetSamplesPerPixel());
+    ASSERT_EQ(16u, index.GetBitsAllocated());
+    ASSERT_EQ(0u, index.GetPixelRepresentation());
+    ASSERT_EQ(explicitVR ? "1.2.840.10008.1.2.1" : "1.2.840.10008.1.2", index.GetTransferSyntax());
+
+    uint64_t a, b;
+    index.GetFrameRange(a, b, 0);  ASSERT_EQ(start, a);       ASSERT_EQ(start + 12, b);
+    index.GetFrameRange(a, b, 2);  ASSERT_EQ(start + 24, a);  ASSERT_EQ(start + 36, b);
+    ASSERT_THROW(index.GetFrameRange(a, b, 3), OrthancException);
+
+    std::string header, trailer;
+    index.GetSingleFrameEnvelope(header, trailer, w.GetBuffer().c_str(), w.GetSize());
+    ASSERT_TRUE(trailer.empty());
+
+    index.GetFrameRange(a, b, 1);
+    std::string single = header + w.GetBuffer().substr(a, b - a) + trailer;
+
+    DicomFrameIndex index2(single.c_str(), single.size());
+    ASSERT_FALSE(index2.IsEncapsulated());
+    ASSERT_EQ(1u, index2.GetFramesCount());
+    index2.GetFrameRange(a, b, 0);
+    ASSERT_EQ(single.size(), b);
+    ASSERT_EQ(std::string(12, 'a'), single.substr(a, b - a));
+  }
+
+  {
+    // Truncated pixel data
+    DicomWriter w("1.2.840.10008.1.2.1", true);
+    AddImageInformation(w, "4");
+    w.AddHeader(0x7fe0, 0x0010, "OW", 36);
+    w.AddRaw(std::string(36, 'a'));
+    ASSERT_THROW(DicomFrameIndex(w.GetBuffer().c_str(), w.GetSize()), OrthancException);
+  }
+
+  {
+    // Huge number of frames, that must be rejected before allocating
+    // the index of the frames
+    DicomWriter w("1.2.840.10008.1.2.1", true);
+    AddImageInformation(w, "4000000000");
+    w.AddHeader(0x7fe0, 0x0010, "OW", 36);
+    w.AddRaw(std::string(36, 'a'));
+    ASSERT_THROW(DicomFrameIndex(w.GetBuffer().c_str(), w.GetSize()), OrthancException);
+  }
+
+  {
+    // Big endian is not supported
+    DicomWriter w("1.2.840.10008.1.2.2", true);
+    ASSERT_THROW(DicomFrameIndex(w.GetBuffer().c_str(), w.GetSize()), OrthancException);
+  }
+
+  ASSERT_THROW(DicomFrameIndex("nope", 4), OrthancException);
+}
+
+
+TEST(DicomFrameIndex, Encapsulated)
+{
+  {
+    // Basic Offset Table, the first frame is made of 2 fragments
+    DicomWriter w("1.2.840.10008.1.2.4.50", true);
+    AddImageInformation(w, "2");
+    w.AddHeader(0x7fe0, 0x0010, "OB", 0xffffffffu);
+    w.AddItem(8);
+    w.AddUInt32(0);
+    w.AddUInt32(8 + 4 + 8 + 2);
+
+    size_t first = w.GetSize();
+    w.AddItem(4);  w.AddRaw("abcd");
+    w.AddItem(2);  w.AddRaw("ef");
+    size_t second = w.GetSize();
+    w.AddItem(6);  w.AddRaw("ghijkl");
+    size_t end = w.GetSize();
+    w.AddDelimiter(0xe0dd);
+
+    DicomFrameIndex index(w.GetBuffer().c_str(), w.GetSize());
+    ASSERT_TRUE(index.IsEncapsulated());
+    ASSERT_EQ(2u, index.GetFramesCount());
+
+    uint64_t a, b;
+    index.GetFrameRange(a, b, 0);  ASSERT_EQ(first, a);   ASSERT_EQ(second, b);
+    index.GetFrameRange(a, b, 1);  ASSERT_EQ(second, a);  ASSERT_EQ(end, b);
+
+    index.GetFrameRange(a, b, 0);
+    std::string frame = w.GetBuffer().substr(a, b - a);
+
+    DicomFrameIndex::Fragments fragments;
+    DicomFrameIndex::ParseFragments(fragments, frame.c_str(), frame.size());
+    ASSERT_EQ(2u, fragments.size());
+    ASSERT_EQ("abcd", frame.substr(fragments[0].first, fragments[0].second));
+    ASSERT_EQ("ef", frame.substr(fragments[1].first, fragments[1].second));
+
+    std::string header, trailer;
+    index.GetSingleFrameEnvelope(header, trailer, w.GetBuffer().c_str(), w.GetSize());
+    std::string single = header + frame + trailer;
+
+    DicomFrameIndex index2(single.c_str(), single.size());
+    ASSERT_TRUE(index2.IsEncapsulated());
+    ASSERT_EQ(1u, index2.GetFramesCount());
+    index2.GetFrameRange(a, b, 0);
+    ASSERT_EQ(frame, single.substr(a, b - a));
+  }
+
+  {
+    // Empty Basic Offset Table, one fragment per frame
+    DicomWriter w("1.2.840.10008.1.2.4.50", true);
+    AddImageInformation(w, "2");
+    w.AddHeader(0x7fe0, 0x0010, "OB", 0xffffffffu);
+    w.AddItem(0);
+    w.AddItem(4);  w.AddRaw("abcd");
+    size_t second = w.GetSize();
+    w.AddItem(2);  w.AddRaw("ef");
+    w.AddDelimiter(0xe0dd);
+
+    DicomFrameIndex index(w.GetBuffer().c_str(), w.GetSize());
+    ASSERT_EQ(2u, index.GetFramesCount());
+
+    uint64_t a, b;
+    index.GetFrameRange(a, b, 1);
+    ASSERT_EQ(second, a);
+    ASSERT_EQ(second + 10, b);
+  }
+
+  {
+    // Huge number of frames, with less fragments than frames
+    DicomWriter w("1.2.840.10008.1.2.4.50", true);
+    AddImageInformation(w, "4000000000");
+    w.AddHeader(0x7fe0, 0x0010, "OB", 0xffffffffu);
+    w.AddItem(0);
+    w.AddItem(4);  w.AddRaw("abcd");
+    w.AddItem(2);  w.AddRaw("ef");
+    w.AddDelimiter(0xe0dd);
+
+    ASSERT_THROW(DicomFrameIndex(w.GetBuffer().c_str(), w.GetSize()), OrthancException);
+  }
+
+  {
+    // Basic Offset Table that is larger than the file
+    DicomWriter w("1.2.840.10008.1.2.4.50", true);
+    AddImageInformation(w, "2");
+    w.AddHeader(0x7fe0, 0x0010, "OB", 0xffffffffu);
+    w.AddItem(0xfffffff0u);
+    w.AddUInt32(0);
+    w.AddDelimiter(0xe0dd);
+
+    ASSERT_THROW(DicomFrameIndex(w.GetBuffer().c_str(), w.GetSize()), OrthancException);
+  }
+
+  {
+    // Empty Basic Offset Table, and more fragments than frames
+    DicomWriter w("1.2.840.10008.1.2.4.50", true);
+    AddImageInformation(w, "2");
+    w.AddHeader(0x7fe0, 0x0010, "OB", 0xffffffffu);
+    w.AddItem(0);
+    w.AddItem(4);  w.AddRaw("abcd");
+    w.AddItem(2);  w.AddRaw("ef");
+    w.AddItem(2);  w.AddRaw("gh");
+    w.AddDelimiter(0xe0dd);
+
+    ASSERT_THROW(DicomFrameIndex(w.GetBuffer().c_str(), w.GetSize()), OrthancException);
+  }
+}
+
+
+TEST(DicomFrameIndex, LocatePixelData)
+{
+  uint64_t start, end;
+
+  {
+    // No requirement on the image information
+    DicomWriter w("1.2.840.10008.1.2.1", true);
+    w.AddString(0x0008, 0x0060, "CS", "CT");
+    size_t pixelData = w.GetSize();
+    w.AddHeader(0x7fe0, 0x0010, "OW", 4);
+    w.AddRaw("abcd");
+    size_t trailer = w.GetSize();
+    w.AddString(0xfffc, 0xfffc, "OB", "");
+
+    ASSERT_THROW(DicomFrameIndex(w.GetBuffer().c_str(), w.GetSize()), OrthancException);
+    ASSERT_TRUE(DicomFrameIndex::LocatePixelData(start, end, w.GetBuffer().c_str(), w.GetSize()));
+    ASSERT_EQ(pixelData, start);
+    ASSERT_EQ(trailer, end);
+  }
+
+  {
+    DicomWriter w("1.2.840.10008.1.2.4.50", true);
+    AddImageInformation(w, "1");
+    size_t pixelData = w.GetSize();
+    w.AddHeader(0x7fe0, 0x0010, "OB", 0xffffffffu);
+    w.AddItem(0);
+    w.AddItem(4);  w.AddRaw("abcd");
+    w.AddDelimiter(0xe0dd);
+
+    ASSERT_TRUE(DicomFrameIndex::LocatePixelData(start, end, w.GetBuffer().c_str(), w.GetSize()));
+    ASSERT_EQ(pixelData, start);
+    ASSERT_EQ(w.GetSize(), end);
+  }
+
+  {
+    // No pixel data
+    DicomWriter w("1.2.840.10008.1.2", false);
+    w.AddString(0x0008, 0x0060, "CS", "CT");
+    ASSERT_FALSE(DicomFrameIndex::LocatePixelData(start, end, w.GetBuffer().c_str(), w.GetSize()));
+  }
+
+  {
+    DicomWriter w("1.2.840.10008.1.2.2", true);
+    ASSERT_FALSE(DicomFrameIndex::LocatePixelData(start, end, w.GetBuffer().c_str(), w.GetSize()));
+  }
+
+  ASSERT_FALSE(DicomFrameIndex::LocatePixelData(start, end, "nope", 4));
+}
@@ -32,9 +32,11 @@
 
 #include "PrecompiledHeadersUnitTests.h"
 #include "gtest/gtest.h"
+#include "BenchmarkTimer.h"
 
 #include "../Core/Uuid.h"
 #include "../Core/OrthancException.h"
+#include "../Core/DicomFormat/DicomArray.h"
 #include "../Core/DicomFormat/DicomMap.h"
 #include "../Core/DicomFormat/DicomNullValue.h"
 #include "../OrthancServer/FromDcmtkBridge.h"
@@ -128,6 +130,48 @@ TEST(DicomMap, Tags)
 }
 
 
+TEST(DicomMap, Order)
+{
+  DicomMap m;
+  m.SetValue(0x0020, 0x000d, "c");
+  m.SetValue(0x0008, 0x0020, "a");
+  m.SetValue(0x7fe0, 0x0010, DicomNullValue());
+  m.SetValue(0x0010, 0x0020, "b");
+  m.SetValue(0x0008, 0x0018, "z");
+  m.SetValue(0x0010, 0x0010, "b0");
+  m.SetValue(0x0010, 0x0020, "b1");
+  m.Remove(DicomTag(0x0008, 0x0018));
+  m.Remove(DicomTag(0x0008, 0x0019));  // Inexistent tag
+
+  ASSERT_EQ(5u, m.GetSize());
+  ASSERT_TRUE(m.GetValue(0x7fe0, 0x0010).IsNull());
+  ASSERT_FALSE(m.GetValue(0x0010, 0x0020).IsNull());
+  ASSERT_EQ("b1", m.GetValue(0x0010, 0x0020).AsString());
+  ASSERT_EQ(NULL, m.TestAndGetValue(0x0008, 0x0018));
+
+  // The elements are enumerated in the order of the tags
+  DicomArray a(m);
+  ASSERT_EQ(5u, a.GetSize());
+  ASSERT_EQ(DicomTag(0x0008, 0x0020), a.GetElement(0).GetTag());
+  ASSERT_EQ(DicomTag(0x0010, 0x0010), a.GetElement(1).GetTag());
+  ASSERT_EQ(DicomTag(0x0010, 0x0020), a.GetElement(2).GetTag());
+  ASSERT_EQ(DicomTag(0x0020, 0x000d), a.GetElement(3).GetTag());
+  ASSERT_EQ(DicomTag(0x7fe0, 0x0010), a.GetElement(4).GetTag());
+  ASSERT_TRUE(a.GetElement(4).GetValue().IsNull());
+
+  DicomMap b;
+  b.SetValue(DICOM_TAG_PATIENT_ID, "nope");
+  b.Assign(m);
+  ASSERT_EQ(5u, b.GetSize());
+  ASSERT_EQ("b1", b.GetValue(DICOM_TAG_PATIENT_ID).AsString());
+
+  std::auto_ptr<DicomValue> v(b.GetValue(0x7fe0, 0x0010).Clone());
+  ASSERT_TRUE(v->IsNull());
+  v.reset(b.GetValue(0x0008, 0x0020).Clone());
+  ASSERT_EQ("a", v->AsString());
+}
+
+
 TEST(DicomMap, FindTemplates)
 {
   DicomMap m;
@@ -204,3 +248,70 @@ TEST(DicomMap, Modules)
   //TestModule(ResourceType_Series, DicomModule_Series);   // TODO
   TestModule(ResourceType_Instance, DicomModule_Instance);
 }
+
+
+TEST(DicomMap, DISABLED_Benchmark)
+{
+  static const unsigned int COUNT = 100000;
+
+  // Summary of a typical instance
+  DicomMap summary;
+  for (uint16_t element = 0; element < 80; element++)
+  {
+    summary.SetValue(0x0009, element, "Some private value");
+  }
+
+  std::set<DicomTag> tags;
+  DicomMap::GetMainDicomTags(tags);
+  for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+  {
+    summary.SetValue(*it, "1.2.840.113619.2.55.3.604688119");
+  }
+
+  {
+    // Same operations as "ServerIndex::Store()"
+    BenchmarkTimer timer;
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      DicomMap patient, study, series, instance;
+      summary.ExtractPatientInformation(patient);
+      summary.ExtractStudyInformation(study);
+      summary.ExtractSeriesInformation(series);
+      summary.ExtractInstanceInformation(instance);
+    }
+    printf("Extraction of the main tags of one instance: %.3f us\n",
+           timer.GetElapsedMicroseconds() / static_cast<double>(COUNT));
+  }
+
+  {
+    // Same operations as for one answer to a C-FIND query: Only the
+    // tags of the query are copied from the summary (cf. "AddAnswer()"
+    // in "OrthancFindRequestHandler.cpp")
+    DicomMap query;
+    DicomMap::SetupFindStudyTemplate(query);
+    DicomArray queryTags(query);
+
+    BenchmarkTimer timer;
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      DicomMap answer;
+      for (size_t j = 0; j < queryTags.GetSize(); j++)
+      {
+        const DicomTag& tag = queryTags.GetElement(j).GetTag();
+        const DicomValue* value = summary.TestAndGetValue(tag);
+        if (value == NULL)
+        {
+          answer.SetValue(tag, "");
+        }
+        else
+        {
+          answer.SetValue(tag, *value);
+        }
+      }
+
+      std::auto_ptr<DicomMap> clone(answer.Clone());
+    }
+    printf("Construction of one C-FIND answer: %.3f us\n",
+           timer.GetElapsedMicroseconds() / static_cast<double>(COUNT));
+  }
+}
@@ -231,3 +231,30 @@ TEST(FileStorageAccessor, Mix)
   ASSERT_THROW(accessor.Read(r, uncompressedInfo.GetUuid(), FileContentType_Unknown), OrthancException);
   */
 }
+
+
+TEST(FileStorageAccessor, ReadRange)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  CompressedFileStorageAccessor accessor(s);
+
+  std::string r;
+  std::string data = "HelloWorld";
+
+  accessor.SetCompressionForNextOperations(CompressionType_None);
+  FileInfo uncompressedInfo = accessor.Write(data, FileContentType_Dicom);
+
+  accessor.ReadRange(r, uncompressedInfo.GetUuid(), FileContentType_Unknown, 5, 10);
+  ASSERT_EQ("World", r);
+  accessor.ReadRange(r, uncompressedInfo.GetUuid(), FileContentType_Unknown, 3, 3);
+  ASSERT_TRUE(r.empty());
+  ASSERT_THROW(accessor.ReadRange(r, uncompressedInfo.GetUuid(), FileContentType_Unknown, 5, 11), OrthancException);
+  ASSERT_THROW(accessor.ReadRange(r, uncompressedInfo.GetUuid(), FileContentType_Unknown, 6, 5), OrthancException);
+
+  accessor.SetCompressionForNextOperations(CompressionType_Zlib);
+  FileInfo compressedInfo = accessor.Write(data, FileContentType_Dicom);
+
+  accessor.ReadRange(r, compressedInfo.GetUuid(), FileContentType_Unknown, 0, 5);
+  ASSERT_EQ("Hello", r);
+  ASSERT_THROW(accessor.ReadRange(r, compressedInfo.GetUuid(), FileContentType_Unknown, 5, 11), OrthancException);
+}
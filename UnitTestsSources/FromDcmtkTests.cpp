@@ -200,6 +200,94 @@ TEST(DicomModification, Png)
 }
 
 
+namespace
+{
+  class CountingPixelDataLoader : public ParsedDicomFile::IPixelDataLoader
+  {
+  private:
+    const std::string&  dicom_;
+    unsigned int&       count_;
+
+  public:
+    CountingPixelDataLoader(const std::string& dicom,
+                            unsigned int& count) :
+      dicom_(dicom),
+      count_(count)
+    {
+    }
+
+    virtual void ReadRange(std::string& target,
+                           uint64_t start,
+                           uint64_t end)
+    {
+      count_++;
+      target = dicom_.substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
+    }
+  };
+}
+
+
+TEST(ParsedDicomFile, LazyPixelData)
+{
+  std::string dicom;
+
+  {
+    ImageBuffer img;
+    img.SetWidth(16);
+    img.SetHeight(8);
+    img.SetFormat(PixelFormat_Grayscale8);
+
+    for (unsigned int y = 0; y < img.GetHeight(); y++)
+    {
+      uint8_t *p = reinterpret_cast<uint8_t*>(img.GetAccessor().GetRow(y));
+      for (unsigned int x = 0; x < img.GetWidth(); x++, p++)
+      {
+        *p = static_cast<uint8_t>(x + y * 16);
+      }
+    }
+
+    ParsedDicomFile o;
+    o.EmbedImage(img.GetAccessor());
+    o.SaveToMemoryBuffer(dicom);
+  }
+
+  ParsedDicomFile full(dicom);
+
+  unsigned int count = 0;
+  ParsedDicomFile lazy(dicom, new CountingPixelDataLoader(dicom, count));
+  ASSERT_FALSE(lazy.IsPixelDataLoaded());
+
+  std::string a, b;
+  ASSERT_TRUE(full.GetTagValue(a, DICOM_TAG_SOP_INSTANCE_UID));
+  ASSERT_TRUE(lazy.GetTagValue(b, DICOM_TAG_SOP_INSTANCE_UID));
+  ASSERT_EQ(a, b);
+
+  Json::Value fullJson, lazyJson;
+  full.ToJson(fullJson, false);
+  lazy.ToJson(lazyJson, false);
+  ASSERT_EQ(fullJson.toStyledString(), lazyJson.toStyledString());
+  ASSERT_EQ(0u, count);
+
+  ImageBuffer fullImage, lazyImage;
+  full.ExtractImage(fullImage, 0);
+  lazy.ExtractImage(lazyImage, 0);
+  ASSERT_EQ(1u, count);
+  ASSERT_TRUE(lazy.IsPixelDataLoaded());
+
+  ASSERT_EQ(fullImage.GetWidth(), lazyImage.GetWidth());
+  ASSERT_EQ(fullImage.GetHeight(), lazyImage.GetHeight());
+  for (unsigned int y = 0; y < fullImage.GetHeight(); y++)
+  {
+    ASSERT_EQ(0, memcmp(fullImage.GetAccessor().GetRow(y), lazyImage.GetAccessor().GetRow(y), 16));
+  }
+
+  std::string saved;
+  lazy.SaveToMemoryBuffer(saved);
+  ASSERT_EQ(1u, count);
+  ASSERT_EQ(dicom.size(), saved.size());
+}
+
+
 TEST(FromDcmtkBridge, Encodings1)
 {
   for (unsigned int i = 0; i < testEncodingsCount; i++)
@@ -289,6 +377,50 @@ TEST(FromDcmtkBridge, Encodings3)
 }
 
 
+#include "../OrthancServer/ServerToolbox.h"
+
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+TEST(FromDcmtkBridge, ExtractDicomSummaryAndJson)
+{
+  DcmDataset dataset;
+  ASSERT_TRUE(dataset.putAndInsertString(DCM_SpecificCharacterSet, "ISO_IR 100").good());
+  ASSERT_TRUE(dataset.putAndInsertString(DCM_PatientName, "H\xe9llo").good());
+  ASSERT_TRUE(dataset.putAndInsertString(DCM_StudyDescription, std::string(300, 'a').c_str()).good());
+
+  DcmItem* item = NULL;
+  ASSERT_TRUE(dataset.findOrCreateSequenceItem(DCM_ReferencedStudySequence, item, -2).good());
+  ASSERT_TRUE(item->putAndInsertString(DCM_ReferencedSOPInstanceUID, "1.2.3").good());
+
+  DicomMap summary;
+  Json::Value json, simplified;
+  FromDcmtkBridge::ExtractDicomSummaryAndJson(summary, json, simplified, dataset);
+
+  // The single pass must give the same results as the separate conversions
+  DicomMap summary2;
+  Json::Value json2, simplified2, simplified3;
+  FromDcmtkBridge::Convert(summary2, dataset);
+  FromDcmtkBridge::ToJson(json2, dataset);
+  FromDcmtkBridge::ToSimplifiedJson(simplified3, dataset);
+  SimplifyTags(simplified2, json2);
+
+  Json::Value a, b;
+  FromDcmtkBridge::ToJson(a, summary, false);
+  FromDcmtkBridge::ToJson(b, summary2, false);
+  ASSERT_EQ(a.toStyledString(), b.toStyledString());
+  ASSERT_EQ(json.toStyledString(), json2.toStyledString());
+  ASSERT_EQ(simplified.toStyledString(), simplified2.toStyledString());
+  ASSERT_EQ(simplified.toStyledString(), simplified3.toStyledString());
+
+  ASSERT_EQ("H\xc3\xa9llo", simplified["PatientName"].asString());
+  ASSERT_EQ("TooLong", json["0008,1030"]["Type"].asString());
+  ASSERT_EQ(Json::nullValue, simplified["StudyDescription"].type());
+  ASSERT_EQ(300u, summary.GetValue(0x0008, 0x1030).AsString().size());
+  ASSERT_EQ("1.2.3", simplified["ReferencedStudySequence"][0]["ReferencedSOPInstanceUID"].asString());
+  ASSERT_FALSE(summary.HasTag(0x0008, 0x1110));
+}
+
+
 TEST(FromDcmtkBridge, ValueRepresentation)
 {
   ASSERT_EQ(ValueRepresentation_PatientName, 
@@ -302,3 +434,89 @@ TEST(FromDcmtkBridge, ValueRepresentation)
   ASSERT_EQ(ValueRepresentation_Other, 
             FromDcmtkBridge::GetValueRepresentation(DICOM_TAG_PATIENT_ID));
 }
+
+
+#include "../OrthancServer/Internals/DicomImageDecoder.h"
+
+static void AddFragment(DcmPixelSequence& sequence,
+                        const std::string& content)
+{
+  std::auto_ptr<DcmPixelItem> item(new DcmPixelItem(DcmTag(DCM_Item, EVR_OB)));
+
+  if (!content.empty())
+  {
+    ASSERT_TRUE(item->putUint8Array(reinterpret_cast<const Uint8*>(content.c_str()), 
+                                    content.size()).good());
+  }
+
+  ASSERT_TRUE(sequence.insert(item.release()).good());
+}
+
+static std::string GetFragment(DcmPixelItem* item)
+{
+  Uint8* buffer = NULL;
+  if (item == NULL ||
+      !item->getUint8Array(buffer).good() ||
+      buffer == NULL)
+  {
+    throw OrthancException(ErrorCode_InternalError);
+  }
+
+  return std::string(reinterpret_cast<const char*>(buffer), item->getLength());
+}
+
+
+TEST(DicomImageDecoder, ExtractFragments)
+{
+  std::vector<DcmPixelItem*> fragments;
+
+  {
+    // One fragment per frame, with an empty Basic Offset Table
+    DcmPixelSequence sequence(DcmTag(DCM_PixelData, EVR_OB));
+    AddFragment(sequence, "");
+    AddFragment(sequence, "AAAA");
+    AddFragment(sequence, "BB");
+
+    ASSERT_TRUE(DicomImageDecoder::ExtractFragments(fragments, sequence, 1, 2));
+    ASSERT_EQ(1u, fragments.size());
+    ASSERT_EQ("BB", GetFragment(fragments[0]));
+    ASSERT_FALSE(DicomImageDecoder::ExtractFragments(fragments, sequence, 2, 2));
+
+    // One single frame spanning all the fragments
+    ASSERT_TRUE(DicomImageDecoder::ExtractFragments(fragments, sequence, 0, 1));
+    ASSERT_EQ(2u, fragments.size());
+    ASSERT_EQ("AAAA", GetFragment(fragments[0]));
+    ASSERT_EQ("BB", GetFragment(fragments[1]));
+  }
+
+  {
+    // 3 frames in 5 fragments: {A, B}, {C}, {D, E}. The offsets are
+    // relative to the first fragment, and include the item headers
+    // of 8 bytes: 0, (8 + 4) + (8 + 2) = 22, 22 + (8 + 6) = 36
+    DcmPixelSequence sequence(DcmTag(DCM_PixelData, EVR_OB));
+    AddFragment(sequence, std::string("\x00\x00\x00\x00" "\x16\x00\x00\x00" "\x24\x00\x00\x00", 12));
+    AddFragment(sequence, "AAAA");
+    AddFragment(sequence, "BB");
+    AddFragment(sequence, "CCCCCC");
+    AddFragment(sequence, "DD");
+    AddFragment(sequence, "EEEE");
+
+    ASSERT_TRUE(DicomImageDecoder::ExtractFragments(fragments, sequence, 0, 3));
+    ASSERT_EQ(2u, fragments.size());
+    ASSERT_EQ("AAAA", GetFragment(fragments[0]));
+    ASSERT_EQ("BB", GetFragment(fragments[1]));
+
+    ASSERT_TRUE(DicomImageDecoder::ExtractFragments(fragments, sequence, 1, 3));
+    ASSERT_EQ(1u, fragments.size());
+    ASSERT_EQ("CCCCCC", GetFragment(fragments[0]));
+
+    ASSERT_TRUE(DicomImageDecoder::ExtractFragments(fragments, sequence, 2, 3));
+    ASSERT_EQ(2u, fragments.size());
+    ASSERT_EQ("DD", GetFragment(fragments[0]));
+    ASSERT_EQ("EEEE", GetFragment(fragments[1]));
+
+    // The Basic Offset Table does not match the number of frames
+    ASSERT_FALSE(DicomImageDecoder::ExtractFragments(fragments, sequence, 0, 2));
+    ASSERT_FALSE(DicomImageDecoder::ExtractFragments(fragments, sequence, 3, 3));
+  }
+}
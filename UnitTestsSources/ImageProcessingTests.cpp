@@ -32,10 +32,19 @@
 
 #include "PrecompiledHeadersUnitTests.h"
 #include "gtest/gtest.h"
+#include "BenchmarkTimer.h"
 
 #include "../Core/DicomFormat/DicomImageInformation.h"
 #include "../Core/ImageFormats/ImageBuffer.h"
 #include "../Core/ImageFormats/ImageProcessing.h"
+#include "../Core/OrthancException.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+#include <boost/math/special_functions/round.hpp>
+#include <boost/noncopyable.hpp>
 
 using namespace Orthanc;
 
@@ -78,3 +87,529 @@ TEST(DicomImageInformation, ExtractPixelFormat2)
   ASSERT_TRUE(info.ExtractPixelFormat(format));
   ASSERT_EQ(PixelFormat_SignedGrayscale16, format);
 }
+
+
+namespace
+{
+  class TestImage : public boost::noncopyable
+  {
+  private:
+    std::vector<uint8_t> buffer_;
+    ImageAccessor accessor_;
+
+  public:
+    // The pitch is padded so that the rows are not contiguous, and
+    // the width is chosen so that the SIMD kernels have a remainder
+    TestImage(PixelFormat format,
+              unsigned int width,
+              unsigned int height)
+    {
+      unsigned int pitch = GetBytesPerPixel(format) * width + 7;
+      buffer_.resize(pitch * height);
+
+      for (size_t i = 0; i < buffer_.size(); i++)
+      {
+        buffer_[i] = static_cast<uint8_t>(rand() % 256);
+      }
+
+      accessor_.AssignWritable(format, width, height, pitch, &buffer_[0]);
+    }
+
+    ImageAccessor& GetAccessor()
+    {
+      return accessor_;
+    }
+
+    void CopyTo(TestImage& target) const
+    {
+      target.buffer_ = buffer_;
+    }
+
+    bool IsEqual(const TestImage& other) const
+    {
+      unsigned int lineSize = accessor_.GetBytesPerPixel() * accessor_.GetWidth();
+
+      for (unsigned int y = 0; y < accessor_.GetHeight(); y++)
+      {
+        if (memcmp(accessor_.GetConstRow(y), other.accessor_.GetConstRow(y), lineSize) != 0)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+  };
+
+
+  class SimdRestorer : public boost::noncopyable
+  {
+  private:
+    bool enabled_;
+
+  public:
+    SimdRestorer() : enabled_(ImageProcessing::IsSimdEnabled())
+    {
+    }
+
+    ~SimdRestorer()
+    {
+      ImageProcessing::SetSimdEnabled(enabled_);
+    }
+  };
+}
+
+
+static const PixelFormat GRAYSCALE_FORMATS[] = {
+  PixelFormat_Grayscale8,
+  PixelFormat_Grayscale16,
+  PixelFormat_SignedGrayscale16
+};
+
+
+static void CheckConvertSimd(PixelFormat targetFormat,
+                             PixelFormat sourceFormat)
+{
+  SimdRestorer restorer;
+
+  TestImage source(sourceFormat, 53, 17);
+  TestImage scalar(targetFormat, 53, 17);
+  TestImage simd(targetFormat, 53, 17);
+
+  ImageProcessing::SetSimdEnabled(false);
+  ImageProcessing::Convert(scalar.GetAccessor(), source.GetAccessor());
+
+  ImageProcessing::SetSimdEnabled(true);
+  ImageProcessing::Convert(simd.GetAccessor(), source.GetAccessor());
+
+  ASSERT_TRUE(scalar.IsEqual(simd));
+}
+
+
+TEST(ImageProcessing, ConvertSimd)
+{
+  for (size_t i = 0; i < 3; i++)
+  {
+    for (size_t j = 0; j < 3; j++)
+    {
+      CheckConvertSimd(GRAYSCALE_FORMATS[i], GRAYSCALE_FORMATS[j]);
+    }
+
+    CheckConvertSimd(GRAYSCALE_FORMATS[i], PixelFormat_RGB24);
+  }
+}
+
+
+TEST(ImageProcessing, GetMinMaxValueSimd)
+{
+  SimdRestorer restorer;
+
+  for (size_t i = 0; i < 3; i++)
+  {
+    TestImage image(GRAYSCALE_FORMATS[i], 45, 13);
+
+    int64_t a, b, c, d;
+    ImageProcessing::SetSimdEnabled(false);
+    ImageProcessing::GetMinMaxValue(a, b, image.GetAccessor());
+    ImageProcessing::SetSimdEnabled(true);
+    ImageProcessing::GetMinMaxValue(c, d, image.GetAccessor());
+
+    ASSERT_EQ(a, c);
+    ASSERT_EQ(b, d);
+  }
+
+  TestImage image(PixelFormat_Grayscale16, 45, 13);
+  ImageProcessing::Set(image.GetAccessor(), 1000);
+  reinterpret_cast<uint16_t*>(image.GetAccessor().GetRow(7)) [3] = 65535;
+  reinterpret_cast<uint16_t*>(image.GetAccessor().GetRow(12)) [44] = 2;
+
+  int64_t a, b;
+  ImageProcessing::GetMinMaxValue(a, b, image.GetAccessor());
+  ASSERT_EQ(2, a);
+  ASSERT_EQ(65535, b);
+}
+
+
+TEST(ImageProcessing, ShiftScaleSimd)
+{
+  SimdRestorer restorer;
+
+  static const float parameters[][2] = {
+    { 0.0f, 1.0f },
+    { -100.0f, 0.5f },
+    { 12.5f, -3.0f },
+    { -32768.0f, 255.0f / 65535.0f },
+    { 0.3f, 1.7f }
+  };
+
+  for (size_t i = 0; i < 3; i++)
+  {
+    for (size_t j = 0; j < sizeof(parameters) / sizeof(parameters[0]); j++)
+    {
+      TestImage scalar(GRAYSCALE_FORMATS[i], 61, 9);
+      TestImage simd(GRAYSCALE_FORMATS[i], 61, 9);
+      scalar.CopyTo(simd);
+
+      ImageProcessing::SetSimdEnabled(false);
+      ImageProcessing::ShiftScale(scalar.GetAccessor(), parameters[j][0], parameters[j][1]);
+      ImageProcessing::SetSimdEnabled(true);
+      ImageProcessing::ShiftScale(simd.GetAccessor(), parameters[j][0], parameters[j][1]);
+      ASSERT_TRUE(scalar.IsEqual(simd));
+
+      ImageProcessing::SetSimdEnabled(false);
+      ImageProcessing::MultiplyConstant(scalar.GetAccessor(), parameters[j][1]);
+      ImageProcessing::SetSimdEnabled(true);
+      ImageProcessing::MultiplyConstant(simd.GetAccessor(), parameters[j][1]);
+      ASSERT_TRUE(scalar.IsEqual(simd));
+    }
+  }
+}
+
+
+TEST(ImageProcessing, MultiplyConstantOverflow)
+{
+  SimdRestorer restorer;
+
+  static const float factors[] = {
+    1.0e10f,
+    -1.0e10f,
+    std::numeric_limits<float>::max(),
+    std::numeric_limits<float>::infinity(),
+    -std::numeric_limits<float>::infinity(),
+    std::numeric_limits<float>::quiet_NaN()
+  };
+
+  for (size_t i = 0; i < 3; i++)
+  {
+    for (size_t j = 0; j < sizeof(factors) / sizeof(factors[0]); j++)
+    {
+      TestImage scalar(GRAYSCALE_FORMATS[i], 61, 9);
+      TestImage simd(GRAYSCALE_FORMATS[i], 61, 9);
+      scalar.CopyTo(simd);
+
+      ImageProcessing::SetSimdEnabled(false);
+      ASSERT_NO_THROW(ImageProcessing::MultiplyConstant(scalar.GetAccessor(), factors[j]));
+      ImageProcessing::SetSimdEnabled(true);
+      ASSERT_NO_THROW(ImageProcessing::MultiplyConstant(simd.GetAccessor(), factors[j]));
+      ASSERT_TRUE(scalar.IsEqual(simd));
+    }
+  }
+
+  // The large positive pixels saturate to the maximum
+  TestImage image(PixelFormat_Grayscale16, 10, 1);
+  ImageProcessing::Set(image.GetAccessor(), 1000);
+  ImageProcessing::MultiplyConstant(image.GetAccessor(), 1.0e10f);
+
+  int64_t a, b;
+  ImageProcessing::GetMinMaxValue(a, b, image.GetAccessor());
+  ASSERT_EQ(65535, a);
+  ASSERT_EQ(65535, b);
+}
+
+
+TEST(ImageProcessing, GetRegion)
+{
+  TestImage image(PixelFormat_Grayscale16, 10, 8);
+
+  ImageAccessor region = image.GetAccessor().GetRegion(2, 3, 5, 4);
+  ASSERT_EQ(5u, region.GetWidth());
+  ASSERT_EQ(4u, region.GetHeight());
+  ASSERT_EQ(image.GetAccessor().GetPitch(), region.GetPitch());
+  ASSERT_EQ(reinterpret_cast<const uint16_t*>(image.GetAccessor().GetConstRow(4)) + 2,
+            region.GetConstRow(1));
+  ASSERT_FALSE(region.IsReadOnly());
+
+  ImageAccessor readOnly;
+  readOnly.AssignReadOnly(PixelFormat_Grayscale16, 10, 8, 
+                          image.GetAccessor().GetPitch(), image.GetAccessor().GetConstBuffer());
+  ASSERT_TRUE(readOnly.GetRegion(0, 0, 10, 8).IsReadOnly());
+
+  ASSERT_EQ(0u, image.GetAccessor().GetRegion(10, 8, 0, 0).GetWidth());
+  ASSERT_THROW(image.GetAccessor().GetRegion(6, 0, 5, 1), OrthancException);
+  ASSERT_THROW(image.GetAccessor().GetRegion(0, 7, 1, 2), OrthancException);
+}
+
+
+TEST(ImageProcessing, Parallel)
+{
+  // This image is large enough to be split into several bands
+  TestImage source(PixelFormat_SignedGrayscale16, 1021, 1537);
+
+  TestImage sequential(PixelFormat_Grayscale8, 1021, 1537);
+  TestImage parallel(PixelFormat_Grayscale8, 1021, 1537);
+  int64_t a, b, c, d;
+
+  ImageProcessing::SetThreadsCount(1);
+  ImageProcessing::GetMinMaxValue(a, b, source.GetAccessor());
+  ImageProcessing::Convert(sequential.GetAccessor(), source.GetAccessor());
+  ImageProcessing::ShiftScale(sequential.GetAccessor(), -10.0f, 1.5f);
+
+  ImageProcessing::SetThreadsCount(4);
+  ImageProcessing::GetMinMaxValue(c, d, source.GetAccessor());
+  ImageProcessing::Convert(parallel.GetAccessor(), source.GetAccessor());
+  ImageProcessing::ShiftScale(parallel.GetAccessor(), -10.0f, 1.5f);
+
+  ImageProcessing::SetThreadsCount(0);
+
+  ASSERT_EQ(a, c);
+  ASSERT_EQ(b, d);
+  ASSERT_TRUE(sequential.IsEqual(parallel));
+}
+
+
+TEST(ImageProcessing, ParallelUnevenBands)
+{
+  // 8 bands are requested, but 12 rows only give 6 bands of 2 rows
+  TestImage image(PixelFormat_Grayscale8, 180000, 12);
+
+  ImageProcessing::SetThreadsCount(8);
+
+  ImageProcessing::Set(image.GetAccessor(), 100);
+  reinterpret_cast<uint8_t*>(image.GetAccessor().GetRow(1)) [5] = 50;
+  reinterpret_cast<uint8_t*>(image.GetAccessor().GetRow(11)) [179999] = 150;
+
+  int64_t a, b;
+  ImageProcessing::GetMinMaxValue(a, b, image.GetAccessor());
+
+  ImageProcessing::SetThreadsCount(0);
+
+  ASSERT_EQ(50, a);
+  ASSERT_EQ(150, b);
+}
+
+
+TEST(ImageProcessing, FitSize)
+{
+  unsigned int w, h;
+  ImageProcessing::FitSize(w, h, 3000, 2000, 200, 200);  ASSERT_EQ(200u, w);  ASSERT_EQ(133u, h);
+  ImageProcessing::FitSize(w, h, 2000, 3000, 200, 200);  ASSERT_EQ(133u, w);  ASSERT_EQ(200u, h);
+  ImageProcessing::FitSize(w, h, 3000, 2000, 0, 100);    ASSERT_EQ(150u, w);  ASSERT_EQ(100u, h);
+  ImageProcessing::FitSize(w, h, 3000, 2000, 300, 0);    ASSERT_EQ(300u, w);  ASSERT_EQ(200u, h);
+  ImageProcessing::FitSize(w, h, 3000, 2000, 0, 0);      ASSERT_EQ(3000u, w); ASSERT_EQ(2000u, h);
+  ImageProcessing::FitSize(w, h, 100, 50, 200, 200);     ASSERT_EQ(100u, w);  ASSERT_EQ(50u, h);  // No upscaling
+  ImageProcessing::FitSize(w, h, 10000, 1, 100, 100);    ASSERT_EQ(100u, w);  ASSERT_EQ(1u, h);
+}
+
+
+TEST(ImageProcessing, Resize)
+{
+  {
+    // Integer factor, box filter
+    uint8_t pixels[] = { 0, 2, 10, 20,
+                         4, 6, 30, 40,
+                         1, 1, 255, 255,
+                         1, 2, 255, 254 };
+    ImageAccessor source;
+    source.AssignReadOnly(PixelFormat_Grayscale8, 4, 4, 4, pixels);
+
+    ImageBuffer target(2, 2, PixelFormat_Grayscale8);
+    ImageAccessor t = target.GetAccessor();
+    ImageProcessing::Resize(t, source, ImageInterpolation_Box);
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(t.GetConstRow(0));
+    ASSERT_EQ(3, p[0]);
+    ASSERT_EQ(25, p[1]);
+    p = reinterpret_cast<const uint8_t*>(t.GetConstRow(1));
+    ASSERT_EQ(1, p[0]);    // 1.25 is rounded down
+    ASSERT_EQ(255, p[1]);  // 254.75 is rounded up
+  }
+
+  {
+    // Non-integer factors preserve constant images
+    TestImage source(PixelFormat_SignedGrayscale16, 97, 53);
+    ImageProcessing::Set(source.GetAccessor(), -1234);
+
+    for (int i = 0; i < 2; i++)
+    {
+      ImageInterpolation interpolation = (i == 0 ? ImageInterpolation_Box : ImageInterpolation_Bilinear);
+
+      ImageBuffer target(31, 70, PixelFormat_SignedGrayscale16);
+      ImageAccessor t = target.GetAccessor();
+      ImageProcessing::Resize(t, source.GetAccessor(), interpolation);
+
+      int64_t a, b;
+      ImageProcessing::GetMinMaxValue(a, b, t);
+      ASSERT_EQ(-1234, a);
+      ASSERT_EQ(-1234, b);
+    }
+  }
+
+  {
+    // Fusion of the resizing with the stretching to 8bpp
+    uint16_t pixels[] = { 1000, 1000, 3000, 3000, 2000, 2000 };
+    ImageAccessor source;
+    source.AssignReadOnly(PixelFormat_Grayscale16, 6, 1, 12, pixels);
+
+    ImageBuffer target(3, 1, PixelFormat_Grayscale8);
+    ImageAccessor t = target.GetAccessor();
+    ImageProcessing::ResizeAndShiftScale(t, source, ImageInterpolation_Box, -1000.0f, 255.0f / 2000.0f);
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(t.GetConstRow(0));
+    ASSERT_EQ(0, p[0]);
+    ASSERT_EQ(255, p[1]);
+    ASSERT_EQ(128, p[2]);
+  }
+
+  {
+    // Color images
+    uint8_t pixels[] = { 10, 20, 30,   30, 40, 50,   0, 0, 0,
+                         10, 20, 30,   30, 40, 50,   0, 0, 0 };
+    ImageAccessor source;
+    source.AssignReadOnly(PixelFormat_RGB24, 3, 2, 9, pixels);
+
+    ImageBuffer target(2, 1, PixelFormat_RGB24);
+    ImageAccessor t = target.GetAccessor();
+    ImageProcessing::Resize(t, source, ImageInterpolation_Box);
+
+    // The first target pixel covers 1.5 source pixels
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(t.GetConstRow(0));
+    ASSERT_EQ(17, p[0]);  // (10 + 0.5 * 30) / 1.5 = 16.67
+    ASSERT_EQ(27, p[1]);
+    ASSERT_EQ(37, p[2]);
+    ASSERT_EQ(10, p[3]);  // (0.5 * 30 + 0) / 1.5
+    ASSERT_EQ(13, p[4]);
+    ASSERT_EQ(17, p[5]);
+
+    ImageBuffer gray(2, 1, PixelFormat_Grayscale8);
+    ImageAccessor g = gray.GetAccessor();
+    ASSERT_THROW(ImageProcessing::Resize(g, source, ImageInterpolation_Box), OrthancException);
+  }
+}
+
+
+TEST(ImageProcessing, Windowing)
+{
+  {
+    // CT image in Hounsfield units, with a typical "abdomen" window
+    int16_t pixels[] = { 0, 864, 1024, 1224, 1424, 2000 };
+    ImageAccessor source;
+    source.AssignReadOnly(PixelFormat_SignedGrayscale16, 6, 1, 12, pixels);
+
+    ImageBuffer target(6, 1, PixelFormat_Grayscale8);
+    ImageAccessor t = target.GetAccessor();
+    ImageProcessing::ApplyWindowing(t, source, 40.0f, 400.0f, 1.0f, -1024.0f, false);
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(t.GetConstRow(0));
+    ASSERT_EQ(0, p[0]);    // -1024 HU
+    ASSERT_EQ(0, p[1]);    // -160 HU
+    ASSERT_EQ(102, p[2]);  // 0 HU
+    ASSERT_EQ(230, p[3]);  // 200 HU
+    ASSERT_EQ(255, p[4]);  // 400 HU
+    ASSERT_EQ(255, p[5]);
+
+    // MONOCHROME1
+    ImageProcessing::ApplyWindowing(t, source, 40.0f, 400.0f, 1.0f, -1024.0f, true);
+    ASSERT_EQ(255, p[0]);
+    ASSERT_EQ(153, p[2]);
+    ASSERT_EQ(0, p[5]);
+
+    ASSERT_THROW(ImageProcessing::ApplyWindowing(t, source, 40.0f, 0.5f, 1.0f, 0.0f, false), OrthancException);
+  }
+
+  {
+    // The lookup table must give the same result as the direct
+    // computation, for all the grayscale formats
+    for (size_t i = 0; i < sizeof(GRAYSCALE_FORMATS) / sizeof(PixelFormat); i++)
+    {
+      TestImage source(GRAYSCALE_FORMATS[i], 1021, 1537);
+      ImageBuffer target(1021, 1537, PixelFormat_Grayscale8);
+      ImageAccessor t = target.GetAccessor();
+      ImageProcessing::ApplyWindowing(t, source.GetAccessor(), 100.0f, 50.0f, 2.0f, -30.0f, false);
+
+      for (unsigned int y = 0; y < source.GetAccessor().GetHeight(); y++)
+      {
+        for (unsigned int x = 0; x < source.GetAccessor().GetWidth(); x++)
+        {
+          int32_t v;
+          const void* row = source.GetAccessor().GetConstRow(y);
+          switch (GRAYSCALE_FORMATS[i])
+          {
+            case PixelFormat_Grayscale8:
+              v = reinterpret_cast<const uint8_t*>(row) [x];
+              break;
+
+            case PixelFormat_Grayscale16:
+              v = reinterpret_cast<const uint16_t*>(row) [x];
+              break;
+
+            default:
+              v = reinterpret_cast<const int16_t*>(row) [x];
+          }
+
+          float hu = 2.0f * static_cast<float>(v) - 30.0f;
+          uint8_t expectedValue;
+          if (hu <= 74.5f)
+            expectedValue = 0;
+          else if (hu > 123.5f)
+            expectedValue = 255;
+          else
+            expectedValue = static_cast<uint8_t>(boost::math::iround(((hu - 99.5f) / 49.0f + 0.5f) * 255.0f));
+
+          ASSERT_EQ(expectedValue, reinterpret_cast<const uint8_t*>(t.GetConstRow(y)) [x]);
+        }
+      }
+    }
+  }
+}
+
+
+static void BenchmarkKernel(const char* name,
+                            ImageAccessor& image,
+                            void (*kernel) (ImageAccessor& image))
+{
+  static const unsigned int COUNT = 10;
+
+  SimdRestorer restorer;
+
+  for (int simd = 0; simd < 2; simd++)
+  {
+    ImageProcessing::SetSimdEnabled(simd == 1);
+
+    BenchmarkTimer timer;
+    for (unsigned int i = 0; i < COUNT; i++)
+    {
+      kernel(image);
+    }
+
+    double pixels = static_cast<double>(COUNT) * image.GetWidth() * image.GetHeight();
+    printf("%-40s %-6s %10.1f MPixels/s\n", name, simd ? "SIMD" : "scalar",
+           pixels / timer.GetElapsedMicroseconds());
+  }
+}
+
+
+static void BenchmarkConvertTo8(ImageAccessor& image)
+{
+  ImageBuffer target(image.GetWidth(), image.GetHeight(), PixelFormat_Grayscale8);
+  ImageAccessor accessor = target.GetAccessor();
+  ImageProcessing::Convert(accessor, image);
+}
+
+static void BenchmarkMinMax(ImageAccessor& image)
+{
+  int64_t a, b;
+  ImageProcessing::GetMinMaxValue(a, b, image);
+}
+
+static void BenchmarkShiftScale(ImageAccessor& image)
+{
+  ImageProcessing::ShiftScale(image, -10.0f, 0.99f);
+}
+
+static void BenchmarkMultiplyConstant(ImageAccessor& image)
+{
+  ImageProcessing::MultiplyConstant(image, 1.01f);
+}
+
+
+TEST(ImageProcessing, DISABLED_Benchmark)
+{
+  TestImage gray16(PixelFormat_Grayscale16, 4096, 4096);
+  TestImage color(PixelFormat_RGB24, 4096, 4096);
+
+  BenchmarkKernel("Convert (Grayscale16 -> Grayscale8)", gray16.GetAccessor(), BenchmarkConvertTo8);
+  BenchmarkKernel("Convert (RGB24 -> Grayscale8)", color.GetAccessor(), BenchmarkConvertTo8);
+  BenchmarkKernel("GetMinMaxValue (Grayscale16)", gray16.GetAccessor(), BenchmarkMinMax);
+  BenchmarkKernel("ShiftScale (Grayscale16)", gray16.GetAccessor(), BenchmarkShiftScale);
+  BenchmarkKernel("MultiplyConstant (Grayscale16)", gray16.GetAccessor(), BenchmarkMultiplyConstant);
+}
@@ -0,0 +1,133 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersUnitTests.h"
+#include "gtest/gtest.h"
+
+#if ORTHANC_JPEG_ENABLED == 1
+
+#include <stdint.h>
+#include "../Core/ImageFormats/ImageBuffer.h"
+#include "../Core/ImageFormats/JpegWriter.h"
+#include "../Core/OrthancException.h"
+#include "../Core/Toolbox.h"
+
+using namespace Orthanc;
+
+
+static void CheckJpegMarkers(const std::string& jpeg)
+{
+  // Start Of Image and End Of Image markers
+  ASSERT_LE(4u, jpeg.size());
+  ASSERT_EQ(0xff, static_cast<uint8_t>(jpeg[0]));
+  ASSERT_EQ(0xd8, static_cast<uint8_t>(jpeg[1]));
+  ASSERT_EQ(0xff, static_cast<uint8_t>(jpeg[jpeg.size() - 2]));
+  ASSERT_EQ(0xd9, static_cast<uint8_t>(jpeg[jpeg.size() - 1]));
+}
+
+
+static void FillGradient(ImageAccessor& image)
+{
+  const unsigned int channels = (image.GetFormat() == PixelFormat_RGB24 ? 3 : 1);
+
+  for (unsigned int y = 0; y < image.GetHeight(); y++)
+  {
+    uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
+    for (unsigned int x = 0; x < image.GetWidth() * channels; x++, p++)
+    {
+      *p = static_cast<uint8_t>((x + 3 * y) % 256);
+    }
+  }
+}
+
+
+TEST(JpegWriter, Basic)
+{
+  ImageBuffer buffer(227, 131, PixelFormat_Grayscale8);
+  ImageAccessor image(buffer.GetAccessor());
+  FillGradient(image);
+
+  JpegWriter w;
+  ASSERT_EQ(90, w.GetQuality());
+
+  std::string jpeg, file;
+  w.WriteToMemory(jpeg, image);
+  CheckJpegMarkers(jpeg);
+
+  w.WriteToFile("UnitTestsResults/Gradient.jpg", image);
+  Toolbox::ReadFile(file, "UnitTestsResults/Gradient.jpg");
+  ASSERT_EQ(jpeg, file);
+
+  // Lower quality results in smaller files
+  std::string low;
+  w.SetQuality(10);
+  w.WriteToMemory(low, image);
+  CheckJpegMarkers(low);
+  ASSERT_LT(low.size(), jpeg.size());
+}
+
+
+TEST(JpegWriter, Formats)
+{
+  JpegWriter w;
+  std::string jpeg, gray;
+
+  {
+    ImageBuffer buffer(64, 48, PixelFormat_RGB24);
+    ImageAccessor image(buffer.GetAccessor());
+    FillGradient(image);
+    w.WriteToMemory(jpeg, image);
+    CheckJpegMarkers(jpeg);
+  }
+
+  {
+    // Non-contiguous rows
+    ImageBuffer buffer(64, 48, PixelFormat_Grayscale8);
+    ImageAccessor image(buffer.GetAccessor());
+    FillGradient(image);
+    w.WriteToMemory(gray, image.GetRegion(5, 7, 31, 17));
+    CheckJpegMarkers(gray);
+  }
+
+  ImageBuffer gray16(16, 16, PixelFormat_Grayscale16);
+  ImageBuffer rgba(16, 16, PixelFormat_RGBA32);
+  ASSERT_THROW(w.WriteToMemory(jpeg, gray16.GetConstAccessor()), OrthancException);
+  ASSERT_THROW(w.WriteToMemory(jpeg, rgba.GetConstAccessor()), OrthancException);
+
+  ASSERT_THROW(w.SetQuality(0), OrthancException);
+  ASSERT_THROW(w.SetQuality(101), OrthancException);
+  w.SetQuality(1);
+  w.SetQuality(100);
+  ASSERT_EQ(100, w.GetQuality());
+}
+
+#endif
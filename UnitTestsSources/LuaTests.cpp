@@ -35,6 +35,7 @@
 
 #include "../Core/Toolbox.h"
 #include "../Core/Lua/LuaFunctionCall.h"
+#include "../Core/Lua/LuaContextPool.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -112,6 +113,81 @@ TEST(Lua, Existing)
 }
 
 
+TEST(LuaContextPool, Basic)
+{
+  Orthanc::LuaContextPool pool(3);
+  ASSERT_EQ(3u, pool.GetSize());
+  ASSERT_FALSE(pool.IsSerialized());
+
+  pool.Execute("x = 42");
+  pool.Execute("function f() end");
+
+  {
+    // Each locker gets its own interpreter, loaded with the scripts
+    Orthanc::LuaContextPool::Locker a(pool);
+    Orthanc::LuaContextPool::Locker b(pool);
+    Orthanc::LuaContextPool::Locker c(pool);
+    ASSERT_NE(&a.GetLua(), &b.GetLua());
+    ASSERT_NE(&a.GetLua(), &c.GetLua());
+    ASSERT_NE(&b.GetLua(), &c.GetLua());
+
+    std::string s;
+    c.GetLua().Execute(s, "print(x)");
+    ASSERT_EQ("42\n", s);
+    ASSERT_TRUE(c.GetLua().IsExistingFunction("f"));
+
+    // The global variables are not shared between the interpreters
+    a.GetLua().Execute("x = 43");
+    b.GetLua().Execute(s, "print(x)");
+    ASSERT_EQ("42\n", s);
+  }
+
+  pool.SetSerialized(true);
+  ASSERT_TRUE(pool.IsSerialized());
+
+  Orthanc::LuaContext* first;
+
+  {
+    Orthanc::LuaContextPool::Locker a(pool);
+    first = &a.GetLua();
+    a.GetLua().Execute("y = 1");
+  }
+
+  {
+    // In serialized mode, the same interpreter is always used
+    Orthanc::LuaContextPool::Locker a(pool);
+    ASSERT_EQ(first, &a.GetLua());
+
+    std::string s;
+    a.GetLua().Execute(s, "print(y)");
+    ASSERT_EQ("1\n", s);
+  }
+}
+
+
+TEST(LuaContextPool, Broadcast)
+{
+  Orthanc::LuaContextPool pool(3);
+
+  std::string s;
+  pool.Broadcast(s, "x = 42; function f() return x end; print('ok')");
+  ASSERT_EQ("ok\n", s);
+
+  // An error must not leave any interpreter reserved
+  ASSERT_THROW(pool.Broadcast(s, "nope("), Orthanc::LuaException);
+
+  Orthanc::LuaContextPool::Locker a(pool);
+  Orthanc::LuaContextPool::Locker b(pool);
+  Orthanc::LuaContextPool::Locker c(pool);
+  a.GetLua().Execute(s, "print(f())");
+  ASSERT_EQ("42\n", s);
+  b.GetLua().Execute(s, "print(f())");
+  ASSERT_EQ("42\n", s);
+  c.GetLua().Execute(s, "print(f())");
+  ASSERT_EQ("42\n", s);
+}
+
+
 TEST(Lua, Simple)
 {
   Orthanc::LuaContext lua;
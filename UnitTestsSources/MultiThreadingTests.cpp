@@ -41,6 +41,7 @@
 #include "../Core/MultiThreading/Locker.h"
 #include "../Core/MultiThreading/Mutex.h"
 #include "../Core/MultiThreading/ReaderWriterLock.h"
+#include "../Core/MultiThreading/ThreadPool.h"
 
 using namespace Orthanc;
 
@@ -131,6 +132,87 @@ TEST(MultiThreading, ReaderWriterLock)
 
 #include "../OrthancServer/DicomProtocol/ReusableDicomUserConnection.h"
 
+namespace
+{
+  class IncrementCommand : public ICommand
+  {
+  private:
+    boost::mutex& mutex_;
+    int& counter_;
+    bool success_;
+
+  public:
+    IncrementCommand(boost::mutex& mutex,
+                     int& counter,
+                     bool success) :
+      mutex_(mutex),
+      counter_(counter),
+      success_(success)
+    {
+    }
+
+    virtual bool Execute()
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+
+      boost::mutex::scoped_lock lock(mutex_);
+      counter_++;
+      return success_;
+    }
+  };
+
+  class ThrowingCommand : public ICommand
+  {
+  public:
+    virtual bool Execute()
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  };
+}
+
+
+TEST(MultiThreading, ThreadPool)
+{
+  for (unsigned int workers = 0; workers < 4; workers++)
+  {
+    ThreadPool pool(workers);
+    ASSERT_EQ(workers, pool.GetWorkersCount());
+
+    boost::mutex mutex;
+    int counter = 0;
+
+    std::vector<ICommand*> commands;
+    ASSERT_TRUE(pool.ExecuteBatch(commands));
+
+    for (int i = 0; i < 20; i++)
+    {
+      commands.push_back(new IncrementCommand(mutex, counter, true));
+    }
+
+    ASSERT_TRUE(pool.ExecuteBatch(commands));
+    ASSERT_EQ(20, counter);
+
+    IncrementCommand failure(mutex, counter, false);
+    commands.push_back(&failure);
+    ASSERT_FALSE(pool.ExecuteBatch(commands));
+    ASSERT_EQ(41, counter);
+    commands.pop_back();
+
+    ThrowingCommand throwing;
+    commands.push_back(&throwing);
+    ASSERT_THROW(pool.ExecuteBatch(commands), OrthancException);
+    ASSERT_EQ(61, counter);
+    commands.pop_back();
+
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+      delete commands[i];
+    }
+  }
+}
+
+
 TEST(ReusableDicomUserConnection, DISABLED_Basic)
 {
   ReusableDicomUserConnection c;
@@ -36,6 +36,9 @@
 #include <glog/logging.h>
 
 #include "../Plugins/Engine/PluginsManager.h"
+#include "../Plugins/Engine/PluginsChangesDispatcher.h"
+
+#include <boost/lexical_cast.hpp>
 
 using namespace Orthanc;
 
@@ -76,3 +79,249 @@ TEST(SharedLibrary, Basic)
 #error Support your platform here
 #endif
 }
+
+
+namespace
+{
+  // The "OnChanges" callbacks have no payload
+  class ChangesRecorder
+  {
+  private:
+    static boost::mutex               mutex_;
+    static boost::condition_variable  received_;
+    static std::vector<size_t>        batches_;
+    static std::vector<int64_t>       seqs_;
+    static std::vector<std::string>   ids_;
+
+  public:
+    static void Reset()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      batches_.clear();
+      seqs_.clear();
+      ids_.clear();
+    }
+
+    static int32_t Callback(const OrthancPluginChangeEvent* changes,
+                            uint32_t count)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      batches_.push_back(count);
+
+      for (uint32_t i = 0; i < count; i++)
+      {
+        seqs_.push_back(changes[i].seq);
+        ids_.push_back(changes[i].resourceId);
+      }
+
+      received_.notify_all();
+      return 0;
+    }
+
+    // Waits for at most 10 seconds until "count" changes are received
+    static bool WaitCount(size_t count)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      boost::system_time timeout = boost::get_system_time() + boost::posix_time::seconds(10);
+
+      while (seqs_.size() < count)
+      {
+        if (!received_.timed_wait(lock, timeout))
+        {
+          return seqs_.size() >= count;
+        }
+      }
+
+      return true;
+    }
+
+    static std::vector<size_t> GetBatches()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return batches_;
+    }
+
+    static std::vector<int64_t> GetSeqs()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return seqs_;
+    }
+
+    static std::vector<std::string> GetIds()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return ids_;
+    }
+  };
+
+  boost::mutex               ChangesRecorder::mutex_;
+  boost::condition_variable  ChangesRecorder::received_;
+  std::vector<size_t>        ChangesRecorder::batches_;
+  std::vector<int64_t>       ChangesRecorder::seqs_;
+  std::vector<std::string>   ChangesRecorder::ids_;
+
+
+  void EnqueueChange(PluginsChangesDispatcher& dispatcher,
+                     int64_t seq)
+  {
+    // The strings are only valid during the call to Enqueue()
+    std::string id = "resource-" + boost::lexical_cast<std::string>(seq);
+    std::string date = "20151017T120000";
+
+    OrthancPluginChangeEvent change;
+    change.seq = seq;
+    change.changeType = OrthancPluginChangeType_NewInstance;
+    change.resourceType = OrthancPluginResourceType_Instance;
+    change.resourceId = id.c_str();
+    change.date = date.c_str();
+    dispatcher.Enqueue(change);
+  }
+}
+
+
+TEST(PluginsChangesDispatcher, Batches)
+{
+  ChangesRecorder::Reset();
+
+  {
+    // With a long latency, only full batches are delivered, until the
+    // dispatcher is stopped, which flushes the last partial batch
+    PluginsChangesDispatcher dispatcher(ChangesRecorder::Callback, 3, 10000, 100, NULL);
+
+    for (int64_t seq = 10; seq < 17; seq++)
+    {
+      EnqueueChange(dispatcher, seq);
+    }
+
+    ASSERT_TRUE(ChangesRecorder::WaitCount(6));
+    dispatcher.Stop();
+  }
+
+  std::vector<size_t> batches = ChangesRecorder::GetBatches();
+  ASSERT_EQ(3u, batches.size());
+  ASSERT_EQ(3u, batches[0]);
+  ASSERT_EQ(3u, batches[1]);
+  ASSERT_EQ(1u, batches[2]);
+
+  // The changes are delivered in order, with their sequence number
+  std::vector<int64_t> seqs = ChangesRecorder::GetSeqs();
+  std::vector<std::string> ids = ChangesRecorder::GetIds();
+  ASSERT_EQ(7u, seqs.size());
+  for (size_t i = 0; i < seqs.size(); i++)
+  {
+    ASSERT_EQ(static_cast<int64_t>(10 + i), seqs[i]);
+    ASSERT_EQ("resource-" + boost::lexical_cast<std::string>(10 + i), ids[i]);
+  }
+}
+
+
+TEST(PluginsChangesDispatcher, Latency)
+{
+  ChangesRecorder::Reset();
+
+  // A partial batch is delivered once the latency has expired,
+  // without stopping the dispatcher
+  PluginsChangesDispatcher dispatcher(ChangesRecorder::Callback, 100, 10, 100, NULL);
+  EnqueueChange(dispatcher, 1);
+  EnqueueChange(dispatcher, 2);
+  ASSERT_TRUE(ChangesRecorder::WaitCount(2));
+
+  std::vector<int64_t> seqs = ChangesRecorder::GetSeqs();
+  ASSERT_EQ(2u, seqs.size());
+  ASSERT_EQ(1, seqs[0]);
+  ASSERT_EQ(2, seqs[1]);
+
+  ASSERT_THROW(PluginsChangesDispatcher(ChangesRecorder::Callback, 0, 10, 100, NULL), OrthancException);
+  ASSERT_THROW(PluginsChangesDispatcher(ChangesRecorder::Callback, 100, 10, 0, NULL), OrthancException);
+}
+
+
+namespace
+{
+  // Log of changes whose sequence numbers go from 1 to "last"
+  class ChangesLog : public PluginsChangesDispatcher::IChangesLog
+  {
+  private:
+    int64_t  last_;
+
+  public:
+    ChangesLog(int64_t last) : last_(last)
+    {
+    }
+
+    virtual bool ReadChanges(std::list<PluginsChangesDispatcher::Change>& target,
+                             int64_t& last,
+                             int64_t since,
+                             size_t maxResults)
+    {
+      target.clear();
+      last = since;
+
+      while (target.size() < maxResults &&
+             last < last_)
+      {
+        last++;
+
+        PluginsChangesDispatcher::Change change;
+        change.seq_ = last;
+        change.changeType_ = OrthancPluginChangeType_NewInstance;
+        change.resourceType_ = OrthancPluginResourceType_Instance;
+        change.resourceId_ = "resource-" + boost::lexical_cast<std::string>(last);
+        change.date_ = "20151017T120000";
+        target.push_back(change);
+      }
+
+      return last == last_;
+    }
+  };
+}
+
+
+TEST(PluginsChangesDispatcher, Overflow)
+{
+  ChangesRecorder::Reset();
+
+  {
+    // The queue holds 3 changes: The 7 next changes are read from the
+    // log once the queue is delivered
+    ChangesLog log(10);
+    PluginsChangesDispatcher dispatcher(ChangesRecorder::Callback, 100, 10000, 3, &log);
+
+    for (int64_t seq = 1; seq <= 10; seq++)
+    {
+      EnqueueChange(dispatcher, seq);
+    }
+
+    dispatcher.Stop();
+  }
+
+  std::vector<size_t> batches = ChangesRecorder::GetBatches();
+  ASSERT_EQ(2u, batches.size());
+  ASSERT_EQ(3u, batches[0]);
+  ASSERT_EQ(7u, batches[1]);
+
+  std::vector<int64_t> seqs = ChangesRecorder::GetSeqs();
+  std::vector<std::string> ids = ChangesRecorder::GetIds();
+  ASSERT_EQ(10u, seqs.size());
+  for (size_t i = 0; i < seqs.size(); i++)
+  {
+    ASSERT_EQ(static_cast<int64_t>(1 + i), seqs[i]);
+    ASSERT_EQ("resource-" + boost::lexical_cast<std::string>(1 + i), ids[i]);
+  }
+
+  ChangesRecorder::Reset();
+
+  {
+    // Without a log, the changes that do not fit in the queue are lost
+    PluginsChangesDispatcher dispatcher(ChangesRecorder::Callback, 100, 10000, 3, NULL);
+
+    for (int64_t seq = 1; seq <= 10; seq++)
+    {
+      EnqueueChange(dispatcher, seq);
+    }
+
+    dispatcher.Stop();
+  }
+
+  ASSERT_EQ(3u, ChangesRecorder::GetSeqs().size());
+}
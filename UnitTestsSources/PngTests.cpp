@@ -34,8 +34,12 @@
 #include "gtest/gtest.h"
 
 #include <stdint.h>
+#include <string.h>
+#include "../Core/ImageFormats/ImageBuffer.h"
+#include "../Core/ImageFormats/ImageProcessing.h"
 #include "../Core/ImageFormats/PngReader.h"
 #include "../Core/ImageFormats/PngWriter.h"
+#include "../Core/OrthancException.h"
 #include "../Core/Toolbox.h"
 #include "../Core/Uuid.h"
 
@@ -184,3 +188,119 @@ TEST(PngWriter, EndToEnd)
     }
   }
 }
+
+
+static void CheckPngRoundTrip(Orthanc::PngWriter& writer,
+                              const Orthanc::ImageAccessor& image)
+{
+  std::string s;
+  writer.WriteToMemory(s, image);
+
+  Orthanc::PngReader r;
+  r.ReadFromMemory(s);
+
+  ASSERT_EQ(image.GetFormat(), r.GetFormat());
+  ASSERT_EQ(image.GetWidth(), r.GetWidth());
+  ASSERT_EQ(image.GetHeight(), r.GetHeight());
+
+  size_t rowSize = image.GetWidth() * Orthanc::GetBytesPerPixel(image.GetFormat());
+  for (unsigned int y = 0; y < image.GetHeight(); y++)
+  {
+    ASSERT_EQ(0, memcmp(image.GetConstRow(y), r.GetConstRow(y), rowSize));
+  }
+}
+
+
+TEST(PngWriter, Settings)
+{
+  Orthanc::PngWriter w;
+  ASSERT_EQ(6u, w.GetCompressionLevel());
+  ASSERT_EQ(Orthanc::PngFilter_Adaptive, w.GetFilter());
+  ASSERT_TRUE(w.IsParallelEnabled());
+  ASSERT_THROW(w.SetCompressionLevel(10), Orthanc::OrthancException);
+
+  w.SetFastPreset();
+  ASSERT_EQ(1u, w.GetCompressionLevel());
+  ASSERT_EQ(Orthanc::PngFilter_Sub, w.GetFilter());
+
+  Orthanc::ImageBuffer image(93, 47, Orthanc::PixelFormat_RGB24);
+  Orthanc::ImageAccessor accessor = image.GetAccessor();
+  for (unsigned int y = 0; y < accessor.GetHeight(); y++)
+  {
+    uint8_t* p = reinterpret_cast<uint8_t*>(accessor.GetRow(y));
+    for (unsigned int x = 0; x < accessor.GetWidth() * 3; x++)
+    {
+      p[x] = static_cast<uint8_t>((x * y) % 251);
+    }
+  }
+
+  for (unsigned int level = 0; level <= 9; level++)
+  {
+    Orthanc::PngWriter writer;
+    writer.SetCompressionLevel(level);
+    writer.SetFilter(static_cast<Orthanc::PngFilter>(level % 6));
+    CheckPngRoundTrip(writer, accessor);
+  }
+}
+
+
+TEST(PngWriter, Parallel)
+{
+  Orthanc::ImageProcessing::SetThreadsCount(4);
+
+  const Orthanc::PixelFormat formats[] = {
+    Orthanc::PixelFormat_Grayscale8,
+    Orthanc::PixelFormat_Grayscale16,
+    Orthanc::PixelFormat_RGB24,
+    Orthanc::PixelFormat_RGBA32
+  };
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+  {
+    // Large enough to be split into several blocks
+    Orthanc::ImageBuffer image(1031, 1543, formats[i]);
+    Orthanc::ImageAccessor accessor = image.GetAccessor();
+
+    for (unsigned int y = 0; y < accessor.GetHeight(); y++)
+    {
+      uint8_t* p = reinterpret_cast<uint8_t*>(accessor.GetRow(y));
+      for (unsigned int x = 0; x < accessor.GetWidth() * Orthanc::GetBytesPerPixel(formats[i]); x++)
+      {
+        p[x] = static_cast<uint8_t>((x / 7 + y / 3 + (x * y) % 5) % 256);
+      }
+    }
+
+    for (int filter = Orthanc::PngFilter_Adaptive; filter <= Orthanc::PngFilter_Paeth; filter++)
+    {
+      Orthanc::PngWriter parallel;
+      parallel.SetFilter(static_cast<Orthanc::PngFilter>(filter));
+      parallel.SetCompressionLevel(filter % 2 == 0 ? 1 : 6);
+      CheckPngRoundTrip(parallel, accessor);
+    }
+
+    Orthanc::PngWriter serial;
+    serial.SetParallelEnabled(false);
+    CheckPngRoundTrip(serial, accessor);
+  }
+
+  {
+    // Each block of rows is stored in a separate IDAT chunk
+    Orthanc::ImageBuffer image(1024, 2048, Orthanc::PixelFormat_Grayscale8);
+    Orthanc::ImageAccessor accessor = image.GetAccessor();
+    Orthanc::ImageProcessing::Set(accessor, 42);
+
+    std::string s;
+    Orthanc::PngWriter w;
+    w.WriteToMemory(s, accessor);
+
+    size_t count = 0;
+    for (size_t pos = s.find("IDAT"); pos != std::string::npos; pos = s.find("IDAT", pos + 1))
+    {
+      count++;
+    }
+
+    ASSERT_LT(1u, count);
+  }
+
+  Orthanc::ImageProcessing::SetThreadsCount(0);
+}
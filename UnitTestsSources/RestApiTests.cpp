@@ -43,6 +43,7 @@
 #include "../Core/OrthancException.h"
 #include "../Core/Compression/ZlibCompressor.h"
 #include "../Core/RestApi/RestApiHierarchy.h"
+#include "../Core/HttpServer/HttpOutput.h"
 
 using namespace Orthanc;
 
@@ -120,6 +121,197 @@ TEST(RestApi, ParseCookies)
   ASSERT_EQ("v", cookies["n"]);
 }
 
+TEST(RestApi, ParseRange)
+{
+  bool satisfiable;
+  uint64_t start, end;
+
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=0-9", 100));
+  ASSERT_TRUE(satisfiable);
+  ASSERT_EQ(0u, start);
+  ASSERT_EQ(10u, end);
+
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, " bytes=90- ", 100));
+  ASSERT_TRUE(satisfiable);
+  ASSERT_EQ(90u, start);
+  ASSERT_EQ(100u, end);
+
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=50-1000", 100));
+  ASSERT_TRUE(satisfiable);
+  ASSERT_EQ(50u, start);
+  ASSERT_EQ(100u, end);
+
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=-10", 100));
+  ASSERT_TRUE(satisfiable);
+  ASSERT_EQ(90u, start);
+  ASSERT_EQ(100u, end);
+
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=-1000", 100));
+  ASSERT_TRUE(satisfiable);
+  ASSERT_EQ(0u, start);
+  ASSERT_EQ(100u, end);
+
+  // Valid, but not satisfiable
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=100-", 100));
+  ASSERT_FALSE(satisfiable);
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=200-300", 100));
+  ASSERT_FALSE(satisfiable);
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=-0", 100));
+  ASSERT_FALSE(satisfiable);
+  ASSERT_TRUE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=0-1", 0));
+  ASSERT_FALSE(satisfiable);
+
+  // Invalid or unsupported, to be ignored
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "", 100));
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=10-5", 100));
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=0-1,5-6", 100));
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=a-b", 100));
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=--5", 100));
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=-", 100));
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "bytes=99999999999999999999-", 100));
+  ASSERT_FALSE(HttpHandler::ParseRange(satisfiable, start, end, "items=0-1", 100));
+}
+
+TEST(RestApi, SelectMediaType)
+{
+  std::vector<std::string> c;
+  c.push_back("image/png");
+  c.push_back("image/jpeg");
+
+  size_t s;
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "", c));  ASSERT_EQ(0u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/jpeg", c));  ASSERT_EQ(1u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/jpeg, image/png", c));  ASSERT_EQ(1u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/png,image/jpeg", c));  ASSERT_EQ(0u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "Image/JPEG", c));  ASSERT_EQ(1u, s);
+
+  // Quality values
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/jpeg;q=0.5, image/png", c));  ASSERT_EQ(0u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/png;q=0.5, image/jpeg ; q=0.8", c));  ASSERT_EQ(1u, s);
+  ASSERT_FALSE(HttpHandler::SelectMediaType(s, "image/jpeg;q=0", c));
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/jpeg;q=0, image/*", c));  ASSERT_EQ(0u, s);
+
+  // Wildcards, the most specific range wins
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/*", c));  ASSERT_EQ(0u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "*/*;q=0.1, image/jpeg", c));  ASSERT_EQ(1u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/webp,image/*;q=0.8,*/*;q=0.5", c));  ASSERT_EQ(0u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/*;q=0.9, image/png;q=0.1", c));  ASSERT_EQ(1u, s);
+  ASSERT_FALSE(HttpHandler::SelectMediaType(s, "text/html", c));
+
+  // Malformed ranges are ignored
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "image/png;q=abc, image/jpeg", c));  ASSERT_EQ(1u, s);
+  ASSERT_TRUE(HttpHandler::SelectMediaType(s, "nope, image/jpeg;q=2, image/png", c));  ASSERT_EQ(0u, s);
+}
+
+namespace
+{
+  class StringHttpOutputStream : public IHttpOutputStream
+  {
+  public:
+    std::string  header_;
+    std::string  body_;
+
+    virtual void OnHttpStatusReceived(HttpStatus status)
+    {
+    }
+
+    virtual void Send(bool isHeader, const void* buffer, size_t length)
+    {
+      (isHeader ? header_ : body_).append(reinterpret_cast<const char*>(buffer), length);
+    }
+
+    virtual bool IsChunkedTransferEncoding() const
+    {
+      return true;
+    }
+  };
+}
+
+TEST(HttpOutput, ChunkedTransfer)
+{
+  StringHttpOutputStream stream;
+
+  {
+    HttpOutput output(stream, true);
+    output.SetContentType("text/event-stream");
+    ASSERT_THROW(output.SendChunk("nope"), OrthancException);
+    output.StartChunkedTransfer();
+    ASSERT_THROW(output.SendBody("nope"), OrthancException);
+    output.SendChunk("Hello");
+    output.SendChunk("");
+    output.SendChunk(std::string(26, 'a'));
+    output.CloseChunkedTransfer();
+    ASSERT_THROW(output.SendChunk("nope"), OrthancException);
+  }
+
+  ASSERT_NE(std::string::npos, stream.header_.find("Transfer-Encoding: chunked\r\n"));
+  ASSERT_EQ(std::string::npos, stream.header_.find("Content-Length"));
+  ASSERT_EQ("\r\n\r\n", stream.header_.substr(stream.header_.size() - 4));
+  ASSERT_EQ("5\r\nHello\r\n1a\r\n" + std::string(26, 'a') + "\r\n0\r\n\r\n", stream.body_);
+}
+
+TEST(HttpOutput, Multipart)
+{
+  StringHttpOutputStream stream;
+
+  {
+    HttpOutput output(stream, true);
+    ASSERT_THROW(output.SendMultipartItem("nope"), OrthancException);
+    output.StartMultipart("related", "application/dicom");
+    ASSERT_TRUE(output.IsWritingMultipart());
+    output.SendMultipartItem("Hello");
+    output.SendMultipartItem("World!");
+    output.CloseMultipart();
+    ASSERT_FALSE(output.IsWritingMultipart());
+    ASSERT_FALSE(output.IsWritingChunks());
+  }
+
+  const std::string prefix = "Content-Type: multipart/related; type=\"application/dicom\"; boundary=";
+  size_t pos = stream.header_.find(prefix);
+  ASSERT_NE(std::string::npos, pos);
+  pos += prefix.size();
+  std::string boundary = stream.header_.substr(pos, stream.header_.find("\r\n", pos) - pos);
+  ASSERT_FALSE(boundary.empty());
+
+  // Remove the framing of the chunked transfer encoding
+  std::string body;
+  for (size_t i = 0; ; )
+  {
+    size_t eol = stream.body_.find("\r\n", i);
+    size_t size = strtoul(stream.body_.substr(i, eol - i).c_str(), NULL, 16);
+    if (size == 0)
+    {
+      break;
+    }
+
+    body += stream.body_.substr(eol + 2, size);
+    i = eol + 2 + size + 2;
+  }
+
+  ASSERT_EQ("\r\n--" + boundary + "\r\n"
+            "Content-Type: application/dicom\r\nContent-Length: 5\r\n\r\nHello"
+            "\r\n--" + boundary + "\r\n"
+            "Content-Type: application/dicom\r\nContent-Length: 6\r\n\r\nWorld!"
+            "\r\n--" + boundary + "--\r\n", body);
+}
+
+TEST(HttpOutput, RangeNotSatisfiable)
+{
+  StringHttpOutputStream stream;
+
+  {
+    HttpOutput output(stream, true);
+    output.AddHeader("X-Orthanc-Rows", "16");
+    ASSERT_THROW(output.SendStatus(HttpStatus_416_RequestedRangeNotSatisfiable), OrthancException);
+    output.SendRangeNotSatisfiable(1234);
+  }
+
+  ASSERT_EQ(0u, stream.header_.find("HTTP/1.1 416 "));
+  ASSERT_NE(std::string::npos, stream.header_.find("Content-Range: bytes */1234\r\n"));
+  ASSERT_EQ(std::string::npos, stream.header_.find("X-Orthanc-Rows"));
+  ASSERT_TRUE(stream.body_.empty());
+}
+
 TEST(RestApi, RestApiPath)
 {
   HttpHandler::Arguments args;
@@ -0,0 +1,132 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersUnitTests.h"
+#include "gtest/gtest.h"
+
+#include "../OrthancServer/RoutingRules.h"
+#include "../Core/OrthancException.h"
+
+#include <json/reader.h>
+
+using namespace Orthanc;
+
+
+static void ParseJson(Json::Value& target,
+                      const char* source)
+{
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(source, target));
+}
+
+
+TEST(RoutingRules, Conditions)
+{
+  Json::Value rules;
+  ParseJson(rules, 
+            "[ { \"Name\" : \"ct\", "
+            "    \"Condition\" : { \"And\" : [ { \"Tag\" : \"Modality\", \"Equals\" : \"CT\" },"
+            "                                  { \"Tag\" : \"CalledAET\", \"Equals\" : \"ORTHANC\" } ] },"
+            "    \"Actions\" : [ { \"Operation\" : \"store-scu\", \"Modality\" : \"pacs\" } ] },"
+            "  { \"Condition\" : { \"Or\" : [ { \"Tag\" : \"0008,0060\", \"In\" : [ \"MR\", \"PT\" ] },"
+            "                                 { \"Tag\" : \"StudyDescription\", \"Matches\" : \"*HEAD*\" } ] },"
+            "    \"Actions\" : [ { \"Operation\" : \"delete\" } ] },"
+            "  { \"Condition\" : { \"Not\" : { \"Tag\" : \"RemoteAET\", \"Matches\" : \"MOD?\" } },"
+            "    \"Actions\" : [ { \"Operation\" : \"delete\" } ] },"
+            "  { \"Actions\" : [ { \"Operation\" : \"delete\" } ] } ]");
+
+  RoutingRules r;
+  r.Load(rules);
+  ASSERT_EQ(4u, r.GetSize());
+  ASSERT_EQ("ct", r.GetName(0));
+  ASSERT_EQ("Rule 2", r.GetName(1));
+
+  DicomMap m;
+  m.SetValue(0x0008, 0x0060, "CT");
+  ASSERT_TRUE(r.Match(0, m, "MOD1", "ORTHANC"));
+  ASSERT_FALSE(r.Match(0, m, "MOD1", "OTHER"));
+  ASSERT_FALSE(r.Match(1, m, "MOD1", "ORTHANC"));
+  ASSERT_FALSE(r.Match(2, m, "MOD1", "ORTHANC"));
+  ASSERT_TRUE(r.Match(2, m, "MODALITY", "ORTHANC"));
+  ASSERT_TRUE(r.Match(3, m, "MOD1", "ORTHANC"));
+
+  m.SetValue(0x0008, 0x1030, "MY HEAD STUDY");
+  ASSERT_TRUE(r.Match(1, m, "MOD1", "ORTHANC"));
+
+  m.Clear();
+  m.SetValue(0x0008, 0x0060, "PT");
+  ASSERT_FALSE(r.Match(0, m, "MOD1", "ORTHANC"));
+  ASSERT_TRUE(r.Match(1, m, "MOD1", "ORTHANC"));
+
+  m.Clear();
+  ASSERT_FALSE(r.Match(0, m, "MOD1", "ORTHANC"));
+  ASSERT_FALSE(r.Match(1, m, "MOD1", "ORTHANC"));
+
+  ASSERT_THROW(r.Match(4, m, "MOD1", "ORTHANC"), OrthancException);
+}
+
+
+TEST(RoutingRules, Operations)
+{
+  Json::Value rule;
+  ParseJson(rule, 
+            "{ \"Actions\" : [ { \"Operation\" : \"store-peer\", \"Peer\" : \"backup\" },"
+            "                  { \"Operation\" : \"modify\", \"Remove\" : [ \"PatientName\" ] },"
+            "                  { \"Operation\" : \"store-scu\", \"Modality\" : \"pacs\" } ] }");
+
+  RoutingRules r;
+  r.AddRule(rule);
+
+  Json::Value operations;
+  r.FormatOperations(operations, 0, "instance");
+  ASSERT_EQ(Json::arrayValue, operations.type());
+  ASSERT_EQ(3u, operations.size());
+  ASSERT_EQ("store-peer", operations[0]["Operation"].asString());
+  ASSERT_EQ("backup", operations[0]["Peer"].asString());
+  ASSERT_EQ("instance", operations[0]["Instance"].asString());
+  ASSERT_EQ("modify", operations[1]["Operation"].asString());
+  ASSERT_EQ("instance", operations[1]["Instance"].asString());
+  ASSERT_EQ("store-scu", operations[2]["Operation"].asString());
+  ASSERT_EQ("", operations[2]["Instance"].asString());
+
+  Json::Value bad;
+  ParseJson(bad, "{ \"Actions\" : [ ] }");
+  ASSERT_THROW(r.AddRule(bad), OrthancException);
+  ParseJson(bad, "{ \"Actions\" : [ { \"Operation\" : \"nope\" } ] }");
+  ASSERT_THROW(r.AddRule(bad), OrthancException);
+  ParseJson(bad, "{ \"Actions\" : [ { \"Operation\" : \"modify\" }, { \"Operation\" : \"modify\" } ] }");
+  ASSERT_THROW(r.AddRule(bad), OrthancException);
+  ParseJson(bad, "{ \"Condition\" : { \"Tag\" : \"Modality\" }, "
+            "\"Actions\" : [ { \"Operation\" : \"delete\" } ] }");
+  ASSERT_THROW(r.AddRule(bad), OrthancException);
+  ASSERT_EQ(1u, r.GetSize());
+}
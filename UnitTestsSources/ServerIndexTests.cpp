@@ -43,6 +43,7 @@
 #include <ctype.h>
 #include <glog/logging.h>
 #include <algorithm>
+#include <stdexcept>
 
 using namespace Orthanc;
 
@@ -509,6 +510,102 @@ TEST_P(DatabaseWrapperTest, Upward)
 }
 
 
+TEST_P(DatabaseWrapperTest, CreateInstance)
+{
+  IDatabaseWrapper::CreateInstanceResult r;
+  int64_t i1, i2, i3;
+
+  ASSERT_TRUE(index_->CreateInstance(r, i1, "patient", "study", "series", "instance1"));
+  ASSERT_TRUE(r.isNewPatient_);
+  ASSERT_TRUE(r.isNewStudy_);
+  ASSERT_TRUE(r.isNewSeries_);
+
+  int64_t parent;
+  ASSERT_TRUE(index_->LookupParent(parent, i1)); ASSERT_EQ(r.seriesId_, parent);
+  ASSERT_TRUE(index_->LookupParent(parent, r.seriesId_)); ASSERT_EQ(r.studyId_, parent);
+  ASSERT_TRUE(index_->LookupParent(parent, r.studyId_)); ASSERT_EQ(r.patientId_, parent);
+
+  const int64_t series = r.seriesId_;
+  ASSERT_TRUE(index_->CreateInstance(r, i2, "patient", "study", "series", "instance2"));
+  ASSERT_FALSE(r.isNewPatient_);
+  ASSERT_FALSE(r.isNewStudy_);
+  ASSERT_FALSE(r.isNewSeries_);
+  ASSERT_EQ(series, r.seriesId_);
+  ASSERT_TRUE(index_->LookupParent(parent, i2)); ASSERT_EQ(series, parent);
+
+  ASSERT_FALSE(index_->CreateInstance(r, i3, "patient", "study", "series", "instance1"));
+  ASSERT_EQ(i1, i3);
+
+  ASSERT_TRUE(index_->CreateInstance(r, i3, "patient", "study2", "series2", "instance3"));
+  ASSERT_FALSE(r.isNewPatient_);
+  ASSERT_TRUE(r.isNewStudy_);
+  ASSERT_TRUE(r.isNewSeries_);
+
+  DicomMap tags;
+  tags.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "1.2.3");
+
+  ResourcesContent content;
+  content.AddMainDicomTags(i1, tags);
+  content.AddMetadata(i1, MetadataType_Instance_RemoteAet, "AET");
+  content.AddAttachment(i1, FileInfo("uuid", FileContentType_Dicom, 42, "md5"));
+  index_->SetResourcesContent(content);
+
+  DicomMap m;
+  index_->GetMainDicomTags(m, i1);
+  ASSERT_EQ("1.2.3", m.GetValue(DICOM_TAG_SOP_INSTANCE_UID).AsString());
+
+  std::string s;
+  ASSERT_TRUE(index_->LookupMetadata(s, i1, MetadataType_Instance_RemoteAet));
+  ASSERT_EQ("AET", s);
+
+  FileInfo info;
+  ASSERT_TRUE(index_->LookupAttachment(info, i1, FileContentType_Dicom));
+  ASSERT_EQ("uuid", info.GetUuid());
+
+  // Compound reads
+  std::list<std::string> children;
+  std::map<MetadataType, std::string> metadata;
+  index_->LookupResourceContent(m, children, metadata, i1);
+  ASSERT_EQ("1.2.3", m.GetValue(DICOM_TAG_SOP_INSTANCE_UID).AsString());
+  ASSERT_TRUE(children.empty());
+  ASSERT_EQ(1u, metadata.size());
+  ASSERT_EQ("AET", metadata[MetadataType_Instance_RemoteAet]);
+
+  index_->LookupResourceContent(m, children, metadata, series);
+  ASSERT_EQ(0u, m.GetSize());
+  ASSERT_EQ(2u, children.size());
+  ASSERT_TRUE(metadata.empty());
+
+  index_->AddAttachment(i1, FileInfo("json", FileContentType_DicomAsJson, 10, "md5b",
+                                     CompressionType_Zlib, 5, "md5c"));
+
+  std::list<FileInfo> attachments;
+  index_->GetAllAttachments(attachments, i1);
+  ASSERT_EQ(2u, attachments.size());
+
+  for (std::list<FileInfo>::const_iterator
+         it = attachments.begin(); it != attachments.end(); ++it)
+  {
+    if (it->GetContentType() == FileContentType_Dicom)
+    {
+      ASSERT_EQ("uuid", it->GetUuid());
+      ASSERT_EQ(42u, it->GetUncompressedSize());
+      ASSERT_EQ(CompressionType_None, it->GetCompressionType());
+    }
+    else
+    {
+      ASSERT_EQ(FileContentType_DicomAsJson, it->GetContentType());
+      ASSERT_EQ("json", it->GetUuid());
+      ASSERT_EQ(5u, it->GetCompressedSize());
+      ASSERT_EQ("md5c", it->GetCompressedMD5());
+    }
+  }
+
+  index_->GetAllAttachments(attachments, i2);
+  ASSERT_TRUE(attachments.empty());
+}
+
+
 TEST_P(DatabaseWrapperTest, PatientRecycling)
 {
   std::vector<int64_t> patients;
@@ -672,6 +769,29 @@ TEST(ServerIndex, Sequence)
 
 
 
+TEST_P(DatabaseWrapperTest, LogChange)
+{
+  int64_t patient = index_->CreateResource("patient", ResourceType_Patient);
+
+  int64_t previous = -1;
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    // The sequence number that is reported to the listeners is the
+    // one that is stored in the log of changes
+    int64_t seq = index_->LogChange(patient, ServerIndexChange(ChangeType_StablePatient, ResourceType_Patient, "patient"));
+    ASSERT_LT(previous, seq);
+
+    std::list<ServerIndexChange> last;
+    index_->GetLastChange(last);
+    ASSERT_EQ(1u, last.size());
+    ASSERT_EQ(seq, last.front().GetSeq());
+    ASSERT_EQ("patient", last.front().GetPublicId());
+
+    previous = seq;
+  }
+}
+
+
 TEST_P(DatabaseWrapperTest, LookupIdentifier)
 {
   int64_t a[] = {
@@ -780,3 +900,227 @@ TEST(ServerIndex, AttachmentRecycling)
   // Because the DB is in memory, the SQLite index must not have been created
   ASSERT_THROW(Toolbox::GetFileSize(path + "/index"), OrthancException);  
 }
+
+
+TEST(ServerIndex, PatientRecycling)
+{
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  ServerContext context(db);
+  ServerIndex& index = context.GetIndex();
+
+  index.SetMaximumPatientCount(2);
+
+  ServerIndex::Attachments attachments;
+  ServerIndex::MetadataMap metadata;
+  std::map<MetadataType, std::string> instanceMetadata;
+
+  std::vector<std::string> patients;
+  for (int i = 0; i < 5; i++)
+  {
+    std::string id = boost::lexical_cast<std::string>(i);
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient-" + id);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study-" + id);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + id);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + id);
+
+    ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, instance, attachments, "", metadata));
+    patients.push_back(DicomInstanceHasher(instance).HashPatient());
+
+    // The recycling takes place before the creation of the new
+    // patient, so that the latter is not counted
+    Json::Value tmp;
+    index.ComputeStatistics(tmp);
+    ASSERT_EQ(std::min(i + 1, 3), tmp["CountPatients"].asInt());
+
+    // Storing the same instance twice must not recycle anything
+    ASSERT_EQ(StoreStatus_AlreadyStored, index.Store(instanceMetadata, instance, attachments, "", metadata));
+    index.ComputeStatistics(tmp);
+    ASSERT_EQ(std::min(i + 1, 3), tmp["CountPatients"].asInt());
+  }
+
+  // The oldest patients have been recycled
+  Json::Value tmp;
+  ASSERT_FALSE(index.LookupResource(tmp, patients[0], ResourceType_Patient));
+  ASSERT_FALSE(index.LookupResource(tmp, patients[1], ResourceType_Patient));
+  ASSERT_TRUE(index.LookupResource(tmp, patients[2], ResourceType_Patient));
+  ASSERT_TRUE(index.LookupResource(tmp, patients[3], ResourceType_Patient));
+  ASSERT_TRUE(index.LookupResource(tmp, patients[4], ResourceType_Patient));
+}
+
+
+namespace
+{
+  class StoredInstanceRecorder : public StoredInstanceDispatcher::IHandler
+  {
+  private:
+    boost::mutex mutex_;
+    boost::condition_variable received_;
+    std::map<std::string, std::string> calledAets_;
+    unsigned int count_;
+    std::string failing_;
+
+  public:
+    StoredInstanceRecorder() : count_(0)
+    {
+    }
+
+    // The callback of this instance throws a non-Orthanc exception
+    void SetFailingInstance(const std::string& instanceId)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      failing_ = instanceId;
+    }
+
+    virtual void SignalStoredInstance(const std::string& instanceId,
+                                      const std::string& remoteAet,
+                                      const std::string& calledAet)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      calledAets_[instanceId] = calledAet;
+      count_++;
+      received_.notify_all();
+
+      if (instanceId == failing_)
+      {
+        throw std::runtime_error("Failing callback");
+      }
+    }
+
+    // Waits for at most 10 seconds until "count" events are received
+    bool WaitCount(unsigned int count)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      boost::system_time timeout = boost::get_system_time() + boost::posix_time::seconds(10);
+
+      while (count_ < count)
+      {
+        if (!received_.timed_wait(lock, timeout))
+        {
+          return count_ >= count;
+        }
+      }
+
+      return true;
+    }
+
+    unsigned int GetCount()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return count_;
+    }
+
+    std::string GetCalledAet(const std::string& instanceId)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return calledAets_[instanceId];
+    }
+  };
+}
+
+
+TEST(StoredInstanceDispatcher, Basic)
+{
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  ServerContext context(db);
+  ServerIndex& index = context.GetIndex();
+  ServerIndex::Attachments attachments;
+
+  std::vector<std::string> ids;
+  for (int i = 0; i < 5; i++)
+  {
+    std::string id = boost::lexical_cast<std::string>(i);
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient-" + id);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study-" + id);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + id);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + id);
+
+    std::map<MetadataType, std::string> instanceMetadata;
+    ServerIndex::MetadataMap metadata;
+    metadata[std::make_pair(ResourceType_Instance, MetadataType_Instance_CalledAet)] = "AET" + id;
+    ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, instance, attachments, "", metadata));
+
+    ids.push_back(DicomInstanceHasher(instance).HashInstance());
+
+    if (i == 1)
+    {
+      // The first startup ignores the instances that are already
+      // stored: The position in the log is set by Start()
+      StoredInstanceRecorder recorder;
+      StoredInstanceDispatcher dispatcher(index, recorder, 2, 10);
+      dispatcher.Start();
+
+      Json::Value statistics;
+      dispatcher.GetStatistics(statistics);
+      ASSERT_EQ(0, statistics["PendingChanges"].asInt());
+
+      dispatcher.Stop();
+      ASSERT_EQ(0u, recorder.GetCount());
+    }
+  }
+
+  {
+    // Deliver the 3 instances stored after the first startup. An
+    // exception in one callback does not stop the delivery.
+    StoredInstanceRecorder recorder;
+    recorder.SetFailingInstance(ids[2]);
+
+    StoredInstanceDispatcher dispatcher(index, recorder, 2, 1);
+    dispatcher.Start();
+    ASSERT_TRUE(recorder.WaitCount(3));
+    dispatcher.Stop();   // Waits for the end of the delivery
+
+    ASSERT_EQ(3u, recorder.GetCount());
+    ASSERT_EQ("", recorder.GetCalledAet(ids[1]));
+    ASSERT_EQ("AET2", recorder.GetCalledAet(ids[2]));
+    ASSERT_EQ("AET4", recorder.GetCalledAet(ids[4]));
+
+    // Duplicates are queued in memory. As the dispatcher is stopped,
+    // those above the maximum size of the queue are dropped.
+    dispatcher.SignalDuplicateInstance(ids[0], "REMOTE", "DUPLICATE");
+    dispatcher.SignalDuplicateInstance(ids[1], "REMOTE", "DUPLICATE");
+    dispatcher.Start();
+    ASSERT_TRUE(recorder.WaitCount(4));
+    dispatcher.Stop();
+
+    ASSERT_EQ(4u, recorder.GetCount());
+    ASSERT_EQ("DUPLICATE", recorder.GetCalledAet(ids[0]));
+    ASSERT_EQ("", recorder.GetCalledAet(ids[1]));
+
+    Json::Value statistics;
+    dispatcher.GetStatistics(statistics);
+    ASSERT_EQ(0, statistics["PendingChanges"].asInt());
+    ASSERT_EQ("4", statistics["Delivered"].asString());
+    ASSERT_EQ("1", statistics["Dropped"].asString());
+
+    // While the dispatcher is running, a full queue blocks the sender
+    // of the duplicates instead of dropping the events
+    dispatcher.Start();
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      dispatcher.SignalDuplicateInstance(ids[i], "REMOTE", "BLOCKING");
+    }
+
+    ASSERT_TRUE(recorder.WaitCount(static_cast<unsigned int>(4 + ids.size())));
+    dispatcher.Stop();
+
+    dispatcher.GetStatistics(statistics);
+    ASSERT_EQ("1", statistics["Dropped"].asString());
+    ASSERT_EQ("BLOCKING", recorder.GetCalledAet(ids[3]));
+  }
+
+  {
+    // The position in the log of changes is persistent
+    StoredInstanceRecorder recorder;
+    StoredInstanceDispatcher dispatcher(index, recorder, 0, 10);
+    dispatcher.Start();
+
+    Json::Value statistics;
+    dispatcher.GetStatistics(statistics);
+    ASSERT_EQ(0, statistics["PendingChanges"].asInt());
+
+    dispatcher.Stop();
+    ASSERT_EQ(0u, recorder.GetCount());
+  }
+}
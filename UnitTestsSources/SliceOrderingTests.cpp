@@ -0,0 +1,185 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2015 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersUnitTests.h"
+#include "gtest/gtest.h"
+
+#include "../OrthancServer/SliceOrdering.h"
+#include "../Core/OrthancException.h"
+
+#include <json/value.h>
+
+using namespace Orthanc;
+
+
+static Json::Value MakeSlice(const char* position,
+                             const char* orientation,
+                             const char* number)
+{
+  Json::Value tags = Json::objectValue;
+
+  if (position != NULL)
+  {
+    tags["ImagePositionPatient"] = position;
+  }
+
+  if (orientation != NULL)
+  {
+    tags["ImageOrientationPatient"] = orientation;
+  }
+
+  if (number != NULL)
+  {
+    tags["InstanceNumber"] = number;
+  }
+
+  return tags;
+}
+
+
+TEST(SliceOrdering, Position)
+{
+  // Axial slices, whose instance numbers are in the reverse order
+  SliceOrdering o;
+  o.AddInstance("b", MakeSlice("-100\\-100\\12.5", "1\\0\\0\\0\\1\\0", "1"));
+  o.AddInstance("c", MakeSlice("-100\\-100\\15", "1\\0\\0\\0\\1\\0 ", "0"));
+  o.AddInstance("a", MakeSlice("-100\\-100\\10", "1\\0\\0\\0\\1\\0", "2"));
+  o.Sort();
+
+  ASSERT_EQ(SliceOrdering::Method_Position, o.GetMethod());
+  ASSERT_EQ(3u, o.GetSlicesCount());
+  ASSERT_EQ("a", o.GetInstanceId(0));
+  ASSERT_EQ("b", o.GetInstanceId(1));
+  ASSERT_EQ("c", o.GetInstanceId(2));
+  ASSERT_EQ(0u, o.GetFrame(2));
+  ASSERT_THROW(o.GetInstanceId(3), OrthancException);
+
+  ASSERT_DOUBLE_EQ(0, o.GetNormal()[0]);
+  ASSERT_DOUBLE_EQ(0, o.GetNormal()[1]);
+  ASSERT_DOUBLE_EQ(1, o.GetNormal()[2]);
+  ASSERT_DOUBLE_EQ(10, o.GetPosition(0)[2]);
+  ASSERT_DOUBLE_EQ(1, o.GetOrientation()[0]);
+
+  double spacing;
+  ASSERT_TRUE(o.ComputeSpacingBetweenSlices(spacing));
+  ASSERT_DOUBLE_EQ(2.5, spacing);
+}
+
+
+TEST(SliceOrdering, Fallback)
+{
+  {
+    // Different orientations: Fallback to the instance numbers
+    SliceOrdering o;
+    o.AddInstance("b", MakeSlice("0\\0\\1", "1\\0\\0\\0\\1\\0", " 12"));
+    o.AddInstance("a", MakeSlice("0\\0\\0", "1\\0\\0\\0\\0\\1", "3"));
+    o.Sort();
+
+    ASSERT_EQ(SliceOrdering::Method_InstanceNumber, o.GetMethod());
+    ASSERT_EQ("a", o.GetInstanceId(0));
+    ASSERT_EQ("b", o.GetInstanceId(1));
+    ASSERT_THROW(o.GetNormal(), OrthancException);
+
+    double spacing;
+    ASSERT_FALSE(o.ComputeSpacingBetweenSlices(spacing));
+  }
+
+  {
+    // Missing positions and instance numbers: Order of insertion
+    SliceOrdering o;
+    o.AddInstance("b", MakeSlice(NULL, NULL, "2"));
+    o.AddInstance("c", MakeSlice(NULL, NULL, NULL));
+    o.AddInstance("a", MakeSlice("0\\0", NULL, "1"));
+    o.Sort();
+
+    ASSERT_EQ(SliceOrdering::Method_None, o.GetMethod());
+    ASSERT_EQ("b", o.GetInstanceId(0));
+    ASSERT_EQ("c", o.GetInstanceId(1));
+    ASSERT_EQ("a", o.GetInstanceId(2));
+  }
+
+  {
+    SliceOrdering o;
+    o.Sort();
+    ASSERT_EQ(SliceOrdering::Method_None, o.GetMethod());
+    ASSERT_EQ(0u, o.GetSlicesCount());
+  }
+}
+
+
+TEST(SliceOrdering, Multiframe)
+{
+  SliceOrdering o;
+
+  Json::Value tags = MakeSlice("0\\0\\5", "1\\0\\0\\0\\1\\0", "2");
+  tags["NumberOfFrames"] = "3";
+  o.AddInstance("b", tags);
+  o.AddInstance("a", MakeSlice("0\\0\\0", "1\\0\\0\\0\\1\\0", "1"));
+  o.Sort();
+
+  ASSERT_EQ(SliceOrdering::Method_Position, o.GetMethod());
+  ASSERT_EQ(4u, o.GetSlicesCount());
+  ASSERT_EQ("a", o.GetInstanceId(0));
+  ASSERT_EQ(0u, o.GetFrame(0));
+  ASSERT_EQ("b", o.GetInstanceId(1));
+  ASSERT_EQ(0u, o.GetFrame(1));
+  ASSERT_EQ("b", o.GetInstanceId(3));
+  ASSERT_EQ(2u, o.GetFrame(3));
+
+  // The spacing between the frames is unknown
+  double spacing;
+  ASSERT_FALSE(o.ComputeSpacingBetweenSlices(spacing));
+}
+
+
+TEST(SliceOrdering, MaximumFrames)
+{
+  SliceOrdering o(10);
+
+  Json::Value tags = MakeSlice("0\\0\\0", "1\\0\\0\\0\\1\\0", "1");
+  tags["NumberOfFrames"] = "10";
+  ASSERT_TRUE(o.AddInstance("a", tags));
+  ASSERT_EQ(10u, o.GetFramesCount());
+
+  tags["NumberOfFrames"] = "11";
+  ASSERT_FALSE(o.AddInstance("b", tags));
+  ASSERT_EQ(10u, o.GetFramesCount());
+
+  o.Sort();
+  ASSERT_EQ(10u, o.GetSlicesCount());
+
+  SliceOrdering unlimited;
+  tags["NumberOfFrames"] = "100000";
+  ASSERT_TRUE(unlimited.AddInstance("c", tags));
+  ASSERT_TRUE(unlimited.AddInstance("d", tags));
+  ASSERT_EQ(200000u, unlimited.GetFramesCount());
+}
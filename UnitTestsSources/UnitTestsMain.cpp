@@ -34,9 +34,11 @@
 #include "../Core/EnumerationDictionary.h"
 
 #include "gtest/gtest.h"
+#include "BenchmarkTimer.h"
 
 #include <ctype.h>
 
+#include "../Core/BufferPool.h"
 #include "../Core/Compression/ZlibCompressor.h"
 #include "../Core/DicomFormat/DicomTag.h"
 #include "../Core/HttpServer/HttpHandler.h"
@@ -421,6 +423,29 @@ TEST(Toolbox, ComputeSHA1)
   ASSERT_EQ("da39a3ee-5e6b4b0d-3255bfef-95601890-afd80709", s);
 }
 
+TEST(Toolbox, ComputeSHA1Accelerated)
+{
+  const bool accelerated = Toolbox::IsSHA1Accelerated();
+
+  // All the lengths around the padding of the blocks, with both
+  // implementations
+  std::string data;
+  for (unsigned int i = 0; i < 300; i++)
+  {
+    std::string a, b;
+    Toolbox::SetSHA1Accelerated(false);
+    ASSERT_FALSE(Toolbox::IsSHA1Accelerated());
+    Toolbox::ComputeSHA1(a, data);
+    Toolbox::SetSHA1Accelerated(true);
+    Toolbox::ComputeSHA1(b, data);
+    ASSERT_EQ(a, b);
+
+    data.push_back(static_cast<char>(i * 37));
+  }
+
+  Toolbox::SetSHA1Accelerated(accelerated);
+}
+
 
 static std::string EncodeBase64Bis(const std::string& s)
 {
@@ -516,6 +541,63 @@ TEST(Toolbox, ConvertFromLatin1)
   ASSERT_EQ(0x00, static_cast<unsigned char>(utf8[14]));  // Null-terminated string
 }
 
+
+#include "../Resources/EncodingTests.h"
+
+TEST(Toolbox, ConvertToUtf8)
+{
+  // The 7-bit strings are returned as such, except in Shift-JIS
+  ASSERT_EQ("Hello\\World", Toolbox::ConvertToUtf8("Hello\\World", Encoding_Latin1));
+  ASSERT_EQ("Hello\\World", Toolbox::ConvertToUtf8("Hello\\World", Encoding_Chinese));
+  ASSERT_EQ("Hello\xc2\xa5World", Toolbox::ConvertToUtf8("Hello\\World", Encoding_Japanese));
+
+  // Invalid input bytes are skipped
+  ASSERT_EQ("Test", Toolbox::ConvertToUtf8("Test\x81", Encoding_Chinese));
+
+  // The cached converters give the same results once reused
+  for (unsigned int j = 0; j < 3; j++)
+  {
+    for (unsigned int i = 0; i < testEncodingsCount; i++)
+    {
+      ASSERT_EQ(std::string(testEncodingsExpected[i]), 
+                Toolbox::ConvertToUtf8(testEncodingsEncoded[i], testEncodings[i]));
+    }
+  }
+}
+
+
+TEST(Toolbox, DISABLED_BenchmarkConvertToUtf8)
+{
+  static const unsigned int COUNT = 100000;
+
+  for (unsigned int i = 0; i < testEncodingsCount; i++)
+  {
+    // Short values, as found in the DICOM tags
+    const std::string source(testEncodingsEncoded[i]);
+
+    BenchmarkTimer timer;
+    for (unsigned int j = 0; j < COUNT; j++)
+    {
+      Toolbox::ConvertToUtf8(source, testEncodings[i]);
+    }
+    printf("%-12s %8.2f MB/s\n", EnumerationToString(testEncodings[i]),
+           static_cast<double>(COUNT * source.size()) / timer.GetElapsedMicroseconds());
+  }
+
+  {
+    const std::string source("1.2.840.113619.2.55.3.604688119");
+
+    BenchmarkTimer timer;
+    for (unsigned int j = 0; j < COUNT; j++)
+    {
+      Toolbox::ConvertToUtf8(source, Encoding_Latin1);
+    }
+    printf("%-12s %8.2f MB/s\n", "7-bit",
+           static_cast<double>(COUNT * source.size()) / timer.GetElapsedMicroseconds());
+  }
+}
+
+
 TEST(Toolbox, UrlDecode)
 {
   std::string s;
@@ -586,6 +668,7 @@ TEST(EnumerationDictionary, ServerEnumerations)
 
   ASSERT_EQ("IndexInSeries", EnumerationToString(MetadataType_Instance_IndexInSeries));
   ASSERT_EQ("LastUpdate", EnumerationToString(MetadataType_LastUpdate));
+  ASSERT_EQ("CalledAET", EnumerationToString(MetadataType_Instance_CalledAet));
 
   ASSERT_EQ(ResourceType_Patient, StringToResourceType("PATienT"));
   ASSERT_EQ(ResourceType_Study, StringToResourceType("STudy"));
@@ -789,6 +872,70 @@ TEST(Toolbox, IsInteger)
 }
 
 
+TEST(BufferPool, Basic)
+{
+  BufferPool pool;
+  BufferPool::Statistics s;
+
+  // Small buffers are not pooled
+  void* a = pool.Allocate(100);
+  pool.Release(a, 100);
+  ASSERT_EQ(NULL, pool.Allocate(0));
+  pool.GetStatistics(s);
+  ASSERT_EQ(2u, s.allocations_);
+  ASSERT_EQ(0u, s.idleCount_);
+
+  // Buffers of the same bucket are reused
+  a = pool.Allocate(100000);
+  memset(a, 0, 100000);
+  pool.GetStatistics(s);
+  ASSERT_LE(100000u, s.usedSize_);
+  ASSERT_GE(125000u, s.usedSize_);  // At most 25% of overhead
+  pool.Release(a, 100000);
+
+  pool.GetStatistics(s);
+  ASSERT_EQ(0u, s.usedSize_);
+  ASSERT_EQ(1u, s.idleCount_);
+  ASSERT_LE(100000u, s.idleSize_);
+
+  void* b = pool.Allocate(100001);
+  ASSERT_EQ(a, b);
+  pool.GetStatistics(s);
+  ASSERT_EQ(1u, s.hits_);
+  ASSERT_EQ(0u, s.idleCount_);
+
+  void* c = pool.Allocate(300000);
+  ASSERT_NE(b, c);
+  pool.Release(b, 100001);
+  pool.Release(c, 300000);
+
+  pool.GetStatistics(s);
+  ASSERT_EQ(2u, s.idleCount_);
+  ASSERT_EQ(0u, s.usedSize_);
+
+  // The cap on the idle buffers
+  pool.SetMaximumIdleSize(200000);
+  pool.GetStatistics(s);
+  ASSERT_EQ(0u, s.idleCount_);
+  ASSERT_EQ(200000u, s.maximumIdleSize_);
+
+  a = pool.Allocate(300000);
+  pool.Release(a, 300000);
+  pool.GetStatistics(s);
+  ASSERT_EQ(0u, s.idleCount_);
+
+  a = pool.Allocate(100000);
+  pool.Release(a, 100000);
+  pool.GetStatistics(s);
+  ASSERT_EQ(1u, s.idleCount_);
+
+  pool.Clear();
+  pool.GetStatistics(s);
+  ASSERT_EQ(0u, s.idleCount_);
+  ASSERT_EQ(0u, s.idleSize_);
+}
+
+
 int main(int argc, char **argv)
 {
   // Initialize Google's logging library.